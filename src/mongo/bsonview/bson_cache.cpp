@@ -0,0 +1,178 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/bson_cache.h"
+
+#include <algorithm>
+
+#include "mongo/bsonview/bson_file_set.h"
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+BSONCache::BSONCache(const char* base, const char* end)
+: _base(base), _end(end), _complete(false)
+{
+    _docs.push_back(BSONObj(base));
+}
+
+void BSONCache::init(const char* base, const char* end) {
+    _base = base;
+    _end = end;
+    _complete = false;
+    _docs.clear();
+    _docs.push_back(BSONObj(base));
+}
+
+void BSONCache::init(BSONFileSet* files) {
+    _files = files;
+    _base = nullptr;
+    _end = nullptr;
+    _complete = false;
+    _docs.clear();
+    _fileFirstDocs.clear();
+    _file = 0;
+    _nextFile();
+    if ( ! isComplete()) {
+        _loadNextOfFiles();
+    }
+}
+
+size_t BSONCache::sizeOfFile() const {
+    return _files ? _files->totalSize() : _getEnd() - _getBase();
+}
+
+size_t BSONCache::sizeOfFileSeen() const {
+    if (_files) {
+        if (isComplete()) {
+            return sizeOfFile();
+        }
+        const bool started = (_docs.size() > _fileFirstDocs.back());
+        return _files->sizeOfFilesBefore(_file) + (started ? _getNextBase() - _getBase() : 0);
+    }
+    return _getNextBase() - _getBase();
+}
+
+size_t BSONCache::numFiles() const {
+    return _files ? _files->numFiles() : 1;
+}
+
+size_t BSONCache::fileOf(unsigned long doc) const {
+    if ( ! _files) {
+        return 0;
+    }
+    // empty files have the same first doc as the file after them, which is the one it's in
+    return std::upper_bound(_fileFirstDocs.begin(), _fileFirstDocs.end(), doc) - _fileFirstDocs.begin() - 1;
+}
+
+void BSONCache::loadAll(std::function<void(void)> cb) {
+    unsigned long i = 0;
+    while ( ! isComplete()) {
+        _loadNext();
+        if (i % 1000 == 0) {
+            cb();
+        }
+        i++;
+    }
+}
+
+void BSONCache::loadSome(unsigned long maxDocs) {
+    unsigned long i = 0;
+    while ( ! isComplete() && i < maxDocs) {
+        _loadNext();
+        i++;
+    }
+}
+
+void BSONCache::getLoadedDocs(unsigned long begin, unsigned long end, std::vector<BSONObj>* out) const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    invariant(end <= _docs.size());
+    out->assign(_docs.begin() + begin, _docs.begin() + end);
+}
+
+void BSONCache::_loadNext() {
+    if (_files) {
+        _loadNextOfFiles();
+        return;
+    }
+    if ( ! isComplete()) {
+        auto nextBase = _getNextBase();
+        // TODO: catch bson exceptions and don't abort the whole program on them
+        BSONObj next(nextBase);
+
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _docs.push_back(next);
+
+        nextBase = _getNextBase();
+        if (nextBase >= _getEnd()) {
+            _complete = true;
+        }
+    }
+}
+
+void BSONCache::_loadNextOfFiles() {
+    if (isComplete()) {
+        return;
+    }
+    // the offsets only cover what looks like docs, so a truncated doc at the end is left out
+    BSONObj next(_base + _fileOffsets[_nextFileOffset++]);
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _docs.push_back(next);
+    }
+    if (_nextFileOffset == _fileOffsets.size()) {
+        _file++;
+        _nextFile();
+    }
+}
+
+void BSONCache::_nextFile() {
+    for (; _file < _files->numFiles(); _file++) {
+        _fileFirstDocs.push_back(_docs.size());
+        auto base = _files->map(_file);
+        if ( ! base.isOK()) {
+            // unreadable (or empty), so it has no docs
+            continue;
+        }
+        _files->takeOffsets(_file, &_fileOffsets);
+        if (_fileOffsets.empty()) {
+            continue;
+        }
+        _nextFileOffset = 0;
+        _base = base.getValue();
+        _end = _base + _files->fileSize(_file);
+        return;
+    }
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    _complete = true;
+}
+
+}  // namespace mongo
@@ -0,0 +1,195 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/stdx/mutex.h"
+
+namespace mongo {
+
+class BSONFileSet;
+
+/**
+ * The docs of a (mapped) BSON file, which are found by walking the file from the start.  Docs are
+ * loaded on demand, as they're asked for, or in batches by the UI thread in between events, so a
+ * big file can be viewed before it's all been walked.
+ */
+class BSONCache {
+
+public:
+    BSONCache()
+    : _base(nullptr), _end(nullptr), _complete(false)
+    {
+    }
+
+    BSONCache(const char* base, const char* end);
+
+    void init(const char* base, const char* end);
+
+    // The docs of all the files, one file after another.  Each file is only mapped once loading
+    // gets to it, and if the set's indexing threads have walked it already, its docs are loaded
+    // from their offsets.  The set must outlive the cache.
+    void init(BSONFileSet* files);
+
+    const BSONObj& operator[](unsigned long index) {
+        _loadTo(index);
+        return _docs[index];
+    }
+
+    bool isComplete() const {
+        return _complete;
+    }
+
+    unsigned long numDocs() const {
+        return _docs.size();
+    }
+
+    void loadAll(std::function<void(void)> cb = [] () {});
+
+    // TODO: convert the limit to be a Duration
+    void loadSome(unsigned long maxDocs = 100);
+
+    // The whole file, including any docs that aren't loaded yet.  With several files, it's just
+    // the one being loaded.
+    const char* fileBegin() const {
+        return _getBase();
+    }
+
+    const char* fileEnd() const {
+        return _getEnd();
+    }
+
+    // With several files, these are of all of them.
+    size_t sizeOfFile() const;
+
+    size_t sizeOfFileSeen() const;
+
+    // Null unless the docs are from several files.
+    const BSONFileSet* getFileSet() const {
+        return _files;
+    }
+
+    size_t numFiles() const;
+
+    // Which file a loaded doc is in.
+    size_t fileOf(unsigned long doc) const;
+
+    // The number of the first doc of a file that loading has got to (which, for an empty file, is
+    // the first doc of the file after it).
+    unsigned long firstDocOfFile(size_t file) const {
+        return _fileFirstDocs[file];
+    }
+
+    // Of every file that loading has got to, in order.
+    const std::vector<unsigned long>& getFileFirstDocs() const {
+        return _fileFirstDocs;
+    }
+
+    double percOfFileSeen() const {
+        return ((double)sizeOfFileSeen()) / ((double)sizeOfFile()) * 100.0;
+    }
+
+    // The offset table, ie. a BSONObj per loaded doc.
+    size_t memoryUsage() const {
+        return _docs.capacity() * sizeof(BSONObj) + _fileFirstDocs.capacity() * sizeof(unsigned long) +
+            _fileOffsets.capacity() * sizeof(size_t);
+    }
+
+    // The docs are only ever loaded by the UI thread, so it doesn't need any locking.  Background
+    // threads must instead use the following methods, which are safe to call concurrently with
+    // loading.
+
+    void getLoadProgress(unsigned long* numDocs, bool* complete) const {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        *numDocs = _docs.size();
+        *complete = _complete;
+    }
+
+    // Copies out the docs in [begin, end), which must already be loaded.  The BSONObjs point
+    // straight into the mapped file, so this is cheap.
+    void getLoadedDocs(unsigned long begin, unsigned long end, std::vector<BSONObj>* out) const;
+
+private:
+
+    void _loadTo(unsigned long index) {
+        while (index >= _docs.size()) {
+            _loadNext();
+        }
+    }
+
+    const BSONObj& _getLast() const {
+        return _docs.back();
+    }
+
+    const BSONObj& _getFirst() const {
+        return _docs.front();
+    }
+
+    const char* _getBase() const {
+        return _base;
+    }
+
+    const char* _getEnd() const {
+        return _end;
+    }
+
+    const char* _getNextBase() const {
+        auto last = _getLast();
+        return last.objdata() + last.objsize();
+    }
+
+    void _loadNext();
+
+    void _loadNextOfFiles();
+
+    // Moves on to the next file with any docs in it, or if there are none, is complete.
+    void _nextFile();
+
+    std::vector<BSONObj> _docs;
+    const char* _base;
+    const char* _end;
+    bool _complete;
+
+    // With several files, _base and _end are the file being loaded.
+    BSONFileSet* _files = nullptr;
+    size_t _file = 0;
+    std::vector<unsigned long> _fileFirstDocs;  // of each file that loading has got to
+    std::vector<size_t> _fileOffsets;  // of the current file's docs
+    size_t _nextFileOffset = 0;
+
+    // Protects _docs and _complete against concurrent modification while a background thread is
+    // reading them.  Not needed for reads on the UI thread.
+    mutable stdx::mutex _mutex;
+};
+
+}  // namespace mongo
@@ -0,0 +1,439 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/bson_diff.h"
+
+#include <algorithm>
+#include <third_party/murmurhash3/MurmurHash3.h>
+
+#include "mongo/base/data_view.h"
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/hasher.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+constexpr unsigned long BSONDiff::kBatchSize;
+constexpr size_t BSONDiff::kNumPartitions;
+constexpr uint64_t BSONDiff::kSideBit;
+
+namespace {
+
+const char* const kFileNames[] = {"first file", "second file"};
+
+void appendResult(std::string* results, const BSONObj& result) {
+    results->append(result.objdata(), result.objsize());
+}
+
+void diffFieldsAt(const std::string& prefix,
+                  const BSONObj& a,
+                  const BSONObj& b,
+                  std::string* results) {
+    const auto pathOf = [&](StringData name) {
+        return prefix.empty() ? name.toString() : prefix + "." + name;
+    };
+
+    // the fields in both, in the order of each doc
+    std::vector<StringData> aCommon;
+    std::vector<StringData> bCommon;
+
+    for (auto&& aElem : a) {
+        BSONElement bElem = b.getField(aElem.fieldNameStringData());
+        if (bElem.eoo()) {
+            BSONObjBuilder result;
+            result.append("path", pathOf(aElem.fieldNameStringData()));
+            result.append("change", "removed");
+            result.appendAs(aElem, "from");
+            appendResult(results, result.obj());
+            continue;
+        }
+        aCommon.push_back(aElem.fieldNameStringData());
+        if (aElem.type() == bElem.type() && (aElem.type() == Object || aElem.type() == Array)) {
+            diffFieldsAt(pathOf(aElem.fieldNameStringData()),
+                         aElem.embeddedObject(),
+                         bElem.embeddedObject(),
+                         results);
+        } else if (!aElem.binaryEqualValues(bElem)) {
+            BSONObjBuilder result;
+            result.append("path", pathOf(aElem.fieldNameStringData()));
+            result.append("change", "changed");
+            result.appendAs(aElem, "from");
+            result.appendAs(bElem, "to");
+            appendResult(results, result.obj());
+        }
+    }
+
+    for (auto&& bElem : b) {
+        if (!a.hasField(bElem.fieldNameStringData())) {
+            BSONObjBuilder result;
+            result.append("path", pathOf(bElem.fieldNameStringData()));
+            result.append("change", "added");
+            result.appendAs(bElem, "to");
+            appendResult(results, result.obj());
+            continue;
+        }
+        bCommon.push_back(bElem.fieldNameStringData());
+    }
+
+    if (aCommon != bCommon) {
+        appendResult(results, BSON("path" << prefix << "change"
+                                          << "reordered"));
+    }
+}
+
+}  // namespace
+
+bool BSONDiff::Difference::operator<(const Difference& other) const {
+    // the added docs go last, since they're only in the second file
+    const bool added = (change == Change::kAdded);
+    const bool otherAdded = (other.change == Change::kAdded);
+    if (added != otherAdded) {
+        return otherAdded;
+    }
+    return added ? otherDoc < other.otherDoc : doc < other.doc;
+}
+
+BSONDiff::BSONDiff(const char* aBegin,
+                   const char* aEnd,
+                   const char* bBegin,
+                   const char* bEnd,
+                   const std::string& tempDir,
+                   size_t maxMemoryUsageBytes)
+    : _begin{aBegin, bBegin},
+      _end{aEnd, bEnd},
+      _maxMemoryUsageBytes(maxMemoryUsageBytes),
+      _partitions(std::make_unique<Partitions>(tempDir, "bv-diff")) {}
+
+BSONDiff::~BSONDiff() {
+    _stop.store(true);
+    _batchesAvailable.notify_all();
+    _memoryAvailable.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void BSONDiff::start(unsigned numThreads) {
+    invariant(!_thread.joinable());
+    _thread = stdx::thread([this, numThreads]() { _run(numThreads); });
+}
+
+double BSONDiff::percentHashed() const {
+    const size_t total = (_end[0] - _begin[0]) + (_end[1] - _begin[1]);
+    return (total == 0) ? 100.0 : 100.0 * _bytesHashed.load() / total;
+}
+
+void BSONDiff::_run(unsigned numThreads) {
+    const unsigned numHashers = (numThreads > 3) ? numThreads - 2 : 1;
+    // Half of the limit is for buffering while hashing, which is also the most that can be left
+    // in memory once hashing is done.  The other half is for the spilled partitions being joined.
+    _threadBufferEntries =
+        std::max<size_t>(kNumPartitions, _maxMemoryUsageBytes / 2 / numHashers / sizeof(Entry));
+    _numWalking = 2;
+
+    std::vector<stdx::thread> threads;
+    threads.emplace_back([this]() { _walk(0); });
+    threads.emplace_back([this]() { _walk(1); });
+    for (unsigned i = 0; i < numHashers; i++) {
+        threads.emplace_back([this]() { _hashWorker(); });
+    }
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+
+    if (_status.isOK()) {
+        threads.clear();
+        for (unsigned i = 0; i < std::max(numThreads, 1U); i++) {
+            threads.emplace_back([this]() { _checkWorker(); });
+        }
+        for (auto&& thread : threads) {
+            thread.join();
+        }
+    }
+    _partitions.reset();
+
+    if (_status.isOK()) {
+        std::sort(_differences.begin(), _differences.end());
+        _report();
+    }
+    _differences.clear();
+    _differences.shrink_to_fit();
+    _done.store(true);
+}
+
+void BSONDiff::_walk(int side) {
+    // Only reads the size of each doc, so it keeps well ahead of the hashing, and is what pulls
+    // the file in from the disk.
+    const char* const end = _end[side];
+    const char* next = _begin[side];
+    Batch batch{side ? kSideBit : 0, next, next};
+    unsigned long numInBatch = 0;
+    while (next < end && !_stop.load()) {
+        int size = 0;
+        if (end - next >= 4) {
+            size = ConstDataView(next).read<LittleEndian<int>>();
+        }
+        if (size < BSONObj::kMinBSONLength || size > end - next) {
+            _fail(Status(ErrorCodes::InvalidBSON,
+                         str::stream() << "Invalid BSON document at offset " << (next - _begin[side])
+                                       << " of the " << kFileNames[side]));
+            break;
+        }
+        next += size;
+        if (++numInBatch == kBatchSize || next >= end) {
+            batch.end = next;
+            {
+                stdx::lock_guard<stdx::mutex> lk(_mutex);
+                _batches.push_back(batch);
+            }
+            _batchesAvailable.notify_one();
+            batch.firstDoc += numInBatch;
+            batch.begin = next;
+            numInBatch = 0;
+        }
+    }
+
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _numWalking--;
+    }
+    _batchesAvailable.notify_all();
+}
+
+bool BSONDiff::_nextBatch(Batch* batch) {
+    stdx::unique_lock<stdx::mutex> lk(_mutex);
+    _batchesAvailable.wait(
+        lk, [&]() { return _stop.load() || !_batches.empty() || _numWalking == 0; });
+    uassert(ErrorCodes::Interrupted, "Diff was interrupted", !_stop.load());
+    if (_batches.empty()) {
+        return false;
+    }
+    *batch = _batches.front();
+    _batches.pop_front();
+    return true;
+}
+
+void BSONDiff::_hashWorker() {
+    try {
+        auto buffers = Partitions::makeBuffers();
+        size_t numBuffered = 0;
+        Batch batch;
+        while (_nextBatch(&batch)) {
+            const int side = (batch.firstDoc & kSideBit) ? 1 : 0;
+            uint64_t doc = batch.firstDoc;
+            for (const char* next = batch.begin; next < batch.end; doc++) {
+                BSONObj obj(next);
+                next += obj.objsize();
+                BSONElement id = obj["_id"];
+                if (id.eoo()) {
+                    _numWithoutId.fetchAndAdd(1);
+                    continue;
+                }
+                uint64_t contentHash[2];
+                MurmurHash3_x64_128(obj.objdata(), obj.objsize(), 0, contentHash);
+                const Entry entry{static_cast<uint64_t>(BSONElementHasher::hash64(id, 0)),
+                                  contentHash[0],
+                                  static_cast<uint64_t>(obj.objdata() - _begin[side]),
+                                  doc};
+                buffers[Partitions::partitionOf(entry)].push_back(entry);
+                numBuffered++;
+            }
+            _bytesHashed.fetchAndAdd(batch.end - batch.begin);
+            if (numBuffered >= _threadBufferEntries) {
+                _partitions->spill(&buffers);
+                numBuffered = 0;
+            }
+        }
+
+        // whatever is left fits in this thread's share of the limit
+        _partitions->keep(&buffers);
+    } catch (const DBException& e) {
+        _fail(e.toStatus());
+    }
+}
+
+void BSONDiff::_checkWorker() {
+    const size_t limit = _maxMemoryUsageBytes / 2;
+    while (true) {
+        const size_t p = _nextPartition.fetchAndAdd(1);
+        if (p >= kNumPartitions) {
+            return;
+        }
+        // hashing is done, so the partitions don't change any more
+        const size_t bytes = _partitions->spilledBytes(p);
+
+        {
+            // a partition bigger than the whole limit still gets joined, on its own
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+            _memoryAvailable.wait(lk, [&]() {
+                return _stop.load() || _checkMemoryUsed == 0 || _checkMemoryUsed + bytes <= limit;
+            });
+            if (_stop.load()) {
+                return;
+            }
+            _checkMemoryUsed += bytes;
+        }
+
+        try {
+            _checkPartition(p);
+        } catch (const DBException& e) {
+            _fail(e.toStatus());
+        }
+
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _checkMemoryUsed -= bytes;
+        }
+        _memoryAvailable.notify_all();
+        _numPartitionsChecked.fetchAndAdd(1);
+    }
+}
+
+void BSONDiff::_checkPartition(size_t p) {
+    std::vector<Entry> entries = _partitions->take(p);
+    // the first file's docs come before the second's with the same hash
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.hash < b.hash || (a.hash == b.hash && a.doc < b.doc);
+    });
+
+    std::vector<Difference> differences;
+    std::vector<bool> paired;
+    for (size_t begin = 0; begin < entries.size();) {
+        uassert(ErrorCodes::Interrupted, "Diff was interrupted", !_stop.load());
+        size_t split = begin;
+        while (split < entries.size() && entries[split].hash == entries[begin].hash &&
+               !(entries[split].doc & kSideBit)) {
+            split++;
+        }
+        size_t end = split;
+        while (end < entries.size() && entries[end].hash == entries[begin].hash) {
+            end++;
+        }
+
+        // by far the most common case: the same doc in both
+        if (split - begin == 1 && end - split == 1 &&
+            entries[begin].contentHash == entries[split].contentHash) {
+            begin = end;
+            continue;
+        }
+
+        // Otherwise the _ids have to be compared, in case of a hash collision (or the same _id
+        // being in a file more than once, in which case they're paired up in order).
+        paired.assign(end - split, false);
+        for (size_t i = begin; i < split; i++) {
+            const Entry& a = entries[i];
+            BSONElement aId = BSONObj(_begin[0] + a.offset)["_id"];
+            bool found = false;
+            for (size_t j = split; j < end; j++) {
+                const Entry& b = entries[j];
+                if (paired[j - split] ||
+                    BSONObj(_begin[1] + b.offset)["_id"].woCompare(aId, false) != 0) {
+                    continue;
+                }
+                paired[j - split] = true;
+                found = true;
+                if (a.contentHash != b.contentHash) {
+                    differences.push_back(Difference{
+                        Change::kChanged, a.doc, b.doc & ~kSideBit, a.offset, b.offset});
+                }
+                break;
+            }
+            if (!found) {
+                differences.push_back(Difference{Change::kRemoved, a.doc, 0, a.offset, 0});
+            }
+        }
+        for (size_t j = split; j < end; j++) {
+            if (!paired[j - split]) {
+                const Entry& b = entries[j];
+                differences.push_back(
+                    Difference{Change::kAdded, 0, b.doc & ~kSideBit, 0, b.offset});
+            }
+        }
+        begin = end;
+    }
+
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    _differences.insert(_differences.end(), differences.begin(), differences.end());
+}
+
+void BSONDiff::_report() {
+    for (auto&& difference : _differences) {
+        BSONObjBuilder result;
+        switch (difference.change) {
+            case Change::kRemoved:
+                result.append("change", "removed");
+                _numRemoved++;
+                break;
+            case Change::kChanged:
+                result.append("change", "changed");
+                _numChanged++;
+                break;
+            case Change::kAdded:
+                result.append("change", "added");
+                _numAdded++;
+                break;
+        }
+        const bool added = (difference.change == Change::kAdded);
+        result.appendAs(added ? BSONObj(_begin[1] + difference.otherOffset)["_id"]
+                              : BSONObj(_begin[0] + difference.offset)["_id"],
+                        "_id");
+        if (!added) {
+            result.append("doc", static_cast<long long>(difference.doc));
+            result.append("offset", static_cast<long long>(difference.offset));
+        }
+        if (difference.change != Change::kRemoved) {
+            result.append("otherDoc", static_cast<long long>(difference.otherDoc));
+            result.append("otherOffset", static_cast<long long>(difference.otherOffset));
+        }
+        appendResult(&_results, result.obj());
+    }
+}
+
+std::string BSONDiff::diffFields(const BSONObj& a, const BSONObj& b) {
+    std::string results;
+    diffFieldsAt("", a, b, &results);
+    return results;
+}
+
+void BSONDiff::_fail(Status status) {
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        if (_status.isOK()) {
+            _status = std::move(status);
+        }
+        // no point in the other threads carrying on
+        _stop.store(true);
+    }
+    _batchesAvailable.notify_all();
+    _memoryAvailable.notify_all();
+}
+
+}  // namespace mongo
@@ -0,0 +1,216 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/base/status.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/hash_partitions.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * Compares two BSON files (eg. dumps of a collection from before and after a migration) doc by
+ * doc, pairing up the docs by their _id, regardless of the order they're in.
+ *
+ * A thread for each file walks its docs and hands out batches of them to the hashing threads,
+ * which hash each doc's _id (with BSONElementHasher, so that an _id which only changed between
+ * eg. int and long is still the same doc) and its whole contents, and scatter the (hash, content
+ * hash, doc) entries of both files into the same HashPartitions, spilling to temp files within
+ * the memory limit.  Then each partition is sorted and the docs with equal _id hashes are joined
+ * up, which says which docs were added, removed or changed.  Pairs whose content hashes match are
+ * taken to be unchanged without reading them again, so that unchanged docs (usually most of them)
+ * are only read the once.
+ *
+ * The files must stay mapped while the diff is running.
+ *
+ * Only the hashing and joining are held to the memory limit.  The differences themselves are kept
+ * in memory (about 40 bytes each while joining, and then a result doc of about 60 bytes plus the
+ * _id), so diffing files in which most of millions of docs differ needs that much more.
+ */
+class BSONDiff {
+    struct Entry {
+        uint64_t hash;  // of the _id
+        uint64_t contentHash;
+        uint64_t offset;
+        uint64_t doc;  // with kSideBit set for the second file
+    };
+    using Partitions = HashPartitions<Entry>;
+
+public:
+    static constexpr unsigned long kBatchSize = 4096;
+    static constexpr size_t kNumPartitions = Partitions::kNumPartitions;
+
+    BSONDiff(const char* aBegin,
+             const char* aEnd,
+             const char* bBegin,
+             const char* bEnd,
+             const std::string& tempDir,
+             size_t maxMemoryUsageBytes);
+
+    ~BSONDiff();
+
+    // Needs at least 3 threads: one to walk each file, and the rest to hash.
+    void start(unsigned numThreads);
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    // How much of both files has been hashed, as a percentage.
+    double percentHashed() const;
+
+    // How many partitions have been joined, out of kNumPartitions.
+    unsigned long numPartitionsChecked() const {
+        return _numPartitionsChecked.load();
+    }
+
+    // The rest are only valid once done.
+
+    const Status& getStatus() const {
+        return _status;
+    }
+
+    // A doc for each difference, eg. {change: "changed", _id: 5, doc: 17, offset: 2304,
+    // otherDoc: 20, otherOffset: 2880}, where doc and offset are its number and where it starts in
+    // the first file, and otherDoc and otherOffset in the second.  The removed docs only have a
+    // doc and offset, and the added ones only an otherDoc and otherOffset.  Ordered by doc, then
+    // otherDoc.
+    const std::string& getResults() const {
+        return _results;
+    }
+
+    unsigned long numResults() const {
+        return _numAdded + _numRemoved + _numChanged;
+    }
+
+    unsigned long numAdded() const {
+        return _numAdded;
+    }
+
+    unsigned long numRemoved() const {
+        return _numRemoved;
+    }
+
+    unsigned long numChanged() const {
+        return _numChanged;
+    }
+
+    // Docs with no _id, which can't be paired up, and so are left out.
+    unsigned long numWithoutId() const {
+        return _numWithoutId.load();
+    }
+
+    /**
+     * A doc for each field that differs between two docs, eg. {path: "a.b", change: "changed",
+     * from: 1, to: "1"}, where "removed" ones only have a from, and "added" ones only a to.
+     * Subdocuments and arrays are compared field by field, and values of different types are
+     * always different, even if they compare equal.  When only the order of the fields at some
+     * path differs, there's a {path: ..., change: "reordered"}.  Returned as contiguous BSON.
+     */
+    static std::string diffFields(const BSONObj& a, const BSONObj& b);
+
+private:
+    static constexpr uint64_t kSideBit = uint64_t(1) << 63;
+
+    struct Batch {
+        uint64_t firstDoc;  // with kSideBit set for the second file
+        const char* begin;
+        const char* end;
+    };
+
+    enum class Change { kRemoved, kChanged, kAdded };
+
+    struct Difference {
+        Change change;
+        uint64_t doc;
+        uint64_t otherDoc;
+        uint64_t offset;
+        uint64_t otherOffset;
+
+        bool operator<(const Difference& other) const;
+    };
+
+    void _run(unsigned numThreads);
+
+    void _walk(int side);
+
+    void _hashWorker();
+
+    bool _nextBatch(Batch* batch);
+
+    void _checkWorker();
+
+    void _checkPartition(size_t partition);
+
+    void _report();
+
+    void _fail(Status status);
+
+    const char* _begin[2];
+    const char* _end[2];
+    const size_t _maxMemoryUsageBytes;
+    size_t _threadBufferEntries = 0;
+    std::unique_ptr<Partitions> _partitions;
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+    AtomicWord<unsigned long long> _bytesHashed{0};
+    AtomicWord<unsigned long> _numWithoutId{0};
+    AtomicWord<unsigned long> _nextPartition{0};
+    AtomicWord<unsigned long> _numPartitionsChecked{0};
+
+    // Protects the batches, the memory used by partitions being checked, the differences, and
+    // _status while running.
+    stdx::mutex _mutex;
+    stdx::condition_variable _batchesAvailable;
+    std::deque<Batch> _batches;
+    int _numWalking = 0;
+    stdx::condition_variable _memoryAvailable;
+    size_t _checkMemoryUsed = 0;
+    std::vector<Difference> _differences;
+    Status _status = Status::OK();
+
+    std::string _results;
+    unsigned long _numAdded = 0;
+    unsigned long _numRemoved = 0;
+    unsigned long _numChanged = 0;
+};
+
+}  // namespace mongo
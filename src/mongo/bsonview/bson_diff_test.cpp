@@ -0,0 +1,378 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/bson_diff.h"
+
+#include <map>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/unittest/temp_dir.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+namespace {
+
+std::vector<BSONObj> split(const std::string& results) {
+    std::vector<BSONObj> docs;
+    for (const char* next = results.data(); next < results.data() + results.size();) {
+        docs.push_back(BSONObj(next).getOwned());
+        next += docs.back().objsize();
+    }
+    return docs;
+}
+
+void assertSameDocs(const std::vector<BSONObj>& actual, const std::vector<BSONObj>& expected) {
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < actual.size(); i++) {
+        ASSERT_BSONOBJ_EQ(actual[i], expected[i]);
+    }
+}
+
+void assertFieldDiffs(const BSONObj& a, const BSONObj& b, const std::vector<BSONObj>& expected) {
+    assertSameDocs(split(BSONDiff::diffFields(a, b)), expected);
+}
+
+TEST(BSONDiffFields, Same) {
+    assertFieldDiffs(BSON("_id" << 1 << "a" << BSON("b" << 2)),
+                     BSON("_id" << 1 << "a" << BSON("b" << 2)),
+                     {});
+}
+
+TEST(BSONDiffFields, MissingFromEachSide) {
+    assertFieldDiffs(BSON("_id" << 1 << "a" << 1),
+                     BSON("_id" << 1),
+                     {BSON("path"
+                           << "a"
+                           << "change"
+                           << "removed"
+                           << "from" << 1)});
+    assertFieldDiffs(BSON("_id" << 1),
+                     BSON("_id" << 1 << "a" << 1),
+                     {BSON("path"
+                           << "a"
+                           << "change"
+                           << "added"
+                           << "to" << 1)});
+}
+
+TEST(BSONDiffFields, Changed) {
+    assertFieldDiffs(BSON("a" << 1 << "b"
+                              << "x"),
+                     BSON("a" << 2 << "b"
+                              << "y"),
+                     {BSON("path"
+                           << "a"
+                           << "change"
+                           << "changed"
+                           << "from" << 1 << "to" << 2),
+                      BSON("path"
+                           << "b"
+                           << "change"
+                           << "changed"
+                           << "from"
+                           << "x"
+                           << "to"
+                           << "y")});
+}
+
+TEST(BSONDiffFields, OnlyTheTypeChanged) {
+    assertFieldDiffs(BSON("a" << 1 << "b" << 1LL << "c" << 1.0),
+                     BSON("a" << 1LL << "b" << 1LL << "c" << 1),
+                     {BSON("path"
+                           << "a"
+                           << "change"
+                           << "changed"
+                           << "from" << 1 << "to" << 1LL),
+                      BSON("path"
+                           << "c"
+                           << "change"
+                           << "changed"
+                           << "from" << 1.0 << "to" << 1)});
+    // an object and an array with the same elements
+    assertFieldDiffs(BSON("a" << BSON("0" << 1)),
+                     BSON("a" << BSON_ARRAY(1)),
+                     {BSON("path"
+                           << "a"
+                           << "change"
+                           << "changed"
+                           << "from" << BSON("0" << 1) << "to" << BSON_ARRAY(1))});
+}
+
+TEST(BSONDiffFields, Nested) {
+    assertFieldDiffs(
+        BSON("a" << BSON("b" << BSON("c" << 1 << "d" << 1)) << "e" << BSON_ARRAY(1 << 2)),
+        BSON("a" << BSON("b" << BSON("c" << 2 << "f" << 1)) << "e" << BSON_ARRAY(1 << 3 << 4)),
+        {BSON("path"
+              << "a.b.c"
+              << "change"
+              << "changed"
+              << "from" << 1 << "to" << 2),
+         BSON("path"
+              << "a.b.d"
+              << "change"
+              << "removed"
+              << "from" << 1),
+         BSON("path"
+              << "a.b.f"
+              << "change"
+              << "added"
+              << "to" << 1),
+         BSON("path"
+              << "e.1"
+              << "change"
+              << "changed"
+              << "from" << 2 << "to" << 3),
+         BSON("path"
+              << "e.2"
+              << "change"
+              << "added"
+              << "to" << 4)});
+}
+
+TEST(BSONDiffFields, Reordered) {
+    assertFieldDiffs(BSON("a" << 1 << "b" << BSON("c" << 1 << "d" << 2)),
+                     BSON("b" << BSON("d" << 2 << "c" << 1) << "a" << 1),
+                     {BSON("path"
+                           << "b"
+                           << "change"
+                           << "reordered"),
+                      BSON("path"
+                           << ""
+                           << "change"
+                           << "reordered")});
+}
+
+struct File {
+    std::string data;
+    std::vector<size_t> offsets;
+    unsigned long numWithoutId = 0;
+
+    void append(const BSONObj& doc) {
+        offsets.push_back(data.size());
+        data.append(doc.objdata(), doc.objsize());
+        numWithoutId += doc["_id"].eoo();
+    }
+};
+
+// Diffs two files, and checks the counts agree with the results.
+std::vector<BSONObj> diff(const File& a,
+                          const File& b,
+                          unsigned numThreads,
+                          size_t maxMemoryUsageBytes) {
+    unittest::TempDir tempDir("bson_diff_test");
+    BSONDiff diff(a.data.data(),
+                  a.data.data() + a.data.size(),
+                  b.data.data(),
+                  b.data.data() + b.data.size(),
+                  tempDir.path(),
+                  maxMemoryUsageBytes);
+    diff.start(numThreads);
+    while (!diff.isDone()) {
+        sleepmillis(1);
+    }
+    ASSERT_OK(diff.getStatus());
+    ASSERT_EQ(diff.percentHashed(), 100.0);
+    ASSERT_EQ(diff.numPartitionsChecked(), BSONDiff::kNumPartitions);
+    ASSERT_EQ(diff.numWithoutId(), a.numWithoutId + b.numWithoutId);
+
+    const auto results = split(diff.getResults());
+    ASSERT_EQ(diff.numResults(), results.size());
+    unsigned long numAdded = 0;
+    unsigned long numRemoved = 0;
+    for (auto&& result : results) {
+        numAdded += (result["change"].str() == "added");
+        numRemoved += (result["change"].str() == "removed");
+    }
+    ASSERT_EQ(diff.numAdded(), numAdded);
+    ASSERT_EQ(diff.numRemoved(), numRemoved);
+    ASSERT_EQ(diff.numChanged(), results.size() - numAdded - numRemoved);
+    return results;
+}
+
+// Pairs up the docs by looking their _ids up directly, without any hashing.
+std::vector<BSONObj> bruteForce(const File& a, const File& b) {
+    auto less = [](const BSONElement& x, const BSONElement& y) {
+        return x.woCompare(y, false) < 0;
+    };
+    std::map<BSONElement, unsigned long, decltype(less)> bDocs(less);
+    for (unsigned long doc = 0; doc < b.offsets.size(); doc++) {
+        BSONElement id = BSONObj(b.data.data() + b.offsets[doc])["_id"];
+        if (!id.eoo()) {
+            bDocs.emplace(id, doc);
+        }
+    }
+
+    std::vector<BSONObj> results;
+    for (unsigned long doc = 0; doc < a.offsets.size(); doc++) {
+        BSONObj aDoc(a.data.data() + a.offsets[doc]);
+        BSONElement id = aDoc["_id"];
+        if (id.eoo()) {
+            continue;
+        }
+        auto it = bDocs.find(id);
+        if (it == bDocs.end()) {
+            results.push_back(BSON("change"
+                                   << "removed"
+                                   << "_id" << id << "doc" << static_cast<long long>(doc)
+                                   << "offset" << static_cast<long long>(a.offsets[doc])));
+            continue;
+        }
+        const unsigned long otherDoc = it->second;
+        bDocs.erase(it);
+        if (!aDoc.binaryEqual(BSONObj(b.data.data() + b.offsets[otherDoc]))) {
+            results.push_back(BSON("change"
+                                   << "changed"
+                                   << "_id" << id << "doc" << static_cast<long long>(doc)
+                                   << "offset" << static_cast<long long>(a.offsets[doc])
+                                   << "otherDoc" << static_cast<long long>(otherDoc)
+                                   << "otherOffset"
+                                   << static_cast<long long>(b.offsets[otherDoc])));
+        }
+    }
+
+    std::map<unsigned long, BSONElement> added;
+    for (auto&& bDoc : bDocs) {
+        added.emplace(bDoc.second, bDoc.first);
+    }
+    for (auto&& doc : added) {
+        results.push_back(BSON("change"
+                               << "added"
+                               << "_id" << doc.second << "otherDoc"
+                               << static_cast<long long>(doc.first) << "otherOffset"
+                               << static_cast<long long>(b.offsets[doc.first])));
+    }
+    return results;
+}
+
+// The second file is the first with some docs removed, changed (some only in the type of their
+// _id), moved about or added, and a few in each without an _id.
+void makeFiles(unsigned long numDocs, File* a, File* b) {
+    auto doc = [](unsigned long i, long long x) {
+        BSONObjBuilder builder;
+        if (i % 1000 == 7) {
+            // no _id
+        } else if (i % 50 == 1) {
+            builder.append("_id", static_cast<int>(i));
+        } else if (i % 50 == 2) {
+            builder.append("_id", "s" + std::to_string(i));
+        } else {
+            builder.append("_id", static_cast<long long>(i));
+        }
+        builder.append("x", x);
+        return builder.obj();
+    };
+
+    for (unsigned long i = 0; i < numDocs; i++) {
+        a->append(doc(i, i));
+    }
+
+    std::vector<BSONObj> moved;
+    for (unsigned long i = 0; i < numDocs; i++) {
+        if (i % 37 == 3) {
+            continue;  // removed
+        }
+        if (i % 41 == 4) {
+            b->append(doc(i, -1));
+        } else if (i % 50 == 1 && i % 100 == 1) {
+            // the same _id, as a long
+            b->append(BSON("_id" << static_cast<long long>(i) << "x" << static_cast<long long>(i)));
+        } else if (i % 9 == 5) {
+            moved.push_back(doc(i, i));
+        } else {
+            b->append(doc(i, i));
+        }
+        if (i % 43 == 6) {
+            b->append(doc(numDocs + i, i));  // added
+        }
+    }
+    for (auto&& doc : moved) {
+        b->append(doc);
+    }
+}
+
+TEST(BSONDiff, NoDocs) {
+    const File empty;
+    ASSERT(diff(empty, empty, 3, 1 << 20).empty());
+}
+
+TEST(BSONDiff, EmptyAgainstNot) {
+    File a;
+    File b;
+    makeFiles(100, &a, &b);
+    const File empty;
+    assertSameDocs(diff(a, empty, 3, 1 << 20), bruteForce(a, empty));
+    assertSameDocs(diff(empty, b, 3, 1 << 20), bruteForce(empty, b));
+}
+
+TEST(BSONDiff, InMemory) {
+    File a;
+    File b;
+    makeFiles(20000, &a, &b);
+    const auto expected = bruteForce(a, b);
+    ASSERT_GT(expected.size(), 1000UL);
+    assertSameDocs(diff(a, b, 3, 64 << 20), expected);
+    assertSameDocs(diff(a, b, 6, 64 << 20), expected);
+}
+
+// With a tiny budget, every hashing thread spills its buffers after each batch, and the
+// partitions are joined one at a time.
+TEST(BSONDiff, Spilled) {
+    File a;
+    File b;
+    makeFiles(20000, &a, &b);
+    const auto expected = bruteForce(a, b);
+    assertSameDocs(diff(a, b, 3, 1), expected);
+    assertSameDocs(diff(a, b, 6, 1), expected);
+}
+
+TEST(BSONDiff, InvalidBSON) {
+    File a;
+    File b;
+    makeFiles(100, &a, &b);
+    a.data.resize(a.data.size() - 1);
+
+    unittest::TempDir tempDir("bson_diff_test");
+    BSONDiff diff(a.data.data(),
+                  a.data.data() + a.data.size(),
+                  b.data.data(),
+                  b.data.data() + b.data.size(),
+                  tempDir.path(),
+                  1 << 20);
+    diff.start(3);
+    while (!diff.isDone()) {
+        sleepmillis(1);
+    }
+    ASSERT_EQ(diff.getStatus().code(), ErrorCodes::InvalidBSON);
+}
+
+}  // namespace
+}  // namespace mongo
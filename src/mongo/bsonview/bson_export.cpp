@@ -0,0 +1,205 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/bson_export.h"
+
+#include <algorithm>
+#include <climits>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "mongo/util/assert_util.h"
+#include "mongo/util/errno_util.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+constexpr size_t BSONExport::kMinCopyFileRangeBytes;
+constexpr size_t BSONExport::kMaxGatherBytes;
+
+BSONExport::BSONExport(int fd,
+                       const char* base,
+                       LoadedDocsFn loadedDocs,
+                       std::vector<unsigned long> docs,
+                       std::vector<unsigned long> fileFirstDocs,
+                       std::string path)
+    : _fd(fd),
+      _base(base),
+      _loadedDocs(std::move(loadedDocs)),
+      _docs(std::move(docs)),
+      _fileFirstDocs(std::move(fileFirstDocs)),
+      _path(std::move(path)) {}
+
+BSONExport::~BSONExport() {
+    _stop.store(true);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void BSONExport::start() {
+    invariant(!_thread.joinable());
+    _thread = stdx::thread([this]() { _run(); });
+}
+
+void BSONExport::_run() {
+    try {
+        _out = std::make_unique<OutputFile>(_path);
+
+        std::vector<BSONObj> ends;
+        const char* rangeBegin = nullptr;
+        const char* rangeEnd = nullptr;
+        unsigned long rangeDocs = 0;
+        for (size_t i = 0; i < _docs.size();) {
+            uassert(ErrorCodes::Interrupted, "Export was interrupted", !_stop.load());
+            // consecutive docs are next to each other in the source, unless they're in different
+            // files
+            size_t j = i + 1;
+            while (j < _docs.size() && _docs[j] == _docs[j - 1] + 1 && !_startsFile(_docs[j])) {
+                j++;
+            }
+            _loadedDocs(_docs[i], _docs[i] + 1, &ends);
+            const char* const begin = ends[0].objdata();
+            _loadedDocs(_docs[j - 1], _docs[j - 1] + 1, &ends);
+            const char* const end = ends[0].objdata() + ends[0].objsize();
+
+            if (begin != rangeEnd || rangeBegin == rangeEnd || _startsFile(_docs[i])) {
+                if (rangeBegin != rangeEnd) {
+                    _write(rangeBegin, rangeEnd);
+                    _numDocsExported.fetchAndAdd(rangeDocs);
+                }
+                rangeBegin = begin;
+                rangeDocs = 0;
+            }
+            rangeEnd = end;
+            rangeDocs += j - i;
+            i = j;
+        }
+        if (rangeBegin != rangeEnd) {
+            _write(rangeBegin, rangeEnd);
+        }
+        _flushGathered();
+        _numDocsExported.fetchAndAdd(rangeDocs);
+        _out->commit();
+    } catch (const DBException& e) {
+        _status = e.toStatus();
+    }
+    // which removes the file if the export failed
+    _out.reset();
+    _done.store(true);
+}
+
+bool BSONExport::_startsFile(unsigned long doc) const {
+    return std::binary_search(_fileFirstDocs.begin(), _fileFirstDocs.end(), doc);
+}
+
+void BSONExport::_write(const char* begin, const char* end) {
+    if (_fd != -1 && _copyFileRangeWorks &&
+        static_cast<size_t>(end - begin) >= kMinCopyFileRangeBytes) {
+        _flushGathered();
+        if (_copyFileRange(begin - _base, end - _base)) {
+            return;
+        }
+    }
+
+    // pwritev() won't take more than SSIZE_MAX in one go
+    while (begin < end) {
+        const size_t size = std::min(static_cast<size_t>(end - begin), kMaxGatherBytes);
+        _gathered.push_back(iovec{const_cast<char*>(begin), size});
+        _gatheredBytes += size;
+        begin += size;
+        if (_gathered.size() == IOV_MAX || _gatheredBytes >= kMaxGatherBytes) {
+            _flushGathered();
+        }
+    }
+}
+
+bool BSONExport::_copyFileRange(size_t begin, size_t end) {
+    loff_t inOffset = begin;
+    while (inOffset < static_cast<loff_t>(end)) {
+        uassert(ErrorCodes::Interrupted, "Export was interrupted", !_stop.load());
+        // Via syscall(), since older libcs don't have a wrapper.  Limited in size so that
+        // progress gets reported, and interrupting doesn't take long.
+        const ssize_t copied = ::syscall(__NR_copy_file_range,
+                                         _fd,
+                                         &inOffset,
+                                         _out->fd(),
+                                         &_outOffset,
+                                         std::min(end - inOffset, kMaxGatherBytes * 8),
+                                         0U);
+        if (copied == -1 && errno == EINTR) {
+            continue;
+        }
+        if (copied == -1 && inOffset == static_cast<loff_t>(begin) &&
+            (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+            // eg. an old kernel, or the files are on different filesystems
+            _copyFileRangeWorks = false;
+            return false;
+        }
+        uassert(ErrorCodes::FileStreamFailed,
+                str::stream() << "Unable to copy to " << _path << ": " << errnoWithDescription(),
+                copied > 0);
+        _numBytesWritten.fetchAndAdd(copied);
+    }
+    return true;
+}
+
+void BSONExport::_flushGathered() {
+    struct iovec* iov = _gathered.data();
+    int iovcnt = _gathered.size();
+    while (iovcnt > 0) {
+        const ssize_t written = ::pwritev(_out->fd(), iov, iovcnt, _outOffset);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        uassert(ErrorCodes::FileStreamFailed,
+                str::stream() << "Unable to write " << _path << ": " << errnoWithDescription(),
+                written > 0);
+        _outOffset += written;
+        _numBytesWritten.fetchAndAdd(written);
+
+        // skip over whatever was written, which might end part way through an iovec
+        size_t remaining = written;
+        while (iovcnt > 0 && remaining >= iov->iov_len) {
+            remaining -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+    _gathered.clear();
+    _gatheredBytes = 0;
+}
+
+}  // namespace mongo
@@ -0,0 +1,138 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+#include "mongo/base/status.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/output_file.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * Writes some of the docs of a file (or of any other contiguous BSON, eg. aggregation results)
+ * out to a new BSON file, in the order given.
+ *
+ * Runs of consecutive docs are contiguous in the source, so they're coalesced into byte ranges.
+ * With several files, each is mapped on its own, so runs are only contiguous within a file.  Large
+ * ranges are copied with copy_file_range() when the source is a file, so that the kernel
+ * moves the data between the files itself (or the filesystem shares the extents).  Smaller
+ * ranges, or all of them where copy_file_range() isn't supported, are gathered into pwritev()
+ * calls straight from the mapping, so nothing is ever copied into a buffer of our own.
+ */
+class BSONExport {
+public:
+    // Must be thread-safe.  Only asked for docs which are already loaded.
+    using LoadedDocsFn =
+        std::function<void(unsigned long begin, unsigned long end, std::vector<BSONObj>* out)>;
+
+    // Ranges shorter than this aren't worth a syscall of their own.
+    static constexpr size_t kMinCopyFileRangeBytes = 64 * 1024;
+    // How much to gather up before each pwritev().
+    static constexpr size_t kMaxGatherBytes = 8 * 1024 * 1024;
+
+    /**
+     * The docs are given by their numbers in the source.  If fd isn't -1, the source is that one
+     * file, mapped at base, and ranges can be copied from it.  Otherwise they're only written from
+     * memory, and base isn't used.  If the source is several files, fileFirstDocs is the number of
+     * the first doc of each.  The source must outlive the export.
+     */
+    BSONExport(int fd,
+               const char* base,
+               LoadedDocsFn loadedDocs,
+               std::vector<unsigned long> docs,
+               std::vector<unsigned long> fileFirstDocs,
+               std::string path);
+
+    ~BSONExport();
+
+    void start();
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    unsigned long numDocsExported() const {
+        return _numDocsExported.load();
+    }
+
+    unsigned long long numBytesWritten() const {
+        return _numBytesWritten.load();
+    }
+
+    unsigned long numDocs() const {
+        return _docs.size();
+    }
+
+    // Only valid once done.  The file is removed if the export fails.
+    const Status& getStatus() const {
+        return _status;
+    }
+
+private:
+    void _run();
+
+    bool _startsFile(unsigned long doc) const;
+
+    void _write(const char* begin, const char* end);
+
+    bool _copyFileRange(size_t begin, size_t end);
+
+    void _flushGathered();
+
+    const int _fd;
+    const char* const _base;
+    LoadedDocsFn _loadedDocs;
+    const std::vector<unsigned long> _docs;
+    const std::vector<unsigned long> _fileFirstDocs;
+    const std::string _path;
+
+    std::unique_ptr<OutputFile> _out;
+    off_t _outOffset = 0;
+    bool _copyFileRangeWorks = true;
+    std::vector<struct iovec> _gathered;
+    size_t _gatheredBytes = 0;
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+    AtomicWord<unsigned long> _numDocsExported{0};
+    AtomicWord<unsigned long long> _numBytesWritten{0};
+    Status _status = Status::OK();
+};
+
+}  // namespace mongo
@@ -0,0 +1,256 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/bson_file_set.h"
+
+#include <algorithm>
+#include <boost/filesystem/operations.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mongo/base/data_view.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/errno_util.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+constexpr unsigned BSONFileSet::kMaxIndexingThreads;
+
+StatusWith<std::vector<std::string>> BSONFileSet::expandPaths(const std::vector<std::string>& paths) {
+    std::vector<std::string> files;
+    for (auto&& path : paths) {
+        boost::system::error_code ec;
+        if ( ! boost::filesystem::is_directory(path, ec)) {
+            files.push_back(path);
+            continue;
+        }
+        // eg. a mongodump directory, with a directory for each database
+        std::vector<std::string> found;
+        for (boost::filesystem::recursive_directory_iterator it(path, ec), end; !ec && it != end;
+             it.increment(ec)) {
+            if (it->path().extension() == ".bson" && boost::filesystem::is_regular_file(it->status())) {
+                found.push_back(it->path().string());
+            }
+        }
+        if (ec) {
+            return Status(ErrorCodes::FileOpenFailed,
+                          str::stream() << "Unable to read directory '" << path << "': " << ec.message());
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+BSONFileSet::~BSONFileSet() {
+    stopIndexing();
+    for (auto&& file : _files) {
+        if (file.base) {
+            ::munmap(const_cast<char*>(file.base), file.size);
+        }
+    }
+}
+
+Status BSONFileSet::open(std::vector<std::string> paths) {
+    _files.clear();
+    _sizeBefore.assign(1, 0);
+    for (auto&& path : paths) {
+        struct stat sb;
+        if (::stat(path.c_str(), &sb) == -1) {
+            int res = errno;
+            return Status(ErrorCodes::FileOpenFailed,
+                          str::stream() << "Unable to stat input file '" << path << "': " << errnoWithDescription(res));
+        }
+        if ((sb.st_mode & S_IFMT) != S_IFREG) {
+            return Status(ErrorCodes::FileOpenFailed,
+                          str::stream() << "Input file '" << path << "' is not a regular file.");
+        }
+        File file;
+        file.path = std::move(path);
+        file.size = sb.st_size;
+        _files.push_back(std::move(file));
+        _sizeBefore.push_back(_sizeBefore.back() + sb.st_size);
+    }
+    return Status::OK();
+}
+
+StatusWith<const char*> BSONFileSet::map(size_t file) {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    return _map(&_files[file]);
+}
+
+StatusWith<const char*> BSONFileSet::_map(File* file) {
+    if (file->base) {
+        return file->base;
+    }
+    if (file->size == 0) {
+        // can't be mapped, and there's nothing in it anyway
+        return Status(ErrorCodes::FileOpenFailed, str::stream() << "Input file '" << file->path << "' is empty.");
+    }
+
+    const int fd = ::open(file->path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        int res = errno;
+        return Status(ErrorCodes::FileOpenFailed,
+                      str::stream() << "Unable to open input file '" << file->path << "': " << errnoWithDescription(res));
+    }
+    void* base = ::mmap(NULL, file->size, PROT_READ, MAP_SHARED, fd, 0);
+    const int res = errno;
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return Status(ErrorCodes::FileOpenFailed,
+                      str::stream() << "Unable to mmap input file '" << file->path << "': " << errnoWithDescription(res));
+    }
+
+    // the same advice as for a single file (these are only hints, so failures don't matter)
+#if _POSIX_C_SOURCE >= 200112L
+    ::posix_madvise(base, file->size, POSIX_MADV_WILLNEED);
+#endif
+#if _DEFAULT_SOURCE
+    ::madvise(base, file->size, MADV_DONTDUMP);
+#endif
+
+    file->base = static_cast<const char*>(base);
+    return file->base;
+}
+
+void BSONFileSet::startIndexing(unsigned numThreads) {
+    invariant(_threads.empty());
+    _stop.store(false);
+    numThreads = std::max(1u, std::min(numThreads, kMaxIndexingThreads));
+    for (unsigned i = 0; i < numThreads; i++) {
+        _threads.emplace_back([this]() { _index(); });
+    }
+}
+
+void BSONFileSet::stopIndexing() {
+    _stop.store(true);
+    for (auto&& thread : _threads) {
+        thread.join();
+    }
+    _threads.clear();
+}
+
+void BSONFileSet::takeOffsets(size_t file, std::vector<size_t>* offsets) {
+    const char* base;
+    size_t size;
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        File& f = _files[file];
+        invariant(f.base);
+        const bool indexed = (f.state == kIndexed);
+        // if an indexing thread is still walking it, it'll throw away what it finds
+        f.state = kLoading;
+        if (indexed) {
+            *offsets = std::move(f.offsets);
+            f.offsets = std::vector<size_t>();
+            return;
+        }
+        base = f.base;
+        size = f.size;
+    }
+    *offsets = _walk(base, size);
+}
+
+void BSONFileSet::forEachMapping(const std::function<void(const char* begin, const char* end)>& fn) const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    for (auto&& file : _files) {
+        if (file.base) {
+            fn(file.base, file.base + file.size);
+        }
+    }
+}
+
+size_t BSONFileSet::memoryUsage() const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    size_t bytes = 0;
+    for (auto&& file : _files) {
+        bytes += file.offsets.capacity() * sizeof(size_t);
+    }
+    return bytes;
+}
+
+void BSONFileSet::_index() {
+    while ( ! _stop.load()) {
+        size_t i;
+        const char* base = nullptr;
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            while (_nextToIndex < _files.size() && _files[_nextToIndex].state != kNotStarted) {
+                _nextToIndex++;
+            }
+            if (_nextToIndex == _files.size()) {
+                return;
+            }
+            i = _nextToIndex++;
+            _files[i].state = kIndexing;
+            auto mapped = _map(&_files[i]);
+            if (mapped.isOK()) {
+                base = mapped.getValue();
+            }
+        }
+
+        // an unreadable (or empty) file has no docs
+        std::vector<size_t> offsets;
+        if (base) {
+            offsets = _walk(base, _files[i].size);
+        }
+
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        if (_files[i].state == kIndexing) {
+            _files[i].offsets = std::move(offsets);
+            _files[i].state = kIndexed;
+        }
+        _numFilesIndexed.fetchAndAdd(1);
+    }
+}
+
+std::vector<size_t> BSONFileSet::_walk(const char* base, size_t size) {
+    std::vector<size_t> offsets;
+    size_t offset = 0;
+    while (offset + BSONObj::kMinBSONLength <= size) {
+        const int32_t docSize = ConstDataView(base + offset).read<LittleEndian<int32_t>>();
+        if (docSize < BSONObj::kMinBSONLength || static_cast<size_t>(docSize) > size - offset ||
+            base[offset + docSize - 1] != EOO) {
+            // the rest of the file isn't docs, so it's left out
+            break;
+        }
+        offsets.push_back(offset);
+        offset += docSize;
+    }
+    return offsets;
+}
+
+}  // namespace mongo
@@ -0,0 +1,151 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "mongo/base/status.h"
+#include "mongo/base/status_with.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * Many BSON files, eg. a mongodump directory or the dumps of a collection's shards, which are
+ * viewed as one (by BSONCache::init()), as if they were concatenated.
+ *
+ * A file is only opened and mapped once it's needed, and its fd is closed again as soon as it's
+ * mapped (the mapping doesn't need it), so only a few are ever open at once: one for each
+ * indexing thread, and one for the loader.  10k files don't come anywhere near ulimit -n.
+ *
+ * The indexing threads walk the files ahead of the loader, each taking the next file that nobody
+ * has started on, and find the offsets of their docs.  When the loader gets to a file which has
+ * been walked, it can take its docs from the offsets without walking it again (and otherwise
+ * walks it itself).
+ */
+class BSONFileSet {
+public:
+    // Enough to keep ahead of the loader, which is mostly waiting on the disk anyway.
+    static constexpr unsigned kMaxIndexingThreads = 4;
+
+    // Directories are replaced by the .bson files in and under them, in path order.
+    static StatusWith<std::vector<std::string>> expandPaths(const std::vector<std::string>& paths);
+
+    ~BSONFileSet();
+
+    // Fails if any of the files isn't a regular file.  They're only stat()ed, not opened.
+    Status open(std::vector<std::string> paths);
+
+    size_t numFiles() const {
+        return _files.size();
+    }
+
+    const std::string& path(size_t file) const {
+        return _files[file].path;
+    }
+
+    size_t fileSize(size_t file) const {
+        return _files[file].size;
+    }
+
+    // The total size of the files before file.
+    size_t sizeOfFilesBefore(size_t file) const {
+        return _sizeBefore[file];
+    }
+
+    size_t totalSize() const {
+        return _sizeBefore.back();
+    }
+
+    // Maps the file, if it hasn't been already.  Safe to call from any thread.
+    StatusWith<const char*> map(size_t file);
+
+    // Starts the indexing threads.  The set must outlive them, or stopIndexing() must be called.
+    void startIndexing(unsigned numThreads);
+
+    void stopIndexing();
+
+    // Called by the loader when it gets to a (mapped) file, for the offsets of its docs.  If the
+    // file hasn't been walked yet, the loader walks it, so that the same docs are loaded (and
+    // numbered) whichever gets there first.
+    void takeOffsets(size_t file, std::vector<size_t>* offsets);
+
+    unsigned long numFilesIndexed() const {
+        return _numFilesIndexed.load();
+    }
+
+    // The mapped files, for working out (and dropping) how much of them is resident.
+    void forEachMapping(const std::function<void(const char* begin, const char* end)>& fn) const;
+
+    // The offsets found by the indexing threads that the loader hasn't taken yet.
+    size_t memoryUsage() const;
+
+private:
+    enum State {
+        kNotStarted,
+        kIndexing,
+        kIndexed,
+        kLoading,  // by the loader, which has either taken the offsets, or is walking it itself
+    };
+
+    struct File {
+        std::string path;
+        size_t size = 0;
+        const char* base = nullptr;  // once mapped
+        State state = kNotStarted;
+        std::vector<size_t> offsets;  // once indexed
+    };
+
+    // With _mutex held.
+    StatusWith<const char*> _map(File* file);
+
+    void _index();
+
+    // The offsets of the docs at the start of the file that look like docs (which is normally all
+    // of them).
+    static std::vector<size_t> _walk(const char* base, size_t size);
+
+    std::vector<File> _files;
+    std::vector<size_t> _sizeBefore;  // one more than there are files
+
+    // Protects the files' base, state and offsets, and _nextToIndex.
+    mutable stdx::mutex _mutex;
+    size_t _nextToIndex = 0;
+
+    std::vector<stdx::thread> _threads;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<unsigned long> _numFilesIndexed{0};
+};
+
+}  // namespace mongo
@@ -0,0 +1,258 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <string>
+
+#include "mongo/bsonview/bson_cache.h"
+#include "mongo/bsonview/corpus_generator.h"
+#include "mongo/bsonview/doc_renderer.h"
+#include "mongo/bsonview/field_value_index.h"
+#include "mongo/bsonview/search.h"
+
+namespace mongo {
+namespace {
+
+// The shapes of synthetic file, as made by bvgen (huge docs would make the files too big).
+const char* kShapes[] = {"flat", "oplog", "nested:8", "wide:100", "arrays:50", "logs"};
+const int kNumShapes = sizeof(kShapes) / sizeof(kShapes[0]);
+// The only shape that can be rendered as text logs.
+const int kLogsShape = 5;
+
+const int kNumDocs = 10000;
+
+// Roughly one screen.
+const int kPageLines = 50;
+const int kNumPages = 100;
+
+// A file of kNumDocs docs of the shape, the same as bvgen writes with seed 0.
+const std::string& file(int shape) {
+    static std::string files[kNumShapes];
+    std::string& data = files[shape];
+    if (data.empty()) {
+        const auto spec = CorpusGenerator::parseSpec(kShapes[shape]).getValue();
+        for (int i = 0; i < kNumDocs; i++) {
+            BSONObj doc = CorpusGenerator::makeDoc(spec, 0, i);
+            data.append(doc.objdata(), doc.objsize());
+        }
+    }
+    return data;
+}
+
+DocRenderer::DocumentRenderMode renderMode(int64_t mode) {
+    return static_cast<DocRenderer::DocumentRenderMode>(mode);
+}
+
+// Shape x render mode x extended JSON format, leaving out the shapes that can't be rendered as
+// logs.
+void renderArgs(benchmark::internal::Benchmark* b) {
+    for (int shape = 0; shape < kNumShapes; shape++) {
+        for (int mode = DocRenderer::kJSONOneline; mode <= DocRenderer::kTextLogs; mode++) {
+            if (mode == DocRenderer::kTextLogs && shape != kLogsShape) {
+                continue;
+            }
+            for (int format : {Strict, TenGen}) {
+                b->Args({shape, mode, format});
+            }
+        }
+    }
+}
+
+// Walking the file to find where each doc starts, as the loader does.
+void BM_LoadAll(benchmark::State& state) {
+    const std::string& data = file(state.range(0));
+    for (auto _ : state) {
+        BSONCache cache(data.data(), data.data() + data.size());
+        cache.loadAll();
+        benchmark::DoNotOptimize(cache.numDocs());
+    }
+    state.SetItemsProcessed(state.iterations() * kNumDocs);
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+// Collecting the values of _id for a field value index (without writing out the sidecar).
+void BM_FieldIndexBuild(benchmark::State& state) {
+    const std::string& data = file(state.range(0));
+    BSONCache cache(data.data(), data.data() + data.size());
+    cache.loadAll();
+    for (auto _ : state) {
+        FieldValueIndex::Builder builder("_id");
+        for (unsigned long doc = 0; doc < cache.numDocs(); doc++) {
+            builder.add(doc, cache[doc]);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kNumDocs);
+}
+
+void BM_Render(benchmark::State& state) {
+    const std::string& data = file(state.range(0));
+    BSONCache cache(data.data(), data.data() + data.size());
+    cache.loadAll();
+    DocRenderer renderer;
+    renderer.setDocumentRenderMode(renderMode(state.range(1)));
+    renderer.setExtendedJSONMode(static_cast<JsonStringFormat>(state.range(2)));
+
+    unsigned long doc = 0;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        bytes += renderer.render(cache[doc]).size();
+        doc = (doc + 1) % cache.numDocs();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+
+// A search which matches nothing, so that every doc has to be rendered and scanned.
+void BM_TextSearch(benchmark::State& state) {
+    const std::string& data = file(state.range(0));
+    BSONCache cache(data.data(), data.data() + data.size());
+    cache.loadAll();
+    DocRenderer renderer;
+    for (auto _ : state) {
+        SearchRenderedText search("no such text");
+        benchmark::DoNotOptimize(search.findNext(0, cache.numDocs(), cache, renderer));
+    }
+    state.SetItemsProcessed(state.iterations() * kNumDocs);
+}
+
+const char* kQueries[] = {
+    "{_id: -1}",
+    "{_id: {$gte: 5000}}",
+    "{_id: {$in: [1, 10, 100, 1000]}}",
+    "{missing: {$exists: true}}",
+};
+
+// Finds every match of the query, through the match bitmap, as n does.
+void BM_MQLSearch(benchmark::State& state) {
+    const std::string& data = file(state.range(0));
+    BSONCache cache(data.data(), data.data() + data.size());
+    cache.loadAll();
+    DocRenderer renderer;
+    unsigned long matched = 0;
+    for (auto _ : state) {
+        SearchMQL search(kQueries[state.range(1)]);
+        for (auto doc = search.findNext(0, cache.numDocs(), cache, renderer); doc;
+             doc = search.findNext(*doc + 1, cache.numDocs(), cache, renderer)) {
+            matched++;
+        }
+    }
+    benchmark::DoNotOptimize(matched);
+    state.SetItemsProcessed(state.iterations() * kNumDocs);
+}
+
+// A model of paging, not BSONCacheView's own: the view lives in main.cpp along with the terminal
+// drawing, so it can't be linked in here.  This renders the docs from doc onwards (or backwards)
+// until a page of lines is full, and returns the first doc of the next page, which is the least
+// loading and rendering that any page needs.  The view does more than that (eg. paging up lays
+// the page out again after each doc it steps back over), so its times are a lower bound.
+unsigned long modelPage(BSONCache& cache, const DocRenderer& renderer, unsigned long doc, bool down) {
+    int lines = 0;
+    while (lines < kPageLines) {
+        if (down ? (cache.isComplete() && doc >= cache.numDocs()) : (doc == 0)) {
+            break;
+        }
+        if ( ! down) {
+            doc--;
+        }
+        const std::string rendered = renderer.render(cache[doc]);
+        lines += 1 + std::count(rendered.begin(), rendered.end(), '\n');
+        if (down) {
+            doc++;
+        }
+    }
+    return doc;
+}
+
+// Paging down (as modelled by modelPage) from the top of a freshly opened file, which loads the
+// docs on demand.
+void BM_PageDown(benchmark::State& state) {
+    const std::string& data = file(state.range(0));
+    DocRenderer renderer;
+    renderer.setDocumentRenderMode(renderMode(state.range(1)));
+    for (auto _ : state) {
+        BSONCache cache(data.data(), data.data() + data.size());
+        unsigned long doc = 0;
+        for (int page = 0; page < kNumPages; page++) {
+            doc = modelPage(cache, renderer, doc, true);
+        }
+        benchmark::DoNotOptimize(doc);
+    }
+    state.SetItemsProcessed(state.iterations() * kNumPages);
+}
+
+// Jumping to the end of a freshly opened file (which has to load all of it), and paging up (as
+// modelled by modelPage).
+void BM_EndPageUp(benchmark::State& state) {
+    const std::string& data = file(state.range(0));
+    DocRenderer renderer;
+    renderer.setDocumentRenderMode(renderMode(state.range(1)));
+    for (auto _ : state) {
+        BSONCache cache(data.data(), data.data() + data.size());
+        cache.loadAll();
+        unsigned long doc = cache.numDocs();
+        for (int page = 0; page < kNumPages; page++) {
+            doc = modelPage(cache, renderer, doc, false);
+        }
+        benchmark::DoNotOptimize(doc);
+    }
+    state.SetItemsProcessed(state.iterations() * kNumPages);
+}
+
+// Shape x query.
+void queryArgs(benchmark::internal::Benchmark* b) {
+    for (int shape = 0; shape < kNumShapes; shape++) {
+        for (int query = 0; query < static_cast<int>(sizeof(kQueries) / sizeof(kQueries[0])); query++) {
+            b->Args({shape, query});
+        }
+    }
+}
+
+// Shape x the render modes which every shape can be rendered in, one and several lines per doc.
+void pageArgs(benchmark::internal::Benchmark* b) {
+    for (int shape = 0; shape < kNumShapes; shape++) {
+        b->Args({shape, DocRenderer::kJSONOneline});
+        b->Args({shape, DocRenderer::kJSONPretty});
+    }
+}
+
+BENCHMARK(BM_LoadAll)->DenseRange(0, kNumShapes - 1);
+BENCHMARK(BM_FieldIndexBuild)->DenseRange(0, kNumShapes - 1);
+BENCHMARK(BM_Render)->Apply(renderArgs);
+BENCHMARK(BM_TextSearch)->DenseRange(0, kNumShapes - 1);
+BENCHMARK(BM_MQLSearch)->Apply(queryArgs);
+BENCHMARK(BM_PageDown)->Apply(pageArgs);
+BENCHMARK(BM_EndPageUp)->Apply(pageArgs);
+
+}  // namespace
+}  // namespace mongo
@@ -0,0 +1,130 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+// bvgen writes files of synthetic docs for testing bv, eg.
+//     bvgen --shape oplog --size 4G --seed 7 oplog.bson
+
+#include "mongo/platform/basic.h"
+
+#include <iostream>
+
+#include "mongo/base/initializer.h"
+#include "mongo/base/parse_number.h"
+#include "mongo/bsonview/byte_size.h"
+#include "mongo/bsonview/corpus_generator.h"
+#include "mongo/stdx/thread.h"
+#include "mongo/util/exit_code.h"
+#include "mongo/util/quick_exit.h"
+#include "mongo/util/time_support.h"
+
+using namespace mongo;
+
+namespace {
+
+void usage() {
+    std::cerr << "Usage: bvgen --shape <shape>[:<n>] (--docs <n> | --size <bytes>[K|M|G|T]) [--seed <n>] [--threads <n>] <outfile>" << std::endl;
+    std::cerr << "  Shapes: flat, oplog, logs, nested[:depth], wide[:fields], arrays[:length], huge[:KB]." << std::endl;
+    std::cerr << "  The same arguments always give the same file.  With an outfile of -, the docs are written to stdout." << std::endl;
+}
+
+int _main(int argc, char* argv[], char** envp) {
+    std::string shape;
+    std::string path;
+    unsigned long long numDocs = 0;
+    unsigned long long numBytes = 0;
+    long long seed = 0;
+    unsigned numThreads = stdx::thread::hardware_concurrency();
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--shape" || arg == "--docs" || arg == "--size" || arg == "--seed" || arg == "--threads") {
+            if (i + 1 >= argc) {
+                usage();
+                return EXIT_BADOPTIONS;
+            }
+            const std::string value = argv[++i];
+            bool ok = true;
+            if (arg == "--shape") {
+                shape = value;
+            } else if (arg == "--docs") {
+                long long n;
+                ok = NumberParser{}(value, &n).isOK() && n > 0;
+                numDocs = n;
+            } else if (arg == "--size") {
+                auto size = parseByteSize(value);
+                ok = size.isOK() && size.getValue() > 0;
+                numBytes = ok ? size.getValue() : 0;
+            } else if (arg == "--seed") {
+                ok = NumberParser{}(value, &seed).isOK();
+            } else {
+                ok = NumberParser{}(value, &numThreads).isOK() && numThreads > 0;
+            }
+            if ( ! ok) {
+                std::cerr << "bvgen: Error: invalid value for " << arg << ": " << value << std::endl;
+                return EXIT_BADOPTIONS;
+            }
+        } else if (path.empty()) {
+            path = arg;
+        } else {
+            usage();
+            return EXIT_BADOPTIONS;
+        }
+    }
+    if (shape.empty() || path.empty() || (numDocs == 0 && numBytes == 0)) {
+        usage();
+        return EXIT_BADOPTIONS;
+    }
+
+    auto spec = CorpusGenerator::parseSpec(shape);
+    if ( ! spec.isOK()) {
+        std::cerr << "bvgen: Error: " << spec.getStatus().reason() << std::endl;
+        return EXIT_BADOPTIONS;
+    }
+
+    CorpusGenerator generator(spec.getValue(), seed, numDocs, numBytes, path);
+    generator.start(numThreads);
+    while ( ! generator.isDone()) {
+        sleepmillis(1000);
+        std::cerr << "\rbvgen: " << generator.numDocsWritten() << " docs, "
+                  << generator.numBytesWritten() / (1024 * 1024) << " MiB" << std::flush;
+    }
+    std::cerr << std::endl;
+
+    if ( ! generator.getStatus().isOK()) {
+        std::cerr << "bvgen: Error: " << generator.getStatus().reason() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_CLEAN;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[], char** envp) {
+    runGlobalInitializersOrDie(argc, argv, envp);
+    quickExit(_main(argc, argv, envp));
+}
@@ -0,0 +1,76 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/byte_size.h"
+
+#include <limits>
+
+#include "mongo/base/parse_number.h"
+
+namespace mongo {
+
+StatusWith<size_t> parseByteSize(StringData s) {
+    size_t multiplier = 1;
+    if (!s.empty()) {
+        switch (s[s.size() - 1]) {
+            case 'K':
+            case 'k':
+                multiplier = 1ULL << 10;
+                break;
+            case 'M':
+            case 'm':
+                multiplier = 1ULL << 20;
+                break;
+            case 'G':
+            case 'g':
+                multiplier = 1ULL << 30;
+                break;
+            case 'T':
+            case 't':
+                multiplier = 1ULL << 40;
+                break;
+        }
+    }
+    if (multiplier != 1) {
+        s = s.substr(0, s.size() - 1);
+    }
+    long long n;
+    if (!NumberParser{}(s, &n).isOK() || n < 0) {
+        return Status(ErrorCodes::BadValue, "expected a size, eg. 512M or 4G");
+    }
+    if (static_cast<unsigned long long>(n) > std::numeric_limits<size_t>::max() / multiplier) {
+        return Status(ErrorCodes::BadValue, "size is too big");
+    }
+    return static_cast<size_t>(n) * multiplier;
+}
+
+}  // namespace mongo
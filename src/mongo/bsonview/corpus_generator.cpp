@@ -0,0 +1,430 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/corpus_generator.h"
+
+#include <unistd.h>
+#include <vector>
+
+#include "mongo/base/data_view.h"
+#include "mongo/base/parse_number.h"
+#include "mongo/bson/bson_depth.h"
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/platform/random.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/errno_util.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+constexpr unsigned long CorpusGenerator::kChunkDocs;
+constexpr long long CorpusGenerator::kMaxHugeKB;
+
+namespace {
+
+const char* kWords[] = {
+    "alpha",   "bravo",  "charlie", "delta",   "echo",     "foxtrot", "golf",    "hotel",
+    "india",   "juliet", "kilo",    "lima",    "mike",     "november", "oscar",  "papa",
+    "quebec",  "romeo",  "sierra",  "tango",   "uniform",  "victor",  "whiskey", "xray",
+    "yankee",  "zulu",   "request", "replica", "shard",    "cursor",  "index",   "collection",
+};
+const int kNumWords = sizeof(kWords) / sizeof(kWords[0]);
+
+const char* kNamespaces[] = {
+    "app.users", "app.orders", "app.sessions", "app.events",
+    "app.carts", "app.items", "admin.system.users", "config.transactions",
+};
+
+const char* kComponents[] = {
+    "NETWORK", "COMMAND", "STORAGE", "REPL", "QUERY", "ACCESS", "SHARDING", "CONTROL",
+};
+
+const long long kEpochSecs = 1560000000;
+
+// splitmix64, so that nearby doc numbers get unrelated random sequences.
+uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+std::string words(PseudoRandom* r, int n) {
+    std::string s;
+    for (int i = 0; i < n; i++) {
+        if (i > 0) {
+            s += ' ';
+        }
+        s += kWords[r->nextInt32(kNumWords)];
+    }
+    return s;
+}
+
+OID randomOID(PseudoRandom* r) {
+    char bytes[OID::kOIDSize];
+    for (int i = 0; i < OID::kOIDSize; i++) {
+        bytes[i] = static_cast<char>(r->nextInt32(256));
+    }
+    return OID::from(bytes);
+}
+
+void appendOplog(BSONObjBuilder* b, PseudoRandom* r, unsigned long doc) {
+    static const char* kOps[] = {"i", "i", "u", "u", "u", "d", "n"};
+    const char* op = kOps[r->nextInt32(7)];
+    b->append("ts", Timestamp(kEpochSecs + doc / 10, doc % 10 + 1));
+    b->append("t", static_cast<long long>(1 + doc / 100000));
+    b->append("h", r->nextInt64());
+    b->append("v", 2);
+    b->append("op", op);
+    b->append("ns", kNamespaces[r->nextInt32(8)]);
+    b->append("ui", randomOID(r));
+    b->appendDate("wall", Date_t::fromMillisSinceEpoch((kEpochSecs + doc / 10) * 1000 + doc % 10));
+    const OID id = randomOID(r);
+    if (op[0] == 'u') {
+        b->append("o2", BSON("_id" << id));
+        BSONObjBuilder o(b->subobjStart("o"));
+        BSONObjBuilder set(o.subobjStart("$set"));
+        set.append("n", r->nextInt32(1000000));
+        set.append("status", kWords[r->nextInt32(kNumWords)]);
+    } else if (op[0] == 'd') {
+        b->append("o", BSON("_id" << id));
+    } else if (op[0] == 'n') {
+        b->append("o", BSON("msg" << "periodic noop"));
+    } else {
+        BSONObjBuilder o(b->subobjStart("o"));
+        o.append("_id", id);
+        o.append("name", words(r, 2 + r->nextInt32(6)));
+        o.append("n", r->nextInt32(1000000));
+        BSONArrayBuilder tags(o.subarrayStart("tags"));
+        for (int i = r->nextInt32(5); i > 0; i--) {
+            tags.append(kWords[r->nextInt32(kNumWords)]);
+        }
+    }
+}
+
+void appendLog(BSONObjBuilder* b, PseudoRandom* r, unsigned long doc) {
+    static const char* kSeverities[] = {"I", "I", "I", "I", "I", "I", "W", "E", "D"};
+    // the text logs render mode expects exactly these first five fields
+    b->appendDate("t", Date_t::fromMillisSinceEpoch(kEpochSecs * 1000 + doc * 37));
+    b->append("s", kSeverities[r->nextInt32(9)]);
+    b->append("c", kComponents[r->nextInt32(8)]);
+    b->append("ctx", "conn" + std::to_string(r->nextInt32(5000)));
+    b->append("msg", words(r, 3 + r->nextInt32(12)));
+    BSONObjBuilder attr(b->subobjStart("attr"));
+    attr.append("durationMillis", r->nextInt32(10000));
+    attr.append("remote",
+                "10.0." + std::to_string(r->nextInt32(256)) + "." +
+                    std::to_string(r->nextInt32(256)) + ":" +
+                    std::to_string(1024 + r->nextInt32(60000)));
+}
+
+void appendNested(BSONObjBuilder* b, PseudoRandom* r, long long depth) {
+    b->append("level", depth);
+    b->append("name", kWords[r->nextInt32(kNumWords)]);
+    if (depth > 0) {
+        BSONObjBuilder child(b->subobjStart("child"));
+        appendNested(&child, r, depth - 1);
+    } else {
+        b->append("value", r->nextInt32(1000000));
+    }
+}
+
+}  // namespace
+
+StatusWith<CorpusGenerator::Spec> CorpusGenerator::parseSpec(StringData spec) {
+    Spec result;
+    const size_t colon = spec.find(':');
+    const StringData name = spec.substr(0, colon);
+    if (name == "flat") {
+        result.shape = Shape::kFlat;
+    } else if (name == "oplog") {
+        result.shape = Shape::kOplog;
+    } else if (name == "logs") {
+        result.shape = Shape::kLogs;
+    } else if (name == "nested") {
+        result.shape = Shape::kNested;
+        result.param = 8;
+    } else if (name == "wide") {
+        result.shape = Shape::kWide;
+        result.param = 100;
+    } else if (name == "arrays") {
+        result.shape = Shape::kArrays;
+        result.param = 50;
+    } else if (name == "huge") {
+        result.shape = Shape::kHuge;
+        result.param = 8192;
+    } else {
+        return Status(ErrorCodes::BadValue, str::stream() << "Unknown shape: " << name);
+    }
+
+    if (colon != std::string::npos) {
+        if (result.param == 0) {
+            return Status(ErrorCodes::BadValue,
+                          str::stream() << "The " << name << " shape takes no parameter");
+        }
+        if (!NumberParser{}(spec.substr(colon + 1), &result.param).isOK() || result.param <= 0) {
+            return Status(ErrorCodes::BadValue,
+                          str::stream() << "The parameter of " << name
+                                        << " must be a positive number");
+        }
+    }
+    if (result.shape == Shape::kNested && result.param > BSONDepth::getMaxAllowableDepth() - 1) {
+        return Status(ErrorCodes::BadValue,
+                      str::stream() << "Docs can't be nested more than "
+                                    << BSONDepth::getMaxAllowableDepth() - 1 << " deep");
+    }
+    if (result.shape == Shape::kHuge && result.param > kMaxHugeKB) {
+        return Status(ErrorCodes::BadValue,
+                      str::stream() << "Huge docs can't be more than " << kMaxHugeKB << " KB");
+    }
+    return result;
+}
+
+BSONObj CorpusGenerator::makeDoc(const Spec& spec, uint64_t seed, unsigned long doc) {
+    PseudoRandom r(static_cast<int64_t>(mix(seed ^ mix(doc))));
+    // only one word of the generator's state is seeded, so its first few outputs are much alike
+    for (int i = 0; i < 4; i++) {
+        r.nextInt32();
+    }
+    BSONObjBuilder b;
+    if (spec.shape == Shape::kLogs) {
+        appendLog(&b, &r, doc);
+        return b.obj();
+    }
+
+    b.append("_id", static_cast<long long>(doc));
+    switch (spec.shape) {
+        case Shape::kFlat:
+            b.append("a", r.nextInt32(1000));
+            b.append("b", words(&r, 1 + r.nextInt32(3)));
+            b.append("c", r.nextCanonicalDouble() * 1000);
+            b.append("d", r.nextInt32(2) == 0);
+            b.appendDate("e", Date_t::fromMillisSinceEpoch(kEpochSecs * 1000 + doc * 1000));
+            break;
+        case Shape::kOplog:
+            appendOplog(&b, &r, doc);
+            break;
+        case Shape::kNested: {
+            BSONObjBuilder root(b.subobjStart("root"));
+            appendNested(&root, &r, spec.param - 1);
+            break;
+        }
+        case Shape::kWide:
+            for (long long f = 0; f < spec.param; f++) {
+                const std::string field = "f" + std::to_string(f);
+                switch (f % 3) {
+                    case 0:
+                        b.append(field, r.nextInt32(1000000));
+                        break;
+                    case 1:
+                        b.append(field, kWords[r.nextInt32(kNumWords)]);
+                        break;
+                    case 2:
+                        b.append(field, r.nextCanonicalDouble());
+                        break;
+                }
+            }
+            break;
+        case Shape::kArrays: {
+            BSONArrayBuilder nums(b.subarrayStart("nums"));
+            for (long long i = 0; i < spec.param; i++) {
+                nums.append(r.nextInt32(1000000));
+            }
+            nums.done();
+            BSONArrayBuilder tags(b.subarrayStart("tags"));
+            for (long long i = 0; i < spec.param; i++) {
+                tags.append(kWords[r.nextInt32(kNumWords)]);
+            }
+            tags.done();
+            BSONArrayBuilder items(b.subarrayStart("items"));
+            for (long long i = 0; i < (spec.param + 4) / 5; i++) {
+                items.append(BSON("sku" << r.nextInt32(10000) << "qty" << 1 + r.nextInt32(10)
+                                        << "price" << r.nextInt32(100000) / 100.0));
+            }
+            items.done();
+            break;
+        }
+        case Shape::kHuge: {
+            // subdocs of about 1KB each
+            BSONArrayBuilder chunks(b.subarrayStart("chunks"));
+            for (long long i = 0; i < spec.param; i++) {
+                BSONObjBuilder chunk(chunks.subobjStart());
+                chunk.append("i", i);
+                std::string text = words(&r, 150);
+                text.resize(980, '.');
+                chunk.append("text", text);
+            }
+            chunks.done();
+            break;
+        }
+        case Shape::kLogs:
+            break;
+    }
+    return b.obj();
+}
+
+CorpusGenerator::CorpusGenerator(Spec spec,
+                                 uint64_t seed,
+                                 unsigned long long numDocs,
+                                 unsigned long long numBytes,
+                                 std::string path)
+    : _spec(spec), _seed(seed), _numDocs(numDocs), _numBytes(numBytes), _path(std::move(path)) {
+    invariant(_numDocs > 0 || _numBytes > 0);
+}
+
+CorpusGenerator::~CorpusGenerator() {
+    _stop.store(true);
+    _cond.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void CorpusGenerator::start(unsigned numThreads) {
+    invariant(!_thread.joinable());
+    _thread = stdx::thread([this, numThreads]() { _run(numThreads); });
+}
+
+void CorpusGenerator::_run(unsigned numThreads) {
+    // keep the generators a little ahead of the writer, without buffering the whole file
+    _window = numThreads * 4;
+    std::vector<stdx::thread> workers;
+    auto stopWorkers = [&] {
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _stop.store(true);
+        }
+        _cond.notify_all();
+        for (auto&& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    };
+
+    try {
+        _out = (_path == "-") ? OutputFile::toStdout() : std::make_unique<OutputFile>(_path);
+
+        for (unsigned i = 0; i < numThreads; i++) {
+            workers.emplace_back([this]() { _worker(); });
+        }
+
+        bool finished = false;
+        while (!finished) {
+            std::string chunk;
+            {
+                stdx::unique_lock<stdx::mutex> lk(_mutex);
+                _cond.wait(lk, [&] { return _stop.load() || _generated.count(_nextChunkToWrite); });
+                uassert(ErrorCodes::Interrupted, "Generating was interrupted", !_stop.load());
+                auto it = _generated.find(_nextChunkToWrite);
+                chunk = std::move(it->second);
+                _generated.erase(it);
+                _nextChunkToWrite++;
+            }
+            _cond.notify_all();
+            finished = _write(chunk);
+        }
+        stopWorkers();
+        _out->commit();
+    } catch (const DBException& e) {
+        _status = e.toStatus();
+        stopWorkers();
+    }
+    // which removes the file if generating it failed
+    _out.reset();
+    _done.store(true);
+}
+
+void CorpusGenerator::_worker() {
+    while (true) {
+        unsigned long chunk;
+        {
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+            _cond.wait(lk,
+                       [&] { return _stop.load() || _nextChunk < _nextChunkToWrite + _window; });
+            if (_stop.load()) {
+                return;
+            }
+            chunk = _nextChunk++;
+        }
+
+        unsigned long long begin = static_cast<unsigned long long>(chunk) * kChunkDocs;
+        unsigned long long end = begin + kChunkDocs;
+        if (_numDocs > 0 && end > _numDocs) {
+            end = std::max(begin, _numDocs);
+        }
+        std::string data;
+        for (unsigned long long doc = begin; doc < end && ! _stop.load(); doc++) {
+            const BSONObj obj = makeDoc(_spec, _seed, doc);
+            data.append(obj.objdata(), obj.objsize());
+        }
+
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _generated.emplace(chunk, std::move(data));
+        }
+        _cond.notify_all();
+    }
+}
+
+bool CorpusGenerator::_write(const std::string& chunk) {
+    // with a size limit, the file ends with the doc that reaches it
+    size_t size = 0;
+    unsigned long long docs = 0;
+    bool finished = false;
+    while (size < chunk.size()) {
+        size += ConstDataView(chunk.data() + size).read<LittleEndian<int>>();
+        docs++;
+        if (_numBytes > 0 && _numBytesWritten.load() + size >= _numBytes) {
+            finished = true;
+            break;
+        }
+    }
+    if (_numDocs > 0 && _numDocsWritten.load() + docs >= _numDocs) {
+        finished = true;
+    }
+
+    size_t written = 0;
+    while (written < size) {
+        ssize_t res = ::write(_out->fd(), chunk.data() + written, size - written);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        uassert(ErrorCodes::FileStreamFailed,
+                str::stream() << "Unable to write " << _path << ": " << errnoWithDescription(),
+                res > 0);
+        written += res;
+    }
+    _numDocsWritten.fetchAndAdd(docs);
+    _numBytesWritten.fetchAndAdd(size);
+    return finished;
+}
+
+}  // namespace mongo
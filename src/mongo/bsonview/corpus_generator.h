@@ -0,0 +1,148 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "mongo/base/status.h"
+#include "mongo/base/status_with.h"
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/output_file.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * Writes a file of synthetic docs, for testing bv against big inputs of realistic shapes.
+ *
+ * Every doc is a function of only the seed, the shape and its number in the file, so the same
+ * arguments always give the same file, however many threads generate it.  The docs are generated
+ * in chunks by several threads, and written out in order.
+ */
+class CorpusGenerator {
+public:
+    enum class Shape {
+        kFlat,    // a few scalar fields
+        kOplog,   // oplog entries
+        kLogs,    // structured server log lines, as rendered by the text logs mode
+        kNested,  // subdocs nested <param> deep (default 8)
+        kWide,    // <param> top level fields (default 100)
+        kArrays,  // arrays of <param> elements (default 50)
+        kHuge,    // single docs of <param> KB (default 8192)
+    };
+
+    struct Spec {
+        Shape shape = Shape::kFlat;
+        long long param = 0;
+    };
+
+    static constexpr unsigned long kChunkDocs = 1024;
+    // Leaves room for the rest of the doc within the maximum BSON size.
+    static constexpr long long kMaxHugeKB = 16000;
+
+    /**
+     * Parses eg. "oplog" or "nested:12".  The shapes are flat, oplog, logs, nested, wide, arrays
+     * and huge.
+     */
+    static StatusWith<Spec> parseSpec(StringData spec);
+
+    static BSONObj makeDoc(const Spec& spec, uint64_t seed, unsigned long doc);
+
+    /**
+     * Stops after numDocs docs, or once the file is at least numBytes long, whichever comes
+     * first (0 for no limit, but there must be one or the other).  The path "-" is stdout.
+     */
+    CorpusGenerator(Spec spec,
+                    uint64_t seed,
+                    unsigned long long numDocs,
+                    unsigned long long numBytes,
+                    std::string path);
+
+    ~CorpusGenerator();
+
+    void start(unsigned numThreads);
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    unsigned long long numDocsWritten() const {
+        return _numDocsWritten.load();
+    }
+
+    unsigned long long numBytesWritten() const {
+        return _numBytesWritten.load();
+    }
+
+    // Only valid once done.  The file is removed if generating it fails.
+    const Status& getStatus() const {
+        return _status;
+    }
+
+private:
+    void _run(unsigned numThreads);
+
+    void _worker();
+
+    // Returns true once the file is long enough.
+    bool _write(const std::string& chunk);
+
+    const Spec _spec;
+    const uint64_t _seed;
+    const unsigned long long _numDocs;
+    const unsigned long long _numBytes;
+    const std::string _path;
+
+    std::unique_ptr<OutputFile> _out;
+    unsigned long _window = 0;  // how many chunks may be generated ahead of the writer
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+    AtomicWord<unsigned long long> _numDocsWritten{0};
+    AtomicWord<unsigned long long> _numBytesWritten{0};
+
+    stdx::mutex _mutex;  // protects the rest
+    stdx::condition_variable _cond;
+    unsigned long _nextChunk = 0;         // to be generated
+    unsigned long _nextChunkToWrite = 0;
+    std::map<unsigned long, std::string> _generated;  // chunks waiting for the writer
+
+    Status _status = Status::OK();
+};
+
+}  // namespace mongo
@@ -0,0 +1,89 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/doc_renderer.h"
+
+#include <cctype>
+
+#include "mongo/bson/util/builder.h"
+
+namespace mongo {
+
+std::string DocRenderer::render(const BSONObj& obj) const {
+    if (_projection) {
+        switch (_documentRenderMode) {
+            // the JSON is written as the doc is projected, without building a copy
+            case kJSONOneline: return _projection->jsonString(obj, _extendedJSONMode);
+            case kJSONPretty:  return _projection->jsonString(obj, _extendedJSONMode, 1);
+            case kToString:    return _projection->project(obj).toString();
+            case kTextLogs:    return textLogs(_projection->project(obj));
+        }
+    }
+    switch (_documentRenderMode) {
+        case kJSONOneline: return obj.jsonString(_extendedJSONMode);
+        case kJSONPretty:  return obj.jsonString(_extendedJSONMode, 1);
+        case kToString:    return obj.toString();
+        case kTextLogs:    return textLogs(obj);
+    }
+    return "--- unknown render mode ---";
+}
+
+std::string DocRenderer::textLogs(const BSONObj& doc) {
+    // TODO: this code is foul
+    StringBuilder sb;
+    int i = 1;
+    for (auto&& elem : doc) {
+        if (i == 1) {
+            sb << elem.Date().toString();
+        } else if (i == 2) {
+            char c = toupper(elem.String()[0]);
+            sb << " " << c;
+        } else if (i == 3) {
+            sb << " " << elem.String();
+        } else if (i == 4) {
+            sb << " [" << elem.String() << "]";
+        } else if (i == 5) {
+            auto msg = elem.String();
+            while (msg.length() > 0 && msg[msg.length()-1] == '\n') {
+                msg = msg.substr(0, msg.length()-1);
+            }
+            while (msg[0] == '\t') {
+                msg = "        " + msg.substr(1);
+            }
+            sb << " " << msg;
+            break;
+        }
+        i++;
+    }
+    return sb.str();
+}
+
+}  // namespace mongo
@@ -0,0 +1,92 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bson/json.h"
+#include "mongo/bsonview/render_projection.h"
+
+namespace mongo {
+
+/**
+ * How a view turns docs into text: the render mode, the extended JSON format, and any projection.
+ * Text searches match against the same text, so they share the view's renderer.
+ */
+class DocRenderer {
+public:
+    enum DocumentRenderMode {
+        kJSONOneline,
+        kJSONPretty,
+        kToString,
+        kTextLogs,
+    };
+
+    void setDocumentRenderMode(DocumentRenderMode documentRenderMode) {
+        _documentRenderMode = documentRenderMode;
+    }
+
+    DocumentRenderMode getDocumentRenderMode() const {
+        return _documentRenderMode;
+    }
+
+    void setExtendedJSONMode(JsonStringFormat extendedJSONMode) {
+        _extendedJSONMode = extendedJSONMode;
+    }
+
+    JsonStringFormat getExtendedJSONMode() const {
+        return _extendedJSONMode;
+    }
+
+    // Only the projected fields are rendered, or the whole doc if projection is null.
+    void setProjection(std::unique_ptr<RenderProjection> projection) {
+        _projection = std::move(projection);
+    }
+
+    const RenderProjection* getProjection() const {
+        return _projection.get();
+    }
+
+    // Safe to call from several threads at once, as long as the renderer isn't being changed.
+    std::string render(const BSONObj& obj) const;
+
+    // The first five fields of a log doc (date, severity, component, context, message), as a line
+    // of the server log.
+    static std::string textLogs(const BSONObj& doc);
+
+private:
+    DocumentRenderMode _documentRenderMode = kJSONOneline;
+    JsonStringFormat _extendedJSONMode = Strict;
+    std::unique_ptr<RenderProjection> _projection;
+};
+
+}  // namespace mongo
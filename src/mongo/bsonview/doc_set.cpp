@@ -0,0 +1,511 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/doc_set.h"
+
+#include <algorithm>
+
+#include "mongo/platform/bits.h"
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+constexpr int DocSet::kLowBits;
+constexpr uint32_t DocSet::kContainerSize;
+constexpr uint32_t DocSet::kMaxArray;
+constexpr uint32_t DocSet::kBitsetWords;
+
+bool DocSet::Container::contains(uint16_t low) const {
+    switch (kind) {
+        case kArray:
+            return std::binary_search(array.begin(), array.end(), low);
+        case kBitset:
+            return (bits[low >> 6] >> (low & 63)) & 1;
+        case kRuns: {
+            auto it = std::upper_bound(
+                runs.begin(), runs.end(), low, [](uint16_t l, const Run& r) { return l < r.first; });
+            return it != runs.begin() && low <= (--it)->last;
+        }
+    }
+    MONGO_UNREACHABLE;
+}
+
+bool DocSet::Container::add(uint16_t low) {
+    if (contains(low)) {
+        return false;
+    }
+    switch (kind) {
+        case kArray:
+            array.insert(std::lower_bound(array.begin(), array.end(), low), low);
+            if (++card > kMaxArray) {
+                assign(toRuns());
+            }
+            break;
+        case kBitset:
+            bits[low >> 6] |= 1ULL << (low & 63);
+            card++;
+            break;
+        case kRuns:
+            assign(_union(runs, {{low, low}}));
+            break;
+    }
+    return true;
+}
+
+bool DocSet::Container::remove(uint16_t low) {
+    if ( ! contains(low)) {
+        return false;
+    }
+    switch (kind) {
+        case kArray:
+            array.erase(std::lower_bound(array.begin(), array.end(), low));
+            card--;
+            break;
+        case kBitset:
+            bits[low >> 6] &= ~(1ULL << (low & 63));
+            if (--card <= kMaxArray) {
+                assign(toRuns());
+            }
+            break;
+        case kRuns:
+            assign(_subtract(runs, {{low, low}}));
+            break;
+    }
+    return true;
+}
+
+uint32_t DocSet::Container::next(uint32_t from) const {
+    if (from >= kContainerSize) {
+        return kContainerSize;
+    }
+    switch (kind) {
+        case kArray: {
+            auto it = std::lower_bound(array.begin(), array.end(), from);
+            return it == array.end() ? kContainerSize : *it;
+        }
+        case kBitset: {
+            uint32_t w = from >> 6;
+            uint64_t word = bits[w] & (~0ULL << (from & 63));
+            while (word == 0) {
+                if (++w == kBitsetWords) {
+                    return kContainerSize;
+                }
+                word = bits[w];
+            }
+            return w * 64 + countTrailingZeros64(word);
+        }
+        case kRuns: {
+            auto it = std::lower_bound(
+                runs.begin(), runs.end(), from, [](const Run& r, uint32_t f) { return r.last < f; });
+            return it == runs.end() ? kContainerSize : std::max<uint32_t>(it->first, from);
+        }
+    }
+    MONGO_UNREACHABLE;
+}
+
+int32_t DocSet::Container::prev(uint32_t from) const {
+    switch (kind) {
+        case kArray: {
+            auto it = std::upper_bound(array.begin(), array.end(), from);
+            return it == array.begin() ? -1 : *(--it);
+        }
+        case kBitset: {
+            int32_t w = from >> 6;
+            const uint32_t shift = from & 63;
+            uint64_t word = bits[w] & (shift == 63 ? ~0ULL : (1ULL << (shift + 1)) - 1);
+            while (word == 0) {
+                if (--w < 0) {
+                    return -1;
+                }
+                word = bits[w];
+            }
+            return w * 64 + 63 - countLeadingZeros64(word);
+        }
+        case kRuns: {
+            auto it = std::upper_bound(
+                runs.begin(), runs.end(), from, [](uint32_t f, const Run& r) { return f < r.first; });
+            return it == runs.begin() ? -1 : std::min<uint32_t>((--it)->last, from);
+        }
+    }
+    MONGO_UNREACHABLE;
+}
+
+std::vector<DocSet::Run> DocSet::Container::toRuns() const {
+    switch (kind) {
+        case kArray:
+            return _runsOf(array.begin(), array.end());
+        case kBitset: {
+            std::vector<Run> out;
+            uint32_t i = 0;
+            while ((i = next(i)) < kContainerSize) {
+                // find the end of the run, a word at a time
+                uint32_t w = i >> 6;
+                uint64_t clear = ~bits[w] & (~0ULL << (i & 63));
+                while (clear == 0 && ++w < kBitsetWords) {
+                    clear = ~bits[w];
+                }
+                const uint32_t end = (w == kBitsetWords) ? kContainerSize : w * 64 + countTrailingZeros64(clear);
+                out.push_back({static_cast<uint16_t>(i), static_cast<uint16_t>(end - 1)});
+                i = end;
+            }
+            return out;
+        }
+        case kRuns:
+            return runs;
+    }
+    MONGO_UNREACHABLE;
+}
+
+void DocSet::Container::assign(const std::vector<Run>& newRuns) {
+    uint32_t newCard = 0;
+    for (auto&& r : newRuns) {
+        newCard += r.last - r.first + 1;
+    }
+
+    // whichever is smallest
+    const size_t runBytes = newRuns.size() * sizeof(Run);
+    const size_t arrayBytes = (newCard <= kMaxArray) ? newCard * sizeof(uint16_t) : SIZE_MAX;
+    const size_t bitsetBytes = kBitsetWords * sizeof(uint64_t);
+    Kind newKind;
+    if (runBytes <= arrayBytes && runBytes <= bitsetBytes) {
+        newKind = kRuns;
+    } else if (arrayBytes <= bitsetBytes) {
+        newKind = kArray;
+    } else {
+        newKind = kBitset;
+    }
+
+    std::vector<uint16_t> newArray;
+    std::vector<uint64_t> newBits;
+    std::vector<Run> keptRuns;
+    if (newKind == kArray) {
+        newArray.reserve(newCard);
+        for (auto&& r : newRuns) {
+            for (uint32_t i = r.first; i <= r.last; i++) {
+                newArray.push_back(i);
+            }
+        }
+    } else if (newKind == kBitset) {
+        newBits.assign(kBitsetWords, 0);
+        for (auto&& r : newRuns) {
+            for (uint32_t i = r.first; i <= r.last;) {
+                if ((i & 63) == 0 && i + 63 <= r.last) {
+                    newBits[i >> 6] = ~0ULL;
+                    i += 64;
+                } else {
+                    newBits[i >> 6] |= 1ULL << (i & 63);
+                    i++;
+                }
+            }
+        }
+    } else {
+        keptRuns = newRuns;
+    }
+    // swapped rather than assigned, so that the old storage is freed
+    array.swap(newArray);
+    bits.swap(newBits);
+    runs.swap(keptRuns);
+    kind = newKind;
+    card = newCard;
+}
+
+size_t DocSet::Container::memoryUsage() const {
+    return array.capacity() * sizeof(uint16_t) + bits.capacity() * sizeof(uint64_t) +
+        runs.capacity() * sizeof(Run);
+}
+
+std::vector<DocSet::Run> DocSet::_union(const std::vector<Run>& a, const std::vector<Run>& b) {
+    std::vector<Run> out;
+    out.reserve(a.size() + b.size());
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() || j < b.size()) {
+        const Run r = (j == b.size() || (i < a.size() && a[i].first <= b[j].first)) ? a[i++] : b[j++];
+        if ( ! out.empty() && static_cast<uint32_t>(r.first) <= static_cast<uint32_t>(out.back().last) + 1) {
+            out.back().last = std::max(out.back().last, r.last);
+        } else {
+            out.push_back(r);
+        }
+    }
+    return out;
+}
+
+std::vector<DocSet::Run> DocSet::_subtract(const std::vector<Run>& a, const std::vector<Run>& b) {
+    std::vector<Run> out;
+    size_t j = 0;
+    for (auto&& r : a) {
+        while (j < b.size() && b[j].last < r.first) {
+            j++;
+        }
+        uint32_t first = r.first;
+        for (size_t k = j; first <= r.last; k++) {
+            if (k == b.size() || b[k].first > r.last) {
+                out.push_back({static_cast<uint16_t>(first), r.last});
+                break;
+            }
+            if (b[k].first > first) {
+                out.push_back({static_cast<uint16_t>(first), static_cast<uint16_t>(b[k].first - 1)});
+            }
+            first = static_cast<uint32_t>(b[k].last) + 1;
+        }
+    }
+    return out;
+}
+
+template <typename It>
+std::vector<DocSet::Run> DocSet::_runsOf(It begin, It end) {
+    std::vector<Run> out;
+    for (It it = begin; it != end; ++it) {
+        const uint16_t low = _low(*it);
+        if ( ! out.empty() && low <= out.back().last) {
+            continue;
+        }
+        if ( ! out.empty() && static_cast<uint32_t>(low) == static_cast<uint32_t>(out.back().last) + 1) {
+            out.back().last = low;
+        } else {
+            out.push_back({low, low});
+        }
+    }
+    return out;
+}
+
+std::vector<DocSet::Container>::iterator DocSet::_lowerBound(uint64_t key) {
+    return std::lower_bound(_containers.begin(), _containers.end(), key,
+                            [](const Container& c, uint64_t k) { return c.key < k; });
+}
+
+std::vector<DocSet::Container>::const_iterator DocSet::_lowerBound(uint64_t key) const {
+    return std::lower_bound(_containers.begin(), _containers.end(), key,
+                            [](const Container& c, uint64_t k) { return c.key < k; });
+}
+
+bool DocSet::contains(unsigned long doc) const {
+    auto it = _lowerBound(_key(doc));
+    return it != _containers.end() && it->key == _key(doc) && it->contains(_low(doc));
+}
+
+void DocSet::add(unsigned long doc) {
+    auto it = _lowerBound(_key(doc));
+    if (it == _containers.end() || it->key != _key(doc)) {
+        Container c;
+        c.key = _key(doc);
+        it = _containers.insert(it, std::move(c));
+    }
+    if (it->add(_low(doc))) {
+        _size++;
+    }
+}
+
+void DocSet::remove(unsigned long doc) {
+    auto it = _lowerBound(_key(doc));
+    if (it == _containers.end() || it->key != _key(doc) || ! it->remove(_low(doc))) {
+        return;
+    }
+    _size--;
+    if (it->card == 0) {
+        _containers.erase(it);
+    }
+}
+
+void DocSet::addRange(unsigned long begin, unsigned long end) {
+    if (begin >= end) {
+        return;
+    }
+    const uint64_t firstKey = _key(begin);
+    const uint64_t lastKey = _key(end - 1);
+
+    // rebuilt, so that adding a container to the middle doesn't move all the ones after it
+    std::vector<Container> out;
+    out.reserve(_containers.size() + (lastKey - firstKey + 1));
+    auto it = _containers.begin();
+    while (it != _containers.end() && it->key < firstKey) {
+        out.push_back(std::move(*it++));
+    }
+    for (uint64_t key = firstKey; key <= lastKey; key++) {
+        const Run r{key == firstKey ? _low(begin) : static_cast<uint16_t>(0),
+                    key == lastKey ? _low(end - 1) : static_cast<uint16_t>(kContainerSize - 1)};
+        Container c;
+        if (it != _containers.end() && it->key == key) {
+            c = std::move(*it++);
+        }
+        c.key = key;
+        _size -= c.card;
+        if (r.first == 0 && r.last == kContainerSize - 1) {
+            c.assign({r});
+        } else {
+            c.assign(_union(c.toRuns(), {r}));
+        }
+        _size += c.card;
+        out.push_back(std::move(c));
+    }
+    while (it != _containers.end()) {
+        out.push_back(std::move(*it++));
+    }
+    _containers = std::move(out);
+}
+
+void DocSet::removeRange(unsigned long begin, unsigned long end) {
+    if (begin >= end) {
+        return;
+    }
+    const uint64_t firstKey = _key(begin);
+    const uint64_t lastKey = _key(end - 1);
+    auto first = _lowerBound(firstKey);
+    auto last = first;
+    for (; last != _containers.end() && last->key <= lastKey; ++last) {
+        const Run r{last->key == firstKey ? _low(begin) : static_cast<uint16_t>(0),
+                    last->key == lastKey ? _low(end - 1) : static_cast<uint16_t>(kContainerSize - 1)};
+        _size -= last->card;
+        if (r.first == 0 && r.last == kContainerSize - 1) {
+            last->assign({});
+        } else {
+            last->assign(_subtract(last->toRuns(), {r}));
+        }
+        _size += last->card;
+    }
+    _containers.erase(
+        std::remove_if(first, last, [](const Container& c) { return c.card == 0; }), last);
+}
+
+template <typename Op>
+void DocSet::_applySorted(const std::vector<unsigned long>& docs, Op op) {
+    std::vector<Container> out;
+    out.reserve(_containers.size());
+    auto it = _containers.begin();
+    size_t i = 0;
+    while (i < docs.size()) {
+        const uint64_t key = _key(docs[i]);
+        size_t j = i;
+        while (j < docs.size() && _key(docs[j]) == key) {
+            j++;
+        }
+        const std::vector<Run> runs = _runsOf(docs.begin() + i, docs.begin() + j);
+        i = j;
+
+        while (it != _containers.end() && it->key < key) {
+            out.push_back(std::move(*it++));
+        }
+        Container c;
+        if (it != _containers.end() && it->key == key) {
+            c = std::move(*it++);
+        }
+        c.key = key;
+        _size -= c.card;
+        c.assign(op(c.toRuns(), runs));
+        _size += c.card;
+        if (c.card > 0) {
+            out.push_back(std::move(c));
+        }
+    }
+    while (it != _containers.end()) {
+        out.push_back(std::move(*it++));
+    }
+    _containers = std::move(out);
+}
+
+void DocSet::addSorted(const std::vector<unsigned long>& docs) {
+    _applySorted(docs, &DocSet::_union);
+}
+
+void DocSet::removeSorted(const std::vector<unsigned long>& docs) {
+    _applySorted(docs, &DocSet::_subtract);
+}
+
+boost::optional<unsigned long> DocSet::next(unsigned long from) const {
+    auto it = _lowerBound(_key(from));
+    if (it != _containers.end() && it->key == _key(from)) {
+        const uint32_t low = it->next(_low(from));
+        if (low < kContainerSize) {
+            return (it->key << kLowBits) | low;
+        }
+        ++it;
+    }
+    if (it == _containers.end()) {
+        return boost::none;
+    }
+    return (it->key << kLowBits) | it->next(0);
+}
+
+boost::optional<unsigned long> DocSet::prev(unsigned long from) const {
+    auto it = _lowerBound(_key(from));
+    if (it != _containers.end() && it->key == _key(from)) {
+        const int32_t low = it->prev(_low(from));
+        if (low >= 0) {
+            return (it->key << kLowBits) | low;
+        }
+    }
+    if (it == _containers.begin()) {
+        return boost::none;
+    }
+    --it;
+    return (it->key << kLowBits) | it->prev(kContainerSize - 1);
+}
+
+void DocSet::clear() {
+    std::vector<Container>().swap(_containers);
+    _size = 0;
+}
+
+void DocSet::appendTo(std::vector<unsigned long>* out) const {
+    out->reserve(out->size() + _size);
+    for (auto&& c : _containers) {
+        const unsigned long base = c.key << kLowBits;
+        switch (c.kind) {
+            case Container::kArray:
+                for (auto low : c.array) {
+                    out->push_back(base | low);
+                }
+                break;
+            case Container::kBitset:
+                for (uint32_t low = c.next(0); low < kContainerSize; low = c.next(low + 1)) {
+                    out->push_back(base | low);
+                }
+                break;
+            case Container::kRuns:
+                for (auto&& r : c.runs) {
+                    for (uint32_t low = r.first; low <= r.last; low++) {
+                        out->push_back(base | low);
+                    }
+                }
+                break;
+        }
+    }
+}
+
+size_t DocSet::memoryUsage() const {
+    size_t bytes = _containers.capacity() * sizeof(Container);
+    for (auto&& c : _containers) {
+        bytes += c.memoryUsage();
+    }
+    return bytes;
+}
+
+}  // namespace mongo
@@ -0,0 +1,155 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace mongo {
+
+/**
+ * A set of doc numbers, eg. the marked docs of a view, compressed like a Roaring bitmap: docs are
+ * grouped into containers of 2^16 by their high bits, and each container holds its low bits as
+ * whichever is smallest of a sorted array (when sparse), a bitset (when dense), or a list of runs
+ * (when clustered).  So a range of any size takes only a run per container, and can be added or
+ * removed in time proportional to the number of containers it spans, rather than the number of
+ * docs.
+ *
+ * Not thread-safe.
+ */
+class DocSet {
+public:
+    bool contains(unsigned long doc) const;
+
+    void add(unsigned long doc);
+
+    void remove(unsigned long doc);
+
+    // [begin, end)
+    void addRange(unsigned long begin, unsigned long end);
+
+    void removeRange(unsigned long begin, unsigned long end);
+
+    // The docs must be in order (duplicates are fine).  Cheaper than adding them one at a time.
+    void addSorted(const std::vector<unsigned long>& docs);
+
+    void removeSorted(const std::vector<unsigned long>& docs);
+
+    // The first doc in the set at or after from.
+    boost::optional<unsigned long> next(unsigned long from) const;
+
+    // The last doc in the set at or before from.
+    boost::optional<unsigned long> prev(unsigned long from) const;
+
+    unsigned long size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    void clear();
+
+    // Appends the docs to *out, in order.
+    void appendTo(std::vector<unsigned long>* out) const;
+
+    size_t memoryUsage() const;
+
+private:
+    static constexpr int kLowBits = 16;
+    static constexpr uint32_t kContainerSize = 1 << kLowBits;
+    // Arrays bigger than this take more space than a bitset.
+    static constexpr uint32_t kMaxArray = 4096;
+    static constexpr uint32_t kBitsetWords = kContainerSize / 64;
+
+    struct Run {
+        uint16_t first;
+        uint16_t last;  // inclusive
+    };
+
+    struct Container {
+        enum Kind : uint8_t {
+            kArray,
+            kBitset,
+            kRuns,
+        };
+
+        uint64_t key = 0;  // the high bits of the docs
+        Kind kind = kArray;
+        uint32_t card = 0;
+        std::vector<uint16_t> array;  // sorted
+        std::vector<uint64_t> bits;   // kBitsetWords
+        std::vector<Run> runs;        // sorted, and neither overlapping nor adjacent
+
+        bool contains(uint16_t low) const;
+        // Both return false if there was nothing to do.
+        bool add(uint16_t low);
+        bool remove(uint16_t low);
+        // Returns kContainerSize if there's none.
+        uint32_t next(uint32_t from) const;
+        // Returns -1 if there's none.
+        int32_t prev(uint32_t from) const;
+
+        std::vector<Run> toRuns() const;
+        // Replaces the contents, in whichever form is smallest.
+        void assign(const std::vector<Run>& runs);
+
+        size_t memoryUsage() const;
+    };
+
+    static std::vector<Run> _union(const std::vector<Run>& a, const std::vector<Run>& b);
+    static std::vector<Run> _subtract(const std::vector<Run>& a, const std::vector<Run>& b);
+    // The runs of the low bits of some sorted docs (which may repeat).
+    template <typename It>
+    static std::vector<Run> _runsOf(It begin, It end);
+
+    static uint64_t _key(unsigned long doc) {
+        return doc >> kLowBits;
+    }
+
+    static uint16_t _low(unsigned long doc) {
+        return doc & (kContainerSize - 1);
+    }
+
+    std::vector<Container>::iterator _lowerBound(uint64_t key);
+    std::vector<Container>::const_iterator _lowerBound(uint64_t key) const;
+
+    // Replaces the runs of each container that the (sorted) docs fall in with
+    // op(existing runs, runs of the docs).
+    template <typename Op>
+    void _applySorted(const std::vector<unsigned long>& docs, Op op);
+
+    std::vector<Container> _containers;  // sorted by key, and none are empty
+    unsigned long _size = 0;
+};
+
+}  // namespace mongo
@@ -0,0 +1,272 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/doc_set.h"
+
+#include <set>
+
+#include "mongo/platform/random.h"
+#include "mongo/unittest/unittest.h"
+
+namespace mongo {
+namespace {
+
+// The docs of a container.
+const unsigned long kC = 1 << 16;
+
+// Checks set against a std::set of the same docs, including next() and prev() around each doc.
+void assertSameAs(const DocSet& set, const std::set<unsigned long>& model) {
+    ASSERT_EQ(set.size(), model.size());
+    ASSERT_EQ(set.empty(), model.empty());
+    std::vector<unsigned long> docs;
+    set.appendTo(&docs);
+    ASSERT(docs == std::vector<unsigned long>(model.begin(), model.end()));
+
+    std::set<unsigned long> probes = {0, kC - 1, kC, 5 * kC};
+    for (unsigned long doc : model) {
+        probes.insert(doc);
+        probes.insert(doc + 1);
+        if (doc > 0) {
+            probes.insert(doc - 1);
+        }
+    }
+    for (unsigned long probe : probes) {
+        ASSERT_EQ(set.contains(probe), model.count(probe) == 1);
+        auto next = model.lower_bound(probe);
+        auto expectedNext = (next == model.end()) ? boost::none : boost::make_optional(*next);
+        ASSERT(set.next(probe) == expectedNext);
+        auto prev = model.upper_bound(probe);
+        auto expectedPrev =
+            (prev == model.begin()) ? boost::none : boost::make_optional(*std::prev(prev));
+        ASSERT(set.prev(probe) == expectedPrev);
+    }
+}
+
+TEST(DocSet, Empty) {
+    DocSet set;
+    assertSameAs(set, {});
+    ASSERT_FALSE(set.next(0));
+    ASSERT_FALSE(set.prev(10 * kC));
+    set.remove(3);
+    set.removeRange(0, 10 * kC);
+    assertSameAs(set, {});
+    ASSERT_EQ(set.memoryUsage(), 0UL);
+}
+
+TEST(DocSet, AddAndRemove) {
+    DocSet set;
+    std::set<unsigned long> model;
+    for (unsigned long doc : {5UL, 3UL, kC + 7, 3UL, 0UL, kC - 1, 9 * kC}) {
+        set.add(doc);
+        model.insert(doc);
+    }
+    assertSameAs(set, model);
+    for (unsigned long doc : {3UL, 4UL, 9 * kC}) {
+        set.remove(doc);
+        model.erase(doc);
+    }
+    assertSameAs(set, model);
+}
+
+TEST(DocSet, ArrayToBitsetAndBack) {
+    DocSet set;
+    std::set<unsigned long> model;
+    // every other doc, so that runs don't help, until there are too many for an array
+    for (unsigned long doc = 0; doc < 2 * 4097; doc += 2) {
+        set.add(kC + doc);
+        model.insert(kC + doc);
+    }
+    assertSameAs(set, model);
+    const size_t bitsetBytes = kC / 8;
+    ASSERT_GTE(set.memoryUsage(), bitsetBytes);
+    ASSERT_LT(set.memoryUsage(), bitsetBytes + 4096);
+    const size_t asBitset = set.memoryUsage();
+
+    for (unsigned long doc = 0; doc < 2 * 100; doc += 2) {
+        set.remove(kC + doc);
+        model.erase(kC + doc);
+    }
+    assertSameAs(set, model);
+    // back to an array of the rest, which is no bigger than the bitset was
+    ASSERT_LTE(set.memoryUsage(), asBitset);
+}
+
+TEST(DocSet, RangesAreRuns) {
+    DocSet set;
+    std::set<unsigned long> model;
+    set.addRange(100, 20 * kC + 100);
+    for (unsigned long doc = 100; doc < 20 * kC + 100; doc++) {
+        model.insert(doc);
+    }
+    ASSERT_EQ(set.size(), model.size());
+    // a run per container, rather than millions of docs
+    ASSERT_LT(set.memoryUsage(), 4096UL);
+    ASSERT(*set.next(0) == 100);
+    ASSERT(*set.prev(30 * kC) == 20 * kC + 99);
+
+    // a hole across two containers
+    set.removeRange(3 * kC - 10, 4 * kC + 10);
+    for (unsigned long doc = 3 * kC - 10; doc < 4 * kC + 10; doc++) {
+        model.erase(doc);
+    }
+    ASSERT_EQ(set.size(), model.size());
+    ASSERT(*set.next(3 * kC - 10) == 4 * kC + 10);
+    ASSERT(*set.prev(4 * kC + 9) == 3 * kC - 11);
+    ASSERT_FALSE(set.contains(3 * kC + 5));
+    ASSERT(set.contains(4 * kC + 10));
+
+    // whole containers removed
+    set.removeRange(0, 19 * kC);
+    ASSERT_EQ(set.size(), kC + 100);
+    ASSERT(*set.next(0) == 19 * kC);
+    ASSERT_FALSE(set.prev(19 * kC - 1));
+}
+
+TEST(DocSet, RangesOverExistingDocs) {
+    DocSet set;
+    std::set<unsigned long> model;
+    // an array, a bitset, and runs
+    for (unsigned long doc = 0; doc < 10 * kC; doc += 997) {
+        set.add(doc);
+        model.insert(doc);
+    }
+    for (unsigned long doc = 3 * kC; doc < 4 * kC; doc += 3) {
+        set.add(doc);
+        model.insert(doc);
+    }
+    set.addRange(6 * kC + 10, 6 * kC + 5000);
+    for (unsigned long doc = 6 * kC + 10; doc < 6 * kC + 5000; doc++) {
+        model.insert(doc);
+    }
+    assertSameAs(set, model);
+
+    set.addRange(2 * kC + 500, 6 * kC + 20);
+    for (unsigned long doc = 2 * kC + 500; doc < 6 * kC + 20; doc++) {
+        model.insert(doc);
+    }
+    set.removeRange(kC + 3, 3 * kC + 7);
+    for (unsigned long doc = kC + 3; doc < 3 * kC + 7; doc++) {
+        model.erase(doc);
+    }
+    set.removeRange(6 * kC + 4000, 6 * kC + 4001);
+    model.erase(6 * kC + 4000);
+    assertSameAs(set, model);
+
+    // empty ranges
+    set.addRange(50, 50);
+    set.removeRange(60, 10);
+    assertSameAs(set, model);
+}
+
+TEST(DocSet, AddAndRemoveSorted) {
+    DocSet set;
+    std::set<unsigned long> model;
+    std::vector<unsigned long> docs;
+    for (unsigned long doc = 0; doc < 3 * kC; doc += 7) {
+        docs.push_back(doc);
+        docs.push_back(doc);  // repeats are fine
+        model.insert(doc);
+    }
+    set.addSorted(docs);
+    assertSameAs(set, model);
+
+    std::vector<unsigned long> removed;
+    for (unsigned long doc = kC - 700; doc < 2 * kC + 700; doc += 14) {
+        removed.push_back(doc);
+        model.erase(doc);
+    }
+    set.removeSorted(removed);
+    assertSameAs(set, model);
+
+    // removing every doc of a container drops it
+    removed.clear();
+    for (unsigned long doc : model) {
+        if (doc >= 2 * kC) {
+            removed.push_back(doc);
+        }
+    }
+    for (unsigned long doc : removed) {
+        model.erase(doc);
+    }
+    set.removeSorted(removed);
+    assertSameAs(set, model);
+    ASSERT_FALSE(set.next(2 * kC));
+}
+
+TEST(DocSet, NextAndPrevAcrossContainers) {
+    DocSet set;
+    set.add(kC - 1);
+    set.add(5 * kC);
+    set.add(9 * kC + 3);
+    ASSERT(*set.next(0) == kC - 1);
+    ASSERT(*set.next(kC) == 5 * kC);
+    ASSERT(*set.next(5 * kC + 1) == 9 * kC + 3);
+    ASSERT_FALSE(set.next(9 * kC + 4));
+    ASSERT(*set.prev(9 * kC + 2) == 5 * kC);
+    ASSERT(*set.prev(5 * kC - 1) == kC - 1);
+    ASSERT(*set.prev(100 * kC) == 9 * kC + 3);
+    ASSERT_FALSE(set.prev(kC - 2));
+}
+
+TEST(DocSet, RandomOperations) {
+    PseudoRandom random(12345);
+    DocSet set;
+    std::set<unsigned long> model;
+    for (int i = 0; i < 300; i++) {
+        const unsigned long begin = random.nextInt64(4 * kC);
+        const unsigned long end = begin + random.nextInt64(i % 10 == 0 ? 2 * kC : 300);
+        switch (random.nextInt32(4)) {
+            case 0:
+                set.add(begin);
+                model.insert(begin);
+                break;
+            case 1:
+                set.remove(begin);
+                model.erase(begin);
+                break;
+            case 2:
+                set.addRange(begin, end);
+                for (unsigned long doc = begin; doc < end; doc++) {
+                    model.insert(doc);
+                }
+                break;
+            case 3:
+                set.removeRange(begin, end);
+                model.erase(model.lower_bound(begin), model.lower_bound(end));
+                break;
+        }
+        ASSERT_EQ(set.size(), model.size());
+    }
+    assertSameAs(set, model);
+}
+
+}  // namespace
+}  // namespace mongo
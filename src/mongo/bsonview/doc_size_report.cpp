@@ -0,0 +1,128 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/doc_size_report.h"
+
+#include <algorithm>
+
+#include "mongo/bson/bsonobjbuilder.h"
+
+namespace mongo {
+
+constexpr unsigned long DocSizeReport::kBatchSize;
+constexpr int DocSizeReport::kNumBuckets;
+
+DocSizeReport::DocSizeReport(LoadProgressFn loadProgress,
+                             LoadedDocsFn loadedDocs,
+                             size_t numLargest)
+    : _batches(std::move(loadProgress), std::move(loadedDocs), kBatchSize, &_stop),
+      _numLargest(numLargest) {}
+
+DocSizeReport::~DocSizeReport() {
+    _stop.store(true);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void DocSizeReport::start() {
+    invariant(!_thread.joinable());
+    _thread = stdx::thread([this]() { _run(); });
+}
+
+void DocSizeReport::_run() {
+    // orders the heap with the smallest of the largest docs at the front
+    const auto greater = std::greater<std::pair<int, unsigned long>>();
+    std::vector<BSONObj> docs;
+    unsigned long begin;
+    try {
+        // a single thread, so the batches come in order
+        while (_batches.next(&docs, &begin)) {
+            for (unsigned long i = 0; i < docs.size(); i++) {
+                const int size = docs[i].objsize();
+                const int bucket = 31 - __builtin_clz(static_cast<unsigned>(size));
+                _bucketDocs[bucket]++;
+                _bucketBytes[bucket] += size;
+
+                const auto entry = std::make_pair(size, begin + i);
+                if (_largest.size() < _numLargest) {
+                    _largest.push_back(entry);
+                    std::push_heap(_largest.begin(), _largest.end(), greater);
+                } else if (_numLargest > 0 && greater(entry, _largest.front())) {
+                    std::pop_heap(_largest.begin(), _largest.end(), greater);
+                    _largest.back() = entry;
+                    std::push_heap(_largest.begin(), _largest.end(), greater);
+                }
+            }
+        }
+    } catch (const DBException& e) {
+        // interrupted
+        _status = e.toStatus();
+        _done.store(true);
+        return;
+    }
+
+    _report();
+    _done.store(true);
+}
+
+void DocSizeReport::_report() {
+    const unsigned long numDocs = _batches.numScanned();
+    const unsigned long maxBucketDocs = *std::max_element(_bucketDocs.begin(), _bucketDocs.end());
+    for (int i = 0; i < kNumBuckets; i++) {
+        if (_bucketDocs[i] == 0) {
+            continue;
+        }
+        BSONObjBuilder b;
+        b.append("minBytes", static_cast<long long>(1LL << i));
+        b.append("maxBytes", static_cast<long long>((1LL << (i + 1)) - 1));
+        b.append("docs", static_cast<long long>(_bucketDocs[i]));
+        b.append("bytes", static_cast<long long>(_bucketBytes[i]));
+        b.append("percent", 100.0 * _bucketDocs[i] / numDocs);
+        // scaled to the fullest bucket, with any docs at all getting at least one
+        b.append("bar", std::string(std::max(1UL, _bucketDocs[i] * 50 / maxBucketDocs), '#'));
+        _appendResult(b.obj());
+    }
+
+    std::sort_heap(_largest.begin(), _largest.end(), std::greater<std::pair<int, unsigned long>>());
+    long long rank = 1;
+    for (auto&& entry : _largest) {
+        _appendResult(BSON("rank" << rank++ << "doc" << static_cast<long long>(entry.second)
+                                  << "bytes" << entry.first));
+    }
+}
+
+void DocSizeReport::_appendResult(const BSONObj& result) {
+    _results.append(result.objdata(), result.objsize());
+    _numResults++;
+}
+
+}  // namespace mongo
@@ -0,0 +1,120 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mongo/base/status.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/loaded_doc_batches.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * Reports the distribution of doc sizes in a file (as a histogram with power of 2 buckets), and
+ * which docs are the largest.
+ *
+ * The size of each doc is just its length prefix, which the loader has already read, so this
+ * makes a single pass over the loaded docs (as they're loaded) without looking inside them.  The
+ * largest docs are kept in a bounded min-heap, so it runs in constant memory.
+ */
+class DocSizeReport {
+public:
+    using LoadProgressFn = LoadedDocBatches::LoadProgressFn;
+    using LoadedDocsFn = LoadedDocBatches::LoadedDocsFn;
+
+    static constexpr unsigned long kBatchSize = 65536;
+
+    DocSizeReport(LoadProgressFn loadProgress, LoadedDocsFn loadedDocs, size_t numLargest = 100);
+
+    ~DocSizeReport();
+
+    void start();
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    unsigned long numDocsScanned() const {
+        return _batches.numScanned();
+    }
+
+    // The rest are only valid once done.
+
+    const Status& getStatus() const {
+        return _status;
+    }
+
+    /**
+     * The report, as a doc for each non-empty bucket of the histogram, from smallest to largest,
+     * eg. {minBytes: 1024, maxBytes: 2047, docs: 10, bytes: 15000, percent: 1.5, bar: "##"},
+     * followed by a doc for each of the largest docs, from largest down, eg.
+     * {rank: 1, doc: 12345, bytes: 16777000}.
+     */
+    const std::string& getResults() const {
+        return _results;
+    }
+
+    unsigned long numResults() const {
+        return _numResults;
+    }
+
+private:
+    // Buckets by the position of the top bit of the size, so bucket i is [2^i, 2^(i+1)).
+    static constexpr int kNumBuckets = 32;
+
+    void _run();
+
+    void _report();
+
+    void _appendResult(const BSONObj& result);
+
+    LoadedDocBatches _batches;
+    size_t _numLargest;
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+
+    std::array<unsigned long, kNumBuckets> _bucketDocs{};
+    std::array<unsigned long long, kNumBuckets> _bucketBytes{};
+    std::vector<std::pair<int, unsigned long>> _largest;  // (size, doc), as a min-heap
+
+    Status _status = Status::OK();
+    std::string _results;
+    unsigned long _numResults = 0;
+};
+
+}  // namespace mongo
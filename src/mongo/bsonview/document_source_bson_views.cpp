@@ -0,0 +1,119 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/document_source_bson_views.h"
+
+#include "mongo/bsonview/mql_match_plan.h"
+#include "mongo/db/matcher/matcher.h"
+
+namespace mongo {
+
+constexpr StringData DocumentSourceBSONViews::kStageName;
+
+DocumentSourceBSONViews::DocumentSourceBSONViews(
+    const boost::intrusive_ptr<ExpressionContext>& expCtx,
+    NextBatchFn nextBatch,
+    bool pauseBetweenBatches)
+    : DocumentSource(expCtx),
+      _nextBatch(std::move(nextBatch)),
+      _pauseBetweenBatches(pauseBetweenBatches) {}
+
+DocumentSourceBSONViews::~DocumentSourceBSONViews() = default;
+
+boost::intrusive_ptr<DocumentSourceBSONViews> DocumentSourceBSONViews::create(
+    const boost::intrusive_ptr<ExpressionContext>& expCtx,
+    NextBatchFn nextBatch,
+    bool pauseBetweenBatches) {
+    return new DocumentSourceBSONViews(expCtx, std::move(nextBatch), pauseBetweenBatches);
+}
+
+DocumentSource::GetNextResult DocumentSourceBSONViews::getNext() {
+    pExpCtx->checkForInterrupt();
+
+    while (!_eof) {
+        if (_pos == _batch.size()) {
+            if (_pauseBetweenBatches && _startedBatch && !_pausedBeforeBatch) {
+                _pausedBeforeBatch = true;
+                return GetNextResult::makePauseExecution();
+            }
+            _pausedBeforeBatch = false;
+            _pos = 0;
+            if (!_nextBatch(&_batch)) {
+                _batch.clear();
+                _eof = true;
+                break;
+            }
+            _startedBatch = true;
+            continue;
+        }
+
+        const BSONObj& obj = _batch[_pos++];
+        if (_plan ? !_plan->matches(obj) : (_matcher && !_matcher->matches(obj))) {
+            continue;
+        }
+        return _deps ? _deps->extractFields(obj) : Document(obj);
+    }
+    return GetNextResult::makeEOF();
+}
+
+const char* DocumentSourceBSONViews::getSourceName() const {
+    return kStageName.rawData();
+}
+
+Value DocumentSourceBSONViews::serialize(
+    boost::optional<ExplainOptions::Verbosity> explain) const {
+    return Value(Document{{getSourceName(), Document()}});
+}
+
+StageConstraints DocumentSourceBSONViews::constraints(Pipeline::SplitState pipeState) const {
+    StageConstraints constraints(StreamType::kStreaming,
+                                 PositionRequirement::kFirst,
+                                 HostTypeRequirement::kNone,
+                                 DiskUseRequirement::kNoDiskUse,
+                                 FacetRequirement::kNotAllowed,
+                                 TransactionRequirement::kAllowed,
+                                 LookupRequirement::kAllowed);
+
+    constraints.requiresInputDocSource = false;
+    return constraints;
+}
+
+void DocumentSourceBSONViews::setDependencies(const DepsTracker& deps) {
+    _deps = deps.toParsedDeps();
+}
+
+void DocumentSourceBSONViews::setMatch(const BSONObj& query) {
+    _plan.reset();
+    _matcher = std::make_unique<Matcher>(query, pExpCtx);
+    _plan = MQLMatchPlan::compile(_matcher.get());
+}
+
+}  // namespace mongo
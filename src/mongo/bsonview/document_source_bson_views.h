@@ -0,0 +1,123 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/db/pipeline/dependencies.h"
+#include "mongo/db/pipeline/document_source.h"
+
+namespace mongo {
+
+class Matcher;
+class MQLMatchPlan;
+
+/**
+ * A DocumentSource which feeds a pipeline from BSONObjs that point straight into a mapped file,
+ * without copying them.  Only the fields that the rest of the pipeline depends on are copied out
+ * into Documents, and a $match at the front of the pipeline can be handed to the source, so that
+ * docs which don't match are skipped before anything is copied out of them.
+ *
+ * The docs come in batches from a callback, which lets several pipelines (on different threads)
+ * share out the docs of one file between them.
+ */
+class DocumentSourceBSONViews final : public DocumentSource {
+public:
+    static constexpr StringData kStageName = "$bsonViews"_sd;
+
+    // Fills docs with the next batch, or returns false once there are no more.
+    using NextBatchFn = std::function<bool(std::vector<BSONObj>* docs)>;
+
+    /**
+     * If pauseBetweenBatches is set, every batch after the first is preceded by a
+     * kPauseExecution result, so the consumer can tell which batch each output came from (as
+     * long as the pipeline only has streaming stages).
+     */
+    static boost::intrusive_ptr<DocumentSourceBSONViews> create(
+        const boost::intrusive_ptr<ExpressionContext>& expCtx,
+        NextBatchFn nextBatch,
+        bool pauseBetweenBatches);
+
+    ~DocumentSourceBSONViews();
+
+    GetNextResult getNext() override;
+
+    const char* getSourceName() const override;
+
+    Value serialize(
+        boost::optional<ExplainOptions::Verbosity> explain = boost::none) const override;
+
+    StageConstraints constraints(Pipeline::SplitState pipeState) const override;
+
+    GetModPathsReturn getModifiedPaths() const override {
+        return {GetModPathsReturn::Type::kFiniteSet, std::set<std::string>{}, {}};
+    }
+
+    boost::optional<DistributedPlanLogic> distributedPlanLogic() override {
+        return boost::none;
+    }
+
+    /**
+     * Only the fields needed by the rest of the pipeline are copied into the Documents produced.
+     * Must be called before execution starts.
+     */
+    void setDependencies(const DepsTracker& deps);
+
+    /**
+     * Skips docs which don't match the query (from a $match stage that has been taken out of the
+     * pipeline).  Must be called before execution starts.
+     */
+    void setMatch(const BSONObj& query);
+
+private:
+    DocumentSourceBSONViews(const boost::intrusive_ptr<ExpressionContext>& expCtx,
+                            NextBatchFn nextBatch,
+                            bool pauseBetweenBatches);
+
+    NextBatchFn _nextBatch;
+    const bool _pauseBetweenBatches;
+
+    std::vector<BSONObj> _batch;
+    size_t _pos = 0;
+    bool _startedBatch = false;  // at least one batch has been fetched
+    bool _pausedBeforeBatch = false;
+    bool _eof = false;
+
+    boost::optional<ParsedDeps> _deps;  // none if the whole doc is needed
+
+    // The plan references the matcher, so must be destroyed first.
+    std::unique_ptr<Matcher> _matcher;
+    std::unique_ptr<MQLMatchPlan> _plan;  // null if it wouldn't help
+};
+
+}  // namespace mongo
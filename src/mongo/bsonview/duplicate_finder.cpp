@@ -0,0 +1,249 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/duplicate_finder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <third_party/murmurhash3/MurmurHash3.h>
+
+#include "mongo/db/hasher.h"
+
+namespace mongo {
+
+constexpr unsigned long DuplicateFinder::kBatchSize;
+constexpr size_t DuplicateFinder::kNumPartitions;
+
+DuplicateFinder::DuplicateFinder(Mode mode,
+                                 LoadProgressFn loadProgress,
+                                 LoadedDocsFn loadedDocs,
+                                 const std::string& tempDir,
+                                 size_t maxMemoryUsageBytes)
+    : _mode(mode),
+      _batches(std::move(loadProgress), std::move(loadedDocs), kBatchSize, &_stop),
+      _maxMemoryUsageBytes(maxMemoryUsageBytes),
+      _partitions(std::make_unique<Partitions>(tempDir, "bv-dups")) {}
+
+DuplicateFinder::~DuplicateFinder() {
+    _stop.store(true);
+    _memoryAvailable.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void DuplicateFinder::start(unsigned numThreads) {
+    invariant(!_thread.joinable());
+    _thread = stdx::thread([this, numThreads]() { _run(numThreads); });
+}
+
+void DuplicateFinder::_run(unsigned numThreads) {
+    // Half of the limit is for buffering while hashing, which is also the most that can be left
+    // in memory once hashing is done.  The other half is for the spilled partitions being checked.
+    _threadBufferEntries =
+        std::max<size_t>(kNumPartitions, _maxMemoryUsageBytes / 2 / numThreads / sizeof(Entry));
+
+    std::vector<stdx::thread> threads;
+    for (unsigned i = 0; i < numThreads; i++) {
+        threads.emplace_back([this]() { _hashWorker(); });
+    }
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+
+    if (_status.isOK()) {
+        threads.clear();
+        for (unsigned i = 0; i < numThreads; i++) {
+            threads.emplace_back([this]() { _checkWorker(); });
+        }
+        for (auto&& thread : threads) {
+            thread.join();
+        }
+    }
+
+    std::sort(_duplicates.begin(), _duplicates.end());
+    _partitions.reset();
+    _done.store(true);
+}
+
+void DuplicateFinder::_hashWorker() {
+    try {
+        auto buffers = Partitions::makeBuffers();
+        size_t numBuffered = 0;
+        std::vector<BSONObj> docs;
+        unsigned long begin;
+        while (_batches.next(&docs, &begin)) {
+            for (unsigned long i = 0; i < docs.size(); i++) {
+                uint64_t hash;
+                if (!_hash(docs[i], &hash)) {
+                    continue;
+                }
+                const Entry entry{hash, begin + i};
+                buffers[Partitions::partitionOf(entry)].push_back(entry);
+                numBuffered++;
+            }
+            if (numBuffered >= _threadBufferEntries) {
+                _partitions->spill(&buffers);
+                numBuffered = 0;
+            }
+        }
+
+        // whatever is left fits in this thread's share of the limit
+        _partitions->keep(&buffers);
+    } catch (const DBException& e) {
+        _fail(e.toStatus());
+    }
+}
+
+void DuplicateFinder::_checkWorker() {
+    const size_t limit = _maxMemoryUsageBytes / 2;
+    while (true) {
+        const size_t p = _nextPartition.fetchAndAdd(1);
+        if (p >= kNumPartitions) {
+            return;
+        }
+        // hashing is done, so the partitions don't change any more
+        const size_t bytes = _partitions->spilledBytes(p);
+
+        {
+            // a partition bigger than the whole limit still gets checked, on its own
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+            _memoryAvailable.wait(lk, [&]() {
+                return _stop.load() || _checkMemoryUsed == 0 || _checkMemoryUsed + bytes <= limit;
+            });
+            if (_stop.load()) {
+                return;
+            }
+            _checkMemoryUsed += bytes;
+        }
+
+        try {
+            _checkPartition(p);
+        } catch (const DBException& e) {
+            _fail(e.toStatus());
+        }
+
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _checkMemoryUsed -= bytes;
+        }
+        _memoryAvailable.notify_all();
+        _numPartitionsChecked.fetchAndAdd(1);
+    }
+}
+
+bool DuplicateFinder::_hash(const BSONObj& doc, uint64_t* hash) const {
+    if (_mode == Mode::kId) {
+        BSONElement id = doc["_id"];
+        if (id.eoo()) {
+            // can't clash with anything
+            return false;
+        }
+        *hash = static_cast<uint64_t>(BSONElementHasher::hash64(id, 0));
+        return true;
+    }
+    uint64_t out[2];
+    MurmurHash3_x64_128(doc.objdata(), doc.objsize(), 0, out);
+    *hash = out[0];
+    return true;
+}
+
+bool DuplicateFinder::_equal(const BSONObj& a, const BSONObj& b) const {
+    if (_mode == Mode::kId) {
+        // the way a unique index compares them, so that eg. 1 and 1.0 are the same _id
+        return a["_id"].woCompare(b["_id"], false) == 0;
+    }
+    return a.objsize() == b.objsize() && std::memcmp(a.objdata(), b.objdata(), a.objsize()) == 0;
+}
+
+void DuplicateFinder::_checkPartition(size_t p) {
+    std::vector<Entry> entries = _partitions->take(p);
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.hash < b.hash || (a.hash == b.hash && a.doc < b.doc);
+    });
+
+    std::vector<unsigned long> duplicates;
+    unsigned long numGroups = 0;
+    std::vector<BSONObj> docs;
+    // The docs with the same hash, split up by value.  There's almost always only the one value,
+    // so comparing each doc against each value seen so far is plenty.
+    std::vector<std::vector<std::pair<BSONObj, unsigned long>>> groups;
+    for (size_t begin = 0; begin < entries.size();) {
+        uassert(ErrorCodes::Interrupted, "Duplicate search was interrupted", !_stop.load());
+        size_t end = begin + 1;
+        while (end < entries.size() && entries[end].hash == entries[begin].hash) {
+            end++;
+        }
+        if (end - begin > 1) {
+            groups.clear();
+            for (size_t i = begin; i < end; i++) {
+                const unsigned long doc = entries[i].doc;
+                _batches.getDocs(doc, doc + 1, &docs);
+                invariant(docs.size() == 1);
+                auto group = std::find_if(groups.begin(), groups.end(), [&](const auto& group) {
+                    return _equal(group.front().first, docs[0]);
+                });
+                if (group == groups.end()) {
+                    groups.emplace_back();
+                    group = groups.end() - 1;
+                }
+                group->emplace_back(docs[0], doc);
+            }
+            for (auto&& group : groups) {
+                if (group.size() > 1) {
+                    numGroups++;
+                    for (auto&& entry : group) {
+                        duplicates.push_back(entry.second);
+                    }
+                }
+            }
+        }
+        begin = end;
+    }
+
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    _duplicates.insert(_duplicates.end(), duplicates.begin(), duplicates.end());
+    _numGroups += numGroups;
+}
+
+void DuplicateFinder::_fail(Status status) {
+    {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        if (_status.isOK()) {
+            _status = std::move(status);
+        }
+        // no point in the other threads carrying on
+        _stop.store(true);
+    }
+    _memoryAvailable.notify_all();
+}
+
+}  // namespace mongo
@@ -0,0 +1,156 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/base/status.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/hash_partitions.h"
+#include "mongo/bsonview/loaded_doc_batches.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * Finds the docs of a file which have the same _id as another doc (which would make a restore of
+ * the file fail), or which are exact copies of another doc.
+ *
+ * Several threads hash the _id (with BSONElementHasher, so that eg. 1 and 1.0 are the same, as
+ * they are to a unique index) or the whole doc of each doc as it's loaded, and scatter the
+ * (hash, doc number) pairs into partitions by the top bits of the hash.  Whenever a thread has
+ * buffered its share of the memory limit, it appends its buffers to the partitions' temp files.
+ * Once every doc has been hashed, each partition is sorted by hash on its own (with as many
+ * partitions at once as fit in the memory limit), and the docs in each run of equal hashes are
+ * compared, so that hash collisions are never reported as duplicates.
+ */
+class DuplicateFinder {
+    struct Entry {
+        uint64_t hash;
+        uint64_t doc;
+    };
+    using Partitions = HashPartitions<Entry>;
+
+public:
+    using LoadProgressFn = LoadedDocBatches::LoadProgressFn;
+    using LoadedDocsFn = LoadedDocBatches::LoadedDocsFn;
+
+    enum class Mode {
+        kId,        // docs with equal _ids
+        kDocument,  // byte-for-byte identical docs
+    };
+
+    static constexpr unsigned long kBatchSize = 4096;
+    static constexpr size_t kNumPartitions = Partitions::kNumPartitions;
+
+    DuplicateFinder(Mode mode,
+                    LoadProgressFn loadProgress,
+                    LoadedDocsFn loadedDocs,
+                    const std::string& tempDir,
+                    size_t maxMemoryUsageBytes);
+
+    ~DuplicateFinder();
+
+    void start(unsigned numThreads);
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    unsigned long numDocsScanned() const {
+        return _batches.numScanned();
+    }
+
+    // How many partitions have been checked for duplicates, out of kNumPartitions.
+    unsigned long numPartitionsChecked() const {
+        return _numPartitionsChecked.load();
+    }
+
+    // The rest are only valid once done.
+
+    const Status& getStatus() const {
+        return _status;
+    }
+
+    // Every doc which is a duplicate of another (including the first of each group), in order.
+    const std::vector<unsigned long>& getDuplicates() const {
+        return _duplicates;
+    }
+
+    // How many distinct values (_ids or docs) are duplicated.
+    unsigned long numGroups() const {
+        return _numGroups;
+    }
+
+private:
+    void _run(unsigned numThreads);
+
+    void _hashWorker();
+
+    void _checkWorker();
+
+    bool _hash(const BSONObj& doc, uint64_t* hash) const;
+
+    bool _equal(const BSONObj& a, const BSONObj& b) const;
+
+    void _checkPartition(size_t partition);
+
+    void _fail(Status status);
+
+    const Mode _mode;
+    LoadedDocBatches _batches;
+    size_t _maxMemoryUsageBytes;
+    size_t _threadBufferEntries = 0;
+
+    std::unique_ptr<Partitions> _partitions;
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+    AtomicWord<unsigned long> _nextPartition{0};
+    AtomicWord<unsigned long> _numPartitionsChecked{0};
+
+    // Protects the results, the memory used by partitions being checked, and _status while
+    // running.
+    stdx::mutex _mutex;
+    stdx::condition_variable _memoryAvailable;
+    size_t _checkMemoryUsed = 0;
+    Status _status = Status::OK();
+
+    std::vector<unsigned long> _duplicates;
+    unsigned long _numGroups = 0;
+};
+
+}  // namespace mongo
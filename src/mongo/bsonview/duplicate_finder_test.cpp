@@ -0,0 +1,238 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/duplicate_finder.h"
+
+#include <algorithm>
+#include <map>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/unittest/temp_dir.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+namespace {
+
+struct Result {
+    std::vector<unsigned long> duplicates;
+    unsigned long numGroups = 0;
+};
+
+// Finds the duplicates of docs which are all loaded already.
+Result find(DuplicateFinder::Mode mode,
+            const std::vector<BSONObj>& docs,
+            unsigned numThreads,
+            size_t maxMemoryUsageBytes) {
+    unittest::TempDir tempDir("duplicate_finder_test");
+    DuplicateFinder finder(
+        mode,
+        [&docs](unsigned long* numDocs, bool* complete) {
+            *numDocs = docs.size();
+            *complete = true;
+        },
+        [&docs](unsigned long begin, unsigned long end, std::vector<BSONObj>* out) {
+            out->assign(docs.begin() + begin, docs.begin() + end);
+        },
+        tempDir.path(),
+        maxMemoryUsageBytes);
+    finder.start(numThreads);
+    while (!finder.isDone()) {
+        sleepmillis(1);
+    }
+    ASSERT_OK(finder.getStatus());
+    ASSERT_EQ(finder.numDocsScanned(), docs.size());
+    ASSERT_EQ(finder.numPartitionsChecked(), DuplicateFinder::kNumPartitions);
+    return {finder.getDuplicates(), finder.numGroups()};
+}
+
+// Groups the docs by comparing them directly, without any hashing.
+Result bruteForce(DuplicateFinder::Mode mode, const std::vector<BSONObj>& docs) {
+    // the _ids compared the way a unique index does, or the whole docs byte for byte
+    auto less = [mode](const BSONObj& a, const BSONObj& b) {
+        if (mode == DuplicateFinder::Mode::kId) {
+            return a["_id"].woCompare(b["_id"], false) < 0;
+        }
+        return std::lexicographical_compare(a.objdata(),
+                                            a.objdata() + a.objsize(),
+                                            b.objdata(),
+                                            b.objdata() + b.objsize());
+    };
+    std::map<BSONObj, std::vector<unsigned long>, decltype(less)> groups(less);
+    for (unsigned long doc = 0; doc < docs.size(); doc++) {
+        if (mode == DuplicateFinder::Mode::kId && docs[doc]["_id"].eoo()) {
+            continue;
+        }
+        groups[docs[doc]].push_back(doc);
+    }
+
+    Result result;
+    for (auto&& group : groups) {
+        if (group.second.size() > 1) {
+            result.numGroups++;
+            result.duplicates.insert(
+                result.duplicates.end(), group.second.begin(), group.second.end());
+        }
+    }
+    std::sort(result.duplicates.begin(), result.duplicates.end());
+    return result;
+}
+
+void assertSameAsBruteForce(DuplicateFinder::Mode mode,
+                            const std::vector<BSONObj>& docs,
+                            unsigned numThreads,
+                            size_t maxMemoryUsageBytes) {
+    const Result expected = bruteForce(mode, docs);
+    ASSERT_GT(expected.numGroups, 0UL);
+    const Result found = find(mode, docs, numThreads, maxMemoryUsageBytes);
+    ASSERT_EQ(found.numGroups, expected.numGroups);
+    ASSERT(found.duplicates == expected.duplicates);
+}
+
+// Mostly distinct, with some _ids repeated (as the same number in different types, too), some
+// docs repeated exactly, and some without an _id.
+std::vector<BSONObj> testDocs(unsigned long numDocs) {
+    std::vector<BSONObj> docs;
+    for (unsigned long i = 0; i < numDocs; i++) {
+        BSONObjBuilder b;
+        if (i % 97 == 5) {
+            // no _id
+        } else if (i % 50 == 1) {
+            b.append("_id", static_cast<double>(i / 100));
+        } else if (i % 50 == 2) {
+            b.append("_id", static_cast<long long>(i / 100));
+        } else if (i % 50 == 3) {
+            b.append("_id", static_cast<int>(i / 100));
+        } else if (i % 200 == 4) {
+            b.append("_id", "s" + std::to_string(i / 1000));
+        } else {
+            b.append("_id", static_cast<long long>(i + 1000000));
+        }
+        // every 300th doc is an exact copy of one a little earlier
+        b.append("x", static_cast<long long>(i % 300 == 7 ? i - 100 : i));
+        docs.push_back(b.obj());
+    }
+    for (unsigned long i = 0; i < numDocs; i += 300) {
+        docs.push_back(docs[i]);
+    }
+    return docs;
+}
+
+TEST(DuplicateFinder, NoDocs) {
+    for (auto mode : {DuplicateFinder::Mode::kId, DuplicateFinder::Mode::kDocument}) {
+        const Result found = find(mode, {}, 2, 1 << 20);
+        ASSERT(found.duplicates.empty());
+        ASSERT_EQ(found.numGroups, 0UL);
+    }
+}
+
+TEST(DuplicateFinder, InMemory) {
+    const auto docs = testDocs(20000);
+    for (auto mode : {DuplicateFinder::Mode::kId, DuplicateFinder::Mode::kDocument}) {
+        assertSameAsBruteForce(mode, docs, 1, 64 << 20);
+        assertSameAsBruteForce(mode, docs, 4, 64 << 20);
+    }
+}
+
+// With a tiny budget, every thread spills its buffers after each batch, and the partitions are
+// checked one at a time.
+TEST(DuplicateFinder, Spilled) {
+    const auto docs = testDocs(20000);
+    for (auto mode : {DuplicateFinder::Mode::kId, DuplicateFinder::Mode::kDocument}) {
+        assertSameAsBruteForce(mode, docs, 1, 1);
+        assertSameAsBruteForce(mode, docs, 4, 1);
+    }
+}
+
+TEST(DuplicateFinder, NumbersAreTheSameId) {
+    const std::vector<BSONObj> docs{
+        BSON("_id" << 1),
+        BSON("_id" << 1LL),
+        BSON("_id" << 1.0),
+        BSON("_id" << 2),
+        BSON("_id"
+             << "1"),
+        BSON("_id" << BSON("a" << 1)),
+        BSON("_id" << BSON("a" << 1.0)),
+    };
+    const Result found = find(DuplicateFinder::Mode::kId, docs, 2, 1);
+    ASSERT_EQ(found.numGroups, 2UL);
+    ASSERT(found.duplicates == std::vector<unsigned long>({0, 1, 2, 5, 6}));
+
+    // but they aren't the same doc
+    const Result exact = find(DuplicateFinder::Mode::kDocument, docs, 2, 1);
+    ASSERT_EQ(exact.numGroups, 0UL);
+}
+
+struct Entry {
+    uint64_t hash;
+    uint64_t value;
+};
+
+TEST(HashPartitions, SpilledAndKeptEntriesAreAllTaken) {
+    unittest::TempDir tempDir("hash_partitions_test");
+    using Partitions = HashPartitions<Entry>;
+    Partitions partitions(tempDir.path(), "test");
+
+    std::map<size_t, std::vector<uint64_t>> expected;
+    auto add = [&](Partitions::Buffers* buffers, uint64_t i) {
+        const Entry entry{i * 0x9e3779b97f4a7c15ULL, i};
+        (*buffers)[Partitions::partitionOf(entry)].push_back(entry);
+        expected[Partitions::partitionOf(entry)].push_back(i);
+    };
+
+    auto buffers = Partitions::makeBuffers();
+    for (uint64_t i = 0; i < 5000; i++) {
+        add(&buffers, i);
+    }
+    partitions.spill(&buffers);
+    for (uint64_t i = 5000; i < 6000; i++) {
+        add(&buffers, i);
+    }
+    partitions.keep(&buffers);
+
+    size_t numSpilled = 0;
+    for (size_t p = 0; p < Partitions::kNumPartitions; p++) {
+        numSpilled += partitions.spilledBytes(p) / sizeof(Entry);
+        std::vector<uint64_t> values;
+        for (auto&& entry : partitions.take(p)) {
+            ASSERT_EQ(Partitions::partitionOf(entry), p);
+            values.push_back(entry.value);
+        }
+        std::sort(values.begin(), values.end());
+        ASSERT(values == expected[p]);
+    }
+    ASSERT_EQ(numSpilled, 5000UL);
+}
+
+}  // namespace
+}  // namespace mongo
@@ -0,0 +1,277 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/field_profile.h"
+
+#include <cmath>
+#include <third_party/murmurhash3/MurmurHash3.h>
+
+#include "mongo/bson/bsonobjbuilder.h"
+
+namespace mongo {
+
+constexpr int HyperLogLog::kPrecision;
+constexpr size_t HyperLogLog::kNumRegisters;
+constexpr unsigned long FieldProfile::kBatchSize;
+constexpr size_t FieldProfile::kNumExamples;
+
+void HyperLogLog::add(uint64_t hash) {
+    // the top bits pick the register, and the rest give the rank of the first set bit
+    const size_t index = hash >> (64 - kPrecision);
+    const uint64_t rest = hash << kPrecision;
+    const uint8_t rank = rest ? __builtin_clzll(rest) + 1 : 64 - kPrecision + 1;
+    if (rank > _registers[index]) {
+        _registers[index] = rank;
+    }
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    for (size_t i = 0; i < kNumRegisters; i++) {
+        _registers[i] = std::max(_registers[i], other._registers[i]);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    const double m = kNumRegisters;
+    double sum = 0;
+    size_t zeros = 0;
+    for (auto reg : _registers) {
+        sum += std::ldexp(1.0, -reg);
+        zeros += (reg == 0);
+    }
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+    const double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        // linear counting is more accurate while many registers are still empty
+        return m * std::log(m / zeros);
+    }
+    return estimate;
+}
+
+void FieldProfile::PathStats::merge(PathStats&& other, PseudoRandom* random) {
+    // Merge the reservoirs by drawing from each in proportion to how many values it stands for,
+    // so the result is still a uniform sample of all the values.
+    std::vector<BSONObj> examples;
+    unsigned long remaining = numValues;
+    unsigned long otherRemaining = other.numValues;
+    while (examples.size() < kNumExamples && (!this->examples.empty() || !other.examples.empty())) {
+        const bool fromThis = other.examples.empty() ||
+            (!this->examples.empty() &&
+             static_cast<unsigned long>(random->nextInt64(remaining + otherRemaining)) <
+                 remaining);
+        auto& from = fromThis ? this->examples : other.examples;
+        auto& fromRemaining = fromThis ? remaining : otherRemaining;
+        const size_t i = random->nextInt64(from.size());
+        examples.push_back(std::move(from[i]));
+        from.erase(from.begin() + i);
+        fromRemaining--;
+    }
+    this->examples = std::move(examples);
+
+    numDocs += other.numDocs;
+    numValues += other.numValues;
+    numBytes += other.numBytes;
+    for (auto&& typeCount : other.typeCounts) {
+        typeCounts[typeCount.first] += typeCount.second;
+    }
+    distinct.merge(other.distinct);
+}
+
+FieldProfile::FieldProfile(LoadProgressFn loadProgress, LoadedDocsFn loadedDocs, double sampleRate)
+    : _batches(std::move(loadProgress), std::move(loadedDocs), kBatchSize, &_stop),
+      _sampleRate(sampleRate) {}
+
+FieldProfile::~FieldProfile() {
+    _stop.store(true);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void FieldProfile::start(unsigned numThreads) {
+    invariant(!_thread.joinable());
+    _thread = stdx::thread([this, numThreads]() { _run(numThreads); });
+}
+
+void FieldProfile::_run(unsigned numThreads) {
+    std::unique_ptr<SecureRandom> seeds(SecureRandom::create());
+    std::vector<Stats> stats(numThreads);
+    std::vector<PseudoRandom> randoms;
+    for (unsigned i = 0; i < numThreads; i++) {
+        randoms.emplace_back(seeds->nextInt64());
+    }
+
+    std::vector<stdx::thread> threads;
+    for (unsigned i = 0; i < numThreads; i++) {
+        threads.emplace_back([this, &stats, &randoms, i]() { _worker(&stats[i], &randoms[i]); });
+    }
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+
+    if (_status.isOK()) {
+        try {
+            for (unsigned i = 1; i < numThreads; i++) {
+                for (auto&& path : stats[i]) {
+                    stats[0][path.first].merge(std::move(path.second), &randoms[0]);
+                }
+                stats[i].clear();
+            }
+            _report(stats[0], _numProfiled.load());
+        } catch (const DBException& e) {
+            _fail(e.toStatus());
+        }
+    }
+    _done.store(true);
+}
+
+void FieldProfile::_worker(Stats* stats, PseudoRandom* random) {
+    try {
+        std::vector<BSONObj> docs;
+        unsigned long begin;
+        while (_batches.next(&docs, &begin)) {
+            unsigned long numProfiled = 0;
+            for (unsigned long i = 0; i < docs.size(); i++) {
+                if (_sampleRate < 1 && random->nextCanonicalDouble() >= _sampleRate) {
+                    continue;
+                }
+                _profileObject(docs[i], "", begin + i, stats, random);
+                numProfiled++;
+            }
+            _numProfiled.fetchAndAdd(numProfiled);
+        }
+    } catch (const DBException& e) {
+        _fail(e.toStatus());
+    }
+}
+
+void FieldProfile::_profileObject(const BSONObj& obj,
+                                  const std::string& prefix,
+                                  unsigned long doc,
+                                  Stats* stats,
+                                  PseudoRandom* random) {
+    for (auto&& elem : obj) {
+        const std::string path =
+            prefix.empty() ? elem.fieldName() : prefix + "." + elem.fieldNameStringData();
+        _profileValue(elem, path, doc, stats, random);
+    }
+}
+
+void FieldProfile::_profileValue(const BSONElement& elem,
+                                 const std::string& path,
+                                 unsigned long doc,
+                                 Stats* stats,
+                                 PseudoRandom* random) {
+    PathStats& pathStats = (*stats)[path];
+    if (pathStats.lastDoc != doc + 1) {
+        pathStats.numDocs++;
+        pathStats.lastDoc = doc + 1;
+    }
+    pathStats.numValues++;
+    pathStats.numBytes += elem.size();
+    pathStats.typeCounts[elem.type()]++;
+
+    // the type is the seed, so that eg. the string "1" and the symbol "1" are distinct
+    uint64_t hash[2];
+    MurmurHash3_x64_128(elem.value(), elem.valuesize(), elem.type(), hash);
+    pathStats.distinct.add(hash[0]);
+
+    // Subdocuments aren't much use as examples, and their fields have examples of their own.
+    if (elem.type() != Object) {
+        // reservoir sampling
+        auto example = [&elem]() {
+            BSONObjBuilder b;
+            b.appendAs(elem, "");
+            return b.obj();
+        };
+        if (pathStats.examples.size() < kNumExamples) {
+            pathStats.examples.push_back(example());
+        } else {
+            const unsigned long i = random->nextInt64(pathStats.numValues);
+            if (i < kNumExamples) {
+                pathStats.examples[i] = example();
+            }
+        }
+    }
+
+    if (elem.type() == Object) {
+        _profileObject(elem.embeddedObject(), path, doc, stats, random);
+    } else if (elem.type() == Array) {
+        for (auto&& member : elem.embeddedObject()) {
+            if (member.type() == Object) {
+                _profileObject(member.embeddedObject(), path, doc, stats, random);
+            }
+        }
+    }
+}
+
+void FieldProfile::_report(const Stats& stats, unsigned long numProfiled) {
+    // with sampling, the counts are scaled up to the whole file (the distinct counts can't be)
+    const double scale = numProfiled ? double(_batches.numScanned()) / numProfiled : 1;
+    for (auto&& path : stats) {
+        const PathStats& pathStats = path.second;
+        BSONObjBuilder b;
+        b.append("path", path.first);
+        b.append("docs", static_cast<long long>(std::llround(pathStats.numDocs * scale)));
+        b.append("frequency", numProfiled ? double(pathStats.numDocs) / numProfiled : 0);
+        {
+            BSONObjBuilder types(b.subobjStart("types"));
+            for (auto&& typeCount : pathStats.typeCounts) {
+                types.append(typeName(static_cast<BSONType>(typeCount.first)),
+                             static_cast<long long>(std::llround(typeCount.second * scale)));
+            }
+        }
+        b.append("distinct", static_cast<long long>(std::llround(pathStats.distinct.estimate())));
+        b.append("bytes", static_cast<long long>(std::llround(pathStats.numBytes * scale)));
+        b.append("avgBytes",
+                 pathStats.numValues ? double(pathStats.numBytes) / pathStats.numValues : 0);
+        {
+            BSONArrayBuilder examples(b.subarrayStart("examples"));
+            for (auto&& example : pathStats.examples) {
+                examples.append(example.firstElement());
+            }
+        }
+        BSONObj result = b.obj();
+        _results.append(result.objdata(), result.objsize());
+        _numResults++;
+    }
+}
+
+void FieldProfile::_fail(Status status) {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    if (_status.isOK()) {
+        _status = std::move(status);
+    }
+    // no point in the other threads carrying on
+    _stop.store(true);
+}
+
+}  // namespace mongo
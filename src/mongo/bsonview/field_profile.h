@@ -0,0 +1,175 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <array>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/base/status.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/loaded_doc_batches.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/platform/random.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * Estimates the number of distinct values added to it (by their hashes), to within a few percent,
+ * in a fixed 1 KiB.  Sketches of disjoint parts of the input can be merged.
+ */
+class HyperLogLog {
+public:
+    static constexpr int kPrecision = 10;
+    static constexpr size_t kNumRegisters = size_t(1) << kPrecision;
+
+    void add(uint64_t hash);
+
+    void merge(const HyperLogLog& other);
+
+    double estimate() const;
+
+private:
+    std::array<uint8_t, kNumRegisters> _registers{};
+};
+
+/**
+ * Profiles the schema of a file: which field paths its docs have, and for each one, how often
+ * it's present, with what BSON types, roughly how many distinct values, how many bytes it takes
+ * up, and some example values.
+ *
+ * Like ParallelAggregation, several threads claim batches of docs as they're loaded, and each
+ * keeps its own stats for every path, which are merged once every doc has been seen.  Distinct
+ * values are counted with a HyperLogLog per path, and the examples are a reservoir sample.
+ *
+ * With a sample rate of less than 1, each doc is only profiled with that probability, and the
+ * counts are scaled up to estimate the whole file.  (The distinct counts are only of the sample,
+ * since there's no telling how many more distinct values the rest of the docs would add.)
+ *
+ * The paths are those that queries use: the fields of subdocuments within arrays are under the
+ * array's path (eg. "a.b" for {a: [{b: 1}]}), and the members of arrays aren't paths of their own.
+ */
+class FieldProfile {
+public:
+    using LoadProgressFn = LoadedDocBatches::LoadProgressFn;
+    using LoadedDocsFn = LoadedDocBatches::LoadedDocsFn;
+
+    static constexpr unsigned long kBatchSize = 4096;
+    static constexpr size_t kNumExamples = 5;
+
+    FieldProfile(LoadProgressFn loadProgress, LoadedDocsFn loadedDocs, double sampleRate = 1.0);
+
+    ~FieldProfile();
+
+    void start(unsigned numThreads);
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    unsigned long numDocsScanned() const {
+        return _batches.numScanned();
+    }
+
+    // The rest are only valid once done.
+
+    const Status& getStatus() const {
+        return _status;
+    }
+
+    /**
+     * The report, as a doc for each path (in order of path), one after another, eg.
+     * {path: "a.b", docs: 10, frequency: 0.5, types: {string: 9, int: 1}, distinct: 7,
+     *  bytes: 250, avgBytes: 25, examples: [...]}
+     */
+    const std::string& getResults() const {
+        return _results;
+    }
+
+    unsigned long numResults() const {
+        return _numResults;
+    }
+
+private:
+    struct PathStats {
+        void merge(PathStats&& other, PseudoRandom* random);
+
+        unsigned long numDocs = 0;        // docs with the path
+        unsigned long numValues = 0;      // can be more than numDocs, through arrays
+        unsigned long numBytes = 0;
+        std::map<int, unsigned long> typeCounts;  // by BSONType
+        HyperLogLog distinct;
+        std::vector<BSONObj> examples;    // each the value as its only (unnamed) element
+        unsigned long lastDoc = 0;        // for counting each doc once
+    };
+
+    using Stats = std::map<std::string, PathStats>;
+
+    void _run(unsigned numThreads);
+
+    void _worker(Stats* stats, PseudoRandom* random);
+
+    void _profileObject(const BSONObj& obj,
+                        const std::string& prefix,
+                        unsigned long doc,
+                        Stats* stats,
+                        PseudoRandom* random);
+
+    void _profileValue(const BSONElement& elem,
+                       const std::string& path,
+                       unsigned long doc,
+                       Stats* stats,
+                       PseudoRandom* random);
+
+    void _report(const Stats& stats, unsigned long numProfiled);
+
+    void _fail(Status status);
+
+    LoadedDocBatches _batches;
+    double _sampleRate;
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+    AtomicWord<unsigned long> _numProfiled{0};
+
+    // Protects _status while running.
+    stdx::mutex _mutex;
+    Status _status = Status::OK();
+
+    std::string _results;
+    unsigned long _numResults = 0;
+};
+
+}  // namespace mongo
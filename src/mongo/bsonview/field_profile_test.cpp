@@ -0,0 +1,210 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/field_profile.h"
+
+#include <cmath>
+#include <set>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/bson/json.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+namespace {
+
+// Well mixed, distinct 64 bit values (splitmix64), standing in for the hashes of distinct values.
+uint64_t hashOf(uint64_t i) {
+    uint64_t z = (i + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+TEST(HyperLogLog, Empty) {
+    HyperLogLog hll;
+    ASSERT_EQ(hll.estimate(), 0.0);
+}
+
+TEST(HyperLogLog, EstimatesWithinAFewPercent) {
+    for (uint64_t n : {10, 100, 1000, 10000, 1000000}) {
+        HyperLogLog hll;
+        for (uint64_t i = 0; i < n; i++) {
+            hll.add(hashOf(i));
+        }
+        // the standard error is 1.04 / sqrt(1024), ie. about 3%
+        ASSERT_LT(std::abs(hll.estimate() - n), 0.1 * n + 1);
+    }
+}
+
+TEST(HyperLogLog, RepeatsAreNotCounted) {
+    HyperLogLog once;
+    HyperLogLog many;
+    for (uint64_t i = 0; i < 500; i++) {
+        once.add(hashOf(i));
+        for (int repeat = 0; repeat < 10; repeat++) {
+            many.add(hashOf(i));
+        }
+    }
+    ASSERT_EQ(once.estimate(), many.estimate());
+}
+
+TEST(HyperLogLog, MergeIsTheSameAsAddingEverything) {
+    HyperLogLog all;
+    HyperLogLog first;
+    HyperLogLog second;
+    for (uint64_t i = 0; i < 20000; i++) {
+        all.add(hashOf(i));
+        (i % 3 ? first : second).add(hashOf(i));
+    }
+    // including values in both
+    for (uint64_t i = 0; i < 100; i++) {
+        second.add(hashOf(i));
+    }
+    first.merge(second);
+    ASSERT_EQ(first.estimate(), all.estimate());
+}
+
+// Profiles docs which are all loaded already, and returns the report of each path.  If
+// oneBatchPerThread, each batch is held up until every thread has one, so they all get one.
+std::map<std::string, BSONObj> profile(const std::vector<BSONObj>& docs,
+                                       unsigned numThreads,
+                                       bool oneBatchPerThread = false) {
+    stdx::mutex mutex;
+    stdx::condition_variable allClaimed;
+    unsigned numClaimed = 0;
+    FieldProfile profile(
+        [&docs](unsigned long* numDocs, bool* complete) {
+            *numDocs = docs.size();
+            *complete = true;
+        },
+        [&](unsigned long begin, unsigned long end, std::vector<BSONObj>* out) {
+            if (oneBatchPerThread) {
+                stdx::unique_lock<stdx::mutex> lk(mutex);
+                numClaimed++;
+                allClaimed.notify_all();
+                allClaimed.wait(lk, [&] { return numClaimed >= numThreads; });
+            }
+            out->assign(docs.begin() + begin, docs.begin() + end);
+        });
+    profile.start(numThreads);
+    while (!profile.isDone()) {
+        sleepmillis(1);
+    }
+    ASSERT_OK(profile.getStatus());
+    ASSERT_EQ(profile.numDocsScanned(), docs.size());
+
+    std::map<std::string, BSONObj> results;
+    const std::string& data = profile.getResults();
+    for (size_t offset = 0; offset < data.size();) {
+        BSONObj result(data.data() + offset);
+        results[result["path"].String()] = result.getOwned();
+        offset += result.objsize();
+    }
+    ASSERT_EQ(results.size(), profile.numResults());
+    return results;
+}
+
+TEST(FieldProfile, Paths) {
+    auto results = profile({fromjson("{a: 1, b: {c: 'x'}}"),
+                            fromjson("{a: 'y', d: [{e: 1}, {e: 2}, 3]}"),
+                            fromjson("{a: null}"),
+                            fromjson("{}")},
+                           2);
+    ASSERT_EQ(results.size(), 5UL);
+
+    ASSERT_EQ(results["a"]["docs"].numberLong(), 3);
+    ASSERT_EQ(results["a"]["frequency"].numberDouble(), 0.75);
+    ASSERT_BSONOBJ_EQ(results["a"]["types"].Obj(), BSON("string" << 1 << "null" << 1 << "int" << 1));
+    ASSERT_EQ(results["a"]["distinct"].numberLong(), 3);
+    ASSERT_EQ(results["a"]["examples"].Obj().nFields(), 3);
+
+    // subdocuments aren't examples, but their fields are paths
+    ASSERT_EQ(results["b"]["examples"].Obj().nFields(), 0);
+    ASSERT_EQ(results["b.c"]["docs"].numberLong(), 1);
+
+    // the fields of subdocuments in arrays are under the array's path, and counted once a doc
+    ASSERT_EQ(results["d.e"]["docs"].numberLong(), 1);
+    ASSERT_BSONOBJ_EQ(results["d.e"]["types"].Obj(), BSON("int" << 2));
+    ASSERT_EQ(results["d"]["docs"].numberLong(), 1);
+}
+
+TEST(FieldProfile, MergedThreads) {
+    std::vector<BSONObj> docs;
+    for (int i = 0; i < 5 * int(FieldProfile::kBatchSize); i++) {
+        docs.push_back(BSON("a" << i << "b" << (i % 10)));
+    }
+    auto results = profile(docs, 4);
+    ASSERT_EQ(results["a"]["docs"].numberLong(), static_cast<long long>(docs.size()));
+    ASSERT_LT(std::abs(results["a"]["distinct"].numberLong() - double(docs.size())),
+              0.1 * docs.size());
+    ASSERT_EQ(results["b"]["distinct"].numberLong(), 10);
+
+    std::set<int> examples;
+    for (auto&& example : results["a"]["examples"].Obj()) {
+        examples.insert(example.numberInt());
+    }
+    ASSERT_EQ(examples.size(), FieldProfile::kNumExamples);
+}
+
+TEST(FieldProfile, MergedExamplesAreUniform) {
+    // Two full batches and a small one, each profiled by its own thread, so the threads'
+    // reservoirs stand for very different numbers of values, and merging them evenly would
+    // over-represent the small batch.
+    const int numDocs = 2 * FieldProfile::kBatchSize + 100;
+    std::vector<BSONObj> docs;
+    for (int i = 0; i < numDocs; i++) {
+        docs.push_back(BSON("a" << i));
+    }
+    int numFirstBatch = 0;
+    int numLastBatch = 0;
+    int numExamples = 0;
+    for (int run = 0; run < 50; run++) {
+        auto results = profile(docs, 3, true);
+        for (auto&& example : results["a"]["examples"].Obj()) {
+            const int value = example.numberInt();
+            numFirstBatch += value < int(FieldProfile::kBatchSize);
+            numLastBatch += value >= int(2 * FieldProfile::kBatchSize);
+            numExamples++;
+        }
+    }
+    ASSERT_EQ(numExamples, 50 * int(FieldProfile::kNumExamples));
+    // expect about 123 and 3
+    ASSERT_GT(numFirstBatch, 80);
+    ASSERT_LT(numFirstBatch, 170);
+    ASSERT_LT(numLastBatch, 20);
+}
+
+}  // namespace
+}  // namespace mongo
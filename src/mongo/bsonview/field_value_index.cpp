@@ -0,0 +1,344 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/field_value_index.h"
+
+#include <algorithm>
+#include <boost/filesystem/operations.hpp>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mongo/bson/bsonelement_comparator_interface.h"
+#include "mongo/db/bson/dotted_path_support.h"
+#include "mongo/db/hasher.h"
+#include "mongo/db/matcher/expression_leaf.h"
+#include "mongo/util/errno_util.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+namespace {
+
+// The sidecar is a cache local to this machine, so it's simply written in native byte order.  The
+// header is followed by the path, and then the entries (aligned to 8 bytes).
+const char kMagic[8] = {'b', 'v', 'i', 'd', 'x', '\0', '\0', '\1'};
+
+struct SidecarHeader {
+    char magic[8];
+    uint64_t dataFileSize;
+    int64_t dataFileMtimeSec;
+    int64_t dataFileMtimeNsec;
+    uint64_t numDocs;
+    uint64_t numEntries;
+    uint64_t pathLength;
+};
+
+const char kSidecarSuffix[] = ".bvidx";
+
+size_t entriesOffset(uint64_t pathLength) {
+    return sizeof(SidecarHeader) + (pathLength + 7) / 8 * 8;
+}
+
+}  // namespace
+
+FieldValueIndex::FileId FieldValueIndex::FileId::fromStat(const struct stat& sb) {
+    FileId id;
+    id.size = sb.st_size;
+    id.mtimeSec = sb.st_mtim.tv_sec;
+    id.mtimeNsec = sb.st_mtim.tv_nsec;
+    return id;
+}
+
+FieldValueIndex::Builder::Builder(std::string path) : _path(std::move(path)) {}
+
+void FieldValueIndex::Builder::add(unsigned long doc, const BSONObj& obj) {
+    // The elements of arrays along the path match on their own, but so do the whole arrays.
+    BSONElementSet elements;
+    dotted_path_support::extractAllElementsAlongPath(obj, _path, elements, true);
+    dotted_path_support::extractAllElementsAlongPath(obj, _path, elements, false);
+    for (auto&& elem : elements) {
+        _entries.emplace_back(hashValue(elem), doc);
+    }
+}
+
+Status FieldValueIndex::Builder::write(const std::string& dataFile,
+                                       const FileId& dataFileId,
+                                       unsigned long numDocs) {
+    std::sort(_entries.begin(), _entries.end());
+    _entries.erase(std::unique(_entries.begin(), _entries.end()), _entries.end());
+
+    SidecarHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.dataFileSize = dataFileId.size;
+    header.dataFileMtimeSec = dataFileId.mtimeSec;
+    header.dataFileMtimeNsec = dataFileId.mtimeNsec;
+    header.numDocs = numDocs;
+    header.numEntries = _entries.size();
+    header.pathLength = _path.size();
+
+    // Write to a temporary file and rename it into place, so that a partial sidecar is never seen.
+    const std::string filename = sidecarFilename(dataFile, _path);
+    const std::string tmpFilename = filename + ".tmp";
+    {
+        std::ofstream out(tmpFilename, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return Status(ErrorCodes::FileOpenFailed,
+                          str::stream() << "Unable to open '" << tmpFilename << "' for writing");
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(_path.data(), _path.size());
+        const char padding[8] = {};
+        out.write(padding, entriesOffset(_path.size()) - sizeof(header) - _path.size());
+        for (auto&& entry : _entries) {
+            Entry e{entry.first, entry.second};
+            out.write(reinterpret_cast<const char*>(&e), sizeof(e));
+        }
+        out.close();
+        if (!out) {
+            ::unlink(tmpFilename.c_str());
+            return Status(ErrorCodes::FileStreamFailed,
+                          str::stream() << "Unable to write '" << tmpFilename << "'");
+        }
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::rename(tmpFilename, filename, ec);
+    if (ec) {
+        ::unlink(tmpFilename.c_str());
+        return Status(ErrorCodes::FileRenameFailed,
+                      str::stream() << "Unable to rename '" << tmpFilename << "' to '" << filename
+                                    << "': " << ec.message());
+    }
+    return Status::OK();
+}
+
+FieldValueIndex::~FieldValueIndex() {
+    if (_mapping) {
+        ::munmap(_mapping, _mappingSize);
+    }
+}
+
+StatusWith<std::unique_ptr<FieldValueIndex>> FieldValueIndex::open(const std::string& sidecarFile,
+                                                                   const FileId& dataFileId) {
+    const int fd = ::open(sidecarFile.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return Status(ErrorCodes::FileOpenFailed,
+                      str::stream() << "Unable to open '" << sidecarFile
+                                    << "': " << errnoWithDescription());
+    }
+    struct stat sb;
+    if (::fstat(fd, &sb) == -1) {
+        auto status = Status(ErrorCodes::FileOpenFailed,
+                             str::stream() << "Unable to fstat '" << sidecarFile
+                                           << "': " << errnoWithDescription());
+        ::close(fd);
+        return status;
+    }
+    if (static_cast<size_t>(sb.st_size) < sizeof(SidecarHeader)) {
+        ::close(fd);
+        return Status(ErrorCodes::UnsupportedFormat,
+                      str::stream() << "'" << sidecarFile << "' is not an index sidecar");
+    }
+
+    std::unique_ptr<FieldValueIndex> index(new FieldValueIndex());
+    index->_mappingSize = sb.st_size;
+    void* mapping = ::mmap(NULL, index->_mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return Status(ErrorCodes::FileOpenFailed,
+                      str::stream() << "Unable to mmap '" << sidecarFile
+                                    << "': " << errnoWithDescription());
+    }
+    index->_mapping = mapping;
+
+    const char* base = static_cast<const char*>(mapping);
+    SidecarHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        index->_mappingSize < entriesOffset(header.pathLength) ||
+        (index->_mappingSize - entriesOffset(header.pathLength)) / sizeof(Entry) !=
+            header.numEntries) {
+        return Status(ErrorCodes::UnsupportedFormat,
+                      str::stream() << "'" << sidecarFile << "' is not an index sidecar");
+    }
+
+    FileId builtFrom;
+    builtFrom.size = header.dataFileSize;
+    builtFrom.mtimeSec = header.dataFileMtimeSec;
+    builtFrom.mtimeNsec = header.dataFileMtimeNsec;
+    if (!(builtFrom == dataFileId)) {
+        return Status(ErrorCodes::BadValue,
+                      str::stream() << "'" << sidecarFile
+                                    << "' was built from a different version of the data file");
+    }
+
+    index->_path.assign(base + sizeof(header), header.pathLength);
+    index->_numDocs = header.numDocs;
+    index->_entries = reinterpret_cast<const Entry*>(base + entriesOffset(header.pathLength));
+    index->_numEntries = header.numEntries;
+    return {std::move(index)};
+}
+
+std::string FieldValueIndex::sidecarFilename(const std::string& dataFile, StringData path) {
+    return str::stream() << dataFile << "." << path << kSidecarSuffix;
+}
+
+bool FieldValueIndex::isValidPath(StringData path) {
+    return !path.empty() && path.find('/') == std::string::npos;
+}
+
+uint64_t FieldValueIndex::hashValue(const BSONElement& elem) {
+    // Stable across versions (it's used for hashed shard keys), so it's safe to persist.
+    return BSONElementHasher::hash64(elem, BSONElementHasher::DEFAULT_HASH_SEED);
+}
+
+void FieldValueIndex::lookup(const BSONElement& elem, std::vector<unsigned long>* docs) const {
+    const uint64_t hash = hashValue(elem);
+    const Entry* end = _entries + _numEntries;
+    const Entry* it = std::lower_bound(
+        _entries, end, hash, [](const Entry& entry, uint64_t h) { return entry.hash < h; });
+    for (; it != end && it->hash == hash; ++it) {
+        docs->push_back(it->doc);
+    }
+}
+
+
+int FieldIndexCatalog::loadExisting(const std::string& dataFile,
+                                    const FieldValueIndex::FileId& dataFileId) {
+    boost::filesystem::path dataPath(dataFile);
+    boost::filesystem::path dir = dataPath.parent_path();
+    if (dir.empty()) {
+        dir = ".";
+    }
+    const std::string prefix = dataPath.filename().string() + ".";
+
+    int numLoaded = 0;
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(dir, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (!StringData(name).startsWith(prefix) || !StringData(name).endsWith(kSidecarSuffix)) {
+            continue;
+        }
+        // stale or broken sidecars are ignored, and get replaced if the path is indexed again
+        auto index = FieldValueIndex::open(it->path().string(), dataFileId);
+        if (index.isOK()) {
+            add(std::move(index.getValue()));
+            numLoaded++;
+        }
+    }
+    return numLoaded;
+}
+
+void FieldIndexCatalog::add(std::unique_ptr<FieldValueIndex> index) {
+    for (auto&& existing : _indexes) {
+        if (existing->getPath() == index->getPath()) {
+            existing = std::move(index);
+            return;
+        }
+    }
+    _indexes.push_back(std::move(index));
+}
+
+const FieldValueIndex* FieldIndexCatalog::find(StringData path) const {
+    for (auto&& index : _indexes) {
+        if (index->getPath() == path) {
+            return index.get();
+        }
+    }
+    return nullptr;
+}
+
+boost::optional<std::vector<unsigned long>> FieldIndexCatalog::candidateDocs(
+    const MatchExpression* expr) const {
+    if (expr->matchType() != MatchExpression::AND) {
+        return _candidatesForLeaf(expr);
+    }
+
+    // Intersect the candidates of all the conjuncts that can use an index.  The rest of the
+    // predicates are left for the matcher to check.
+    boost::optional<std::vector<unsigned long>> result;
+    for (size_t i = 0; i < expr->numChildren(); i++) {
+        auto docs = candidateDocs(expr->getChild(i));
+        if (!docs) {
+            continue;
+        }
+        if (!result) {
+            result = std::move(docs);
+            continue;
+        }
+        std::vector<unsigned long> both;
+        std::set_intersection(result->begin(),
+                              result->end(),
+                              docs->begin(),
+                              docs->end(),
+                              std::back_inserter(both));
+        result = std::move(both);
+    }
+    return result;
+}
+
+boost::optional<std::vector<unsigned long>> FieldIndexCatalog::_candidatesForLeaf(
+    const MatchExpression* expr) const {
+    // Null also matches docs which don't have the path at all, and those aren't in the index.
+    std::vector<unsigned long> docs;
+    switch (expr->matchType()) {
+        case MatchExpression::EQ: {
+            auto eq = static_cast<const EqualityMatchExpression*>(expr);
+            auto index = find(eq->path());
+            if (!index || eq->getCollator() || eq->getData().type() == jstNULL) {
+                return boost::none;
+            }
+            index->lookup(eq->getData(), &docs);
+            break;
+        }
+        case MatchExpression::MATCH_IN: {
+            auto in = static_cast<const InMatchExpression*>(expr);
+            auto index = find(in->path());
+            if (!index || in->getCollator() || in->hasNull() || !in->getRegexes().empty()) {
+                return boost::none;
+            }
+            for (auto&& elem : in->getEqualities()) {
+                index->lookup(elem, &docs);
+            }
+            std::sort(docs.begin(), docs.end());
+            docs.erase(std::unique(docs.begin(), docs.end()), docs.end());
+            break;
+        }
+        default:
+            return boost::none;
+    }
+    return docs;
+}
+
+}  // namespace mongo
@@ -0,0 +1,167 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "mongo/base/status_with.h"
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bsonobj.h"
+
+namespace mongo {
+
+class MatchExpression;
+
+/**
+ * A persistent inverted index over the values of one field path in a BSON file, mapping each
+ * value's hash to the (sorted) numbers of the docs which have it.  The index is stored in a
+ * sidecar file next to the data file, and memory mapped when opened, so that it can be reused by
+ * later runs without any loading.
+ *
+ * Values are hashed with BSONElementHasher (as for hashed indexes), so lookups can return false
+ * positives, but never miss a doc: every element along the path is indexed, including each
+ * member of any arrays, as well as the arrays themselves.  Docs found through the index must
+ * therefore still be checked against the query.
+ */
+class FieldValueIndex {
+public:
+    /**
+     * Identifies the state of the data file that an index was built from, so that indexes of an
+     * older version of it are never used.
+     */
+    struct FileId {
+        static FileId fromStat(const struct stat& sb);
+
+        bool operator==(const FileId& other) const {
+            return size == other.size && mtimeSec == other.mtimeSec &&
+                mtimeNsec == other.mtimeNsec;
+        }
+
+        uint64_t size = 0;
+        int64_t mtimeSec = 0;
+        int64_t mtimeNsec = 0;
+    };
+
+    /**
+     * Collects the values of the path from every doc of a file, in order, and writes them out
+     * as a sidecar.  Not thread-safe.
+     */
+    class Builder {
+    public:
+        explicit Builder(std::string path);
+
+        void add(unsigned long doc, const BSONObj& obj);
+
+        Status write(const std::string& dataFile, const FileId& dataFileId, unsigned long numDocs);
+
+    private:
+        std::string _path;
+        std::vector<std::pair<uint64_t, uint64_t>> _entries;  // (hash, doc)
+    };
+
+    ~FieldValueIndex();
+
+    /**
+     * Opens a sidecar written by Builder::write(), which must have been built from exactly the
+     * given version of the data file.
+     */
+    static StatusWith<std::unique_ptr<FieldValueIndex>> open(const std::string& sidecarFile,
+                                                             const FileId& dataFileId);
+
+    static std::string sidecarFilename(const std::string& dataFile, StringData path);
+
+    // Paths are used in the sidecar's filename, so can't contain '/'.
+    static bool isValidPath(StringData path);
+
+    static uint64_t hashValue(const BSONElement& elem);
+
+    const std::string& getPath() const {
+        return _path;
+    }
+
+    // The number of docs in the data file.
+    unsigned long numDocs() const {
+        return _numDocs;
+    }
+
+    // Thread-safe.  Appends the docs which might have a value equal to elem along the path, in
+    // order.
+    void lookup(const BSONElement& elem, std::vector<unsigned long>* docs) const;
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint64_t doc;
+    };
+
+    FieldValueIndex() = default;
+
+    std::string _path;
+    unsigned long _numDocs = 0;
+    void* _mapping = nullptr;
+    size_t _mappingSize = 0;
+    const Entry* _entries = nullptr;  // sorted by hash, then doc
+    size_t _numEntries = 0;
+};
+
+/**
+ * The field value indexes available for a data file.
+ */
+class FieldIndexCatalog {
+public:
+    /**
+     * Opens every sidecar of the data file that is up to date with it.  Returns the number of
+     * indexes opened.
+     */
+    int loadExisting(const std::string& dataFile, const FieldValueIndex::FileId& dataFileId);
+
+    // Replaces any existing index of the same path.
+    void add(std::unique_ptr<FieldValueIndex> index);
+
+    const FieldValueIndex* find(StringData path) const;
+
+    /**
+     * Uses the indexes to find the docs that could match expr, if it (or any of its top-level
+     * conjuncts) is an equality or $in predicate on an indexed path.  Every other doc is certain
+     * not to match.  The returned docs are sorted.
+     */
+    boost::optional<std::vector<unsigned long>> candidateDocs(const MatchExpression* expr) const;
+
+private:
+    boost::optional<std::vector<unsigned long>> _candidatesForLeaf(
+        const MatchExpression* expr) const;
+
+    std::vector<std::unique_ptr<FieldValueIndex>> _indexes;
+};
+
+}  // namespace mongo
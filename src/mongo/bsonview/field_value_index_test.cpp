@@ -0,0 +1,204 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/field_value_index.h"
+
+#include <fstream>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/bson/json.h"
+#include "mongo/db/matcher/expression_leaf.h"
+#include "mongo/db/matcher/expression_tree.h"
+#include "mongo/unittest/temp_dir.h"
+#include "mongo/unittest/unittest.h"
+
+namespace mongo {
+namespace {
+
+FieldValueIndex::FileId fileId(uint64_t size, int64_t mtimeSec) {
+    FieldValueIndex::FileId id;
+    id.size = size;
+    id.mtimeSec = mtimeSec;
+    id.mtimeNsec = 123;
+    return id;
+}
+
+// Builds and writes an index of path over docs, for the data file dir/data.bson.
+std::string writeIndex(const std::string& dir,
+                       const std::string& path,
+                       const std::vector<BSONObj>& docs,
+                       const FieldValueIndex::FileId& id) {
+    const std::string dataFile = dir + "/data.bson";
+    FieldValueIndex::Builder builder(path);
+    for (unsigned long doc = 0; doc < docs.size(); doc++) {
+        builder.add(doc, docs[doc]);
+    }
+    ASSERT_OK(builder.write(dataFile, id, docs.size()));
+    return dataFile;
+}
+
+std::vector<unsigned long> lookup(const FieldValueIndex& index, const BSONObj& value) {
+    std::vector<unsigned long> docs;
+    index.lookup(value.firstElement(), &docs);
+    return docs;
+}
+
+std::vector<BSONObj> testDocs() {
+    return {
+        fromjson("{a: 1}"),
+        fromjson("{a: [2, 3]}"),
+        fromjson("{a: {b: 'x'}}"),
+        fromjson("{b: 1}"),
+        fromjson("{a: 1, c: 2}"),
+        fromjson("{a: [{b: 'x'}, {b: 'y'}]}"),
+    };
+}
+
+TEST(FieldValueIndex, SidecarRoundTrip) {
+    unittest::TempDir dir("field_value_index_test");
+    const auto id = fileId(1000, 42);
+    const std::string dataFile = writeIndex(dir.path(), "a", testDocs(), id);
+
+    auto index = FieldValueIndex::open(FieldValueIndex::sidecarFilename(dataFile, "a"), id);
+    ASSERT_OK(index.getStatus());
+    ASSERT_EQ(index.getValue()->getPath(), "a");
+    ASSERT_EQ(index.getValue()->numDocs(), testDocs().size());
+
+    ASSERT(lookup(*index.getValue(), BSON("" << 1)) == (std::vector<unsigned long>{0, 4}));
+    // both the members of an array, and the array itself
+    ASSERT(lookup(*index.getValue(), BSON("" << 3)) == (std::vector<unsigned long>{1}));
+    ASSERT(lookup(*index.getValue(), BSON("" << BSON_ARRAY(2 << 3))) ==
+           (std::vector<unsigned long>{1}));
+    ASSERT(lookup(*index.getValue(), BSON("" << BSON("b"
+                                                      << "x"))) ==
+           (std::vector<unsigned long>{2, 5}));
+    ASSERT(lookup(*index.getValue(), BSON("" << 4)).empty());
+}
+
+TEST(FieldValueIndex, DottedPath) {
+    unittest::TempDir dir("field_value_index_test");
+    const auto id = fileId(1000, 42);
+    const std::string dataFile = writeIndex(dir.path(), "a.b", testDocs(), id);
+
+    auto index = FieldValueIndex::open(FieldValueIndex::sidecarFilename(dataFile, "a.b"), id);
+    ASSERT_OK(index.getStatus());
+    ASSERT(lookup(*index.getValue(),
+                  BSON(""
+                       << "x")) == (std::vector<unsigned long>{2, 5}));
+    ASSERT(lookup(*index.getValue(),
+                  BSON(""
+                       << "y")) == (std::vector<unsigned long>{5}));
+}
+
+TEST(FieldValueIndex, StaleFileIdIsRejected) {
+    unittest::TempDir dir("field_value_index_test");
+    const std::string dataFile = writeIndex(dir.path(), "a", testDocs(), fileId(1000, 42));
+    const std::string sidecar = FieldValueIndex::sidecarFilename(dataFile, "a");
+
+    ASSERT_EQ(FieldValueIndex::open(sidecar, fileId(1001, 42)).getStatus().code(),
+              ErrorCodes::BadValue);
+    ASSERT_EQ(FieldValueIndex::open(sidecar, fileId(1000, 43)).getStatus().code(),
+              ErrorCodes::BadValue);
+    auto touched = fileId(1000, 42);
+    touched.mtimeNsec++;
+    ASSERT_EQ(FieldValueIndex::open(sidecar, touched).getStatus().code(), ErrorCodes::BadValue);
+}
+
+TEST(FieldValueIndex, NotASidecar) {
+    unittest::TempDir dir("field_value_index_test");
+    const std::string missing = dir.path() + "/missing.bvidx";
+    ASSERT_EQ(FieldValueIndex::open(missing, fileId(0, 0)).getStatus().code(),
+              ErrorCodes::FileOpenFailed);
+
+    const std::string garbage = dir.path() + "/garbage.bvidx";
+    std::ofstream(garbage) << "this is not an index sidecar, but it's long enough to be one";
+    ASSERT_EQ(FieldValueIndex::open(garbage, fileId(0, 0)).getStatus().code(),
+              ErrorCodes::UnsupportedFormat);
+
+    const std::string tiny = dir.path() + "/tiny.bvidx";
+    std::ofstream(tiny) << "bvidx";
+    ASSERT_EQ(FieldValueIndex::open(tiny, fileId(0, 0)).getStatus().code(),
+              ErrorCodes::UnsupportedFormat);
+}
+
+TEST(FieldValueIndex, ValidPaths) {
+    ASSERT(FieldValueIndex::isValidPath("a"));
+    ASSERT(FieldValueIndex::isValidPath("a.b.c"));
+    ASSERT_FALSE(FieldValueIndex::isValidPath(""));
+    ASSERT_FALSE(FieldValueIndex::isValidPath("a/b"));
+    ASSERT_EQ(FieldValueIndex::sidecarFilename("dir/data.bson", "a.b"), "dir/data.bson.a.b.bvidx");
+}
+
+TEST(FieldIndexCatalog, LoadsOnlyUpToDateSidecars) {
+    unittest::TempDir dir("field_value_index_test");
+    const std::string dataFile = writeIndex(dir.path(), "a", testDocs(), fileId(1000, 42));
+    writeIndex(dir.path(), "b", testDocs(), fileId(999, 42));
+
+    FieldIndexCatalog catalog;
+    ASSERT_EQ(catalog.loadExisting(dataFile, fileId(1000, 42)), 1);
+    ASSERT(catalog.find("a"));
+    ASSERT_FALSE(catalog.find("b"));
+}
+
+TEST(FieldIndexCatalog, CandidateDocs) {
+    unittest::TempDir dir("field_value_index_test");
+    const auto id = fileId(1000, 42);
+    const std::string dataFile = writeIndex(dir.path(), "a", testDocs(), id);
+    writeIndex(dir.path(), "c", testDocs(), id);
+    FieldIndexCatalog catalog;
+    ASSERT_EQ(catalog.loadExisting(dataFile, id), 2);
+
+    const BSONObj one = BSON("" << 1);
+    const BSONObj two = BSON("" << 2);
+    EqualityMatchExpression eqA("a", one.firstElement());
+    ASSERT(*catalog.candidateDocs(&eqA) == (std::vector<unsigned long>{0, 4}));
+
+    // unindexed paths, and null (which matches docs without the path), can't use the index
+    EqualityMatchExpression eqB("b", one.firstElement());
+    ASSERT_FALSE(catalog.candidateDocs(&eqB));
+    const BSONObj null = BSON("" << BSONNULL);
+    EqualityMatchExpression eqNull("a", null.firstElement());
+    ASSERT_FALSE(catalog.candidateDocs(&eqNull));
+
+    InMatchExpression in("a");
+    ASSERT_OK(in.setEqualities({one.firstElement(), two.firstElement()}));
+    ASSERT(*catalog.candidateDocs(&in) == (std::vector<unsigned long>{0, 1, 4}));
+
+    // the indexed conjuncts are intersected, and the rest are left to the matcher
+    AndMatchExpression both;
+    both.add(new EqualityMatchExpression("a", one.firstElement()));
+    both.add(new EqualityMatchExpression("b", one.firstElement()));
+    both.add(new EqualityMatchExpression("c", two.firstElement()));
+    ASSERT(*catalog.candidateDocs(&both) == (std::vector<unsigned long>{4}));
+}
+
+}  // namespace
+}  // namespace mongo
@@ -0,0 +1,149 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mongo {
+
+constexpr int LatencyHistogram::kSubBuckets;
+constexpr int LatencyHistogram::kNumBuckets;
+
+int LatencyHistogram::bucketOf(uint64_t value) {
+    if (value < kSubBuckets) {
+        return static_cast<int>(value);
+    }
+    // the top bit picks the power of two, and the next bits the sub-bucket within it
+    const int topBit = 63 - __builtin_clzll(value);
+    const int subBucket = static_cast<int>((value >> (topBit - 2)) & (kSubBuckets - 1));
+    return (topBit - 1) * kSubBuckets + subBucket;
+}
+
+uint64_t LatencyHistogram::lowerBound(int bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    const int topBit = bucket / kSubBuckets + 1;
+    const uint64_t subBucket = bucket % kSubBuckets;
+    return (uint64_t(1) << topBit) | (subBucket << (topBit - 2));
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    const uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(total * p / 100)));
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < kNumBuckets; bucket++) {
+        seen += _buckets[bucket].load();
+        if (seen >= rank) {
+            return bucket + 1 < kNumBuckets ? lowerBound(bucket + 1) - 1
+                                            : std::numeric_limits<uint64_t>::max();
+        }
+    }
+    // only if it's been cleared meanwhile (a bucket is always counted before the total)
+    return 0;
+}
+
+void LatencyHistogram::clear() {
+    for (auto&& bucket : _buckets) {
+        bucket.store(0);
+    }
+    _count.store(0);
+}
+
+void LatencyHistogram::appendTo(BSONObjBuilder* b) const {
+    b->append("count", static_cast<long long>(count()));
+    b->append("p50", static_cast<long long>(percentile(50)));
+    b->append("p90", static_cast<long long>(percentile(90)));
+    b->append("p99", static_cast<long long>(percentile(99)));
+    b->append("max", static_cast<long long>(percentile(100)));
+    BSONArrayBuilder buckets(b->subarrayStart("buckets"));
+    for (int bucket = 0; bucket < kNumBuckets; bucket++) {
+        if (const auto n = _buckets[bucket].load()) {
+            buckets.append(BSON_ARRAY(static_cast<long long>(lowerBound(bucket))
+                                      << static_cast<long long>(n)));
+        }
+    }
+}
+
+StringData FrameStats::phaseName(Phase phase) {
+    switch (phase) {
+        case kFrame:
+            return "frame";
+        case kEventKey:
+            return "event_key";
+        case kComputeVisible:
+            return "computeVisible";
+        case kDrawMainLines:
+            return "drawMainLines";
+        case kRenderDoc:
+            return "renderDoc";
+        case kSearchMatches:
+            return "Search::matches";
+        case kLoadMore:
+            return "load_more";
+        case kNumPhases:
+            break;
+    }
+    return "unknown";
+}
+
+void FrameStats::clear() {
+    for (auto&& phase : _phases) {
+        phase.clear();
+    }
+    _docsPerFrame.clear();
+    _docsThisFrame = 0;
+    _docsRendered = 0;
+}
+
+BSONObj FrameStats::toBSON() const {
+    BSONObjBuilder b;
+    {
+        BSONObjBuilder phases(b.subobjStart("phases"));
+        for (int phase = 0; phase < kNumPhases; phase++) {
+            BSONObjBuilder histogram(phases.subobjStart(phaseName(static_cast<Phase>(phase))));
+            _phases[phase].appendTo(&histogram);
+        }
+    }
+    {
+        BSONObjBuilder docsPerFrame(b.subobjStart("docsPerFrame"));
+        _docsPerFrame.appendTo(&docsPerFrame);
+    }
+    return b.obj();
+}
+
+}  // namespace mongo
@@ -0,0 +1,159 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/platform/atomic_word.h"
+
+namespace mongo {
+
+/**
+ * A histogram of non-negative values (eg. latencies in nanoseconds), with log-linear buckets: each
+ * power of two is split into kSubBuckets buckets, so percentiles are within 1/kSubBuckets of the
+ * true value.  Recording is wait-free, so it's cheap enough for hot paths, and safe from any
+ * thread.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBuckets = 4;
+    // values below kSubBuckets have a bucket each, and then each power of two from 4 to 2^63
+    static constexpr int kNumBuckets = 63 * kSubBuckets;
+
+    void record(uint64_t value) {
+        _buckets[bucketOf(value)].fetchAndAdd(1);
+        _count.fetchAndAdd(1);
+    }
+
+    uint64_t count() const {
+        return _count.load();
+    }
+
+    // The upper bound of the bucket holding the p'th percentile (p in [0, 100]), or 0 if empty.
+    uint64_t percentile(double p) const;
+
+    void clear();
+
+    // {count, p50, p90, p99, max, buckets: [[lower bound, count], ...]}, leaving out the empty
+    // buckets.
+    void appendTo(BSONObjBuilder* b) const;
+
+    static int bucketOf(uint64_t value);
+
+    // The smallest value in the bucket.
+    static uint64_t lowerBound(int bucket);
+
+private:
+    AtomicWord<unsigned long long> _buckets[kNumBuckets] = {};
+    AtomicWord<unsigned long long> _count{0};
+};
+
+/**
+ * Where the time goes while bv is responding to input and redrawing: per-phase latency
+ * histograms, and how many docs each frame renders.  Phases nest (eg. renderDoc within
+ * drawMainLines), so each one's time includes that of the phases it calls.
+ */
+class FrameStats {
+public:
+    enum Phase {
+        kFrame,  // a whole redraw of the main window
+        kEventKey,
+        kComputeVisible,
+        kDrawMainLines,
+        kRenderDoc,
+        kSearchMatches,
+        kLoadMore,
+        kNumPhases,
+    };
+
+    static StringData phaseName(Phase phase);
+
+    // Times a phase, from construction to destruction.
+    class Timer {
+    public:
+        Timer(FrameStats* stats, Phase phase)
+            : _stats(stats), _phase(phase), _start(std::chrono::steady_clock::now()) {}
+
+        ~Timer() {
+            _stats->record(_phase, std::chrono::steady_clock::now() - _start);
+        }
+
+    private:
+        FrameStats* const _stats;
+        const Phase _phase;
+        const std::chrono::steady_clock::time_point _start;
+    };
+
+    void record(Phase phase, std::chrono::steady_clock::duration elapsed) {
+        _phases[phase].record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    void docRendered() {
+        _docsThisFrame++;
+        _docsRendered++;
+    }
+
+    // All the docs rendered since construction or the last clear().
+    unsigned long long numDocsRendered() const {
+        return _docsRendered;
+    }
+
+    // Called at the end of each frame (from the UI thread).
+    void endFrame() {
+        _docsPerFrame.record(_docsThisFrame);
+        _docsThisFrame = 0;
+    }
+
+    const LatencyHistogram& phase(Phase phase) const {
+        return _phases[phase];
+    }
+
+    const LatencyHistogram& docsPerFrame() const {
+        return _docsPerFrame;
+    }
+
+    void clear();
+
+    // {phases: {frame: {...}, ...}, docsPerFrame: {...}}, with the latencies in nanoseconds.
+    BSONObj toBSON() const;
+
+private:
+    LatencyHistogram _phases[kNumPhases];
+    LatencyHistogram _docsPerFrame;
+    unsigned long _docsThisFrame = 0;  // only used on the UI thread
+    unsigned long long _docsRendered = 0;  // ditto
+};
+
+}  // namespace mongo
@@ -0,0 +1,102 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/hash_partitions.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/errno_util.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+SpillFile::SpillFile(std::string tempDir, std::string prefix)
+    : _tempDir(std::move(tempDir)), _prefix(std::move(prefix)) {}
+
+SpillFile::~SpillFile() {
+    if (_fd != -1) {
+        ::close(_fd);
+    }
+}
+
+void SpillFile::append(const void* data, size_t numBytes) {
+    static AtomicWord<unsigned> spillFileCounter;
+
+    if (_fd == -1) {
+        const std::string path = str::stream() << _tempDir << "/" << _prefix << "." << ::getpid()
+                                               << "." << spillFileCounter.fetchAndAdd(1);
+        _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        uassert(ErrorCodes::FileOpenFailed,
+                str::stream() << "Unable to create " << path << ": " << errnoWithDescription(),
+                _fd != -1);
+        // it only needs to last as long as the fd
+        ::unlink(path.c_str());
+    }
+
+    const char* remaining = static_cast<const char*>(data);
+    while (numBytes > 0) {
+        const ssize_t written = ::pwrite(_fd, remaining, numBytes, _size);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        uassert(ErrorCodes::FileStreamFailed,
+                str::stream() << "Unable to write to a temp file: " << errnoWithDescription(),
+                written > 0);
+        remaining += written;
+        numBytes -= written;
+        _size += written;
+    }
+}
+
+void SpillFile::readAndClose(void* out) {
+    invariant(_fd != -1);
+    char* remaining = static_cast<char*>(out);
+    size_t offset = 0;
+    while (offset < _size) {
+        const ssize_t numRead = ::pread(_fd, remaining, _size - offset, offset);
+        if (numRead == -1 && errno == EINTR) {
+            continue;
+        }
+        uassert(ErrorCodes::FileStreamFailed,
+                str::stream() << "Unable to read back a temp file: " << errnoWithDescription(),
+                numRead > 0);
+        remaining += numRead;
+        offset += numRead;
+    }
+    ::close(_fd);
+    _fd = -1;
+    _size = 0;
+}
+
+}  // namespace mongo
@@ -0,0 +1,165 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/base/string_data.h"
+#include "mongo/stdx/mutex.h"
+
+namespace mongo {
+
+/**
+ * An unlinked temp file which is appended to, and then read back in one go.  Nothing is created
+ * until the first append.
+ */
+class SpillFile {
+public:
+    SpillFile(std::string tempDir, std::string prefix);
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    ~SpillFile();
+
+    // Throws if the file can't be created or written.
+    void append(const void* data, size_t numBytes);
+
+    size_t size() const {
+        return _size;
+    }
+
+    // Reads the whole file into out, which must have room for size() bytes, and then deletes it.
+    void readAndClose(void* out);
+
+private:
+    const std::string _tempDir;
+    const std::string _prefix;
+    int _fd = -1;
+    size_t _size = 0;
+};
+
+/**
+ * Fixed-size entries scattered by the top bits of their hash, so that entries with equal hashes
+ * always end up in the same partition, and each partition can then be processed on its own.
+ * Entries are kept in memory until a writer decides to spill them (usually when it has buffered
+ * its share of a memory limit), after which they're appended to the partition's SpillFile.
+ *
+ * Entry must be trivially copyable, and have a uint64_t "hash" member.
+ */
+template <typename Entry>
+class HashPartitions {
+public:
+    static constexpr int kPartitionBits = 8;
+    static constexpr size_t kNumPartitions = size_t(1) << kPartitionBits;
+
+    HashPartitions(const std::string& tempDir, const std::string& prefix) {
+        for (size_t i = 0; i < kNumPartitions; i++) {
+            _partitions.emplace_back(std::make_unique<Partition>(tempDir, prefix));
+        }
+    }
+
+    static size_t partitionOf(const Entry& entry) {
+        return entry.hash >> (64 - kPartitionBits);
+    }
+
+    // A buffer of entries for each partition, which a writer fills without any locking.
+    using Buffers = std::vector<std::vector<Entry>>;
+
+    static Buffers makeBuffers() {
+        return Buffers(kNumPartitions);
+    }
+
+    // Writes out and clears the buffers.  Thread-safe.
+    void spill(Buffers* buffers) {
+        for (size_t p = 0; p < kNumPartitions; p++) {
+            auto& buffer = (*buffers)[p];
+            if (buffer.empty()) {
+                continue;
+            }
+            Partition& partition = *_partitions[p];
+            stdx::lock_guard<stdx::mutex> lk(partition.mutex);
+            partition.file.append(buffer.data(), buffer.size() * sizeof(Entry));
+            buffer.clear();
+        }
+    }
+
+    // Adds the buffers to what's kept in memory, for a writer that's done.  Thread-safe.
+    void keep(Buffers* buffers) {
+        for (size_t p = 0; p < kNumPartitions; p++) {
+            auto& buffer = (*buffers)[p];
+            Partition& partition = *_partitions[p];
+            stdx::lock_guard<stdx::mutex> lk(partition.mutex);
+            partition.kept.insert(partition.kept.end(), buffer.begin(), buffer.end());
+            buffer.clear();
+        }
+    }
+
+    // The rest are only for once all the writers are done.
+
+    // The memory needed to take a partition, over what's already kept in memory.
+    size_t spilledBytes(size_t p) const {
+        return _partitions[p]->file.size();
+    }
+
+    // Hands over all the entries of a partition, in no particular order.  Can only be done once
+    // for each partition, but different partitions can be taken concurrently.
+    std::vector<Entry> take(size_t p) {
+        Partition& partition = *_partitions[p];
+        std::vector<Entry> entries = std::move(partition.kept);
+        const size_t numKept = entries.size();
+        entries.resize(numKept + partition.file.size() / sizeof(Entry));
+        if (partition.file.size() > 0) {
+            partition.file.readAndClose(entries.data() + numKept);
+        }
+        return entries;
+    }
+
+private:
+    struct Partition {
+        Partition(const std::string& tempDir, const std::string& prefix)
+            : file(tempDir, prefix) {}
+
+        stdx::mutex mutex;  // protects the rest, while writing
+        SpillFile file;
+        std::vector<Entry> kept;
+    };
+
+    std::vector<std::unique_ptr<Partition>> _partitions;
+};
+
+template <typename Entry>
+constexpr int HashPartitions<Entry>::kPartitionBits;
+template <typename Entry>
+constexpr size_t HashPartitions<Entry>::kNumPartitions;
+
+}  // namespace mongo
@@ -0,0 +1,75 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/loaded_doc_batches.h"
+
+#include <algorithm>
+
+#include "mongo/util/assert_util.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+constexpr int LoadedDocBatches::kWaitMillis;
+
+LoadedDocBatches::LoadedDocBatches(LoadProgressFn loadProgress,
+                                   LoadedDocsFn loadedDocs,
+                                   unsigned long batchSize,
+                                   const AtomicWord<bool>* stop)
+    : _loadProgress(std::move(loadProgress)),
+      _loadedDocs(std::move(loadedDocs)),
+      _batchSize(batchSize),
+      _stop(stop) {
+    invariant(_batchSize > 0);
+}
+
+bool LoadedDocBatches::next(std::vector<BSONObj>* docs, unsigned long* begin) {
+    const unsigned long first = _nextBatch.fetchAndAdd(1) * _batchSize;
+    while (true) {
+        uassert(ErrorCodes::Interrupted, "Interrupted while waiting for docs", !_stop->load());
+        unsigned long numDocs;
+        bool complete;
+        _loadProgress(&numDocs, &complete);
+        if (complete && first >= numDocs) {
+            return false;
+        }
+        if (complete || numDocs >= first + _batchSize) {
+            _loadedDocs(first, std::min(numDocs, first + _batchSize), docs);
+            _numScanned.fetchAndAdd(docs->size());
+            *begin = first;
+            return true;
+        }
+        // wait for the loader to catch up
+        sleepmillis(kWaitMillis);
+    }
+}
+
+}  // namespace mongo
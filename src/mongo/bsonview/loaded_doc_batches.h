@@ -0,0 +1,95 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/platform/atomic_word.h"
+
+namespace mongo {
+
+/**
+ * Hands out the docs of a file in batches to the threads of a background job (eg.
+ * ParallelAggregation), as the UI thread loads them.  Each batch goes to whichever thread claims
+ * it first, and a thread that claims one the loader hasn't got to the end of yet waits for it, so
+ * the job can start before the file has all been loaded.
+ *
+ * Claiming is lock-free, and the docs themselves are BSONObjs pointing into the mapped file, so
+ * it's cheap enough for batches of a few thousand docs.
+ */
+class LoadedDocBatches {
+public:
+    // Must be thread-safe.
+    using LoadProgressFn = std::function<void(unsigned long* numDocs, bool* complete)>;
+    using LoadedDocsFn =
+        std::function<void(unsigned long begin, unsigned long end, std::vector<BSONObj>* out)>;
+
+    // How long to wait for the loader before checking its progress again.
+    static constexpr int kWaitMillis = 20;
+
+    // Waiting stops (with an Interrupted exception) once stop is set, which must outlive this.
+    LoadedDocBatches(LoadProgressFn loadProgress,
+                     LoadedDocsFn loadedDocs,
+                     unsigned long batchSize,
+                     const AtomicWord<bool>* stop);
+
+    /**
+     * Claims the next batch, and once it's loaded, copies out its docs and the number of its first
+     * doc.  Returns false if there are no more docs.
+     */
+    bool next(std::vector<BSONObj>* docs, unsigned long* begin);
+
+    // Copies out any docs that are already loaded, without claiming them.
+    void getDocs(unsigned long begin, unsigned long end, std::vector<BSONObj>* out) const {
+        _loadedDocs(begin, end, out);
+    }
+
+    unsigned long batchSize() const {
+        return _batchSize;
+    }
+
+    // How many docs the batches handed out so far have had.
+    unsigned long numScanned() const {
+        return _numScanned.load();
+    }
+
+private:
+    const LoadProgressFn _loadProgress;
+    const LoadedDocsFn _loadedDocs;
+    const unsigned long _batchSize;
+    const AtomicWord<bool>* const _stop;
+
+    AtomicWord<unsigned long> _nextBatch{0};
+    AtomicWord<unsigned long> _numScanned{0};
+};
+
+}  // namespace mongo
@@ -31,12 +31,15 @@
 
 //#include <boost/filesystem/operations.hpp>
 //#include <cctype>
+#include <algorithm>
 #include <cerrno>
-//#include <fstream>
+#include <fstream>
+#include <iomanip>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <iostream>
+#include <map>
 //#include <pcrecpp.h>
 //#include <signal.h>
 //#include <stdio.h>
@@ -44,13 +47,44 @@
 #include <unistd.h>
 #include <sys/mman.h>
 
+#include "mongo/base/data_view.h"
+#include "mongo/base/initializer.h"
+#include "mongo/base/parse_number.h"
 #include "mongo/bson/bsonobj.h"
 #include "mongo/bson/json.h"
+#include "mongo/bsonview/bson_cache.h"
+#include "mongo/bsonview/bson_diff.h"
+#include "mongo/bsonview/bson_export.h"
+#include "mongo/bsonview/bson_file_set.h"
+#include "mongo/bsonview/byte_size.h"
+#include "mongo/bsonview/doc_renderer.h"
+#include "mongo/bsonview/doc_set.h"
+#include "mongo/bsonview/doc_size_report.h"
+#include "mongo/bsonview/duplicate_finder.h"
+#include "mongo/bsonview/field_profile.h"
+#include "mongo/bsonview/frame_stats.h"
+#include "mongo/bsonview/field_value_index.h"
+#include "mongo/bsonview/loaded_doc_batches.h"
+#include "mongo/bsonview/match_bitmap.h"
+#include "mongo/bsonview/memory_registry.h"
+#include "mongo/bsonview/merge_order.h"
+#include "mongo/bsonview/mql_match_plan.h"
+#include "mongo/bsonview/parallel_aggregation.h"
+#include "mongo/bsonview/random_sample.h"
+#include "mongo/bsonview/render_projection.h"
+#include "mongo/bsonview/search.h"
+#include "mongo/bsonview/sort_permutation.h"
 #include "mongo/db/matcher/matcher.h"
 #include "mongo/db/operation_context_noop.h"
+#include "mongo/db/service_context.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
 #include "mongo/util/assert_util.h"
 #include "mongo/util/errno_util.h"
 #include "mongo/util/quick_exit.h"
+#include "mongo/util/time_support.h"
 
 #include <tickit.h>
 
@@ -60,6 +94,7 @@ using namespace mongo;
 namespace mongo {
 enum ShellExitCode : int {
     kDBException = 1,
+    kReplayRegression = 2,
     kInputFileError = -3,
     kTermError = -4,
     //kMongorcError = -5,
@@ -70,132 +105,26 @@ enum ShellExitCode : int {
 
 void noop() {}
 
-class BSONCache {
-
-public:
-    BSONCache()
-    : _base(nullptr), _end(nullptr), _complete(false)
-    {
-    }
-
-    BSONCache(const char* base, const char* end)
-    : _base(base), _end(end), _complete(false)
-    {
-        _docs.push_back(BSONObj(base));
-    }
-
-    void init(const char* base, const char* end) {
-        _base = base;
-        _end = end;
-        _complete = false;
-        _docs.empty();
-        _docs.push_back(BSONObj(base));
-    }
-
-    const BSONObj& operator[](unsigned long index) {
-        _loadTo(index);
-        return _docs[index];
-    }
-
-    bool isComplete() const {
-        return _complete;
-    }
-
-    unsigned long numDocs() const {
-        return _docs.size();
-    }
-
-    void loadAll(std::function<void(void)> cb = noop) {
-        unsigned long i = 0;
-        while ( ! isComplete()) {
-            _loadNext();
-            if (i % 1000 == 0) {
-                cb();
-            }
-            i++;
-        }
-    }
-
-    // TODO: convert the limit to be a Duration
-    void loadSome(unsigned long maxDocs = 100) {
-        unsigned long i = 0;
-        while ( ! isComplete() && i < maxDocs) {
-            _loadNext();
-            i++;
-        }
-    }
-
-    size_t sizeOfFile() const {
-        return _getEnd() - _getBase();
-    }
-
-    size_t sizeOfFileSeen() const {
-        return _getNextBase() - _getBase();
-    }
-
-    double percOfFileSeen() const {
-        return ((double)sizeOfFileSeen()) / ((double)sizeOfFile()) * 100.0;
-    }
-
-private:
-
-    void _loadTo(unsigned long index) {
-        while (index >= _docs.size()) {
-            _loadNext();
-        }
-    }
-
-    const BSONObj& _getLast() const {
-        return _docs.back();
-    }
-
-    const BSONObj& _getFirst() const {
-        return _docs.front();
-    }
-
-    const char* _getBase() const {
-        return _base;
-    }
-
-    const char* _getEnd() const {
-        return _end;
-    }
-
-    const char* _getNextBase() const {
-        auto last = _getLast();
-        return last.objdata() + last.objsize();
-    }
-
-    void _loadNext() {
-        if ( ! isComplete()) {
-            auto nextBase = _getNextBase();
-            // TODO: catch bson exceptions and don't abort the whole program on them
-            _docs.push_back(BSONObj(nextBase));
-
-            nextBase = _getNextBase();
-            if (nextBase >= _getEnd()) {
-                _complete = true;
-            }
-        }
-    }
-
-    std::vector<BSONObj> _docs;
-    const char* _base;
-    const char* _end;
-    bool _complete;
-};
-
-
 
 const char* infname = nullptr;
+int infd = -1;
+// With several input files (or a directory of them), they're viewed as one, and infname only
+// describes them.
+BSONFileSet inputFiles;
+std::string inputFilesName;
+const char* otherfname = nullptr;  // with --diff
 
 
 Tickit *t = nullptr;
 TickitWindow *root = nullptr;
-TickitWindow *mainwin = nullptr;
 
 bool jumpToEndAfterLoadingComplete;
 
+// Where the time goes in the UI thread.  T shows it over the main window.
+FrameStats frameStats;
+bool showFrameStats = false;
+const char* frameStatsFile = nullptr;  // written on exit, with --frame-stats
+
 
 static bool isKey(TickitKeyEventInfo* ev, char ch) {
     return (ev->type == TICKIT_KEYEV_TEXT && ev->str[0] == ch);
@@ -322,6 +251,10 @@ public:
         }
     }
 
+    void setReturnFocusTo(TickitWindow* returnFocusTo) {
+        _returnFocusTo = returnFocusTo;
+    }
+
     void resize() {
         tickit_window_set_geometry(_win, (TickitRect){ .top = ( (_line >= 0) ? _line : tickit_window_lines(_parent) - _line ), .left = 0, .lines = 1, .cols = tickit_window_cols(_parent) });
     }
@@ -471,101 +404,85 @@ private:
 
 class BSONCacheView;
 
-class Search {
+// A virtual document index containing only the docs that match a search, in file order.  The
+// search's background fill threads evaluate it from the start of the file onwards, and the index
+// is extended (on the UI thread, by update()) over the prefix of the file which they've finished.
+// The view only ever shows the matches found so far, so the UI never has to wait for a scan.
+class FilterIndex {
 public:
-    Search(const std::string& s);
-    virtual ~Search();
-
-    virtual bool matches(unsigned long doc, BSONCacheView& view) const = 0;
-
-    virtual bool isValid() const = 0;
+    // Takes ownership of the search.
+    FilterIndex(Search* search, BSONCache* cache);
+    ~FilterIndex();
 
-protected:
-    const std::string& getText() const;
+    // Starts the background evaluation of the search.
+    void start(const BSONCacheView& view);
 
-private:
-    std::string _text;
-};
+    // Stops the background evaluation, and forgets all the docs found so far.
+    void reset();
 
+    // Returns true if more matching docs have been found (or the filter has become complete).
+    bool update();
 
-class SearchRenderedText : public Search {
-public:
-    SearchRenderedText(const std::string& s);
-    virtual ~SearchRenderedText();
+    unsigned long numDocs() const {
+        return _docs.size();
+    }
 
-    virtual bool matches(unsigned long doc, BSONCacheView& view) const;
+    bool isComplete() const {
+        return _complete;
+    }
 
-    virtual bool isValid() const;
+    unsigned long sourceDoc(unsigned long doc) const {
+        return _docs[doc];
+    }
 
-};
+    // The index of the first doc in the filter which is at or after sourceDoc.
+    unsigned long lowerBound(unsigned long sourceDoc) const {
+        return std::lower_bound(_docs.begin(), _docs.end(), sourceDoc) - _docs.begin();
+    }
 
+    bool contains(unsigned long sourceDoc) const {
+        return std::binary_search(_docs.begin(), _docs.end(), sourceDoc);
+    }
 
-class SearchMQL : public Search {
-public:
-    SearchMQL(const std::string& s);
-    virtual ~SearchMQL();
+    // How many docs of the file have been checked against the filter so far.
+    unsigned long numSourceDocsScanned() const {
+        return _scanned;
+    }
 
-    virtual bool matches(unsigned long doc, BSONCacheView& view) const;
+    const Search& getSearch() const {
+        return *_search;
+    }
 
-    virtual bool isValid() const;
+    // The docs found so far, and the search's match bitmap.
+    size_t memoryUsage() const {
+        return _docs.capacity() * sizeof(unsigned long) + _search->memoryUsage();
+    }
 
 private:
-    BSONObj _pattern;
-    static const boost::intrusive_ptr<ExpressionContext> _expCtx;
-    Matcher* _matcher;
-    bool _valid;
+    Search* _search;
+    BSONCache* _cache;
+    std::vector<unsigned long> _docs;  // source doc numbers, in order
+    unsigned long _scanned = 0;  // source docs [0, _scanned) have been checked
+    bool _complete = false;
 };
 
-const boost::intrusive_ptr<ExpressionContext> SearchMQL::_expCtx = new ExpressionContext(nullptr, nullptr);
-
-
-
-std::string textLogs(const BSONObj& doc) {
-    // TODO: this code is foul
-    StringBuilder sb;
-    int i = 1;
-    for (auto&& elem : doc) {
-        if (i == 1) {
-            sb << elem.Date().toString();
-        } else if (i == 2) {
-            char c = toupper(elem.String()[0]);
-            sb << " " << c;
-        } else if (i == 3) {
-            sb << " " << elem.String();
-        } else if (i == 4) {
-            sb << " [" << elem.String() << "]";
-        } else if (i == 5) {
-            auto msg = elem.String();
-            while (msg.length() > 0 && msg[msg.length()-1] == '\n') {
-                msg = msg.substr(0, msg.length()-1);
-            }
-            while (msg[0] == '\t') {
-                msg = "        " + msg.substr(1);
-            }
-            sb << " " << msg;
-            break;
-        }
-        i++;
-    }
-    return sb.str();
-}
-
 
 class BSONCacheView {
 public:
 
-    enum DocumentRenderMode {
-        kJSONOneline,
-        kJSONPretty,
-        kToString,
-        kTextLogs,
-    };
-
-
     BSONCacheView(BSONCache* cache = nullptr, std::function<void(void)> redrawFullFn = noop, std::function<void(void)> redrawStatusFn = noop)
     : _cache(cache), _redrawFullFn(redrawFullFn), _redrawStatusFn(redrawStatusFn) {
     }
 
+    ~BSONCacheView() {
+        // stops their background threads, which use the view
+        delete _filter;
+        if (_lastSearch) {
+            _lastSearch->stopBackgroundFill();
+            delete _lastSearch;
+        }
+    }
+
     void init(BSONCache* cache = nullptr, std::function<void(void)> redrawFullFn = noop, std::function<void(void)> redrawStatusFn = noop)
     {
         _cache = cache;
@@ -577,6 +494,10 @@ public:
         return *_cache;
     }
 
+    const BSONCache& cache() const {
+        return *_cache;
+    }
+
     void moveLeft() {
         if (_startCol > 0) {
             _startCol--;
@@ -624,6 +545,9 @@ public:
         if (target > _lastDisplayedLine) {
             target = _lastDisplayedLine;
         }
+        if (target < 0) {
+            target = 0;
+        }
         if (_cursorLine != target) {
             _cursorLine = target;
             computeVisible();
@@ -636,6 +560,9 @@ public:
         if (target > _lastDisplayedLine) {
             target = _lastDisplayedLine;
         }
+        if (target < 0) {
+            target = 0;
+        }
         if (_cursorLine != target) {
             _cursorLine = target;
             computeVisible();
@@ -651,12 +578,16 @@ public:
         }
     }
 
-    void moveCursorUp() {
-        // push on the top of the screen to scroll up (if possible)
-        if (_cursorLine == 0) {
-            moveUp();
+    void moveCursorUp(int n = 1) {
+        // move the cursor as far as the top of the screen, then push on it to scroll up the rest
+        // of the way (if possible)
+        const int onScreen = std::min(n, _cursorLine);
+        _cursorLine -= onScreen;
+        if (onScreen < n) {
+            _scrollLines(onScreen - n);
         }
-        cursorUp();
+        computeVisible();
+        redrawFull();
     }
 
     void cursorDown() {
@@ -667,16 +598,52 @@ public:
         }
     }
 
-    void moveCursorDown() {
-        // push on the bottom of the screen to scroll up (if possible)
-        if (_cursorLine == _mainLines - 1) {
-            moveDown();
+    void moveCursorDown(int n = 1) {
+        // move the cursor as far as the bottom of the screen, then push on it to scroll down the
+        // rest of the way (if possible)
+        const int bottom = std::min(_mainLines - 1, _lastDisplayedLine);
+        const int onScreen = std::min(n, std::max(0, bottom - _cursorLine));
+        _cursorLine += onScreen;
+        if (onScreen < n && _cursorLine == _mainLines - 1) {
+            _scrollLines(n - onScreen);
+            computeVisible();
+            // scrolling can bring the end of the file up off the bottom of the screen
+            _clampCursorLine();
+        } else {
+            computeVisible();
+        }
+        redrawFull();
+    }
+
+    // The number of docs in the view, which (with a filter) can be less than in the file.
+    unsigned long numDocs() const {
+        if (_order) {
+            return _order->numDocs();
+        }
+        return _filter ? _filter->numDocs() : cache().numDocs();
+    }
+
+    bool isComplete() const {
+        if (_order) {
+            return true;
+        }
+        return _filter ? _filter->isComplete() : cache().isComplete();
+    }
+
+    // Translates a doc number of the view into a doc number of the file.
+    unsigned long sourceDoc(unsigned long doc) const {
+        if (_order) {
+            return _order->sourceDoc(doc);
         }
-        cursorDown();
+        return _filter ? _filter->sourceDoc(doc) : doc;
+    }
+
+    const BSONObj& getDoc(unsigned long doc) {
+        return cache()[sourceDoc(doc)];
     }
 
     bool nextDoc() {
-        if (!cache().isComplete() || _startDoc < cache().numDocs() - 1) {
+        if (_isDocAvailable(_startDoc + 1)) {
             _startDoc++;
             _startLine = 0;
             return true;
@@ -707,36 +674,22 @@ public:
         }
     }
 
-    void moveDown() {
-        computeVisible();
-        if (_startLine == _docLines[0] - 1) {
-            if (nextDoc()) {
-                _startLine = 0;
-                computeVisible();
-                cursorUp();
-                redrawFull();
-            }
-        } else {
-            _startLine++;
+    // Scrolls the view, keeping the cursor on the same content where it can.
+    void moveDown(int n = 1) {
+        const int scrolled = _scrollLines(n);
+        if (scrolled) {
+            _cursorLine = std::max(0, _cursorLine - scrolled);
             computeVisible();
-            cursorUp();
             redrawFull();
         }
     }
 
-    void moveUp() {
-        computeVisible();
-        if (_startLine == 0) {
-            if (prevDoc()) {
-                _startLine = _docLines[0] - 1;
-                computeVisible();
-                cursorDown();
-                redrawFull();
-            }
-        } else {
-            _startLine--;
+    void moveUp(int n = 1) {
+        const int scrolled = -_scrollLines(-n);
+        if (scrolled) {
+            _cursorLine = std::min(_cursorLine + scrolled, _mainLines - 1);
             computeVisible();
-            cursorDown();
+            _clampCursorLine();
             redrawFull();
         }
     }
@@ -752,14 +705,14 @@ public:
     }
 
     void jumpDown() {
-        if ( ! cache().isComplete()) {
+        if ( ! isComplete()) {
             // TODO: indicate to the user that there might be a delay?
             jumpToEndAfterLoadingComplete = true;
-        } else {
-            unsigned long targetStartDoc = cache().numDocs() - 1;
+        } else if (numDocs() > 0) {
+            unsigned long targetStartDoc = numDocs() - 1;
             _startDoc = targetStartDoc;
             computeVisible();
-            while (_lastDisplayedLine < _mainLines - 2) {
+            while (_lastDisplayedLine < _mainLines - 2 && _startDoc > 0) {
                 _startDoc--;
                 computeVisible();
             }
@@ -769,6 +722,8 @@ public:
             redrawFull();
             cursorBottom();
 
+            jumpToEndAfterLoadingComplete = false;
+        } else {
             jumpToEndAfterLoadingComplete = false;
         }
     }
@@ -822,7 +777,7 @@ public:
             _startLine = _docLines.back() - (getTotalDocLines() - _startLine - _mainLines);
             cursorTop();
             computeVisible();
-            if (_lastDisplayedDoc == cache().numDocs() - 1) {
+            if (_lastDisplayedDoc + 1 == numDocs()) {
                 int emptyLines = _mainLines - 1 - _lastDisplayedLine;
                 jumpDown();
                 _cursorLine = emptyLines;
@@ -837,26 +792,30 @@ public:
     }
 
 
-    void setDocumentRenderMode(DocumentRenderMode documentRenderMode) {
-        _documentRenderMode = documentRenderMode;
+    void setDocumentRenderMode(DocRenderer::DocumentRenderMode documentRenderMode) {
+        _renderingChangeStart();
+        _renderer.setDocumentRenderMode(documentRenderMode);
+        _renderingChangeEnd();
         _startCol = 0;
         // TODO: take some care to keep the cursor on the same doc, if possible / at all costs.
         computeVisible();
         redrawFull();
     }
 
-    DocumentRenderMode getDocumentRenderMode() {
-        return _documentRenderMode;
+    DocRenderer::DocumentRenderMode getDocumentRenderMode() {
+        return _renderer.getDocumentRenderMode();
     }
 
     void setExtendedJSONMode(JsonStringFormat extendedJSONMode) {
-        _extendedJSONMode = extendedJSONMode;
+        _renderingChangeStart();
+        _renderer.setExtendedJSONMode(extendedJSONMode);
+        _renderingChangeEnd();
         computeVisible();
         redrawFull();
     }
 
     JsonStringFormat getExtendedJSONMode() {
-        return _extendedJSONMode;
+        return _renderer.getExtendedJSONMode();
     }
 
     void toggleExtendedJSONMode() {
@@ -867,14 +826,35 @@ public:
         }
     }
 
+    // Only the projected fields are rendered (and so searched), or the whole doc if projection is
+    // null.
+    void setProjection(std::unique_ptr<RenderProjection> projection) {
+        _renderingChangeStart();
+        _renderer.setProjection(std::move(projection));
+        _renderingChangeEnd();
+        _startCol = 0;
+        computeVisible();
+        redrawFull();
+    }
+
+    const RenderProjection* getProjection() const {
+        return _renderer.getProjection();
+    }
+
+    // Also used by the view's searches, so that text searches find what's on the screen.
+    const DocRenderer& getRenderer() const {
+        return _renderer;
+    }
+
     std::string renderDoc(unsigned long doc) {
-        switch (_documentRenderMode) {
-            case kJSONOneline: return cache()[doc].jsonString(_extendedJSONMode);
-            case kJSONPretty:  return cache()[doc].jsonString(_extendedJSONMode, 1);
-            case kToString:    return cache()[doc].toString();
-            case kTextLogs:    return textLogs(cache()[doc]);
-        }
-        return "--- unknown render mode ---";
+        FrameStats::Timer timer(&frameStats, FrameStats::kRenderDoc);
+        frameStats.docRendered();
+        return renderDoc(getDoc(doc));
+    }
+
+    // Safe to call from background threads (the render mode is only changed while they're stopped).
+    std::string renderDoc(const BSONObj& obj) const {
+        return _renderer.render(obj);
     }
 
 
@@ -891,17 +871,18 @@ public:
 
 
     void drawStatusBar(TickitRenderBuffer* rb) {
-        tickit_renderbuffer_textf_at(rb, 0, 0, "%s [doc %ld] [docs %ld-%ld/%ld%s%s] [loaded %.0lf%% %.0lf/%.0lf MiB]", infname, _cursorDoc, _startDoc, _lastDisplayedDoc, cache().numDocs(), cache().isComplete() ? "" : "+", cache().isComplete() && _lastDisplayedDoc == cache().numDocs() - 1 ? " (END)" : "", cache().percOfFileSeen(), cache().sizeOfFileSeen()/1048576.0, cache().sizeOfFile()/1048576.0);
+        tickit_renderbuffer_textf_at(rb, 0, 0, "%s [doc %ld] [docs %ld-%ld/%ld%s%s] [loaded %.0lf%% %.0lf/%.0lf MiB]", infname, _cursorDoc, _startDoc, _lastDisplayedDoc, numDocs(), isComplete() ? "" : "+", isComplete() && _lastDisplayedDoc + 1 == numDocs() ? " (END)" : "", cache().percOfFileSeen(), cache().sizeOfFileSeen()/1048576.0, cache().sizeOfFile()/1048576.0);
     }
 
 
     void computeVisible() {
+        FrameStats::Timer timer(&frameStats, FrameStats::kComputeVisible);
         int line = 0;
         int longestLine = 0;
         unsigned long doc = _startDoc;
         _docLines.clear();
         int skipLines = _startLine;
-        while (line < _mainLines && (!cache().isComplete() || doc < cache().numDocs()) ) {
+        while (line < _mainLines && _isDocAvailable(doc)) {
 
             std::string str = renderDoc(doc);
 
@@ -955,19 +936,28 @@ public:
         //    _lastDisplayedLine--; // bleh there are better ways to fix this (like understanding the problem properly), but this band-aid will do for now
         //}
         _longestLineStartCol = longestLine - _mainCols;
+
+        if (_lastSearch && _isDocAvailable(_startDoc)) {
+            _lastSearch->setFillFocus(sourceDoc(_startDoc));
+        }
     }
 
 
     void drawMainLines(TickitRenderBuffer* rb) {
+        FrameStats::Timer timer(&frameStats, FrameStats::kDrawMainLines);
         int line = 0;
         unsigned long doc = _startDoc;
         int skipLines = _startLine;
-        while (line < _mainLines && (!cache().isComplete() || doc < cache().numDocs()) ) {
+        while (line < _mainLines && _isDocAvailable(doc)) {
 
             std::string str = renderDoc(doc);
 
             auto lastSearch = getLastSearch();
-            bool docMatch = lastSearch ? (*lastSearch)->matches(doc, *this) : false;
+            bool docMatch = false;
+            if (lastSearch) {
+                FrameStats::Timer timer(&frameStats, FrameStats::kSearchMatches);
+                docMatch = (*lastSearch)->matches(sourceDoc(doc), cache(), _renderer);
+            }
 
             const char* ss = str.c_str();
 
@@ -1050,7 +1040,7 @@ public:
                 return *_dragMarked;
             }
         }
-        return _markedDocs.find(doc) != _markedDocs.end();
+        return _markedDocs.contains(sourceDoc(doc));
     }
 
     void dragStart(unsigned long doc) {
@@ -1072,11 +1062,31 @@ public:
             // upwards drag
             std::swap(_dragFirst, _dragLast);
         }
-        for (unsigned long doc = _dragFirst; doc <= _dragLast; doc++) {
+        if ( ! _filter && ! _order) {
+            // the docs are the source docs, so it's a single range
             if (*_dragMarked) {
-                markDoc(doc);
+                _markedDocs.addRange(_dragFirst, _dragLast + 1);
             } else {
-                unmarkDoc(doc);
+                _markedDocs.removeRange(_dragFirst, _dragLast + 1);
+            }
+        } else {
+            // in batches, which have to be in file order
+            const unsigned long kBatchSize = 65536;
+            std::vector<unsigned long> docs;
+            for (unsigned long begin = _dragFirst; begin <= _dragLast; begin += kBatchSize) {
+                const unsigned long end = std::min(_dragLast + 1, begin + kBatchSize);
+                docs.clear();
+                for (unsigned long doc = begin; doc < end; doc++) {
+                    docs.push_back(sourceDoc(doc));
+                }
+                if (_order) {
+                    std::sort(docs.begin(), docs.end());
+                }
+                if (*_dragMarked) {
+                    _markedDocs.addSorted(docs);
+                } else {
+                    _markedDocs.removeSorted(docs);
+                }
             }
         }
 
@@ -1106,12 +1116,23 @@ public:
         }
     }
 
+    // Marks are kept by the doc number in the file, so that they survive filtering.
     void markDoc(unsigned long doc) {
-        _markedDocs.insert(doc);
+        _markedDocs.add(sourceDoc(doc));
     }
 
     void unmarkDoc(unsigned long doc) {
-        _markedDocs.erase(doc);
+        _markedDocs.remove(sourceDoc(doc));
+    }
+
+    // The marked docs, by their number in the file.
+    const DocSet& getMarkedSourceDocs() const {
+        return _markedDocs;
+    }
+
+    // Marks docs by their number in the file, which must be in order.
+    void markSourceDocs(const std::vector<unsigned long>& docs) {
+        _markedDocs.addSorted(docs);
     }
 
     void toggleMarkDoc(unsigned long doc) {
@@ -1123,45 +1144,68 @@ public:
     }
 
     boost::optional<unsigned long> nextMarkedDoc(unsigned long doc) const {
-        if (_markedDocs.size() == 0) {
-            return boost::none;
-        }
-        const auto next = _markedDocs.upper_bound(doc);
-        if (next != _markedDocs.end()) {
-            return *next;
-        } else {
-            // wrap to front
-            return *_markedDocs.begin();
+        unsigned long from = _isDocAvailable(doc) ? sourceDoc(doc) : 0;
+        // skip over any marked docs that are hidden by the filter, but only go around once
+        for (size_t i = 0; i < _markedDocs.size(); i++) {
+            auto next = _nextMarkedSourceDoc(from);
+            if ( ! next) {
+                return boost::none;
+            }
+            auto target = _viewDoc(*next);
+            if (target) {
+                return target;
+            }
+            from = *next;
         }
+        return boost::none;
     }
 
     boost::optional<unsigned long> prevMarkedDoc(unsigned long doc) const {
-        if (_markedDocs.size() == 0) {
-            return boost::none;
-        }
-        auto nextOrThis = _markedDocs.lower_bound(doc);  // this will return the next one (or this one).  but we want the one before.
-        if (nextOrThis == _markedDocs.begin()) {
-            // wrap to back
-            return *_markedDocs.rbegin();
-        } else {
-            return *(--nextOrThis);
+        unsigned long from = _isDocAvailable(doc) ? sourceDoc(doc) : 0;
+        for (size_t i = 0; i < _markedDocs.size(); i++) {
+            auto prev = _prevMarkedSourceDoc(from);
+            if ( ! prev) {
+                return boost::none;
+            }
+            auto target = _viewDoc(*prev);
+            if (target) {
+                return target;
+            }
+            from = *prev;
         }
+        return boost::none;
     }
 
 
     void markCursorDoc() {
-        markDoc(_cursorDoc);
-        redrawFull();
+        if (_isDocAvailable(_cursorDoc)) {
+            markDoc(_cursorDoc);
+            redrawFull();
+        }
     }
 
     void unmarkCursorDoc() {
-        unmarkDoc(_cursorDoc);
-        redrawFull();
+        if (_isDocAvailable(_cursorDoc)) {
+            unmarkDoc(_cursorDoc);
+            redrawFull();
+        }
     }
 
     void toggleMarkCursorDoc() {
-        toggleMarkDoc(_cursorDoc);
-        redrawFull();
+        if (_isDocAvailable(_cursorDoc)) {
+            toggleMarkDoc(_cursorDoc);
+            redrawFull();
+        }
+    }
+
+    // Returns false (without moving) if the doc is hidden by the filter.
+    bool jumpToSourceDoc(unsigned long sourceDoc) {
+        auto doc = _viewDoc(sourceDoc);
+        if ( ! doc) {
+            return false;
+        }
+        jumpToDoc(*doc);
+        return true;
     }
 
     void jumpToDoc(unsigned long doc) {
@@ -1239,9 +1283,15 @@ public:
 
 
     boost::optional<unsigned long> searchFor(const Search* s) {
-        for (unsigned long curr = _cursorDoc + 1; curr < cache().numDocs(); curr++) {
-            if (s->matches(curr, *this)) {
-                return curr;
+        FrameStats::Timer timer(&frameStats, FrameStats::kSearchMatches);
+        if ( ! _filter && ! _order) {
+            // an index can find matches beyond what's been loaded so far (which are loaded on demand)
+            unsigned long end = s->getCandidates() ? std::numeric_limits<unsigned long>::max() : cache().numDocs();
+            return s->findNext(_cursorDoc + 1, end, cache(), _renderer);
+        }
+        for (unsigned long doc = _cursorDoc + 1; doc < numDocs(); doc++) {
+            if (s->matches(sourceDoc(doc), cache(), _renderer)) {
+                return doc;
             }
         }
         return boost::none;
@@ -1249,9 +1299,52 @@ public:
 
     void registerSearch(Search* s) {
         if (_lastSearch) {
+            _lastSearch->stopBackgroundFill();
             delete _lastSearch;
         }
         _lastSearch = s;
+        _lastSearchEvicted = false;
+        if (_lastSearch && _lastSearch->isValid()) {
+            _lastSearch->setFillFocus(_startDoc);
+            _lastSearch->startBackgroundFill(cache(), _renderer);
+        }
+    }
+
+    size_t marksMemoryUsage() const {
+        return _markedDocs.memoryUsage();
+    }
+
+    size_t lastSearchMemoryUsage() const {
+        return _lastSearch ? _lastSearch->memoryUsage() : 0;
+    }
+
+    size_t filterMemoryUsage() const {
+        return _filter ? _filter->memoryUsage() : 0;
+    }
+
+    // Throws away what's known about the last search's matches (but not the filter's, which the
+    // view is made of).  Matches are still highlighted and found with n, by evaluating the docs
+    // again as they're needed.  The background fill isn't started again until something needs
+    // all the matches (see resumeLastSearchFill), since it would only fill the bitmap back up.
+    // Returns the bytes freed.
+    size_t evictLastSearchMatches() {
+        if ( ! _lastSearch) {
+            return 0;
+        }
+        const size_t before = _lastSearch->memoryUsage();
+        _lastSearch->resetMatches();
+        _lastSearchEvicted = true;
+        const size_t after = _lastSearch->memoryUsage();
+        return before > after ? before - after : 0;
+    }
+
+    // Starts the last search's background fill again, if its matches were evicted.
+    void resumeLastSearchFill() {
+        if (_lastSearchEvicted && _lastSearch && _lastSearch->isValid()) {
+            _lastSearch->setFillFocus(_startDoc);
+            _lastSearch->startBackgroundFill(cache(), _renderer);
+        }
+        _lastSearchEvicted = false;
     }
 
     boost::optional<const Search*> getLastSearch() const {
@@ -1262,10 +1355,93 @@ public:
         }
     }
 
+    // Only shows the docs which match the search (or all the docs again, if s is null).  Takes
+    // ownership of the search.
+    void setFilter(Search* s) {
+        boost::optional<unsigned long> cursorSourceDoc;
+        if (_isDocAvailable(_cursorDoc)) {
+            cursorSourceDoc = sourceDoc(_cursorDoc);
+        }
+        _dragMarked = boost::none;
+
+        if (_filter) {
+            delete _filter;
+            _filter = nullptr;
+        }
+        if (s) {
+            _filter = new FilterIndex(s, _cache);
+            _filter->start(*this);
+            _filter->update();
+        }
+
+        _startDoc = 0;
+        _startLine = 0;
+        _cursorLine = 0;
+        _startCol = 0;
+        computeVisible();
+        if ( ! _filter && cursorSourceDoc) {
+            // go back to where we were in the whole file
+            jumpToDoc(*cursorSourceDoc);
+        } else {
+            redrawFull();
+        }
+    }
+
+    const FilterIndex* getFilter() const {
+        return _filter;
+    }
+
+    // Shows the docs in the given order (eg. of a finished sort) instead of in file order, or in
+    // file order again if order is null.  Doesn't take ownership.  Can't be combined with a filter.
+    void setOrder(const DocOrder* order) {
+        invariant( ! _filter);
+        boost::optional<unsigned long> cursorSourceDoc;
+        if (_isDocAvailable(_cursorDoc)) {
+            cursorSourceDoc = sourceDoc(_cursorDoc);
+        }
+        _dragMarked = boost::none;
+
+        _order = order;
+
+        _startDoc = 0;
+        _startLine = 0;
+        _cursorLine = 0;
+        _startCol = 0;
+        computeVisible();
+        // stay on the same doc, wherever it is now
+        if ( ! cursorSourceDoc || ! jumpToSourceDoc(*cursorSourceDoc)) {
+            redrawFull();
+        }
+    }
+
+    const DocOrder* getOrder() const {
+        return _order;
+    }
+
+    // Called periodically to pick up newly found matches of the filter.
+    void updateFilter() {
+        if (_filter && _filter->update()) {
+            if (_lastDisplayedLine < _mainLines - 1) {
+                // the new docs might be visible
+                computeVisible();
+                redrawFull();
+            } else {
+                redrawStatus();
+            }
+        }
+    }
+
     unsigned long getCursorDoc() {
         return _cursorDoc;
     }
 
+    boost::optional<unsigned long> getCursorSourceDoc() const {
+        if (_isDocAvailable(_cursorDoc)) {
+            return sourceDoc(_cursorDoc);
+        }
+        return boost::none;
+    }
+
     unsigned long getStartDoc() {
         return _startDoc;
     }
@@ -1285,22 +1461,163 @@ public:
 
 private:
 
-    void _jumpToDocOffscreen(unsigned long doc, boost::optional<int> targetLine = boost::none) {
-        _startDoc = doc;
-        _startLine = 0;
-        _cursorLine = 0;
-
-        if ( ! targetLine) {
-            targetLine = _mainLines / 4;
+    // The background fill threads of a search which depends on rendering must be stopped while
+    // the render mode changes, and its results thrown away.
+    // (Likewise for the filter, which has to start again from scratch.)
+    void _renderingChangeStart() {
+        if (_lastSearch && _lastSearch->dependsOnRendering()) {
+            _lastSearch->resetMatches();
         }
-        if (*targetLine > 0) {
-            for (int i = 0; i < *targetLine; i++) {
-                moveUp();
-            }
-        } else {
-            // happens as part of moveUp(), so need to do it if we don't call moveUp().
-            computeVisible();
+        if (_filter && _filter->getSearch().dependsOnRendering()) {
+            _filter->reset();
+            _startDoc = 0;
+            _startLine = 0;
+            _cursorLine = 0;
         }
+    }
+
+    void _renderingChangeEnd() {
+        if (_lastSearch && _lastSearch->dependsOnRendering() && _lastSearch->isValid()) {
+            _lastSearch->startBackgroundFill(cache(), _renderer);
+            _lastSearchEvicted = false;
+        }
+        if (_filter && _filter->getSearch().dependsOnRendering()) {
+            _filter->start(*this);
+        }
+    }
+
+    // Whether doc can be displayed.  Docs beyond those loaded so far are loaded on demand, but a
+    // filter only ever shows the docs it has found so far.
+    bool _isDocAvailable(unsigned long doc) const {
+        if (_order) {
+            return doc < _order->numDocs();
+        }
+        if (_filter) {
+            return doc < _filter->numDocs();
+        }
+        return !cache().isComplete() || doc < cache().numDocs();
+    }
+
+    // Translates a doc number of the file into a doc number of the view, if it's in the view.
+    boost::optional<unsigned long> _viewDoc(unsigned long sourceDoc) const {
+        if (_order) {
+            if (sourceDoc < _order->numDocs()) {
+                return _order->position(sourceDoc);
+            }
+            return boost::none;
+        }
+        if ( ! _filter) {
+            return sourceDoc;
+        }
+        if (_filter->contains(sourceDoc)) {
+            return _filter->lowerBound(sourceDoc);
+        }
+        return boost::none;
+    }
+
+    boost::optional<unsigned long> _nextMarkedSourceDoc(unsigned long sourceDoc) const {
+        if (_markedDocs.empty()) {
+            return boost::none;
+        }
+        const auto next = _markedDocs.next(sourceDoc + 1);
+        if (next) {
+            return next;
+        } else {
+            // wrap to front
+            return _markedDocs.next(0);
+        }
+    }
+
+    boost::optional<unsigned long> _prevMarkedSourceDoc(unsigned long sourceDoc) const {
+        if (_markedDocs.empty()) {
+            return boost::none;
+        }
+        const auto prev = (sourceDoc > 0) ? _markedDocs.prev(sourceDoc - 1) : boost::none;
+        if (prev) {
+            return prev;
+        } else {
+            // wrap to back
+            return _markedDocs.prev(std::numeric_limits<unsigned long>::max());
+        }
+    }
+
+    int _numDocLines(unsigned long doc) {
+        const std::string str = renderDoc(doc);
+        return 1 + std::count(str.begin(), str.end(), '\n');
+    }
+
+    // Moves _startDoc/_startLine down n lines (up if n is negative), and returns how far they
+    // actually moved (which is less at either end of the view).  The line counts of the docs
+    // from the last computeVisible() are used for as long as they last, so scrolling n lines costs
+    // about one layout of the screen for each screenful, rather than one for every line.
+    int _scrollLines(int n) {
+        int scrolled = 0;
+        if (n > 0) {
+            computeVisible();
+            bool fresh = true;
+            size_t i = 0;  // _docLines[i] is the number of lines in _startDoc
+            while (scrolled < n && ! _docLines.empty()) {
+                if ( ! fresh && i + 1 >= _docLines.size()) {
+                    computeVisible();
+                    fresh = true;
+                    i = 0;
+                    continue;
+                }
+                // the last doc laid out can have been cut off at the bottom of the screen
+                const int docLines = (i + 1 == _docLines.size()) ? _numDocLines(_startDoc) : _docLines[i];
+                if (_startLine >= docLines - 1) {
+                    if ( ! nextDoc()) {
+                        break;
+                    }
+                    i++;
+                    scrolled++;
+                } else {
+                    const int step = std::min(n - scrolled, docLines - 1 - _startLine);
+                    _startLine += step;
+                    scrolled += step;
+                }
+                fresh = false;
+            }
+        } else {
+            while (scrolled < -n) {
+                if (_startLine > 0) {
+                    const int step = std::min(-n - scrolled, _startLine);
+                    _startLine -= step;
+                    scrolled += step;
+                } else if (prevDoc()) {
+                    _startLine = _numDocLines(_startDoc) - 1;
+                    scrolled++;
+                } else {
+                    break;
+                }
+            }
+            scrolled = -scrolled;
+        }
+        return scrolled;
+    }
+
+    // Keeps the cursor on a displayed line, after the end of the file has moved up the screen.
+    void _clampCursorLine() {
+        const int last = std::max(0, _lastDisplayedLine);
+        if (_cursorLine > last) {
+            _cursorLine = last;
+            computeVisible();
+        }
+    }
+
+    void _jumpToDocOffscreen(unsigned long doc, boost::optional<int> targetLine = boost::none) {
+        _startDoc = doc;
+        _startLine = 0;
+        _cursorLine = 0;
+
+        if ( ! targetLine) {
+            targetLine = _mainLines / 4;
+        }
+        if (*targetLine > 0) {
+            moveUp(*targetLine);
+        }
+        // moveUp() only does this if it was able to scroll.
+        computeVisible();
 
         redrawFull();
     }
@@ -1331,7 +1648,7 @@ private:
 
     BSONCache* _cache;
 
-    DocumentRenderMode _documentRenderMode = kJSONOneline;
+    DocRenderer _renderer;
 
     int _startCol = 0;
     int _longestLineStartCol = 0;
@@ -1348,7 +1665,7 @@ private:
     int _mainLines = 0;
     int _mainCols = 0;
 
-    std::set<unsigned long> _markedDocs;
+    DocSet _markedDocs;
 
     boost::optional<bool> _dragMarked = boost::none;
     unsigned long _dragFirst;  // inclusive
@@ -1359,77 +1676,65 @@ private:
 
     // TODO: length-limited list instead
     Search* _lastSearch = nullptr;
+    bool _lastSearchEvicted = false;  // and so its fill is stopped
+
+    FilterIndex* _filter = nullptr;
 
-    JsonStringFormat _extendedJSONMode = Strict;
+    const DocOrder* _order = nullptr;  // not owned
 
     MatchDetails _matchDetails;
 
 };
 
 
-Search::Search(const std::string& s)
-: _text(s)
+FilterIndex::FilterIndex(Search* search, BSONCache* cache)
+: _search(search), _cache(cache)
 {
 }
 
-Search::~Search() {
+FilterIndex::~FilterIndex() {
+    _search->stopBackgroundFill();
+    delete _search;
 }
 
-const std::string& Search::getText() const {
-    return _text;
+void FilterIndex::start(const BSONCacheView& view) {
+    _search->setFillFocus(_scanned);
+    _search->startBackgroundFill(view.cache(), view.getRenderer());
 }
 
-
-SearchRenderedText::SearchRenderedText(const std::string& s)
-: Search(s)
-{
-}
-
-SearchRenderedText::~SearchRenderedText() {
+void FilterIndex::reset() {
+    _search->resetMatches();
+    _docs.clear();
+    _scanned = 0;
+    _complete = false;
 }
 
-bool SearchRenderedText::matches(unsigned long doc, BSONCacheView& view) const {
-    if ( ! isValid()) {
+bool FilterIndex::update() {
+    if (_complete) {
         return false;
     }
-    // TODO: ergh this is so horribly slow
-    return (view.renderDoc(doc).find(getText()) != std::string::npos);
-}
-
-bool SearchRenderedText::isValid() const {
-    return (getText() != "");
-}
-
 
-SearchMQL::SearchMQL(const std::string& s)
-: Search(s), _valid(false)
-{
-    try {
-        _pattern = fromjson(s);
-        //OperationContext* opCtx = new OperationContextNoop();
-        //boost::intrusive_ptr<ExpressionContext> expCtx(new ExpressionContext(opCtx, nullptr));
-        _matcher = new Matcher(_pattern, _expCtx);
-        _valid = true;
-    } catch (DBException& e) {
-        // TODO
-        //return Status(BadQuery, "Cannot parse MQL query");
-        // leave _valid as false
+    const MatchBitmap& bitmap = _search->getMatchBitmap();
+    unsigned long numDocs = _cache->numDocs();
+    unsigned long before = _docs.size();
+    while (_scanned < numDocs) {
+        unsigned long chunkEnd = (_scanned / MatchBitmap::kChunkSize + 1) * MatchBitmap::kChunkSize;
+        unsigned long end = std::min(chunkEnd, numDocs);
+        if ( ! bitmap.appendMatches(_scanned, end, &_docs)) {
+            // not evaluated yet
+            break;
+        }
+        _scanned = end;
     }
-}
 
-SearchMQL::~SearchMQL() {
-    delete _matcher;
-}
+    // keep the background threads working just ahead of what's been collected
+    _search->setFillFocus(_scanned);
 
-bool SearchMQL::matches(unsigned long doc, BSONCacheView& view) const {
-    if ( ! isValid()) {
-        return false;
+    if (_cache->isComplete() && _scanned >= numDocs) {
+        _complete = true;
+        return true;
     }
-    return (_matcher->matches(view.cache()[doc], view.getMatchDetails()));
-}
-
-bool SearchMQL::isValid() const {
-    return _valid;
+    return _docs.size() != before;
 }
 
 
@@ -1457,6 +1762,7 @@ public:
     void init(BSONCache* cache, BSONCacheView* view, TickitWindow* parent, int line = -1) {
         _cache = cache;
         _view = view;
+        _name = infname;
         _parent = parent;
         _line = line;
 
@@ -1475,6 +1781,14 @@ public:
         tickit_window_expose(_win, NULL);
     }
 
+    // Shows the status of a different view, which is described by name.
+    void setView(BSONCache* cache, BSONCacheView* view, const std::string& name) {
+        _cache = cache;
+        _view = view;
+        _name = name;
+        expose();
+    }
+
     const Date_t& getLastRenderTime() const {
         return _lastRenderTime;
     }
@@ -1500,13 +1814,40 @@ private:
         tickit_renderbuffer_setpen(rb, _pen);
         tickit_renderbuffer_clear(rb);
 
+        // with a filter, the doc is the number in the file, but the range is of the filtered docs
+        auto cursorDoc = view().getCursorSourceDoc();
+        std::string cursorDocStr = cursorDoc ? std::to_string(*cursorDoc) : "-";
+
+        // with several files, the one the cursor's doc is in
+        std::string fileStr;
+        if (cursorDoc && cache().getFileSet()) {
+            const size_t file = cache().fileOf(*cursorDoc);
+            fileStr = str::stream() << " [file " << file + 1 << "/" << cache().numFiles() << " " << cache().getFileSet()->path(file) << "]";
+        }
+
+        std::string filterStr;
+        if (auto filter = view().getFilter()) {
+            StringBuilder sb;
+            sb << " [filter: " << filter->numDocs() << " matched";
+            if ( ! filter->isComplete()) {
+                sb << ", " << filter->numSourceDocsScanned() << " scanned";
+            }
+            sb << "]";
+            filterStr = sb.str();
+        }
+        if (auto projection = view().getProjection()) {
+            filterStr += " [project: " + projection->getSpec().jsonString() + "]";
+        }
+
         // TODO: elide fields that aren't needed
         tickit_renderbuffer_textf_at(rb, 0, 0,
-            "%s [doc %ld] [docs %ld-%ld/%ld%s%s] [loaded %.0lf%% %.0lf/%.0lf MiB]%s%s%s",
-            infname,
-            view().getCursorDoc(),
-            view().getStartDoc(), view().getLastDisplayedDoc(), cache().numDocs(), cache().isComplete() ? "" : "+", cache().isComplete() && view().getLastDisplayedDoc() == cache().numDocs() - 1 ? " (END)" : "",
+            "%s%s [doc %s] [docs %ld-%ld/%ld%s%s] [loaded %.0lf%% %.0lf/%.0lf MiB]%s%s%s%s",
+            _name.c_str(),
+            fileStr.c_str(),
+            cursorDocStr.c_str(),
+            view().getStartDoc(), view().getLastDisplayedDoc(), view().numDocs(), view().isComplete() ? "" : "+", view().isComplete() && view().getLastDisplayedDoc() + 1 == view().numDocs() ? " (END)" : "",
             cache().percOfFileSeen(), cache().sizeOfFileSeen()/1048576.0, cache().sizeOfFile()/1048576.0,
+            filterStr.c_str(),
             _extra == "" ? "" : " [", _extra.c_str(), _extra == "" ? "" : "]"
             );
 
@@ -1518,6 +1859,7 @@ private:
 
     BSONCache* _cache;
     BSONCacheView* _view;
+    std::string _name;
 
     TickitWindow* _parent;
     TickitWindow* _win = nullptr;
@@ -1531,16 +1873,419 @@ private:
 };
 
 
+// Builds a field value index over the whole file in a background thread (keeping up with the
+// loader), and writes it out as a sidecar next to the file.
+class IndexBuild {
+public:
+    IndexBuild(const BSONCache* cache, const std::string& path, const std::string& dataFile, const FieldValueIndex::FileId& dataFileId)
+    : _cache(cache), _path(path), _dataFile(dataFile), _dataFileId(dataFileId)
+    {
+        _thread = stdx::thread([this] () { _run(); });
+    }
+
+    ~IndexBuild() {
+        _stop.store(true);
+        _thread.join();
+    }
+
+    const std::string& getPath() const {
+        return _path;
+    }
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    unsigned long numDocsIndexed() const {
+        return _numIndexed.load();
+    }
+
+    // Whether the sidecar was written.  Only valid once done.
+    const Status& getStatus() const {
+        return _status;
+    }
+
+private:
+    void _run() {
+        try {
+            FieldValueIndex::Builder builder(_path);
+            // only the one thread, so the batches come in order
+            const BSONCache* cache = _cache;
+            LoadedDocBatches batches(
+                [cache] (unsigned long* numDocs, bool* complete) { cache->getLoadProgress(numDocs, complete); },
+                [cache] (unsigned long begin, unsigned long end, std::vector<BSONObj>* out) { cache->getLoadedDocs(begin, end, out); },
+                MatchBitmap::kChunkSize, &_stop);
+            std::vector<BSONObj> docs;
+            unsigned long doc;
+            while (batches.next(&docs, &doc)) {
+                for (auto&& obj : docs) {
+                    builder.add(doc++, obj);
+                }
+                _numIndexed.store(doc);
+            }
+            _status = builder.write(_dataFile, _dataFileId, batches.numScanned());
+        } catch (DBException& e) {
+            _status = e.toStatus();
+        }
+        _done.store(true);
+    }
+
+    const BSONCache* _cache;
+    std::string _path;
+    std::string _dataFile;
+    FieldValueIndex::FileId _dataFileId;
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+    AtomicWord<unsigned long> _numIndexed{0};
+    Status _status = Status::OK();
+};
+
+
+// An overlay (just above the status line) showing how many docs match the last search in total,
+// and a histogram of how densely they occur through the file (one bar per 1% of the file, if the
+// screen is wide enough).  The counts come from the search's match bitmap, which the background
+// fill threads complete over the whole file, so update() just needs to be polled until it says
+// the count is complete.  A bucket can be selected to jump to its first match.
+class MatchHistogram {
+public:
+    static const int kMaxBuckets = 100;
+    static const int kLines = 3;
+
+    void init(BSONCache* cache, BSONCacheView* view, TickitWindow* parent, TickitWindow* returnFocusTo) {
+        _cache = cache;
+        _view = view;
+        _parent = parent;
+        _returnFocusTo = returnFocusTo;
+
+        _win = tickit_window_new(root, _geometry(), (TickitWindowFlags)(TICKIT_WINDOW_HIDDEN));
+
+        _barPen = mkpen_base();
+        _textPen = mkpen_highlight();
+
+        tickit_window_bind_event(_win, TICKIT_WINDOW_ON_EXPOSE, (TickitBindFlags)0, &_render_cb, this);
+        tickit_window_bind_event(_win, TICKIT_WINDOW_ON_KEY, (TickitBindFlags)0, &_event_key_cb, this);
+    }
+
+    void setView(BSONCache* cache, BSONCacheView* view) {
+        _cache = cache;
+        _view = view;
+    }
+
+    void setReturnFocusTo(TickitWindow* returnFocusTo) {
+        _returnFocusTo = returnFocusTo;
+    }
+
+    // The jump callback is given the range of docs (of the file) in the selected bucket.
+    void enter(std::function<void(unsigned long, unsigned long)> jump_cb, std::function<void(void)> exit_cb) {
+        _jump_cb = jump_cb;
+        _exit_cb = exit_cb;
+        _selected = 0;
+        update();
+
+        tickit_window_raise_to_front(_win);
+        tickit_window_show(_win);
+        tickit_window_take_focus(_win);
+    }
+
+    void exit() {
+        tickit_window_hide(_win);
+        if (_returnFocusTo) {
+            tickit_window_take_focus(_returnFocusTo);
+        }
+        if (_exit_cb) {
+            _exit_cb();
+        }
+    }
+
+    bool isVisible() const {
+        return _win && tickit_window_is_visible(_win);
+    }
+
+    void resize() {
+        tickit_window_set_geometry(_win, _geometry());
+    }
+
+    void expose() {
+        tickit_window_expose(_win, NULL);
+    }
+
+    // Recounts the matches of the last search.  Returns true once the count is final.
+    bool update() {
+        _numBuckets = 0;
+        _counts.clear();
+        _unknown.clear();
+        _total = 0;
+        _totalUnknown = 0;
+        _complete = false;
+
+        auto lastSearch = _view->getLastSearch();
+        if ( ! lastSearch) {
+            return true;
+        }
+        const MatchBitmap& bitmap = (*lastSearch)->getMatchBitmap();
+
+        _numDocs = _cache->numDocs();
+        _numBuckets = std::min<unsigned long>(std::min(kMaxBuckets, tickit_window_cols(_parent)), _numDocs);
+        for (unsigned long i = 0; i < _numBuckets; i++) {
+            unsigned long unknown = 0;
+            _counts.push_back(bitmap.countMatches(_bucketBegin(i), _bucketBegin(i + 1), &unknown));
+            _unknown.push_back(unknown);
+            _total += _counts.back();
+            _totalUnknown += unknown;
+        }
+        if (_selected >= (int)_counts.size()) {
+            _selected = std::max(0, (int)_counts.size() - 1);
+        }
+
+        _complete = _cache->isComplete() && _totalUnknown == 0;
+        return _complete;
+    }
+
+    bool isComplete() const {
+        return _complete;
+    }
+
+    unsigned long getTotal() const {
+        return _total;
+    }
+
+private:
+    TickitRect _geometry() const {
+        return (TickitRect){ .top = std::max(0, tickit_window_lines(_parent) - 1 - kLines), .left = 0, .lines = kLines, .cols = tickit_window_cols(_parent) };
+    }
+
+    unsigned long _bucketBegin(unsigned long bucket) const {
+        return _numDocs * bucket / _numBuckets;
+    }
+
+    static int _render_cb(TickitWindow *win, TickitEventFlags flags, void *_info, void *data) {
+        MatchHistogram* histogram = static_cast<MatchHistogram*>(data);
+        if (histogram) {
+            return histogram->_render(win, flags, _info);
+        }
+        return 1;
+    }
+
+    int _render(TickitWindow *win, TickitEventFlags flags, void *_info) {
+        TickitExposeEventInfo *info = static_cast<TickitExposeEventInfo*>(_info);
+        TickitRenderBuffer *rb = info->rb;
+
+        static const char* const bars[] = { "\u2581", "\u2582", "\u2583", "\u2584", "\u2585", "\u2586", "\u2587", "\u2588" };
+
+        tickit_renderbuffer_setpen(rb, _barPen);
+        tickit_renderbuffer_clear(rb);
+
+        unsigned long max = 0;
+        for (auto count : _counts) {
+            max = std::max(max, count);
+        }
+        for (int i = 0; i < (int)_counts.size(); i++) {
+            if (_counts[i] > 0) {
+                // any matches at all get at least the smallest bar, so they can't be overlooked
+                tickit_renderbuffer_text_at(rb, 0, i, bars[(_counts[i] - 1) * 8 / max]);
+            } else if (_unknown[i] > 0) {
+                tickit_renderbuffer_text_at(rb, 0, i, ".");
+            }
+        }
+
+        tickit_renderbuffer_setpen(rb, _textPen);
+        tickit_renderbuffer_text_at(rb, 1, _selected, "^");
+
+        StringBuilder sb;
+        sb << _total << " matches";
+        if ( ! _complete) {
+            sb << " so far (counting, " << _totalUnknown << " docs left)";
+        }
+        if (_selected < (int)_counts.size()) {
+            sb << " | " << (100 * _selected / _numBuckets) << "%: docs " << _bucketBegin(_selected) << "-" << (_bucketBegin(_selected + 1) - 1) << ": " << _counts[_selected] << " matches";
+        }
+        sb << " | Left/Right select, Enter jump, Esc close";
+        tickit_renderbuffer_text_at(rb, 2, 0, sb.str().c_str());
+
+        return 1;
+    }
+
+    static int _event_key_cb(TickitWindow *win, TickitEventFlags flags, void *_info, void *data) {
+        MatchHistogram* histogram = static_cast<MatchHistogram*>(data);
+        if (histogram) {
+            return histogram->_event_key(win, flags, _info);
+        }
+        return 0;
+    }
+
+    int _event_key(TickitWindow *win, TickitEventFlags flags, void *_info) {
+        TickitKeyEventInfo *info = static_cast<TickitKeyEventInfo*>(_info);
+
+        if ( ! info->str) {
+            return 1;
+        }
+
+        if (isKey(info, 'h') || isKey(info, "Left")) {
+            if (_selected > 0) {
+                _selected--;
+                expose();
+            }
+
+        } else if (isKey(info, 'l') || isKey(info, "Right")) {
+            if (_selected + 1 < (int)_counts.size()) {
+                _selected++;
+                expose();
+            }
+
+        } else if (isKey(info, '^') || isKey(info, '0') || isKey(info, "Home")) {
+            _selected = 0;
+            expose();
+
+        } else if (isKey(info, '$') || isKey(info, "End")) {
+            _selected = std::max(0, (int)_counts.size() - 1);
+            expose();
+
+        } else if (isKey(info, "Enter")) {
+            exit();
+            if (_selected < (int)_counts.size() && _jump_cb) {
+                _jump_cb(_bucketBegin(_selected), _bucketBegin(_selected + 1));
+            }
+
+        } else if (isKey(info, "Escape") || isKey(info, 'q') || isKey(info, '#')) {
+            exit();
+
+        }
+
+        return 1;
+    }
+
+
+    BSONCache* _cache;
+    BSONCacheView* _view;
+
+    TickitWindow* _parent;
+    TickitWindow* _win = nullptr;
+    TickitWindow* _returnFocusTo = nullptr;
+    TickitPen* _barPen;
+    TickitPen* _textPen;
+
+    std::function<void(unsigned long, unsigned long)> _jump_cb;
+    std::function<void(void)> _exit_cb;
+
+    unsigned long _numDocs = 0;
+    unsigned long _numBuckets = 0;
+    std::vector<unsigned long> _counts;  // matches per bucket
+    std::vector<unsigned long> _unknown;  // docs not yet evaluated per bucket
+    unsigned long _total = 0;
+    unsigned long _totalUnknown = 0;
+    bool _complete = false;
+    int _selected = 0;
+
+};
+
+
 
 
 BSONCache cache;
-BSONCacheView view;
+BSONCacheView fileView;
+BSONCacheView* view = &fileView;  // the view being shown
 SingleLinePrompt prompt;
 SingleLineStatus status;
+MatchHistogram histogram;
+
+// The screen can be split into panes (:split stacks them, :vsplit puts them side by side), each
+// with its own window and its own view of the file, so its own cursor, render mode, search,
+// filter and marks.  They all share the one cache (and so the mapping, the offsets of the docs
+// and the field indexes), so another pane only costs what it renders.
+struct Pane {
+    TickitWindow* win = nullptr;
+    BSONCacheView* fileView = nullptr;
+    std::unique_ptr<BSONCacheView> ownFileView;  // every pane but the first, which has fileView
+    // What the pane is showing: its fileView, unless eg. it's showing some results.
+    BSONCacheView* view = nullptr;
+    BSONCache* viewCache = nullptr;
+    std::string viewName;
+};
+std::vector<std::unique_ptr<Pane>> panes;
+Pane* focusedPane = nullptr;  // shows view
+bool panesSideBySide = false;
+const int kMinPaneLines = 3;
+const int kMinPaneCols = 20;
+
+// The focused pane's view of the file.
+BSONCacheView* paneFileView() {
+    return focusedPane ? focusedPane->fileView : &fileView;
+}
 
-
-int _dispatch(Tickit* t, TickitEventFlags flags, void* info, void* user) {
-    std::function<void(void)>* cb = static_cast<std::function<void(void)>*>(user);
+bool isFileView(const BSONCacheView* v) {
+    for (auto&& pane : panes) {
+        if (v == pane->fileView) {
+            return true;
+        }
+    }
+    return v == &fileView;
+}
+
+FieldValueIndex::FileId infileId;
+FieldIndexCatalog fieldIndexes;
+std::unique_ptr<IndexBuild> indexBuild;
+
+// The results of the last aggregation (or profile).  The cache points into the data.
+std::string resultsData;
+std::unique_ptr<BSONCache> resultsCache;
+std::unique_ptr<BSONCacheView> resultsView;
+std::string resultsName;
+
+std::unique_ptr<ParallelAggregation> aggregation;  // while running
+std::string aggregationName;
+
+std::unique_ptr<FieldProfile> fieldProfile;  // while running
+std::string fieldProfileName;
+
+std::unique_ptr<DocSizeReport> docSizeReport;  // while running
+
+std::unique_ptr<RandomSample> randomSample;  // while running
+std::string sampleData;
+std::unique_ptr<BSONCache> sampleCache;
+std::unique_ptr<BSONCacheView> sampleView;
+std::string sampleName;
+
+std::unique_ptr<DuplicateFinder> duplicateFinder;  // while running
+
+std::unique_ptr<BSONExport> bsonExport;  // while running
+std::string bsonExportPath;
+const BSONCache* bsonExportSource = nullptr;
+
+// Like a blocking sort in a query, except that it spills to disk rather than failing.
+const size_t kSortMaxMemoryUsageBytes = 100 * 1024 * 1024;
+
+// With --diff, the file that the main file is compared to, and the differences between them.
+BSONCache otherCache;
+std::unique_ptr<BSONDiff> diff;  // while running
+std::string diffData;
+std::unique_ptr<BSONCache> diffCache;
+std::unique_ptr<BSONCacheView> diffView;
+std::string diffName;
+std::unique_ptr<SortPermutation> sortPermutation;  // while running
+// The file in the order of the last sort.
+std::unique_ptr<SortPermutation> sortedPermutation;
+std::unique_ptr<BSONCacheView> sortedView;
+std::string sortedName;
+// With several files, all of them interleaved in order of a field (:merge).
+std::unique_ptr<MergeOrder> mergeOrder;
+std::unique_ptr<BSONCacheView> mergedView;
+std::string mergedName;
+
+// Where the memory goes (:memory), and the budget (--memory-budget, :budget) that the caches are
+// evicted to fit within.
+MemoryRegistry memoryRegistry;
+std::vector<MemoryRegistry::Registration> memoryRegistrations;
+const int kMemoryBudgetCheckMillis = 1000;
+// While over the budget with nothing left to evict, the checks (which measure the mapped files
+// page by page) are backed off, up to this.
+const int kMaxMemoryBudgetCheckMillis = 32000;
+int memoryBudgetCheckMillis = kMemoryBudgetCheckMillis;
+
+
+int _dispatch(Tickit* t, TickitEventFlags flags, void* info, void* user) {
+    std::function<void(void)>* cb = static_cast<std::function<void(void)>*>(user);
     (*cb)();
     delete cb;
     return 1;
@@ -1553,48 +2298,1366 @@ void defer(std::function<void(void)> cb) {
 }
 
 
-void doSearch() {
+void doSearch() {
+
+    // TODO: better user feedback (updates)
+    status.setExtra("Searching...");
+    defer([&] () {
+        auto lastSearch = view->getLastSearch();
+        if (lastSearch) {
+            if ((*lastSearch)->isValid()) {
+                auto doc = view->searchFor(*lastSearch);
+                if (doc) {
+                    status.setExtra("");
+                    view->jumpToDoc(*doc);
+                } else {
+                    // notify the user
+                    status.setExtra("Pattern not found");
+                }
+            } else {
+                status.setExtra("Invalid search pattern");
+            }
+        } else {
+            // notify the user
+            status.setExtra("No search pattern");
+        }
+    });
+}
+
+
+Search* makeSearch(const std::string& s) {
+    // check the format (mql etc), handle appropriately
+    if (s[0] == '{') {
+        // the indexes only describe the file
+        return new SearchMQL(s, isFileView(view) ? &fieldIndexes : nullptr);
+    } else {
+        return new SearchRenderedText(s);
+    }
+}
+
+
+void submitSearchString(const std::string& s) {
+    Search *search = makeSearch(s);
+
+    // save the search string in history, both for n/N and up/down-arrow in search input
+    view->registerSearch(search);
+
+    doSearch();
+}
+
+
+
+static int update_filter(Tickit *t, TickitEventFlags flags, void *_info, void *data);
+
+bool filterUpdateScheduled = false;
+
+void scheduleFilterUpdate() {
+    if ( ! filterUpdateScheduled) {
+        filterUpdateScheduled = true;
+        tickit_watch_timer_after_msec(t, 100, (TickitBindFlags)0, &update_filter, NULL);
+    }
+}
+
+static int update_filter(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    filterUpdateScheduled = false;
+    // every pane's filter, not just the focused one's
+    std::vector<BSONCacheView*> shown{view};
+    for (auto&& pane : panes) {
+        if (std::find(shown.begin(), shown.end(), pane->view) == shown.end()) {
+            shown.push_back(pane->view);
+        }
+    }
+    for (BSONCacheView* v : shown) {
+        if (v->getFilter()) {
+            v->updateFilter();
+            if (v->getFilter()->isComplete()) {
+                if (jumpToEndAfterLoadingComplete) {
+                    v->jumpDown();
+                }
+            } else {
+                // changing the render mode can restart it, see renderingChanged()
+                scheduleFilterUpdate();
+            }
+        }
+    }
+    return 0;
+}
+
+
+void submitFilterString(const std::string& s) {
+    if (s == "") {
+        // like less, an empty pattern turns off filtering
+        view->setFilter(nullptr);
+        return;
+    }
+
+    if (view->getOrder()) {
+        status.setExtra("Sorted and merged views can't be filtered");
+        return;
+    }
+
+    Search *search = makeSearch(s);
+    if ( ! search->isValid()) {
+        delete search;
+        status.setExtra("Invalid filter pattern");
+        return;
+    }
+
+    view->setFilter(search);
+    scheduleFilterUpdate();
+}
+
+
+static int update_histogram(Tickit *t, TickitEventFlags flags, void *_info, void *data);
+
+bool histogramUpdateScheduled = false;
+
+void scheduleHistogramUpdate() {
+    if ( ! histogramUpdateScheduled) {
+        histogramUpdateScheduled = true;
+        tickit_watch_timer_after_msec(t, 100, (TickitBindFlags)0, &update_histogram, NULL);
+    }
+}
+
+static int update_histogram(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    histogramUpdateScheduled = false;
+    if (histogram.isVisible()) {
+        // only complete once the file is loaded, too
+        if ( ! histogram.update()) {
+            scheduleHistogramUpdate();
+        }
+        histogram.expose();
+    }
+    return 0;
+}
+
+
+// After the focused view's render mode changes, which can restart its filter and search.
+void renderingChanged() {
+    if (view->getFilter()) {
+        scheduleFilterUpdate();
+    }
+    if (histogram.isVisible()) {
+        scheduleHistogramUpdate();
+    }
+}
+
+
+void jumpToFirstMatch(unsigned long begin, unsigned long end) {
+    auto lastSearch = view->getLastSearch();
+    if ( ! lastSearch) {
+        return;
+    }
+    auto doc = (*lastSearch)->findNext(begin, end, view->cache(), view->getRenderer());
+    if ( ! doc) {
+        status.setExtra("No matches there");
+    } else if ( ! view->jumpToSourceDoc(*doc)) {
+        status.setExtra("Match is hidden by the filter");
+    }
+}
+
+
+void countMatches() {
+    auto lastSearch = view->getLastSearch();
+    if ( ! lastSearch) {
+        status.setExtra("No search pattern");
+        return;
+    }
+    if ( ! (*lastSearch)->isValid()) {
+        status.setExtra("Invalid search pattern");
+        return;
+    }
+    // the counts come from the match bitmap, so it has to fill up again if it was evicted
+    view->resumeLastSearchFill();
+
+    histogram.enter(jumpToFirstMatch, [] () {
+        if (histogram.isComplete()) {
+            status.setExtra(std::to_string(histogram.getTotal()) + " matches");
+        }
+    });
+    scheduleHistogramUpdate();
+}
+
+
+// How often the status bar shows the progress of a background job.
+const int kJobUpdateMillis = 200;
+
+// Calls update after a while, to show a background job's progress (and then reschedule itself)
+// or, once the job is done, its results.
+void scheduleJobUpdate(TickitCallbackFn* update) {
+    tickit_watch_timer_after_msec(t, kJobUpdateMillis, (TickitBindFlags)0, update, NULL);
+}
+
+// The threads for a background job, leaving a core for the UI thread (and the loader).
+unsigned numJobThreads() {
+    unsigned cores = stdx::thread::hardware_concurrency();
+    return (cores > 1) ? cores - 1 : 1;
+}
+
+
+static int update_index_build(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    if ( ! indexBuild) {
+        return 0;
+    }
+    if ( ! indexBuild->isDone()) {
+        status.setExtra(str::stream() << "Indexing " << indexBuild->getPath() << ": " << indexBuild->numDocsIndexed() << " docs");
+        scheduleJobUpdate(&update_index_build);
+        return 0;
+    }
+
+    Status result = indexBuild->getStatus();
+    if (result.isOK()) {
+        auto index = FieldValueIndex::open(FieldValueIndex::sidecarFilename(infname, indexBuild->getPath()), infileId);
+        if (index.isOK()) {
+            fieldIndexes.add(std::move(index.getValue()));
+        }
+        result = index.getStatus();
+    }
+    if (result.isOK()) {
+        // searches made before now don't use it
+        status.setExtra("Indexed " + indexBuild->getPath());
+    } else {
+        status.setExtra("Indexing " + indexBuild->getPath() + " failed: " + result.reason());
+    }
+    indexBuild.reset();
+    return 0;
+}
+
+
+void submitIndexPath(const std::string& s) {
+    if (s == "") {
+        return;
+    }
+    if ( ! FieldValueIndex::isValidPath(s)) {
+        status.setExtra("Invalid field path");
+        return;
+    }
+    if (indexBuild) {
+        status.setExtra("Already indexing " + indexBuild->getPath());
+        return;
+    }
+    if (cache.getFileSet()) {
+        // an index is kept beside the file it's of
+        status.setExtra("Indexes are only built for a single file");
+        return;
+    }
+    indexBuild.reset(new IndexBuild(&cache, s, infname, infileId));
+    scheduleJobUpdate(&update_index_build);
+}
+
+
+void showView(BSONCache* c, BSONCacheView* v, const std::string& name) {
+    view = v;
+    if (focusedPane) {
+        focusedPane->view = v;
+        focusedPane->viewCache = c;
+        focusedPane->viewName = name;
+    }
+    status.setView(c, v, name);
+    histogram.setView(c, v);
+    if (view->getFilter()) {
+        scheduleFilterUpdate();
+    }
+    tickit_window_expose(root, NULL);
+}
+
+// Switches the focused pane back to the file, if it's showing something else.
+void showFileView() {
+    if (view != paneFileView()) {
+        showView(&cache, paneFileView(), infname);
+    }
+}
+
+// Switches any pane showing v back to the file, before v is destroyed.
+void unshowView(const BSONCacheView* v) {
+    for (auto&& pane : panes) {
+        if (pane->view != v || v == pane->fileView) {
+            continue;
+        }
+        if (pane.get() == focusedPane) {
+            showView(&cache, pane->fileView, infname);
+        } else {
+            pane->view = pane->fileView;
+            pane->viewCache = &cache;
+            pane->viewName = infname;
+            tickit_window_expose(pane->win, NULL);
+        }
+    }
+}
+
+
+// Shows the result docs in their own view, as if they were a file.
+void showResults(std::string data, const std::string& name) {
+    // an export of the old results has to finish first (they're in memory, so it won't be long)
+    while (bsonExport && bsonExportSource == resultsCache.get() && ! bsonExport->isDone()) {
+        sleepmillis(10);
+    }
+    showFileView();
+    unshowView(resultsView.get());
+    resultsView.reset();
+    resultsCache.reset();
+    resultsData = std::move(data);
+    resultsName = name;
+    resultsCache.reset(new BSONCache(resultsData.data(), resultsData.data() + resultsData.size()));
+    resultsCache->loadAll();
+    resultsView.reset(new BSONCacheView(resultsCache.get(), [] () { tickit_window_expose(root, NULL); }, [] () { status.expose(); }));
+    showView(resultsCache.get(), resultsView.get(), resultsName);
+}
+
+
+// What :profile and pipelines scan: the sample while it's being viewed, otherwise the file.
+BSONCache* scanSource() {
+    return (sampleView && view == sampleView.get()) ? sampleCache.get() : &cache;
+}
+
+std::string scanSourceName() {
+    return (sampleView && view == sampleView.get()) ? sampleName : std::string(infname);
+}
+
+
+void forEachView(const std::function<void(BSONCacheView&)>& fn) {
+    fn(fileView);
+    for (auto&& pane : panes) {
+        if (pane->ownFileView) {
+            fn(*pane->ownFileView);
+        }
+    }
+    for (BSONCacheView* v : {resultsView.get(), sampleView.get(), diffView.get(), sortedView.get(),
+                             mergedView.get()}) {
+        if (v) {
+            fn(*v);
+        }
+    }
+}
+
+// The mapped input files are usually most of the resident size, but their pages can always be
+// read back in (from the page cache, if they're still there), so they're dropped from the
+// process as a last resort.
+size_t residentBytesOfInputFiles() {
+    size_t bytes = ProcessMemoryStats::residentBytesOf(otherCache.fileBegin(), otherCache.fileEnd());
+    if (cache.getFileSet()) {
+        inputFiles.forEachMapping([&bytes] (const char* begin, const char* end) {
+            bytes += ProcessMemoryStats::residentBytesOf(begin, end);
+        });
+    } else {
+        bytes += ProcessMemoryStats::residentBytesOf(cache.fileBegin(), cache.fileEnd());
+    }
+    return bytes;
+}
+
+size_t evictInputFiles() {
+    const size_t before = residentBytesOfInputFiles();
+    inputFiles.forEachMapping([] (const char* begin, const char* end) {
+        ::madvise(const_cast<char*>(begin), end - begin, MADV_DONTNEED);
+    });
+    for (const BSONCache* c : {&cache, &otherCache}) {
+        if ( ! c->getFileSet() && c->sizeOfFile() > 0) {
+            ::madvise(const_cast<char*>(c->fileBegin()), c->sizeOfFile(), MADV_DONTNEED);
+        }
+    }
+    const size_t after = residentBytesOfInputFiles();
+    return before > after ? before - after : 0;
+}
+
+// In the order they're evicted from, ie. the cheapest to rebuild first.
+void registerMemoryConsumers() {
+    memoryRegistrations.push_back(memoryRegistry.add("search matches",
+        [] () {
+            size_t bytes = 0;
+            forEachView([&bytes] (BSONCacheView& v) { bytes += v.lastSearchMemoryUsage(); });
+            return bytes;
+        },
+        [] () {
+            size_t freed = 0;
+            forEachView([&freed] (BSONCacheView& v) { freed += v.evictLastSearchMatches(); });
+            return freed;
+        }));
+    memoryRegistrations.push_back(memoryRegistry.add("mapped files (resident)",
+        &residentBytesOfInputFiles, &evictInputFiles));
+
+    memoryRegistrations.push_back(memoryRegistry.add("offset tables",
+        [] () {
+            size_t bytes = cache.memoryUsage() + otherCache.memoryUsage() + inputFiles.memoryUsage();
+            for (BSONCache* c : {resultsCache.get(), sampleCache.get(), diffCache.get()}) {
+                if (c) {
+                    bytes += c->memoryUsage();
+                }
+            }
+            if (mergeOrder) {
+                bytes += mergeOrder->memoryUsage();
+            }
+            return bytes;
+        }));
+    memoryRegistrations.push_back(memoryRegistry.add("marks",
+        [] () {
+            size_t bytes = 0;
+            forEachView([&bytes] (BSONCacheView& v) { bytes += v.marksMemoryUsage(); });
+            return bytes;
+        }));
+    memoryRegistrations.push_back(memoryRegistry.add("filters",
+        [] () {
+            size_t bytes = 0;
+            forEachView([&bytes] (BSONCacheView& v) { bytes += v.filterMemoryUsage(); });
+            return bytes;
+        }));
+    memoryRegistrations.push_back(memoryRegistry.add("results",
+        [] () { return resultsData.capacity() + sampleData.capacity() + diffData.capacity(); }));
+}
+
+
+static int update_memory_budget(Tickit *t, TickitEventFlags flags, void *_info, void *data);
+
+void scheduleMemoryBudgetCheck() {
+    tickit_watch_timer_after_msec(t, memoryBudgetCheckMillis, (TickitBindFlags)0, &update_memory_budget, NULL);
+}
+
+// Against the resident size of the whole process, since that's what the rest of the host sees.
+static int update_memory_budget(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    bool overBudget = false;
+    const size_t evicted = memoryRegistry.enforceBudget([&overBudget] () {
+        const size_t resident = ProcessMemoryStats::get().residentBytes;
+        overBudget = resident > memoryRegistry.getBudget();
+        return resident;
+    });
+    if (evicted > 0) {
+        status.setExtra(str::stream() << "Over the memory budget, evicted " << (evicted >> 20) << "MB");
+    }
+    if (overBudget && evicted == 0) {
+        memoryBudgetCheckMillis = std::min(memoryBudgetCheckMillis * 2, kMaxMemoryBudgetCheckMillis);
+    } else {
+        memoryBudgetCheckMillis = kMemoryBudgetCheckMillis;
+    }
+    scheduleMemoryBudgetCheck();
+    return 0;
+}
+
+
+// Shows what each registered structure uses, after a doc about the whole process.
+void submitShowMemory() {
+    const ProcessMemoryStats stats = ProcessMemoryStats::get();
+    BSONObjBuilder process;
+    process.append("name", "process");
+    process.append("residentBytes", static_cast<long long>(stats.residentBytes));
+    process.append("registeredBytes", static_cast<long long>(memoryRegistry.totalBytes()));
+    process.append("budget", static_cast<long long>(memoryRegistry.getBudget()));
+    process.append("evictions", static_cast<long long>(memoryRegistry.numEvictions()));
+    process.append("minorFaults", stats.minorFaults);
+    process.append("majorFaults", stats.majorFaults);
+
+    std::string data;
+    const BSONObj processObj = process.obj();
+    data.append(processObj.objdata(), processObj.objsize());
+    for (auto&& consumer : memoryRegistry.report()) {
+        data.append(consumer.objdata(), consumer.objsize());
+    }
+    showResults(std::move(data), ":memory");
+}
+
+
+// Sets the memory budget, or shows it.  0 means no budget.
+void submitMemoryBudget(const std::string& args) {
+    if (args != "") {
+        auto budget = parseByteSize(args);
+        if ( ! budget.isOK()) {
+            status.setExtra("Usage: budget <bytes>[K|M|G|T], or 0 for none");
+            return;
+        }
+        memoryRegistry.setBudget(budget.getValue());
+        memoryBudgetCheckMillis = kMemoryBudgetCheckMillis;
+    }
+    if (memoryRegistry.getBudget() == 0) {
+        status.setExtra("No memory budget");
+    } else {
+        status.setExtra(str::stream() << "Memory budget " << (memoryRegistry.getBudget() >> 20) << "MB");
+    }
+}
+
+
+static int update_aggregation(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    if ( ! aggregation) {
+        return 0;
+    }
+    if ( ! aggregation->isDone()) {
+        status.setExtra(str::stream() << "Aggregating: " << aggregation->numDocsScanned() << " docs scanned");
+        scheduleJobUpdate(&update_aggregation);
+        return 0;
+    }
+
+    if ( ! aggregation->getStatus().isOK()) {
+        status.setExtra("Aggregation failed: " + aggregation->getStatus().reason());
+        aggregation.reset();
+        return 0;
+    }
+    if (aggregation->numResults() == 0) {
+        status.setExtra("Aggregation returned no results");
+        aggregation.reset();
+        return 0;
+    }
+
+    showResults(aggregation->getResults(), aggregationName);
+    status.setExtra(std::to_string(aggregation->numResults()) + " results");
+    aggregation.reset();
+    return 0;
+}
+
+
+void submitPipeline(const std::string& s) {
+    if (s == "") {
+        // go back to the file
+        showFileView();
+        return;
+    }
+    if (aggregation) {
+        status.setExtra("Already aggregating");
+        return;
+    }
+
+    BSONCache* source = scanSource();
+    auto agg = ParallelAggregation::create(s,
+        [source] (unsigned long* numDocs, bool* complete) { source->getLoadProgress(numDocs, complete); },
+        [source] (unsigned long begin, unsigned long end, std::vector<BSONObj>* out) { source->getLoadedDocs(begin, end, out); });
+    if ( ! agg.isOK()) {
+        status.setExtra("Invalid pipeline: " + agg.getStatus().reason());
+        return;
+    }
+    aggregation = std::move(agg.getValue());
+    aggregationName = str::stream() << scanSourceName() << " | " << s;
+
+    aggregation->start(numJobThreads());
+    scheduleJobUpdate(&update_aggregation);
+}
+
+
+void submitProjection(const std::string& s) {
+    if (s == "") {
+        view->setProjection(nullptr);
+        renderingChanged();
+        return;
+    }
+
+    BSONObj spec;
+    try {
+        spec = fromjson(s);
+    } catch (DBException& e) {
+        status.setExtra("Invalid projection: " + e.reason());
+        return;
+    }
+    auto projection = RenderProjection::parse(spec);
+    if ( ! projection.isOK()) {
+        status.setExtra("Invalid projection: " + projection.getStatus().reason());
+        return;
+    }
+    view->setProjection(std::move(projection.getValue()));
+    renderingChanged();
+}
+
+
+static int update_field_profile(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    if ( ! fieldProfile) {
+        return 0;
+    }
+    if ( ! fieldProfile->isDone()) {
+        status.setExtra(str::stream() << "Profiling: " << fieldProfile->numDocsScanned() << " docs scanned");
+        scheduleJobUpdate(&update_field_profile);
+        return 0;
+    }
+
+    if ( ! fieldProfile->getStatus().isOK()) {
+        status.setExtra("Profiling failed: " + fieldProfile->getStatus().reason());
+        fieldProfile.reset();
+        return 0;
+    }
+    if (fieldProfile->numResults() == 0) {
+        status.setExtra("No fields found");
+        fieldProfile.reset();
+        return 0;
+    }
+
+    showResults(fieldProfile->getResults(), fieldProfileName);
+    status.setExtra(std::to_string(fieldProfile->numResults()) + " field paths");
+    fieldProfile.reset();
+    return 0;
+}
+
+
+// Profiles the fields of the file, or of a random sample of its docs (eg. 0.01 for 1% of them).
+void submitFieldProfile(const std::string& args) {
+    if (fieldProfile) {
+        status.setExtra("Already profiling");
+        return;
+    }
+
+    double sampleRate = 1.0;
+    if (args != "") {
+        if ( ! NumberParser{}(args, &sampleRate).isOK() || ! (sampleRate > 0 && sampleRate <= 1)) {
+            status.setExtra("The sample rate must be a number in (0, 1]");
+            return;
+        }
+    }
+
+    BSONCache* source = scanSource();
+    fieldProfile.reset(new FieldProfile(
+        [source] (unsigned long* numDocs, bool* complete) { source->getLoadProgress(numDocs, complete); },
+        [source] (unsigned long begin, unsigned long end, std::vector<BSONObj>* out) { source->getLoadedDocs(begin, end, out); },
+        sampleRate));
+    fieldProfileName = str::stream() << scanSourceName() << " :profile" << (args == "" ? "" : " ") << args;
+
+    fieldProfile->start(numJobThreads());
+    scheduleJobUpdate(&update_field_profile);
+}
+
+
+static int update_sample(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    if ( ! randomSample) {
+        return 0;
+    }
+    // a profile, pipeline or export may still be scanning the old sample
+    const bool exportingSample = bsonExport && bsonExportSource == sampleCache.get() && ! bsonExport->isDone();
+    if ( ! randomSample->isDone() || fieldProfile || aggregation || exportingSample) {
+        status.setExtra(str::stream() << "Sampling: " << randomSample->numSampled() << " docs sampled in " << randomSample->numAttempts() << " attempts");
+        scheduleJobUpdate(&update_sample);
+        return 0;
+    }
+
+    if ( ! randomSample->getStatus().isOK()) {
+        status.setExtra("Sampling failed: " + randomSample->getStatus().reason());
+        randomSample.reset();
+        return 0;
+    }
+    if (randomSample->numResults() == 0) {
+        status.setExtra("No docs sampled");
+        randomSample.reset();
+        return 0;
+    }
+
+    showFileView();
+    unshowView(sampleView.get());
+    sampleView.reset();
+    sampleCache.reset();
+    sampleData = randomSample->getResults();
+    sampleCache.reset(new BSONCache(sampleData.data(), sampleData.data() + sampleData.size()));
+    sampleCache->loadAll();
+    sampleView.reset(new BSONCacheView(sampleCache.get(), [] () { tickit_window_expose(root, NULL); }, [] () { status.expose(); }));
+    showView(sampleCache.get(), sampleView.get(), sampleName);
+    status.setExtra(str::stream() << randomSample->numResults() << " docs sampled; :profile and | scan just the sample");
+    randomSample.reset();
+    return 0;
+}
+
+
+// Picks N docs (default 1000) at random, without scanning the file, and shows them in their own
+// view.  Goes back to the last sample if it's already been taken.
+void submitSample(const std::string& args) {
+    if (randomSample) {
+        status.setExtra("Already sampling");
+        return;
+    }
+    if (cache.getFileSet()) {
+        // the sample is taken from random offsets in one mapped file
+        status.setExtra("Only a single file can be sampled");
+        return;
+    }
+
+    long long sampleSize = 1000;
+    if (args != "") {
+        if ( ! NumberParser{}(args, &sampleSize).isOK() || sampleSize <= 0) {
+            status.setExtra("The sample size must be a positive number of docs");
+            return;
+        }
+    } else if (sampleView) {
+        showView(sampleCache.get(), sampleView.get(), sampleName);
+        return;
+    }
+
+    // the file is mapped for as long as bv runs
+    randomSample.reset(new RandomSample(cache.fileBegin(), cache.fileEnd(), sampleSize));
+    sampleName = str::stream() << infname << " :sample " << sampleSize;
+
+    randomSample->start(numJobThreads());
+    scheduleJobUpdate(&update_sample);
+}
+
+
+static int update_doc_size_report(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    if ( ! docSizeReport) {
+        return 0;
+    }
+    if ( ! docSizeReport->isDone()) {
+        status.setExtra(str::stream() << "Measuring: " << docSizeReport->numDocsScanned() << " docs scanned");
+        scheduleJobUpdate(&update_doc_size_report);
+        return 0;
+    }
+
+    if ( ! docSizeReport->getStatus().isOK()) {
+        status.setExtra("Size report failed: " + docSizeReport->getStatus().reason());
+        docSizeReport.reset();
+        return 0;
+    }
+
+    showResults(docSizeReport->getResults(), str::stream() << infname << " :sizes");
+    status.setExtra(":doc on a largest doc jumps to it");
+    docSizeReport.reset();
+    return 0;
+}
+
+
+void submitDocSizeReport() {
+    if (docSizeReport) {
+        status.setExtra("Already measuring");
+        return;
+    }
+
+    docSizeReport.reset(new DocSizeReport(
+        [] (unsigned long* numDocs, bool* complete) { cache.getLoadProgress(numDocs, complete); },
+        [] (unsigned long begin, unsigned long end, std::vector<BSONObj>* out) { cache.getLoadedDocs(begin, end, out); }));
+    docSizeReport->start();
+    scheduleJobUpdate(&update_doc_size_report);
+}
+
+
+static int update_duplicate_finder(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    if ( ! duplicateFinder) {
+        return 0;
+    }
+    if ( ! duplicateFinder->isDone()) {
+        if (duplicateFinder->numPartitionsChecked() > 0) {
+            status.setExtra(str::stream() << "Finding duplicates: " << duplicateFinder->numPartitionsChecked() << "/" << DuplicateFinder::kNumPartitions << " partitions checked");
+        } else {
+            status.setExtra(str::stream() << "Finding duplicates: " << duplicateFinder->numDocsScanned() << " docs hashed");
+        }
+        scheduleJobUpdate(&update_duplicate_finder);
+        return 0;
+    }
+
+    if ( ! duplicateFinder->getStatus().isOK()) {
+        status.setExtra("Finding duplicates failed: " + duplicateFinder->getStatus().reason());
+        duplicateFinder.reset();
+        return 0;
+    }
+    if (duplicateFinder->numGroups() == 0) {
+        status.setExtra("No duplicates found");
+        duplicateFinder.reset();
+        return 0;
+    }
+
+    // the marks are on the file, so that's where they can be jumped between
+    paneFileView()->markSourceDocs(duplicateFinder->getDuplicates());
+    showFileView();
+    status.setExtra(str::stream() << duplicateFinder->getDuplicates().size() << " duplicate docs in " << duplicateFinder->numGroups() << " groups (marked, Tab to jump)");
+    duplicateFinder.reset();
+    return 0;
+}
+
+
+// Marks the docs with the same _id as another doc, or with "doc", the docs identical to another.
+void submitFindDuplicates(const std::string& args) {
+    if (duplicateFinder) {
+        status.setExtra("Already finding duplicates");
+        return;
+    }
+
+    DuplicateFinder::Mode mode;
+    if (args == "" || args == "_id") {
+        mode = DuplicateFinder::Mode::kId;
+    } else if (args == "doc") {
+        mode = DuplicateFinder::Mode::kDocument;
+    } else {
+        status.setExtra("Usage: dups [_id|doc]");
+        return;
+    }
+
+    const char* tmpdir = getenv("TMPDIR");
+    duplicateFinder.reset(new DuplicateFinder(mode,
+        [] (unsigned long* numDocs, bool* complete) { cache.getLoadProgress(numDocs, complete); },
+        [] (unsigned long begin, unsigned long end, std::vector<BSONObj>* out) { cache.getLoadedDocs(begin, end, out); },
+        (tmpdir && *tmpdir) ? tmpdir : "/tmp",
+        kSortMaxMemoryUsageBytes));
+
+    duplicateFinder->start(numJobThreads());
+    scheduleJobUpdate(&update_duplicate_finder);
+}
+
+
+static int update_export(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    if ( ! bsonExport) {
+        return 0;
+    }
+    if ( ! bsonExport->isDone()) {
+        status.setExtra(str::stream() << "Exporting: " << bsonExport->numDocsExported() << "/" << bsonExport->numDocs() << " docs, " << bsonExport->numBytesWritten() / (1024 * 1024) << "MB written");
+        scheduleJobUpdate(&update_export);
+        return 0;
+    }
+
+    if ( ! bsonExport->getStatus().isOK()) {
+        status.setExtra("Export failed: " + bsonExport->getStatus().reason());
+    } else {
+        status.setExtra(str::stream() << "Exported " << bsonExport->numDocsExported() << " docs (" << bsonExport->numBytesWritten() << " bytes) to " << bsonExportPath);
+    }
+    bsonExport.reset();
+    return 0;
+}
+
+
+// Writes docs of the view to a new BSON file: all of them (as filtered and sorted), or only the
+// marked ones, or only the ones matching the last search (in file order).
+void submitExport(const std::string& args) {
+    if (bsonExport) {
+        status.setExtra("Already exporting");
+        return;
+    }
+
+    const auto space = args.find(' ');
+    std::string which = args.substr(0, space);
+    std::string path = (space == std::string::npos) ? "" : args.substr(space + 1);
+    if (which != "marked" && which != "matched") {
+        which = "";
+        path = args;
+    }
+    if (path == "") {
+        status.setExtra("Usage: export [marked|matched] <file>");
+        return;
+    }
+
+    const BSONCache& source = view->cache();
+    std::vector<unsigned long> docs;
+    if (which == "marked") {
+        view->getMarkedSourceDocs().appendTo(&docs);
+
+    } else if (which == "matched") {
+        auto lastSearch = view->getLastSearch();
+        if ( ! lastSearch || ! (*lastSearch)->isValid()) {
+            status.setExtra("No search pattern");
+            return;
+        }
+        unsigned long numDocs;
+        bool complete;
+        source.getLoadProgress(&numDocs, &complete);
+        const MatchBitmap& bitmap = (*lastSearch)->getMatchBitmap();
+        for (unsigned long begin = 0; begin < numDocs; begin += MatchBitmap::kChunkSize) {
+            if ( ! bitmap.appendMatches(begin, std::min(numDocs, begin + MatchBitmap::kChunkSize), &docs)) {
+                complete = false;
+                break;
+            }
+        }
+        if ( ! complete) {
+            view->resumeLastSearchFill();
+            status.setExtra("Still searching, try again when it's done");
+            return;
+        }
+        if (auto filter = view->getFilter()) {
+            docs.erase(std::remove_if(docs.begin(), docs.end(), [filter] (unsigned long doc) { return ! filter->contains(doc); }), docs.end());
+        }
+
+    } else {
+        if ( ! view->isComplete()) {
+            status.setExtra("Still loading, try again when it's done");
+            return;
+        }
+        docs.reserve(view->numDocs());
+        for (unsigned long doc = 0; doc < view->numDocs(); doc++) {
+            docs.push_back(view->sourceDoc(doc));
+        }
+    }
+    if (docs.empty()) {
+        status.setExtra("No docs to export");
+        return;
+    }
+
+    // results only exist in memory
+    bsonExport.reset(new BSONExport(
+        (&source == &cache) ? infd : -1,
+        source.fileBegin(),
+        [&source] (unsigned long begin, unsigned long end, std::vector<BSONObj>* out) { source.getLoadedDocs(begin, end, out); },
+        std::move(docs),
+        source.getFileFirstDocs(),
+        path));
+    bsonExportPath = path;
+    bsonExportSource = &source;
+    bsonExport->start();
+    scheduleJobUpdate(&update_export);
+}
+
+
+// Jumps to a doc of the file by its number, or if none is given, to the doc that the cursor's doc
+// (eg. in a report) refers to by its "doc" field.
+void submitJumpToDoc(const std::string& args) {
+    long long doc;
+    if (args == "") {
+        auto cursorDoc = view->getCursorSourceDoc();
+        BSONElement elem;
+        if (cursorDoc) {
+            elem = view->cache()[*cursorDoc]["doc"];
+        }
+        if ( ! elem.isNumber()) {
+            status.setExtra("The cursor's doc has no doc number");
+            return;
+        }
+        doc = elem.safeNumberLong();
+    } else if ( ! NumberParser{}(args, &doc).isOK()) {
+        status.setExtra("Invalid doc number");
+        return;
+    }
+
+    // make sure the doc exists, without trying to load past the end of the file
+    while ( ! cache.isComplete() && doc >= 0 && cache.numDocs() <= static_cast<unsigned long long>(doc)) {
+        cache.loadSome(10000);
+    }
+    if (doc < 0 || static_cast<unsigned long long>(doc) >= cache.numDocs()) {
+        status.setExtra("No such doc");
+        return;
+    }
+
+    showFileView();
+    if ( ! view->jumpToSourceDoc(doc)) {
+        status.setExtra("Doc is hidden by the filter");
+    }
+}
+
+
+static int update_diff(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    if ( ! diff) {
+        return 0;
+    }
+    if ( ! diff->isDone()) {
+        if (diff->numPartitionsChecked() > 0) {
+            status.setExtra(str::stream() << "Diffing: " << diff->numPartitionsChecked() << "/" << BSONDiff::kNumPartitions << " partitions joined");
+        } else {
+            status.setExtra(str::stream() << "Diffing: " << static_cast<int>(diff->percentHashed()) << "% hashed");
+        }
+        scheduleJobUpdate(&update_diff);
+        return 0;
+    }
+
+    if ( ! diff->getStatus().isOK()) {
+        status.setExtra("Diff failed: " + diff->getStatus().reason());
+        diff.reset();
+        return 0;
+    }
+
+    std::string withoutId;
+    if (diff->numWithoutId() > 0) {
+        withoutId = str::stream() << " (" << diff->numWithoutId() << " docs without _id skipped)";
+    }
+    if (diff->numResults() == 0) {
+        status.setExtra("The files have the same docs" + withoutId);
+        diff.reset();
+        return 0;
+    }
+
+    showFileView();
+    unshowView(diffView.get());
+    diffView.reset();
+    diffCache.reset();
+    diffData = diff->getResults();
+    diffName = str::stream() << infname << " vs " << otherfname;
+    diffCache.reset(new BSONCache(diffData.data(), diffData.data() + diffData.size()));
+    diffCache->loadAll();
+    diffView.reset(new BSONCacheView(diffCache.get(), [] () { tickit_window_expose(root, NULL); }, [] () { status.expose(); }));
+    showView(diffCache.get(), diffView.get(), diffName);
+    status.setExtra(str::stream() << diff->numAdded() << " added, " << diff->numRemoved() << " removed, " << diff->numChanged() << " changed" << withoutId << "; :changes shows a changed doc's fields");
+    diff.reset();
+    return 0;
+}
+
+
+void startDiff() {
+    const char* tmpdir = getenv("TMPDIR");
+    // the files are mapped for as long as bv runs
+    diff.reset(new BSONDiff(
+        cache.fileBegin(), cache.fileEnd(),
+        otherCache.fileBegin(), otherCache.fileEnd(),
+        (tmpdir && *tmpdir) ? tmpdir : "/tmp",
+        kSortMaxMemoryUsageBytes));
+
+    diff->start(numJobThreads());
+    scheduleJobUpdate(&update_diff);
+}
+
+
+// Goes back to the list of differences between the files.
+void submitShowDiff() {
+    if (diff) {
+        status.setExtra("Still diffing");
+        return;
+    }
+    if ( ! diffView) {
+        status.setExtra(otherfname ? "The files have the same docs" : "Not diffing (bv --diff <bsonfile> <otherbsonfile>)");
+        return;
+    }
+    showView(diffCache.get(), diffView.get(), diffName);
+}
+
+
+// Shows which fields differ between the two versions of the cursor's changed doc.
+void submitShowChanges() {
+    if ( ! diffView || view != diffView.get()) {
+        status.setExtra("Not on the list of differences (:diff)");
+        return;
+    }
+    auto cursorDoc = view->getCursorSourceDoc();
+    if ( ! cursorDoc) {
+        return;
+    }
+    const BSONObj difference = (*diffCache)[*cursorDoc];
+    if ( ! difference["offset"].isNumber() || ! difference["otherOffset"].isNumber()) {
+        status.setExtra("Only changed docs have changes");
+        return;
+    }
+
+    // straight from the offsets, since looking the docs up by number could mean walking the files
+    std::string changes = BSONDiff::diffFields(
+        BSONObj(cache.fileBegin() + difference["offset"].safeNumberLong()),
+        BSONObj(otherCache.fileBegin() + difference["otherOffset"].safeNumberLong()));
+    if (changes.empty()) {
+        // eg. a field that's in the doc more than once
+        status.setExtra("No differences in the fields");
+        return;
+    }
+    showResults(std::move(changes), str::stream() << "changes to _id " << difference["_id"].toString(false));
+}
+
+
+// Panes.
+
+static int render_main(TickitWindow *win, TickitEventFlags flags, void *_info, void *data);
+static int event_key(TickitWindow *win, TickitEventFlags flags, void *_info, void *data);
+static int event_mouse(TickitWindow *win, TickitEventFlags flags, void *_info, void *data);
+static void applyPendingMotion();
+
+static void createPaneWindow(Pane* pane) {
+    pane->win = tickit_window_new(root, (TickitRect){ .top = 0, .left = 0, .lines = 1, .cols = 1 }, (TickitWindowFlags)0);
+    tickit_window_bind_event(pane->win, TICKIT_WINDOW_ON_EXPOSE, (TickitBindFlags)0, &render_main, pane);
+    tickit_window_bind_event(pane->win, TICKIT_WINDOW_ON_KEY, (TickitBindFlags)0, &event_key, pane);
+    tickit_window_bind_event(pane->win, TICKIT_WINDOW_ON_MOUSE, (TickitBindFlags)0, &event_mouse, pane);
+    tickit_window_set_cursor_visible(pane->win, false);
+}
+
+// Divides the screen above the status bar between the panes, leaving a line (or column) between
+// each of them for a separator.
+static void layoutPanes() {
+    const int lines = tickit_window_lines(root) - 1;
+    const int cols = tickit_window_cols(root);
+    const int n = panes.size();
+    const int room = (panesSideBySide ? cols : lines) - (n - 1);
+    int pos = 0;
+    for (int i = 0; i < n; i++) {
+        const int size = std::max(1, room / n + ((i < room % n) ? 1 : 0));
+        TickitRect rect{ .top = 0, .left = 0, .lines = lines, .cols = cols };
+        if (panesSideBySide) {
+            rect.left = pos;
+            rect.cols = size;
+        } else {
+            rect.top = pos;
+            rect.lines = size;
+        }
+        tickit_window_set_geometry(panes[i]->win, rect);
+        pos += size + 1;
+    }
+}
+
+static int render_separators(TickitWindow *win, TickitEventFlags flags, void *_info, void *data) {
+    TickitExposeEventInfo *info = static_cast<TickitExposeEventInfo*>(_info);
+    TickitRenderBuffer *rb = info->rb;
+    tickit_renderbuffer_save(rb);
+    tickit_renderbuffer_setpen(rb, mkpen_highlight());
+    for (size_t i = 0; i + 1 < panes.size(); i++) {
+        const TickitRect rect = tickit_window_get_geometry(panes[i]->win);
+        if (panesSideBySide) {
+            for (int line = 0; line < rect.lines; line++) {
+                tickit_renderbuffer_text_at(rb, line, rect.left + rect.cols, "|");
+            }
+        } else {
+            tickit_renderbuffer_text_at(rb, rect.top + rect.lines, 0, std::string(rect.cols, '-').c_str());
+        }
+    }
+    tickit_renderbuffer_restore(rb);
+    return 1;
+}
+
+static void focusPane(Pane* pane) {
+    focusedPane = pane;
+    tickit_window_take_focus(pane->win);
+    prompt.setReturnFocusTo(pane->win);
+    histogram.setReturnFocusTo(pane->win);
+    showView(pane->viewCache, pane->view, pane->viewName);
+}
+
+// Splits the focused pane in two, with the new one showing the file from the same doc (and in
+// the same render mode).  Panes are either all stacked or all side by side, so a :vsplit of
+// stacked panes (or vice versa) rearranges all of them.
+void submitSplit(bool sideBySide) {
+    const int n = panes.size() + 1;
+    const int room = sideBySide ? tickit_window_cols(root) : tickit_window_lines(root) - 1;
+    if ((room - (n - 1)) / n < (sideBySide ? kMinPaneCols : kMinPaneLines)) {
+        status.setExtra("Not enough room for another pane");
+        return;
+    }
+
+    BSONCacheView* from = paneFileView();
+    std::unique_ptr<Pane> pane(new Pane());
+    Pane* p = pane.get();
+    createPaneWindow(p);
+    p->ownFileView.reset(new BSONCacheView(&cache, [p] () { tickit_window_expose(p->win, NULL); }, [] () { status.expose(); }));
+    p->fileView = p->ownFileView.get();
+    p->view = p->fileView;
+    p->viewCache = &cache;
+    p->viewName = infname;
+
+    auto it = std::find_if(panes.begin(), panes.end(), [] (const std::unique_ptr<Pane>& x) { return x.get() == focusedPane; });
+    panes.insert(it + 1, std::move(pane));
+    panesSideBySide = sideBySide;
+    layoutPanes();
+
+    p->fileView->updateDimensions(p->win);
+    p->fileView->setDocumentRenderMode(from->getDocumentRenderMode());
+    p->fileView->setExtendedJSONMode(from->getExtendedJSONMode());
+    if (auto doc = from->getCursorSourceDoc()) {
+        p->fileView->jumpToSourceDoc(*doc);
+    }
+    focusPane(p);
+}
+
+static void closePane(Pane* pane) {
+    tickit_window_close(pane->win);
+    panes.erase(std::find_if(panes.begin(), panes.end(), [pane] (const std::unique_ptr<Pane>& x) { return x.get() == pane; }));
+}
+
+void submitClosePane() {
+    if (panes.size() == 1) {
+        status.setExtra("Can't close the only pane (q quits)");
+        return;
+    }
+    auto it = std::find_if(panes.begin(), panes.end(), [] (const std::unique_ptr<Pane>& x) { return x.get() == focusedPane; });
+    Pane* next = (it + 1 != panes.end()) ? (it + 1)->get() : (it - 1)->get();
+    closePane(focusedPane);
+    layoutPanes();
+    focusPane(next);
+}
+
+void submitOnlyPane() {
+    while (panes.size() > 1) {
+        closePane((panes.front().get() == focusedPane) ? panes.back().get() : panes.front().get());
+    }
+    layoutPanes();
+    tickit_window_expose(root, NULL);
+}
+
+static void focusNextPane() {
+    auto it = std::find_if(panes.begin(), panes.end(), [] (const std::unique_ptr<Pane>& x) { return x.get() == focusedPane; });
+    focusPane((it + 1 != panes.end()) ? (it + 1)->get() : panes.front().get());
+}
+
+
+// Each file (eg. the oplog of each member of a replica set) is taken to be in order of the field
+// already, so rather than sorting, the files are merged, as the view gets to each part of it.
+void submitMerge(const std::string& path) {
+    if (path == "") {
+        // go back to the file
+        showFileView();
+        return;
+    }
+    if ( ! cache.getFileSet() || cache.numFiles() < 2) {
+        status.setExtra("Only several files can be merged");
+        return;
+    }
+    if ( ! cache.isComplete()) {
+        // the files' docs are only numbered once they're loaded
+        status.setExtra("Still loading, try again when it's done");
+        return;
+    }
+
+    std::vector<std::pair<unsigned long, unsigned long>> runs;
+    for (size_t file = 0; file < cache.numFiles(); file++) {
+        unsigned long end = (file + 1 < cache.numFiles()) ? cache.firstDocOfFile(file + 1) : cache.numDocs();
+        runs.emplace_back(cache.firstDocOfFile(file), end);
+    }
+
+    unshowView(mergedView.get());
+    mergedView.reset();
+    mergeOrder.reset(new MergeOrder(path, std::move(runs), [] (unsigned long doc) { return cache[doc]; }));
+    mergedName = str::stream() << infname << " merged by " << path;
+    mergedView.reset(new BSONCacheView(&cache, [] () { tickit_window_expose(root, NULL); }, [] () { status.expose(); }));
+    mergedView->setOrder(mergeOrder.get());
+    showView(&cache, mergedView.get(), mergedName);
+    status.setExtra(str::stream() << cache.numFiles() << " files merged by " << path);
+}
+
+
+void submitCommand(const std::string& s) {
+    const auto space = s.find(' ');
+    const std::string command = s.substr(0, space);
+    const std::string args = (space == std::string::npos) ? "" : s.substr(space + 1);
+    if (command == "project") {
+        submitProjection(args);
+    } else if (command == "profile") {
+        submitFieldProfile(args);
+    } else if (command == "sample") {
+        submitSample(args);
+    } else if (command == "sizes") {
+        submitDocSizeReport();
+    } else if (command == "doc") {
+        submitJumpToDoc(args);
+    } else if (command == "dups") {
+        submitFindDuplicates(args);
+    } else if (command == "export") {
+        submitExport(args);
+    } else if (command == "diff") {
+        submitShowDiff();
+    } else if (command == "changes") {
+        submitShowChanges();
+    } else if (command == "memory") {
+        submitShowMemory();
+    } else if (command == "budget") {
+        submitMemoryBudget(args);
+    } else if (command == "merge") {
+        submitMerge(args);
+    } else if (command == "split") {
+        submitSplit(false);
+    } else if (command == "vsplit") {
+        submitSplit(true);
+    } else if (command == "close") {
+        submitClosePane();
+    } else if (command == "only") {
+        submitOnlyPane();
+    } else if (command != "") {
+        status.setExtra("Unknown command: " + command);
+    }
+}
+
+
+static int update_sort(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    if ( ! sortPermutation) {
+        return 0;
+    }
+    if ( ! sortPermutation->isDone()) {
+        if (sortPermutation->numDocsMerged() > 0) {
+            status.setExtra(str::stream() << "Sorting: " << sortPermutation->numDocsMerged() << "/" << sortPermutation->numDocsScanned() << " docs merged");
+        } else {
+            status.setExtra(str::stream() << "Sorting: " << sortPermutation->numDocsScanned() << " docs scanned");
+        }
+        scheduleJobUpdate(&update_sort);
+        return 0;
+    }
+
+    if ( ! sortPermutation->getStatus().isOK()) {
+        status.setExtra("Sort failed: " + sortPermutation->getStatus().reason());
+        sortPermutation.reset();
+        return 0;
+    }
+
+    // the sorted file is shown in its own view, so the file view keeps its filter and position
+    unshowView(sortedView.get());
+    sortedView.reset();
+    sortedPermutation = std::move(sortPermutation);
+    sortedView.reset(new BSONCacheView(&cache, [] () { tickit_window_expose(root, NULL); }, [] () { status.expose(); }));
+    sortedView->setOrder(sortedPermutation.get());
+    showView(&cache, sortedView.get(), sortedName);
+    status.setExtra(std::to_string(sortedPermutation->numDocs()) + " docs sorted");
+    return 0;
+}
+
+
+void submitSort(const std::string& s) {
+    if (s == "") {
+        // go back to the file
+        showFileView();
+        return;
+    }
+    if (sortPermutation) {
+        status.setExtra("Already sorting");
+        return;
+    }
+
+    // a bare path sorts ascending
+    BSONObj pattern;
+    try {
+        pattern = (s[0] == '{') ? fromjson(s) : BSON(s << 1);
+    } catch (DBException& e) {
+        status.setExtra("Invalid sort pattern: " + e.reason());
+        return;
+    }
+
+    const char* tmpdir = getenv("TMPDIR");
+    auto sort = SortPermutation::create(pattern,
+        [] (unsigned long* numDocs, bool* complete) { cache.getLoadProgress(numDocs, complete); },
+        [] (unsigned long begin, unsigned long end, std::vector<BSONObj>* out) { cache.getLoadedDocs(begin, end, out); },
+        (tmpdir && *tmpdir) ? tmpdir : "/tmp",
+        kSortMaxMemoryUsageBytes);
+    if ( ! sort.isOK()) {
+        status.setExtra("Invalid sort pattern: " + sort.getStatus().reason());
+        return;
+    }
+    sortPermutation = std::move(sort.getValue());
+    sortedName = str::stream() << infname << " sorted by " << pattern.jsonString();
+
+    sortPermutation->start(numJobThreads());
+    scheduleJobUpdate(&update_sort);
+}
+
+
 
-    // TODO: better user feedback (updates)
-    status.setExtra("Searching...");
-    defer([&] () {
-        auto lastSearch = view.getLastSearch();
-        if (lastSearch) {
-            if ((*lastSearch)->isValid()) {
-                auto doc = view.searchFor(*lastSearch);
-                if (doc) {
-                    status.setExtra("");
-                    view.jumpToDoc(*doc);
-                } else {
-                    // notify the user
-                    status.setExtra("Pattern not found");
-                }
-            } else {
-                status.setExtra("Invalid search pattern");
-            }
-        } else {
-            // notify the user
-            status.setExtra("No search pattern");
-        }
-    });
+// Held-down motion keys (and a spun mouse wheel) can arrive much faster than the screen can be
+// laid out and drawn, so rather than moving once for every key, the motion is added up here and
+// applied (and drawn) at most once per frame.  Any other key or click applies it first, so that
+// nothing happens out of order.
+int pendingCursorMotion = 0;  // lines to move the cursor down (negative for up)
+int pendingScrollMotion = 0;  // lines to scroll down (negative for up)
+bool motionFrameScheduled = false;
+std::chrono::steady_clock::time_point lastMotionFrame;
+const int kMotionFrameMillis = 16;  // ~60fps
+
+static void applyPendingMotion() {
+    if (pendingCursorMotion > 0) {
+        view->moveCursorDown(pendingCursorMotion);
+    } else if (pendingCursorMotion < 0) {
+        view->moveCursorUp(-pendingCursorMotion);
+    }
+    if (pendingScrollMotion > 0) {
+        view->moveDown(pendingScrollMotion);
+    } else if (pendingScrollMotion < 0) {
+        view->moveUp(-pendingScrollMotion);
+    }
+    pendingCursorMotion = 0;
+    pendingScrollMotion = 0;
 }
 
+static int update_motion(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    motionFrameScheduled = false;
+    lastMotionFrame = std::chrono::steady_clock::now();
+    applyPendingMotion();
+    return 1;
+}
 
-void submitSearchString(const std::string& s) {
-    Search *search;
-    // check the format (mql etc), handle appropriately
-    if (s[0] == '{') {
-        search = new SearchMQL(s);
+static void scheduleMotion() {
+    if (motionFrameScheduled) {
+        return;
+    }
+    motionFrameScheduled = true;
+    const auto sinceLast = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - lastMotionFrame).count();
+    if (sinceLast >= kMotionFrameMillis) {
+        // after the rest of the keys that have already been read
+        tickit_watch_later(t, (TickitBindFlags)0, &update_motion, NULL);
     } else {
-        search = new SearchRenderedText(s);
+        tickit_watch_timer_after_msec(t, kMotionFrameMillis - sinceLast, (TickitBindFlags)0, &update_motion, NULL);
     }
+}
 
-    // save the search string in history, both for n/N and up/down-arrow in search input
-    view.registerSearch(search);
-
-    doSearch();
+static void addCursorMotion(int lines) {
+    if (pendingScrollMotion) {
+        applyPendingMotion();
+    }
+    pendingCursorMotion += lines;
+    scheduleMotion();
 }
 
+static void addScrollMotion(int lines) {
+    if (pendingCursorMotion) {
+        applyPendingMotion();
+    }
+    pendingScrollMotion += lines;
+    scheduleMotion();
+}
 
 
 static int event_key(TickitWindow *win, TickitEventFlags flags, void *_info, void *data) {
@@ -1604,86 +3667,98 @@ static int event_key(TickitWindow *win, TickitEventFlags flags, void *_info, voi
         return 1;
     }
 
+    FrameStats::Timer timer(&frameStats, FrameStats::kEventKey);
+
+    const bool isMotionKey = isKey(info, 'j') || isKey(info, "Down") || isKey(info, 'k') || isKey(info, "Up");
+    if ( ! isMotionKey) {
+        applyPendingMotion();
+    }
+
     status.setExtra("");
 
     if (isKey(info, 'q') || isKey(info, 'Q')/* || isKey(info, "Escape")*/) {
         tickit_stop(t);
 
     } else if (isKey(info, '1')) {
-        view.setDocumentRenderMode(BSONCacheView::kJSONOneline);
+        view->setDocumentRenderMode(DocRenderer::kJSONOneline);
+        renderingChanged();
 
     } else if (isKey(info, '2')) {
-        view.setDocumentRenderMode(BSONCacheView::kJSONPretty);
+        view->setDocumentRenderMode(DocRenderer::kJSONPretty);
+        renderingChanged();
 
     } else if (isKey(info, '3')) {
-        view.setDocumentRenderMode(BSONCacheView::kToString);
+        view->setDocumentRenderMode(DocRenderer::kToString);
+        renderingChanged();
 
     } else if (isKey(info, '4')) {
-        view.setDocumentRenderMode(BSONCacheView::kTextLogs);
+        view->setDocumentRenderMode(DocRenderer::kTextLogs);
+        renderingChanged();
 
     } else if (isKey(info, 's')) {
-        view.toggleExtendedJSONMode();
+        view->toggleExtendedJSONMode();
+        renderingChanged();
 
     } else if (isKey(info, 'h') || isKey(info, "Left")) {
-        view.moveLeft();
+        view->moveLeft();
 
     } else if (isKey(info, 'l') || isKey(info, "Right")) {
-        view.moveRight();
+        view->moveRight();
 
     } else if (isKey(info, '^') || isKey(info, '0')) {
-        view.jumpLeft();
+        view->jumpLeft();
 
     } else if (isKey(info, '$')) {
-        view.jumpRight();
+        view->jumpRight();
 
     } else if (isKey(info, 'j') || isKey(info, "Down")) {
-        view.moveCursorDown();
+        addCursorMotion(1);
 
     } else if (isKey(info, 'k') || isKey(info, "Up")) {
-        view.moveCursorUp();
+        addCursorMotion(-1);
 
     } else if (isKey(info, 'J') || isKey(info, "S-Down")) {
         // TODO: this should jump the cursor to the start of the next doc
-        ////view.moveNextDoc();
-        //view.moveCursorNextDoc();
+        ////view->moveNextDoc();
+        //view->moveCursorNextDoc();
 
     } else if (isKey(info, 'K') || isKey(info, "S-Up")) {
         // TODO: this should jump the cursor to the start of the prev doc
-        ////view.movePrevDoc();
-        //view.moveCursorPrevDoc();
+        ////view->movePrevDoc();
+        //view->moveCursorPrevDoc();
 
     } else if (isKey(info, 'g') || isKey(info, "Home")) {
-        view.jumpUp();
+        view->jumpUp();
 
     } else if (isKey(info, 'G') || isKey(info, "End")) {
-        view.jumpDown();
+        view->jumpDown();
 
     } else if (isKey(info, 'H')) {
-        view.cursorTop();
+        view->cursorTop();
 
     } else if (isKey(info, 'M')) {
-        view.cursorMiddle();
+        view->cursorMiddle();
 
     } else if (isKey(info, 'L')) {
-        view.cursorBottom();
+        view->cursorBottom();
 
     } else if (isKey(info, "PageDown") || isKey(info, "C-f") || isKey(info, ' ')) {
-        view.pageDown();
+        view->pageDown();
 
     } else if (isKey(info, "PageUp") || isKey(info, "C-b")) {
-        view.pageUp();
+        view->pageUp();
 
     } else if (isKey(info, '?')) {
         // TODO: show online help (key reference)
 
     } else if (isKey(info, "Enter")) {
-        view.toggleMarkCursorDoc();
+        view->toggleMarkCursorDoc();
 
     } else if (isKey(info, "Tab")) {
-        view.jumpNextMarkedDoc();
+        view->jumpNextMarkedDoc();
 
     } else if (isKey(info, "S-Tab")) {
-        view.jumpPrevMarkedDoc();
+        view->jumpPrevMarkedDoc();
 
     } else if (isKey(info, '/')) {
         // search forwards
@@ -1691,7 +3766,7 @@ static int event_key(TickitWindow *win, TickitEventFlags flags, void *_info, voi
 
     } else if (isKey(info, 'n')) {
         // search forwards again
-        if (view.getLastSearch()) {
+        if (view->getLastSearch()) {
             doSearch();
         } else {
             // TODO: notify user
@@ -1702,6 +3777,39 @@ static int event_key(TickitWindow *win, TickitEventFlags flags, void *_info, voi
         // search forwards for doc
         prompt.enter("/", "{", submitSearchString);
 
+    } else if (isKey(info, '&')) {
+        // only show docs matching a pattern
+        prompt.enter("&", "", submitFilterString);
+
+    } else if (isKey(info, '#')) {
+        // count the matches of the last search, and show where they are
+        countMatches();
+
+    } else if (isKey(info, 'I')) {
+        // build an index of a field, to make searching for equality on it fast
+        prompt.enter("index field: ", "", submitIndexPath);
+
+    } else if (isKey(info, '|')) {
+        // run an aggregation pipeline over the file, and show the results
+        prompt.enter("|", "", submitPipeline);
+
+    } else if (isKey(info, ':')) {
+        // eg. ":project {ts: 1}"
+        prompt.enter(":", "", submitCommand);
+
+    } else if (isKey(info, 'o')) {
+        // show the file sorted by some fields
+        prompt.enter("sort by: ", "", submitSort);
+
+    } else if (isKey(info, "C-w")) {
+        // like vim, move to the next pane
+        focusNextPane();
+
+    } else if (isKey(info, 'T')) {
+        // show where the time goes in each frame
+        showFrameStats = ! showFrameStats;
+        tickit_window_expose(root, NULL);
+
     }
 
     return 1;
@@ -1710,21 +3818,25 @@ static int event_key(TickitWindow *win, TickitEventFlags flags, void *_info, voi
 
 static int event_mouse(TickitWindow *win, TickitEventFlags flags, void *_info, void *data) {
     TickitMouseEventInfo *info = static_cast<TickitMouseEventInfo*>(_info);
+    Pane* pane = static_cast<Pane*>(data);
+
+    // the pane under the mouse is the one it acts on
+    if (pane != focusedPane) {
+        applyPendingMotion();
+        focusPane(pane);
+    }
 
     if (info->type == TICKIT_MOUSEEV_WHEEL) {
-        if (info->button == TICKIT_MOUSEWHEEL_DOWN) {
-            view.moveDown();
-        } else {
-            view.moveUp();
-        }
+        addScrollMotion((info->button == TICKIT_MOUSEWHEEL_DOWN) ? 1 : -1);
 
     } else if (info->button == 1) {
+        applyPendingMotion();
         if (info->type == TICKIT_MOUSEEV_PRESS) {
-            view.dragStartLine(info->line);
+            view->dragStartLine(info->line);
         } else if (info->type == TICKIT_MOUSEEV_DRAG) {
-            view.dragUpdateLine(info->line);
+            view->dragUpdateLine(info->line);
         } else if (info->type == TICKIT_MOUSEEV_RELEASE) {
-            view.dragEndLine(info->line);
+            view->dragEndLine(info->line);
         }
 
     }
@@ -1733,9 +3845,53 @@ static int event_mouse(TickitWindow *win, TickitEventFlags flags, void *_info, v
 }
 
 
+// eg. "850ns", "12.5us", "3.2ms"
+static std::string formatNanos(uint64_t nanos) {
+    char buf[32];
+    if (nanos < 1000) {
+        snprintf(buf, sizeof(buf), "%lluns", static_cast<unsigned long long>(nanos));
+    } else if (nanos < 1000 * 1000) {
+        snprintf(buf, sizeof(buf), "%.1fus", nanos / 1000.0);
+    } else if (nanos < 1000 * 1000 * 1000) {
+        snprintf(buf, sizeof(buf), "%.1fms", nanos / (1000.0 * 1000));
+    } else {
+        snprintf(buf, sizeof(buf), "%.1fs", nanos / (1000.0 * 1000 * 1000));
+    }
+    return buf;
+}
+
+// Shows the p50/p99 of each phase in the top right corner.
+static void drawFrameStats(TickitRenderBuffer *rb, int cols) {
+    const int width = 48;
+    const int left = (cols > width) ? cols - width : 0;
+    TickitRect rect{ .top = 0, .left = left, .lines = FrameStats::kNumPhases + 2, .cols = width };
+
+    tickit_renderbuffer_savepen(rb);
+    tickit_renderbuffer_setpen(rb, mkpen_highlight());
+    tickit_renderbuffer_eraserect(rb, &rect);
+    tickit_renderbuffer_textf_at(rb, 0, left, " %-16s %9s %9s %9s", "phase", "count", "p50", "p99");
+    for (int phase = 0; phase < FrameStats::kNumPhases; phase++) {
+        const LatencyHistogram& histogram = frameStats.phase(static_cast<FrameStats::Phase>(phase));
+        tickit_renderbuffer_textf_at(rb, 1 + phase, left, " %-16s %9llu %9s %9s",
+            FrameStats::phaseName(static_cast<FrameStats::Phase>(phase)).toString().c_str(),
+            static_cast<unsigned long long>(histogram.count()),
+            formatNanos(histogram.percentile(50)).c_str(),
+            formatNanos(histogram.percentile(99)).c_str());
+    }
+    const LatencyHistogram& docs = frameStats.docsPerFrame();
+    tickit_renderbuffer_textf_at(rb, 1 + FrameStats::kNumPhases, left, " %-16s %9llu %9llu %9llu",
+        "docs/frame",
+        static_cast<unsigned long long>(docs.count()),
+        static_cast<unsigned long long>(docs.percentile(50)),
+        static_cast<unsigned long long>(docs.percentile(99)));
+    tickit_renderbuffer_restore(rb);
+}
+
 static int render_main(TickitWindow *win, TickitEventFlags flags, void *_info, void *data) {
     TickitExposeEventInfo *info = static_cast<TickitExposeEventInfo*>(_info);
     TickitRenderBuffer *rb = info->rb;
+    Pane* pane = static_cast<Pane*>(data);
+    FrameStats::Timer timer(&frameStats, FrameStats::kFrame);
 
     // wtf?  doing this makes it BOLD white on black!?
     //tickit_renderbuffer_setpen(rb, mkpen_base());
@@ -1743,23 +3899,26 @@ static int render_main(TickitWindow *win, TickitEventFlags flags, void *_info, v
     tickit_renderbuffer_eraserect(rb, &info->rect);
     //tickit_renderbuffer_clear(rb);
 
-    view.updateDimensions(win);
-    view.drawMainLines(rb);
-    view.drawTildeLines(rb);
+    pane->view->updateDimensions(win);
+    pane->view->drawMainLines(rb);
+    pane->view->drawTildeLines(rb);
 
-    view.redrawStatus();
+    view->redrawStatus();
+
+    frameStats.endFrame();
+    if (showFrameStats && pane == focusedPane) {
+        drawFrameStats(rb, tickit_window_cols(win));
+    }
 
     return 1;
 }
 
 
 static int event_resize(TickitWindow *root, TickitEventFlags flags, void *_info, void *data) {
-    int lines = tickit_window_lines(root);
-    int cols = tickit_window_cols(root);
-
-    tickit_window_set_geometry(mainwin, (TickitRect){ .top = 0, .left = 0, .lines = lines - 1, .cols = cols });
+    layoutPanes();
     status.resize();
     prompt.resize();
+    histogram.resize();
 
     tickit_window_expose(root, NULL);
 
@@ -1767,61 +3926,67 @@ static int event_resize(TickitWindow *root, TickitEventFlags flags, void *_info,
 }
 
 static int load_more(Tickit *t, TickitEventFlags flags, void *_info, void *data) {
+    FrameStats::Timer timer(&frameStats, FrameStats::kLoadMore);
     if ( ! cache.isComplete()) {
         cache.loadSome();
         if (Date_t::now() - status.getLastRenderTime() > Milliseconds(100)) {
-            view.redrawStatus();
+            view->redrawStatus();
         }
         tickit_watch_later(t, (TickitBindFlags)0, &load_more, NULL);
     } else {
         if (jumpToEndAfterLoadingComplete) {
-            view.jumpDown();
+            fileView.jumpDown();
         }
-        view.redrawStatus();
+        view->redrawStatus();
     }
     return 0;
 }
 
 
 
-int _main(int argc, char* argv[], char** envp) {
-
-    if (argc != 2) {
-        std::cerr << "Usage: bv <bsonfile>" << std::endl;
-        std::cerr << "  Exactly one input file is supported." << std::endl;
-        return kInputFileError;
+// Writes out the frame stats as a single BSON doc, eg. for comparing builds with bsondump.
+static void writeFrameStats(const char* fname) {
+    const BSONObj stats = frameStats.toBSON();
+    std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+    out.write(stats.objdata(), stats.objsize());
+    out.close();
+    if ( ! out) {
+        std::cerr << "bv: Error: Unable to write frame stats to '" << fname << "'" << std::endl;
     }
+}
+
 
-    infname = argv[1];
+// Maps a whole input file into memory, complaining on stderr if it can't.  The file is left open,
+// for anything which can do better than reading it through the mapping.
+static int mapInputFile(const char* fname, struct stat& sb, int* fdOut, const char** base) {
 
     // Check that the file's fd is a regular file, no pipes or funny business.
-    struct stat sb;
-    if (::stat(infname, &sb) == -1) {
+    if (::stat(fname, &sb) == -1) {
         int res = errno;
-        std::cerr << "bv: Error: Unable to stat input file '" << infname << "': " << errnoWithDescription(res) << std::endl;
+        std::cerr << "bv: Error: Unable to stat input file '" << fname << "': " << errnoWithDescription(res) << std::endl;
         return kInputFileError;
     }
     if ((sb.st_mode & S_IFMT) != S_IFREG) {
-        std::cerr << "bv: Error: Input file '" << infname << "' is not a regular file." << std::endl;
+        std::cerr << "bv: Error: Input file '" << fname << "' is not a regular file." << std::endl;
         return kInputFileError;
     }
 
     // Open the file.
-    const int fd = ::open(infname, O_RDONLY);
+    const int fd = ::open(fname, O_RDONLY);
     if (fd == -1) {
         int res = errno;
-        std::cerr << "bv: Error: Unable to open input file '" << infname << "': " << errnoWithDescription(res) << std::endl;
+        std::cerr << "bv: Error: Unable to open input file '" << fname << "': " << errnoWithDescription(res) << std::endl;
         return kInputFileError;
     }
 
     // Double check that the file's fd is a regular file, no pipes or funny business.
     if (::fstat(fd, &sb) == -1) {
         int res = errno;
-        std::cerr << "bv: Error: Unable to fstat input file '" << infname << "': " << errnoWithDescription(res) << std::endl;
+        std::cerr << "bv: Error: Unable to fstat input file '" << fname << "': " << errnoWithDescription(res) << std::endl;
         return kInputFileError;
     }
     if ((sb.st_mode & S_IFMT) != S_IFREG) {
-        std::cerr << "bv: Error: Input file '" << infname << "' is not a regular file." << std::endl;
+        std::cerr << "bv: Error: Input file '" << fname << "' is not a regular file." << std::endl;
         return kInputFileError;
     }
 
@@ -1830,36 +3995,233 @@ int _main(int argc, char* argv[], char** envp) {
     void* fbase = ::mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
     if (fbase == MAP_FAILED) {
         int res = errno;
-        std::cerr << "bv: Error: Unable to mmap input file '" << infname << "': " << errnoWithDescription(res) << std::endl;
+        std::cerr << "bv: Error: Unable to mmap input file '" << fname << "': " << errnoWithDescription(res) << std::endl;
         return kInputFileError;
     }
 
 #if _POSIX_C_SOURCE >= 200112L
     if (::posix_madvise(fbase, sb.st_size, POSIX_MADV_WILLNEED) != 0) {
         int res = errno;
-        std::cerr << "bv: Error: Unable to posix_madvise input file '" << infname << "': " << errnoWithDescription(res) << std::endl;
+        std::cerr << "bv: Error: Unable to posix_madvise input file '" << fname << "': " << errnoWithDescription(res) << std::endl;
         return kInputFileError;
     }
 #endif
 #if _DEFAULT_SOURCE
     if (::madvise(fbase, sb.st_size, MADV_DONTDUMP) != 0) {
         int res = errno;
-        std::cerr << "bv: Error: Unable to madvise input file '" << infname << "': " << errnoWithDescription(res) << std::endl;
+        std::cerr << "bv: Error: Unable to madvise input file '" << fname << "': " << errnoWithDescription(res) << std::endl;
         return kInputFileError;
     }
 #endif
 
-    const char* base = static_cast<const char*>(fbase);
+    *fdOut = fd;
+    *base = static_cast<const char*>(fbase);
+    return 0;
+}
 
-    try {
-        cache.init(base, base + sb.st_size);
-    } catch (mongo::DBException& e) {
-        std::cerr << "bv: Error: Unable to read/parse first document from input file '" << infname << "', is this a BSON file?" << std::endl;
-        throw;
+
+// Options for running without the UI, eg. "bv --query '{a: 1}' --format bson in.bson > out.bson".
+struct BatchOptions {
+    std::string query;
+    std::string projection;
+    std::string format = "json";
+    unsigned numThreads = 0;  // 0 for one less than the number of cores
+};
+
+const unsigned long kBatchChunkSize = 4096;
+
+// Writes the docs of the file which match the query to stdout, projected and rendered like the
+// view would.  Worker threads each take the next chunk of loaded docs and render it into a string,
+// which the main thread (which also loads the file) writes out strictly in chunk order, so that
+// the output is in file order whichever worker finishes first.  Workers can only get a few chunks
+// ahead of the output, which bounds the memory held in the reorder buffer.
+static int runBatch(const BatchOptions& options) {
+    bool rawBSON = false;
+    bool countOnly = false;
+    DocRenderer::DocumentRenderMode renderMode = DocRenderer::kJSONOneline;
+    if (options.format == "pretty") {
+        renderMode = DocRenderer::kJSONPretty;
+    } else if (options.format == "bson") {
+        rawBSON = true;
+    } else if (options.format == "count") {
+        countOnly = true;
+    } else if (options.format != "json") {
+        std::cerr << "bv: Error: Unknown format '" << options.format << "', expected json, pretty, bson or count." << std::endl;
+        return kInputFileError;
     }
 
-    t = tickit_new_stdio();
+    fileView.init(&cache);
+    fileView.setDocumentRenderMode(renderMode);
+    if (options.projection != "") {
+        BSONObj spec;
+        try {
+            spec = fromjson(options.projection);
+        } catch (DBException& e) {
+            std::cerr << "bv: Error: Invalid projection: " << e.reason() << std::endl;
+            return kInputFileError;
+        }
+        auto projection = RenderProjection::parse(spec);
+        if ( ! projection.isOK()) {
+            std::cerr << "bv: Error: Invalid projection: " << projection.getStatus().reason() << std::endl;
+            return kInputFileError;
+        }
+        fileView.setProjection(std::move(projection.getValue()));
+    }
+    const RenderProjection* projection = fileView.getProjection();
+
+    std::unique_ptr<Search> search;
+    if (options.query != "") {
+        search.reset(makeSearch(options.query));
+        if ( ! search->isValid()) {
+            std::cerr << "bv: Error: Invalid query: " << options.query << std::endl;
+            return kInputFileError;
+        }
+    }
+
+    const unsigned numThreads = options.numThreads ? options.numThreads : numJobThreads();
+    const unsigned long window = numThreads * 4;
+
+    stdx::mutex mutex;  // protects done and nextToWrite
+    stdx::condition_variable chunkDone;
+    stdx::condition_variable chunkWritten;
+    std::map<unsigned long, std::string> done;  // the reorder buffer
+    unsigned long nextToWrite = 0;
+    AtomicWord<unsigned long long> numMatched{0};
+    AtomicWord<unsigned long long> numUnrenderable{0};
+    AtomicWord<bool> stop{false};
+    LoadedDocBatches batches(
+        [] (unsigned long* numDocs, bool* complete) { cache.getLoadProgress(numDocs, complete); },
+        [] (unsigned long begin, unsigned long end, std::vector<BSONObj>* out) { cache.getLoadedDocs(begin, end, out); },
+        kBatchChunkSize, &stop);
+
+    auto worker = [&] () {
+        std::vector<BSONObj> docs;
+        while (true) {
+            unsigned long begin;
+            try {
+                if ( ! batches.next(&docs, &begin)) {
+                    return;
+                }
+            } catch (DBException& e) {
+                // stopped
+                return;
+            }
+            const unsigned long chunk = begin / kBatchChunkSize;
+            {
+                stdx::unique_lock<stdx::mutex> lk(mutex);
+                chunkWritten.wait(lk, [&] () { return stop.load() || chunk < nextToWrite + window; });
+                if (stop.load()) {
+                    return;
+                }
+            }
+
+            std::string out;
+            for (unsigned long i = 0; i < docs.size(); i++) {
+                if (search) {
+                    auto& candidates = search->getCandidates();
+                    if (candidates && ! std::binary_search(candidates->begin(), candidates->end(), begin + i)) {
+                        continue;
+                    }
+                    try {
+                        if ( ! search->matchesObj(docs[i], fileView.getRenderer())) {
+                            continue;
+                        }
+                    } catch (DBException& e) {
+                        // eg. a corrupt doc, which certainly doesn't match
+                        continue;
+                    }
+                }
+                numMatched.fetchAndAdd(1);
+                if (countOnly) {
+                    continue;
+                }
+                try {
+                    if (rawBSON) {
+                        const BSONObj obj = projection ? projection->project(docs[i]) : docs[i];
+                        out.append(obj.objdata(), obj.objsize());
+                    } else {
+                        out += fileView.renderDoc(docs[i]);
+                        out += '\n';
+                    }
+                } catch (DBException& e) {
+                    numUnrenderable.fetchAndAdd(1);
+                }
+            }
+
+            {
+                stdx::lock_guard<stdx::mutex> lk(mutex);
+                done[chunk] = std::move(out);
+            }
+            chunkDone.notify_one();
+        }
+    };
+
+    std::vector<stdx::thread> threads;
+    for (unsigned i = 0; i < numThreads; i++) {
+        threads.emplace_back(worker);
+    }
+
+    int result = 0;
+    while (true) {
+        if ( ! cache.isComplete()) {
+            cache.loadSome(kBatchChunkSize);
+        }
+
+        std::string out;
+        {
+            stdx::unique_lock<stdx::mutex> lk(mutex);
+            if (cache.isComplete()) {
+                const unsigned long numChunks = (cache.numDocs() + kBatchChunkSize - 1) / kBatchChunkSize;
+                if (nextToWrite >= numChunks) {
+                    break;
+                }
+                // nothing left to load, so just wait for the next chunk
+                chunkDone.wait(lk, [&] () { return done.count(nextToWrite) > 0; });
+            }
+            auto it = done.find(nextToWrite);
+            if (it == done.end()) {
+                continue;
+            }
+            out = std::move(it->second);
+            done.erase(it);
+            nextToWrite++;
+        }
+        chunkWritten.notify_all();
+
+        if ( ! out.empty() && ::fwrite(out.data(), 1, out.size(), stdout) != out.size()) {
+            int res = errno;
+            std::cerr << "bv: Error: Unable to write output: " << errnoWithDescription(res) << std::endl;
+            result = kInputFileError;
+            break;
+        }
+    }
+
+    stop.store(true);
+    chunkWritten.notify_all();
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+    if (result != 0) {
+        return result;
+    }
+
+    if (countOnly) {
+        std::cout << numMatched.load() << std::endl;
+    }
+    if (::fflush(stdout) != 0) {
+        int res = errno;
+        std::cerr << "bv: Error: Unable to write output: " << errnoWithDescription(res) << std::endl;
+        return kInputFileError;
+    }
+    if (numUnrenderable.load() > 0) {
+        std::cerr << "bv: Warning: " << numUnrenderable.load() << " matching docs couldn't be rendered, and were left out." << std::endl;
+    }
+    return 0;
+}
 
+
+// Sets up the windows and handlers on t, whether it's the real terminal or one being replayed.
+static int initUI() {
     root = tickit_get_rootwin(t);
     if (!root) {
         int res = errno;
@@ -1868,30 +4230,555 @@ int _main(int argc, char* argv[], char** envp) {
         return kTermError;
     }
 
-    auto lines = tickit_window_lines(root);
-    auto cols = tickit_window_cols(root);
-
-    mainwin = tickit_window_new(root, (TickitRect){ .top = 0, .left = 0, .lines = lines - 1, .cols = cols }, (TickitWindowFlags)0);
-    tickit_window_bind_event(mainwin, TICKIT_WINDOW_ON_EXPOSE, (TickitBindFlags)0, &render_main, NULL);
+    // the first pane starts off with the whole screen (above the status bar)
+    std::unique_ptr<Pane> pane(new Pane());
+    pane->fileView = &fileView;
+    pane->view = &fileView;
+    pane->viewCache = &cache;
+    pane->viewName = infname;
+    createPaneWindow(pane.get());
+    TickitWindow* mainwin = pane->win;
+    focusedPane = pane.get();
+    panes.push_back(std::move(pane));
+    layoutPanes();
+    tickit_window_bind_event(root, TICKIT_WINDOW_ON_EXPOSE, (TickitBindFlags)0, &render_separators, NULL);
 
-    tickit_window_bind_event(mainwin, TICKIT_WINDOW_ON_KEY, (TickitBindFlags)0, &event_key, NULL);
-    tickit_window_bind_event(mainwin, TICKIT_WINDOW_ON_MOUSE, (TickitBindFlags)0, &event_mouse, NULL);
+    fileView.init(&cache, [] () { tickit_window_expose(root, NULL); }, [] () { status.expose(); });
 
-    view.init(&cache, [] () { tickit_window_expose(root, NULL); }, [] () { status.expose(); });
-
-    status.init(&cache, &view, root);
+    status.init(&cache, &fileView, root);
 
     prompt.init(root, mainwin);
 
+    histogram.init(&cache, &fileView, root, mainwin);
+
     tickit_window_bind_event(root, TICKIT_WINDOW_ON_GEOMCHANGE, (TickitBindFlags)0, &event_resize, NULL);
 
     tickit_window_take_focus(mainwin);
-    tickit_window_set_cursor_visible(mainwin, false);
 
     tickit_watch_later(t, (TickitBindFlags)0, &load_more, NULL);
 
+    registerMemoryConsumers();
+    scheduleMemoryBudgetCheck();
+
+    return 0;
+}
+
+
+// Options for replaying a script of keys against an off-screen terminal, eg.
+// "bv --replay keys.txt --replay-baseline before.bson in.bson".
+struct ReplayOptions {
+    const char* script = nullptr;
+    int lines = 24;
+    int cols = 80;
+    const char* saveFile = nullptr;      // the results of each step are written here as BSON
+    const char* baselineFile = nullptr;  // results from an earlier run, to compare against
+    double tolerance = 20;  // how much slower (in percent) a step can be than its baseline
+};
+
+// Steps which take less than this are never counted as being slower than their baseline, since
+// they're mostly noise.
+const long long kReplayMinRegressionMicros = 1000;
+
+struct ReplayStep {
+    enum Kind {
+        kKeys,  // types bytes into the terminal
+        kLoad,  // loads the rest of the file
+        kWait,  // runs the event loop for waitMillis, eg. for background searches to finish
+    };
+    Kind kind = kKeys;
+    std::string name;  // as written in the script
+    std::string bytes;
+    int waitMillis = 0;
+};
+
+struct ReplayResult {
+    std::string name;
+    long long micros = 0;
+    long long frames = 0;
+    long long docsRendered = 0;
+    long long outputBytes = 0;
+
+    BSONObj toBSON(int step) const {
+        return BSON("step" << step << "keys" << name << "micros" << micros << "frames" << frames
+                           << "docsRendered" << docsRendered << "outputBytes" << outputBytes);
+    }
+};
+
+// What the named keys of a replay script type, as an xterm would send them.
+static const std::map<std::string, std::string> kReplayKeyNames = {
+    {"Enter", "\r"},
+    {"Tab", "\t"},
+    {"S-Tab", "\x1b[Z"},
+    {"Escape", "\x1b"},
+    {"Backspace", "\x7f"},
+    {"Space", " "},
+    {"Up", "\x1b[A"},
+    {"Down", "\x1b[B"},
+    {"Right", "\x1b[C"},
+    {"Left", "\x1b[D"},
+    {"S-Up", "\x1b[1;2A"},
+    {"S-Down", "\x1b[1;2B"},
+    {"Home", "\x1b[H"},
+    {"End", "\x1b[F"},
+    {"PageUp", "\x1b[5~"},
+    {"PageDown", "\x1b[6~"},
+    {"WheelUp", "\x1b[<64;1;1M"},
+    {"WheelDown", "\x1b[<65;1;1M"},
+};
+
+// Parses a replay script, which has a step per line:
+//   j           a single key
+//   PageDown    a named key (see kReplayKeyNames), or C-<letter> for control keys
+//   type abc    some text, eg. for the / prompt
+//   load        load the rest of the file
+//   wait 500    run the event loop for 500ms
+//   j*100       any of the above, 100 times (as 100 steps)
+// Blank lines, and lines starting with "# ", are ignored.
+static StatusWith<std::vector<ReplayStep>> parseReplayScript(std::istream& in) {
+    std::vector<ReplayStep> steps;
+    std::string line;
+    int lineNum = 0;
+    while (std::getline(in, line)) {
+        lineNum++;
+        while ( ! line.empty() && (line.back() == ' ' || line.back() == '\t' || line.back() == '\r')) {
+            line.pop_back();
+        }
+        const auto indent = line.find_first_not_of(" \t");
+        if (indent == std::string::npos || line.compare(indent, 2, "# ") == 0) {
+            continue;
+        }
+        line = line.substr(indent);
+
+        auto error = [&] (const std::string& what) {
+            return Status(ErrorCodes::FailedToParse, str::stream() << "line " << lineNum << ": " << what);
+        };
+
+        unsigned repeat = 1;
+        const auto star = line.rfind('*');
+        if (star != std::string::npos && star > 0 && star + 1 < line.size() &&
+            line.find_first_not_of("0123456789", star + 1) == std::string::npos) {
+            if ( ! NumberParser{}(line.substr(star + 1), &repeat).isOK() || repeat == 0) {
+                return error("bad repeat count");
+            }
+            line.resize(star);
+        }
+
+        ReplayStep step;
+        step.name = line;
+        if (line.compare(0, 5, "type ") == 0) {
+            step.bytes = line.substr(5);
+        } else if (line == "load") {
+            step.kind = ReplayStep::kLoad;
+        } else if (line.compare(0, 5, "wait ") == 0) {
+            step.kind = ReplayStep::kWait;
+            if ( ! NumberParser{}(line.substr(5), &step.waitMillis).isOK() || step.waitMillis < 0) {
+                return error("bad wait time '" + line.substr(5) + "'");
+            }
+        } else if (kReplayKeyNames.count(line)) {
+            step.bytes = kReplayKeyNames.at(line);
+        } else if (line.size() == 3 && line.compare(0, 2, "C-") == 0 && std::isalpha(line[2])) {
+            step.bytes = std::string(1, line[2] & 0x1f);
+        } else if (line.size() == 1) {
+            step.bytes = line;
+        } else {
+            return error("unknown key '" + line + "'");
+        }
+        steps.insert(steps.end(), repeat, step);
+    }
+    if (in.bad()) {
+        return Status(ErrorCodes::FileStreamFailed, "unable to read");
+    }
+    return steps;
+}
+
+// Reads the results of an earlier replay, as written with --replay-save.
+static StatusWith<std::vector<ReplayResult>> readReplayResults(const char* fname) {
+    std::ifstream in(fname, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (in.bad() || ! in.is_open()) {
+        return Status(ErrorCodes::FileStreamFailed, "unable to read");
+    }
+    std::vector<ReplayResult> results;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        int32_t size = 0;
+        if (data.size() - pos >= sizeof(size)) {
+            size = ConstDataView(data.data() + pos).read<LittleEndian<int32_t>>();
+        }
+        if (size < BSONObj::kMinBSONLength || static_cast<size_t>(size) > data.size() - pos) {
+            return Status(ErrorCodes::InvalidBSON, str::stream() << "bad doc at offset " << pos);
+        }
+        const BSONObj obj(data.data() + pos);
+        ReplayResult result;
+        result.name = obj["keys"].str();
+        result.micros = obj["micros"].safeNumberLong();
+        result.frames = obj["frames"].safeNumberLong();
+        result.docsRendered = obj["docsRendered"].safeNumberLong();
+        result.outputBytes = obj["outputBytes"].safeNumberLong();
+        results.push_back(std::move(result));
+        pos += size;
+    }
+    return results;
+}
+
+static void countOutputBytes(TickitTerm* tt, const char* bytes, size_t len, void* user) {
+    *static_cast<long long*>(user) += len;
+}
+
+// Feeds a script of keys through the same handlers as the terminal would, but with the output
+// going nowhere, and times each step.  The frames drawn, docs rendered and bytes written by each
+// step are counted too, since those are what usually regress (eg. a redraw which re-renders the
+// whole screen for every line scrolled), and unlike the timings they don't vary from run to run.
+// With a baseline, any step which got worse fails the run.
+static int runReplay(const ReplayOptions& options) {
+    std::vector<ReplayStep> steps;
+    {
+        std::ifstream in(options.script);
+        if ( ! in) {
+            std::cerr << "bv: Error: Unable to open replay script '" << options.script << "'" << std::endl;
+            return kInputFileError;
+        }
+        auto parsed = parseReplayScript(in);
+        if ( ! parsed.isOK()) {
+            std::cerr << "bv: Error: Invalid replay script '" << options.script << "': " << parsed.getStatus().reason() << std::endl;
+            return kInputFileError;
+        }
+        steps = std::move(parsed.getValue());
+    }
+
+    std::vector<ReplayResult> baseline;
+    if (options.baselineFile) {
+        auto read = readReplayResults(options.baselineFile);
+        if ( ! read.isOK()) {
+            std::cerr << "bv: Error: Unable to read replay baseline '" << options.baselineFile << "': " << read.getStatus().reason() << std::endl;
+            return kInputFileError;
+        }
+        baseline = std::move(read.getValue());
+        if (baseline.size() != steps.size()) {
+            std::cerr << "bv: Error: Replay baseline '" << options.baselineFile << "' has " << baseline.size() << " steps, but the script has " << steps.size() << "." << std::endl;
+            return kInputFileError;
+        }
+    }
+
+    long long outputBytes = 0;
+    TickitTerm* tt = tickit_term_new_for_termtype("xterm");
+    if ( ! tt) {
+        int res = errno;
+        std::cerr << "bv: Error: Unable to create replay terminal: " << errnoWithDescription(res) << std::endl;
+        return kTermError;
+    }
+    tickit_term_set_output_func(tt, &countOutputBytes, &outputBytes);
+    tickit_term_set_size(tt, options.lines, options.cols);
+    t = tickit_new_for_term(tt);
+    tickit_term_unref(tt);
+
+    if (int res = initUI()) {
+        return res;
+    }
+    // the first tick sets up the terminal, and draws the first screen, which isn't a step
+    tickit_tick(t, TICKIT_RUN_NOHANG);
+
+    std::vector<ReplayResult> results;
+    for (auto&& step : steps) {
+        const long long framesBefore = frameStats.phase(FrameStats::kFrame).count();
+        const long long docsBefore = frameStats.numDocsRendered();
+        const long long bytesBefore = outputBytes;
+        const auto start = std::chrono::steady_clock::now();
+
+        switch (step.kind) {
+        case ReplayStep::kKeys:
+            tickit_term_input_push_bytes(tt, step.bytes.data(), step.bytes.size());
+            // a lone Escape could be the start of a longer key, so it's only delivered once the
+            // terminal gives up waiting for the rest
+            for (int msec; (msec = tickit_term_input_check_timeout_msec(tt)) > 0; ) {
+                sleepmillis(msec);
+            }
+            break;
+        case ReplayStep::kLoad:
+            cache.loadAll();
+            break;
+        case ReplayStep::kWait: {
+            const auto until = start + std::chrono::milliseconds(step.waitMillis);
+            while (std::chrono::steady_clock::now() < until) {
+                tickit_tick(t, TICKIT_RUN_NOHANG);
+                sleepmillis(1);
+            }
+            break;
+        }
+        }
+        // run whatever the step left to do later (eg. loading more), and draw the result, without
+        // waiting for the next frame to move
+        applyPendingMotion();
+        tickit_tick(t, TICKIT_RUN_NOHANG);
+        tickit_window_flush(root);
+
+        ReplayResult result;
+        result.name = step.name;
+        result.micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        result.frames = frameStats.phase(FrameStats::kFrame).count() - framesBefore;
+        result.docsRendered = frameStats.numDocsRendered() - docsBefore;
+        result.outputBytes = outputBytes - bytesBefore;
+        results.push_back(std::move(result));
+    }
+
+    std::cout << std::setw(6) << "step" << "  " << std::left << std::setw(16) << "keys" << std::right
+              << std::setw(12) << "micros" << std::setw(8) << "frames" << std::setw(8) << "docs"
+              << std::setw(10) << "bytes" << std::endl;
+    int regressions = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        const ReplayResult& r = results[i];
+        std::cout << std::setw(6) << i << "  " << std::left << std::setw(16) << r.name << std::right
+                  << std::setw(12) << r.micros << std::setw(8) << r.frames << std::setw(8)
+                  << r.docsRendered << std::setw(10) << r.outputBytes << std::endl;
+        if (baseline.empty()) {
+            continue;
+        }
+        const ReplayResult& b = baseline[i];
+        auto regressed = [&] (const char* what, long long now, long long before) {
+            std::cout << "        regression: " << what << " " << now << ", was " << before << std::endl;
+            regressions++;
+        };
+        if (r.name != b.name) {
+            std::cerr << "bv: Error: Replay baseline '" << options.baselineFile << "' is for a different script, step " << i << " was '" << b.name << "'." << std::endl;
+            return kInputFileError;
+        }
+        if (r.micros > kReplayMinRegressionMicros && r.micros > b.micros * (1 + options.tolerance / 100)) {
+            regressed("micros", r.micros, b.micros);
+        }
+        if (r.frames > b.frames) {
+            regressed("frames", r.frames, b.frames);
+        }
+        if (r.docsRendered > b.docsRendered) {
+            regressed("docs", r.docsRendered, b.docsRendered);
+        }
+        if (r.outputBytes > b.outputBytes) {
+            regressed("bytes", r.outputBytes, b.outputBytes);
+        }
+    }
+
+    if (options.saveFile) {
+        std::ofstream out(options.saveFile, std::ios::binary | std::ios::trunc);
+        for (size_t i = 0; i < results.size(); i++) {
+            const BSONObj obj = results[i].toBSON(i);
+            out.write(obj.objdata(), obj.objsize());
+        }
+        out.close();
+        if ( ! out) {
+            std::cerr << "bv: Error: Unable to write replay results to '" << options.saveFile << "'" << std::endl;
+            return kInputFileError;
+        }
+    }
+
+    if (regressions > 0) {
+        std::cerr << "bv: " << regressions << " regressions against the replay baseline." << std::endl;
+        return kReplayRegression;
+    }
+    return 0;
+}
+
+
+int _main(int argc, char* argv[], char** envp) {
+
+    std::vector<const char*> files;
+    bool diffMode = false;
+    bool batchMode = false;
+    BatchOptions batchOptions;
+    ReplayOptions replayOptions;
+    bool usageError = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--diff") {
+            diffMode = true;
+        } else if (arg == "--frame-stats") {
+            if (i + 1 >= argc) {
+                usageError = true;
+                break;
+            }
+            frameStatsFile = argv[++i];
+        } else if (arg == "--memory-budget") {
+            if (i + 1 >= argc) {
+                usageError = true;
+                break;
+            }
+            auto budget = parseByteSize(argv[++i]);
+            if ( ! budget.isOK()) {
+                std::cerr << "bv: Error: --memory-budget must be a size, eg. 512M or 4G." << std::endl;
+                return kInputFileError;
+            }
+            memoryRegistry.setBudget(budget.getValue());
+        } else if (arg == "--replay" || arg == "--replay-size" || arg == "--replay-save" ||
+                   arg == "--replay-baseline" || arg == "--replay-tolerance") {
+            if (i + 1 >= argc) {
+                usageError = true;
+                break;
+            }
+            const char* value = argv[++i];
+            if (arg == "--replay") {
+                replayOptions.script = value;
+            } else if (arg == "--replay-save") {
+                replayOptions.saveFile = value;
+            } else if (arg == "--replay-baseline") {
+                replayOptions.baselineFile = value;
+            } else if (arg == "--replay-size") {
+                const char* x = strchr(value, 'x');
+                if ( ! x ||
+                    ! NumberParser{}(StringData(value, x - value), &replayOptions.lines).isOK() ||
+                    ! NumberParser{}(x + 1, &replayOptions.cols).isOK() ||
+                    replayOptions.lines < 2 || replayOptions.cols < 1) {
+                    std::cerr << "bv: Error: --replay-size must be <lines>x<cols>, eg. 24x80." << std::endl;
+                    return kInputFileError;
+                }
+            } else if ( ! NumberParser{}(value, &replayOptions.tolerance).isOK() || replayOptions.tolerance < 0) {
+                std::cerr << "bv: Error: --replay-tolerance must be a non-negative percentage." << std::endl;
+                return kInputFileError;
+            }
+        } else if (arg == "--query" || arg == "--project" || arg == "--format" || arg == "--threads") {
+            if (i + 1 >= argc) {
+                usageError = true;
+                break;
+            }
+            batchMode = true;
+            const std::string value = argv[++i];
+            if (arg == "--query") {
+                batchOptions.query = value;
+            } else if (arg == "--project") {
+                batchOptions.projection = value;
+            } else if (arg == "--format") {
+                batchOptions.format = value;
+            } else if ( ! NumberParser{}(value, &batchOptions.numThreads).isOK() || batchOptions.numThreads == 0) {
+                std::cerr << "bv: Error: --threads must be a positive number." << std::endl;
+                return kInputFileError;
+            }
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if ((replayOptions.saveFile || replayOptions.baselineFile) && ! replayOptions.script) {
+        usageError = true;
+    }
+    if (replayOptions.script && (batchMode || diffMode)) {
+        usageError = true;
+    }
+
+    if (diffMode && ! batchMode && files.size() == 2) {
+        infname = files[0];
+        otherfname = files[1];
+    } else if ( ! diffMode && ! files.empty() && ! usageError) {
+        infname = files[0];
+    } else {
+        std::cerr << "Usage: bv [--frame-stats <statsfile>] [--memory-budget <bytes>[K|M|G|T]] <bsonfile|dir>..." << std::endl;
+        std::cerr << "       bv [--frame-stats <statsfile>] [--memory-budget <bytes>[K|M|G|T]] --diff <bsonfile> <otherbsonfile>" << std::endl;
+        std::cerr << "       bv [--query <query>] [--project <projection>] [--format json|pretty|bson|count] [--threads <n>] <bsonfile|dir>..." << std::endl;
+        std::cerr << "       bv --replay <script> [--replay-size <lines>x<cols>] [--replay-save <results>] [--replay-baseline <results>] [--replay-tolerance <percent>] <bsonfile|dir>..." << std::endl;
+        std::cerr << "  Several input files, or directories of them (eg. from mongodump), are shown one after another, as if they were one file." << std::endl;
+        std::cerr << "  Files that are each in order of a field (eg. the oplogs of a replica set, by ts) can be interleaved in order of it with :merge <field>." << std::endl;
+        std::cerr << "  With any of --query, --project, --format or --threads, the matching docs are written to stdout instead of being shown." << std::endl;
+        std::cerr << "  With --memory-budget, cached search results and the resident pages of the input files are let go of whenever bv's resident size is over the budget." << std::endl;
+        std::cerr << "  With --frame-stats, the latency histograms of the UI (as shown by T) are written to statsfile as BSON on exit." << std::endl;
+        std::cerr << "  With --replay, the keys in script are fed to an off-screen terminal (24x80 by default), and the time, frames, docs rendered and bytes written by each step are printed." << std::endl;
+        std::cerr << "  The results can be saved as BSON, and compared against those saved by an earlier run, which fails if any step got worse (or more than 20% slower, by default)." << std::endl;
+        return kInputFileError;
+    }
+
+    struct stat sb;
+    const bool isDir = ::stat(infname, &sb) == 0 && (sb.st_mode & S_IFMT) == S_IFDIR;
+    if (diffMode) {
+        // the diff is of two files, by their offsets, so sets of files aren't supported
+        for (const char* fname : {infname, otherfname}) {
+            if (::stat(fname, &sb) == 0 && (sb.st_mode & S_IFMT) == S_IFDIR) {
+                std::cerr << "bv: Error: --diff compares two files, but '" << fname << "' is a directory." << std::endl;
+                return kInputFileError;
+            }
+        }
+    }
+    if ( ! diffMode && (files.size() > 1 || isDir)) {
+        auto paths = BSONFileSet::expandPaths(std::vector<std::string>(files.begin(), files.end()));
+        if ( ! paths.isOK()) {
+            std::cerr << "bv: Error: " << paths.getStatus().reason() << std::endl;
+            return kInputFileError;
+        }
+        if (paths.getValue().empty()) {
+            std::cerr << "bv: Error: No .bson files in '" << infname << "'." << std::endl;
+            return kInputFileError;
+        }
+        inputFilesName = (files.size() == 1) ? std::string(infname) : str::stream() << files.size() << " files";
+        infname = inputFilesName.c_str();
+        Status opened = inputFiles.open(std::move(paths.getValue()));
+        if ( ! opened.isOK()) {
+            std::cerr << "bv: Error: " << opened.reason() << std::endl;
+            return kInputFileError;
+        }
+
+        // the indexing threads only walk the files ahead of the loader, so they're started first
+        inputFiles.startIndexing(numJobThreads());
+        try {
+            cache.init(&inputFiles);
+        } catch (mongo::DBException& e) {
+            std::cerr << "bv: Error: Unable to read/parse first document from the input files, are they BSON files?" << std::endl;
+            throw;
+        }
+        if (cache.numDocs() == 0) {
+            std::cerr << "bv: Error: The input files have no docs." << std::endl;
+            return kInputFileError;
+        }
+
+    } else {
+        const char* base;
+        if (int res = mapInputFile(infname, sb, &infd, &base)) {
+            return res;
+        }
+
+        infileId = FieldValueIndex::FileId::fromStat(sb);
+        fieldIndexes.loadExisting(infname, infileId);
+
+        try {
+            cache.init(base, base + sb.st_size);
+        } catch (mongo::DBException& e) {
+            std::cerr << "bv: Error: Unable to read/parse first document from input file '" << infname << "', is this a BSON file?" << std::endl;
+            throw;
+        }
+    }
+
+    if (otherfname) {
+        struct stat othersb;
+        int otherfd;
+        const char* otherbase;
+        if (int res = mapInputFile(otherfname, othersb, &otherfd, &otherbase)) {
+            return res;
+        }
+        try {
+            otherCache.init(otherbase, otherbase + othersb.st_size);
+        } catch (mongo::DBException& e) {
+            std::cerr << "bv: Error: Unable to read/parse first document from input file '" << otherfname << "', is this a BSON file?" << std::endl;
+            throw;
+        }
+    }
+
+    if (batchMode) {
+        return runBatch(batchOptions);
+    }
+
+    if (replayOptions.script) {
+        return runReplay(replayOptions);
+    }
+
+    t = tickit_new_stdio();
+
+    if (int res = initUI()) {
+        return res;
+    }
+
+    if (otherfname) {
+        startDiff();
+    }
+
     tickit_run(t);
 
+    if (frameStatsFile) {
+        writeFrameStats(frameStatsFile);
+    }
+
     return 0;
 }
 
@@ -1910,6 +4797,10 @@ void tickitDone() {
 int main(int argc, char* argv[], char** envp) {
     int returnCode;
     try {
+        // registers the aggregation stages, amongst other things
+        runGlobalInitializersOrDie(argc, argv, envp);
+        // the sorter needs one for spilling
+        setGlobalServiceContext(ServiceContext::make());
         returnCode = _main(argc, argv, envp);
         tickitDone();
     } catch (mongo::DBException& e) {
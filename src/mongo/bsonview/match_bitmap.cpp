@@ -0,0 +1,334 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/match_bitmap.h"
+
+#include <algorithm>
+
+namespace mongo {
+
+MatchBitmap::State MatchBitmap::_getInChunk(const Chunk& c, unsigned long offset) {
+    switch (c.kind) {
+        case Chunk::kUnevaluated:
+            return State::kUnknown;
+        case Chunk::kPartial:
+            if (!c.evaluated->test(offset)) {
+                return State::kUnknown;
+            }
+            return c.matched->test(offset) ? State::kMatch : State::kNoMatch;
+        case Chunk::kNone:
+            return State::kNoMatch;
+        case Chunk::kAll:
+            return State::kMatch;
+        case Chunk::kSparse:
+            return std::binary_search(c.sparse.begin(), c.sparse.end(), offset) ? State::kMatch
+                                                                                : State::kNoMatch;
+        case Chunk::kDense:
+            return c.matched->test(offset) ? State::kMatch : State::kNoMatch;
+    }
+    return State::kUnknown;
+}
+
+MatchBitmap::State MatchBitmap::get(unsigned long doc) const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    unsigned long chunk = doc / kChunkSize;
+    if (chunk >= _chunks.size()) {
+        return State::kUnknown;
+    }
+    return _getInChunk(_chunks[chunk], doc % kChunkSize);
+}
+
+void MatchBitmap::set(unsigned long doc, bool match) {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    unsigned long chunk = doc / kChunkSize;
+    _ensureChunks(chunk + 1);
+    Chunk& c = _chunks[chunk];
+    if (c.isComplete()) {
+        return;
+    }
+    if (c.kind == Chunk::kUnevaluated) {
+        c.kind = Chunk::kPartial;
+        c.evaluated = std::make_unique<ChunkBits>();
+        c.matched = std::make_unique<ChunkBits>();
+    }
+    c.evaluated->set(doc % kChunkSize);
+    c.matched->set(doc % kChunkSize, match);
+}
+
+boost::optional<unsigned long> MatchBitmap::findNext(unsigned long from,
+                                                     unsigned long end,
+                                                     unsigned long* firstUnknown) const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    unsigned long doc = from;
+    while (doc < end) {
+        unsigned long chunk = doc / kChunkSize;
+        unsigned long offset = doc % kChunkSize;
+        unsigned long chunkEnd = std::min((chunk + 1) * kChunkSize, end);
+        if (chunk >= _chunks.size()) {
+            *firstUnknown = doc;
+            return boost::none;
+        }
+        const Chunk& c = _chunks[chunk];
+        switch (c.kind) {
+            case Chunk::kNone:
+                break;
+            case Chunk::kAll:
+                return doc;
+            case Chunk::kSparse: {
+                auto it = std::lower_bound(c.sparse.begin(), c.sparse.end(), offset);
+                if (it != c.sparse.end() && chunk * kChunkSize + *it < end) {
+                    return chunk * kChunkSize + *it;
+                }
+                break;
+            }
+            default:
+                for (; doc < chunkEnd; doc++) {
+                    switch (_getInChunk(c, doc % kChunkSize)) {
+                        case State::kUnknown:
+                            *firstUnknown = doc;
+                            return boost::none;
+                        case State::kMatch:
+                            return doc;
+                        case State::kNoMatch:
+                            break;
+                    }
+                }
+                break;
+        }
+        doc = chunkEnd;
+    }
+    *firstUnknown = end;
+    return boost::none;
+}
+
+unsigned long MatchBitmap::countMatches(unsigned long begin,
+                                        unsigned long end,
+                                        unsigned long* numUnknown) const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    unsigned long count = 0;
+    unsigned long doc = begin;
+    while (doc < end) {
+        unsigned long chunk = doc / kChunkSize;
+        unsigned long base = chunk * kChunkSize;
+        unsigned long chunkEnd = std::min(base + kChunkSize, end);
+        if (chunk >= _chunks.size()) {
+            *numUnknown += end - doc;
+            break;
+        }
+        const Chunk& c = _chunks[chunk];
+        switch (c.kind) {
+            case Chunk::kNone:
+                break;
+            case Chunk::kAll:
+                count += chunkEnd - doc;
+                break;
+            case Chunk::kSparse:
+                count += std::lower_bound(c.sparse.begin(), c.sparse.end(), chunkEnd - base) -
+                    std::lower_bound(c.sparse.begin(), c.sparse.end(), doc - base);
+                break;
+            case Chunk::kDense:
+                if (doc == base && chunkEnd == base + kChunkSize) {
+                    count += c.matched->count();
+                } else {
+                    // keep only the bits in [doc, chunkEnd)
+                    count += ((*c.matched << (base + kChunkSize - chunkEnd)) >>
+                              (base + kChunkSize - chunkEnd + doc - base))
+                                 .count();
+                }
+                break;
+            default:
+                for (; doc < chunkEnd; doc++) {
+                    switch (_getInChunk(c, doc - base)) {
+                        case State::kUnknown:
+                            (*numUnknown)++;
+                            break;
+                        case State::kMatch:
+                            count++;
+                            break;
+                        case State::kNoMatch:
+                            break;
+                    }
+                }
+                break;
+        }
+        doc = chunkEnd;
+    }
+    return count;
+}
+
+boost::optional<unsigned long> MatchBitmap::claimChunk(unsigned long focusChunk,
+                                                       unsigned long numDocs,
+                                                       bool allLoaded) {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    unsigned long available = allLoaded ? (numDocs + kChunkSize - 1) / kChunkSize
+                                        : numDocs / kChunkSize;
+    _ensureChunks(available);
+
+    if (focusChunk != _focusChunk) {
+        _focusChunk = focusChunk;
+        _forwardCursor = focusChunk;
+        _wrapCursor = 0;
+    }
+
+    auto claimable = [&](unsigned long chunk) {
+        return !_chunks[chunk].isComplete() && !_chunks[chunk].claimed;
+    };
+
+    while (_forwardCursor < available && !claimable(_forwardCursor)) {
+        _forwardCursor++;
+    }
+    if (_forwardCursor < available) {
+        _chunks[_forwardCursor].claimed = true;
+        return _forwardCursor++;
+    }
+
+    unsigned long wrapEnd = std::min(_focusChunk, available);
+    while (_wrapCursor < wrapEnd && !claimable(_wrapCursor)) {
+        _wrapCursor++;
+    }
+    if (_wrapCursor < wrapEnd) {
+        _chunks[_wrapCursor].claimed = true;
+        return _wrapCursor++;
+    }
+
+    return boost::none;
+}
+
+void MatchBitmap::setChunk(unsigned long chunk, const ChunkBits& matched, unsigned long numDocs) {
+    size_t count = (numDocs == kChunkSize) ? matched.count()
+                                           : (matched << (kChunkSize - numDocs)).count();
+
+    Chunk result;
+    if (count == 0) {
+        result.kind = Chunk::kNone;
+    } else if (count == numDocs) {
+        result.kind = Chunk::kAll;
+    } else if (count < kMaxSparse) {
+        result.kind = Chunk::kSparse;
+        result.sparse.reserve(count);
+        for (unsigned long i = 0; i < numDocs; i++) {
+            if (matched.test(i)) {
+                result.sparse.push_back(i);
+            }
+        }
+    } else {
+        result.kind = Chunk::kDense;
+        result.matched = std::make_unique<ChunkBits>(matched);
+    }
+
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    _ensureChunks(chunk + 1);
+    _chunks[chunk] = std::move(result);
+}
+
+void MatchBitmap::releaseChunk(unsigned long chunk) {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    if (chunk < _chunks.size()) {
+        _chunks[chunk].claimed = false;
+        // make sure it gets picked up again
+        if (chunk >= _focusChunk) {
+            _forwardCursor = std::min(_forwardCursor, chunk);
+        } else {
+            _wrapCursor = std::min(_wrapCursor, chunk);
+        }
+    }
+}
+
+bool MatchBitmap::isChunkComplete(unsigned long chunk) const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    return chunk < _chunks.size() && _chunks[chunk].isComplete();
+}
+
+bool MatchBitmap::appendMatches(unsigned long begin,
+                                unsigned long end,
+                                std::vector<unsigned long>* out) const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    unsigned long chunk = begin / kChunkSize;
+    if (chunk >= _chunks.size() || !_chunks[chunk].isComplete()) {
+        return false;
+    }
+    const Chunk& c = _chunks[chunk];
+    unsigned long base = chunk * kChunkSize;
+    switch (c.kind) {
+        case Chunk::kNone:
+            break;
+        case Chunk::kAll:
+            for (unsigned long doc = begin; doc < end; doc++) {
+                out->push_back(doc);
+            }
+            break;
+        case Chunk::kSparse:
+            for (auto it = std::lower_bound(c.sparse.begin(), c.sparse.end(), begin - base);
+                 it != c.sparse.end() && base + *it < end;
+                 ++it) {
+                out->push_back(base + *it);
+            }
+            break;
+        default:
+            for (unsigned long doc = begin; doc < end; doc++) {
+                if (c.matched->test(doc - base)) {
+                    out->push_back(doc);
+                }
+            }
+            break;
+    }
+    return true;
+}
+
+void MatchBitmap::clear() {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    // and give back the memory, since the bitmap of a big file can be big
+    std::vector<Chunk>().swap(_chunks);
+    _focusChunk = _forwardCursor = _wrapCursor = 0;
+}
+
+size_t MatchBitmap::memoryUsage() const {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    size_t bytes = _chunks.capacity() * sizeof(Chunk);
+    for (auto&& c : _chunks) {
+        bytes += c.sparse.capacity() * sizeof(uint16_t);
+        if (c.matched) {
+            bytes += sizeof(ChunkBits);
+        }
+        if (c.evaluated) {
+            bytes += sizeof(ChunkBits);
+        }
+    }
+    return bytes;
+}
+
+void MatchBitmap::_ensureChunks(unsigned long numChunks) {
+    if (_chunks.size() < numChunks) {
+        _chunks.resize(numChunks);
+    }
+}
+
+}  // namespace mongo
@@ -0,0 +1,161 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <bitset>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "mongo/stdx/mutex.h"
+
+namespace mongo {
+
+/**
+ * Records which documents a Search matches, indexed by document number.  Every document is in one
+ * of three states: not yet evaluated, evaluated and not matching, or evaluated and matching.
+ *
+ * Documents are grouped into fixed-size chunks.  A chunk which has not been evaluated, or which
+ * has been evaluated and turned out to match nothing (or everything), takes no storage beyond its
+ * header.  Chunks with a few matches keep a sorted list of offsets, and only densely matching
+ * chunks need a full bitset.
+ *
+ * Whole chunks are evaluated by background workers, which claimChunk() and then setChunk().  The
+ * UI thread may also record individual documents with set(), eg. for documents that become
+ * visible before the workers get to them.
+ *
+ * All methods are thread-safe.
+ */
+class MatchBitmap {
+public:
+    enum class State {
+        kUnknown,
+        kNoMatch,
+        kMatch,
+    };
+
+    static constexpr unsigned long kChunkSize = 4096;
+    using ChunkBits = std::bitset<kChunkSize>;
+
+    State get(unsigned long doc) const;
+
+    void set(unsigned long doc, bool match);
+
+    /**
+     * Returns the first matching doc in [from, end), provided that it can be found without
+     * passing any unevaluated docs.  Otherwise returns boost::none, and sets *firstUnknown to the
+     * first unevaluated doc (or to end, if every doc in the range has been evaluated).
+     */
+    boost::optional<unsigned long> findNext(unsigned long from,
+                                            unsigned long end,
+                                            unsigned long* firstUnknown) const;
+
+    /**
+     * Returns how many of the docs in [begin, end) match.  Docs which haven't been evaluated yet
+     * aren't counted, but are added to *numUnknown.
+     */
+    unsigned long countMatches(unsigned long begin,
+                               unsigned long end,
+                               unsigned long* numUnknown) const;
+
+    /**
+     * Picks a chunk for a background worker to evaluate, preferring the first unevaluated chunk
+     * at or after focusChunk, and then wrapping around to the start.  Only chunks which are fully
+     * loaded (ie. entirely below numDocs, unless allLoaded) are considered.  The chunk is marked
+     * as claimed, and the caller must later either setChunk() or releaseChunk() it.
+     */
+    boost::optional<unsigned long> claimChunk(unsigned long focusChunk,
+                                              unsigned long numDocs,
+                                              bool allLoaded);
+
+    /**
+     * Stores the result of evaluating every doc in the chunk.  Only the first numDocs bits of
+     * matched are meaningful (this is less than kChunkSize only for the last chunk of the file).
+     */
+    void setChunk(unsigned long chunk, const ChunkBits& matched, unsigned long numDocs);
+
+    void releaseChunk(unsigned long chunk);
+
+    bool isChunkComplete(unsigned long chunk) const;
+
+    /**
+     * Appends the matching docs in [begin, end) to *out, in order.  The range must lie within a
+     * single chunk, which must be complete (otherwise returns false and appends nothing).
+     */
+    bool appendMatches(unsigned long begin, unsigned long end, std::vector<unsigned long>* out) const;
+
+    void clear();
+
+    // The bytes used by the chunks and their lists and bitsets.
+    size_t memoryUsage() const;
+
+private:
+    struct Chunk {
+        enum Kind : uint8_t {
+            kUnevaluated,
+            kPartial,  // some docs have been evaluated individually; uses evaluated and matched
+            kNone,
+            kAll,
+            kSparse,  // uses sparse
+            kDense,   // uses matched
+        };
+
+        Kind kind = kUnevaluated;
+        bool claimed = false;
+        std::vector<uint16_t> sparse;  // sorted offsets of the matching docs
+        std::unique_ptr<ChunkBits> matched;
+        std::unique_ptr<ChunkBits> evaluated;
+
+        bool isComplete() const {
+            return kind != kUnevaluated && kind != kPartial;
+        }
+    };
+
+    // Chunks with fewer matches than this are stored as a list of uint16_t offsets, which is
+    // smaller than a bitset.
+    static constexpr size_t kMaxSparse = kChunkSize / 16;
+
+    static State _getInChunk(const Chunk& c, unsigned long offset);
+
+    void _ensureChunks(unsigned long numChunks);
+
+    mutable stdx::mutex _mutex;
+    std::vector<Chunk> _chunks;
+
+    // Cursors for claimChunk(), so that each claim doesn't have to rescan the completed chunks.
+    // The forward cursor walks from the focus to the end of the loaded docs, and the wrap cursor
+    // from the start of the file up to the focus.  Both are reset when the focus changes.
+    unsigned long _focusChunk = 0;
+    unsigned long _forwardCursor = 0;
+    unsigned long _wrapCursor = 0;
+};
+
+}  // namespace mongo
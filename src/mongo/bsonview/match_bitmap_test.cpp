@@ -0,0 +1,227 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/match_bitmap.h"
+
+#include "mongo/unittest/unittest.h"
+
+namespace mongo {
+namespace {
+
+const unsigned long kChunk = MatchBitmap::kChunkSize;
+
+// The docs in [begin, end) of a chunk, every step'th one.
+MatchBitmap::ChunkBits bitsOf(unsigned long begin, unsigned long end, unsigned long step = 1) {
+    MatchBitmap::ChunkBits bits;
+    for (unsigned long i = begin; i < end; i += step) {
+        bits.set(i);
+    }
+    return bits;
+}
+
+TEST(MatchBitmap, Unevaluated) {
+    MatchBitmap bitmap;
+    ASSERT(bitmap.get(0) == MatchBitmap::State::kUnknown);
+    ASSERT(bitmap.get(10 * kChunk) == MatchBitmap::State::kUnknown);
+
+    unsigned long firstUnknown = 0;
+    ASSERT_FALSE(bitmap.findNext(5, 100, &firstUnknown));
+    ASSERT_EQ(firstUnknown, 5UL);
+
+    unsigned long numUnknown = 0;
+    ASSERT_EQ(bitmap.countMatches(0, 100, &numUnknown), 0UL);
+    ASSERT_EQ(numUnknown, 100UL);
+    ASSERT_FALSE(bitmap.isChunkComplete(0));
+
+    std::vector<unsigned long> out;
+    ASSERT_FALSE(bitmap.appendMatches(0, kChunk, &out));
+    ASSERT(out.empty());
+}
+
+TEST(MatchBitmap, SetIndividualDocs) {
+    MatchBitmap bitmap;
+    bitmap.set(2, false);
+    bitmap.set(3, true);
+    bitmap.set(4, false);
+    ASSERT(bitmap.get(3) == MatchBitmap::State::kMatch);
+    ASSERT(bitmap.get(4) == MatchBitmap::State::kNoMatch);
+    ASSERT(bitmap.get(5) == MatchBitmap::State::kUnknown);
+    ASSERT_FALSE(bitmap.isChunkComplete(0));
+
+    // a match is only found if there are no unknown docs before it
+    unsigned long firstUnknown = 0;
+    ASSERT_EQ(*bitmap.findNext(2, 100, &firstUnknown), 3UL);
+    ASSERT_FALSE(bitmap.findNext(0, 100, &firstUnknown));
+    ASSERT_EQ(firstUnknown, 0UL);
+    ASSERT_FALSE(bitmap.findNext(4, 100, &firstUnknown));
+    ASSERT_EQ(firstUnknown, 5UL);
+
+    unsigned long numUnknown = 0;
+    ASSERT_EQ(bitmap.countMatches(3, 7, &numUnknown), 1UL);
+    ASSERT_EQ(numUnknown, 2UL);
+}
+
+TEST(MatchBitmap, ChunkKinds) {
+    MatchBitmap bitmap;
+    bitmap.setChunk(0, bitsOf(0, 0), kChunk);                   // none
+    bitmap.setChunk(1, bitsOf(0, kChunk), kChunk);              // all
+    bitmap.setChunk(2, bitsOf(10, 20), kChunk);                 // sparse
+    bitmap.setChunk(3, bitsOf(0, kChunk, 2), kChunk);           // dense
+    for (unsigned long chunk = 0; chunk < 4; chunk++) {
+        ASSERT(bitmap.isChunkComplete(chunk));
+    }
+
+    unsigned long numUnknown = 0;
+    ASSERT_EQ(bitmap.countMatches(0, kChunk, &numUnknown), 0UL);
+    ASSERT_EQ(bitmap.countMatches(kChunk, 2 * kChunk, &numUnknown), kChunk);
+    ASSERT_EQ(bitmap.countMatches(2 * kChunk, 3 * kChunk, &numUnknown), 10UL);
+    ASSERT_EQ(bitmap.countMatches(3 * kChunk, 4 * kChunk, &numUnknown), kChunk / 2);
+    ASSERT_EQ(numUnknown, 0UL);
+
+    // part way through each kind
+    ASSERT_EQ(bitmap.countMatches(kChunk + 5, kChunk + 9, &numUnknown), 4UL);
+    ASSERT_EQ(bitmap.countMatches(2 * kChunk + 15, 2 * kChunk + 100, &numUnknown), 5UL);
+    ASSERT_EQ(bitmap.countMatches(3 * kChunk + 1, 3 * kChunk + 11, &numUnknown), 5UL);
+    ASSERT_EQ(bitmap.countMatches(0, 4 * kChunk, &numUnknown), kChunk + 10 + kChunk / 2);
+
+    ASSERT(bitmap.get(2 * kChunk + 9) == MatchBitmap::State::kNoMatch);
+    ASSERT(bitmap.get(2 * kChunk + 10) == MatchBitmap::State::kMatch);
+    ASSERT(bitmap.get(3 * kChunk + 1) == MatchBitmap::State::kNoMatch);
+    ASSERT(bitmap.get(3 * kChunk + 2) == MatchBitmap::State::kMatch);
+
+    unsigned long firstUnknown = 0;
+    ASSERT_EQ(*bitmap.findNext(0, 4 * kChunk, &firstUnknown), kChunk);
+    ASSERT_EQ(*bitmap.findNext(2 * kChunk, 4 * kChunk, &firstUnknown), 2 * kChunk + 10);
+    ASSERT_EQ(*bitmap.findNext(2 * kChunk + 20, 4 * kChunk, &firstUnknown), 3 * kChunk);
+    ASSERT_FALSE(bitmap.findNext(2 * kChunk + 20, 3 * kChunk, &firstUnknown));
+    ASSERT_EQ(firstUnknown, 3 * kChunk);
+
+    std::vector<unsigned long> out;
+    ASSERT(bitmap.appendMatches(2 * kChunk + 12, 2 * kChunk + 15, &out));
+    ASSERT(bitmap.appendMatches(3 * kChunk, 3 * kChunk + 5, &out));
+    ASSERT_EQ(out.size(), 6UL);
+    ASSERT_EQ(out[0], 2 * kChunk + 12);
+    ASSERT_EQ(out[2], 2 * kChunk + 14);
+    ASSERT_EQ(out[5], 3 * kChunk + 4);
+}
+
+TEST(MatchBitmap, LastChunkIgnoresBitsPastTheEnd) {
+    MatchBitmap bitmap;
+    // only the first 100 docs exist, so every one of them matching is all of them
+    bitmap.setChunk(0, bitsOf(0, kChunk), 100);
+    unsigned long numUnknown = 0;
+    ASSERT_EQ(bitmap.countMatches(0, 100, &numUnknown), 100UL);
+    std::vector<unsigned long> out;
+    ASSERT(bitmap.appendMatches(0, 100, &out));
+    ASSERT_EQ(out.size(), 100UL);
+
+    bitmap.setChunk(1, bitsOf(50, kChunk), 100);
+    ASSERT_EQ(bitmap.countMatches(kChunk, kChunk + 100, &numUnknown), 50UL);
+}
+
+TEST(MatchBitmap, SetDoesNotChangeACompleteChunk) {
+    MatchBitmap bitmap;
+    bitmap.set(7, true);
+    bitmap.setChunk(0, bitsOf(0, 0), kChunk);
+    ASSERT(bitmap.get(7) == MatchBitmap::State::kNoMatch);
+    bitmap.set(8, true);
+    ASSERT(bitmap.get(8) == MatchBitmap::State::kNoMatch);
+}
+
+TEST(MatchBitmap, ClaimFromTheFocusThenWrap) {
+    MatchBitmap bitmap;
+    std::vector<unsigned long> claimed;
+    while (auto chunk = bitmap.claimChunk(3, 6 * kChunk, true)) {
+        claimed.push_back(*chunk);
+    }
+    ASSERT_EQ(claimed.size(), 6UL);
+    for (unsigned long i = 0; i < 6; i++) {
+        ASSERT_EQ(claimed[i], (i + 3) % 6);
+    }
+}
+
+TEST(MatchBitmap, ClaimOnlyLoadedChunks) {
+    MatchBitmap bitmap;
+    // the last chunk is only partly loaded
+    ASSERT_EQ(*bitmap.claimChunk(0, kChunk + 10, false), 0UL);
+    ASSERT_FALSE(bitmap.claimChunk(0, kChunk + 10, false));
+    ASSERT_EQ(*bitmap.claimChunk(0, kChunk + 10, true), 1UL);
+    ASSERT_FALSE(bitmap.claimChunk(0, kChunk + 10, true));
+}
+
+TEST(MatchBitmap, ClaimSkipsCompleteChunks) {
+    MatchBitmap bitmap;
+    bitmap.setChunk(1, bitsOf(0, 0), kChunk);
+    bitmap.setChunk(4, bitsOf(0, 0), kChunk);
+    std::vector<unsigned long> claimed;
+    while (auto chunk = bitmap.claimChunk(2, 6 * kChunk, true)) {
+        claimed.push_back(*chunk);
+    }
+    ASSERT(claimed == (std::vector<unsigned long>{2, 3, 5, 0}));
+}
+
+TEST(MatchBitmap, ReleasedChunksAreClaimedAgain) {
+    MatchBitmap bitmap;
+    ASSERT_EQ(*bitmap.claimChunk(2, 4 * kChunk, true), 2UL);
+    ASSERT_EQ(*bitmap.claimChunk(2, 4 * kChunk, true), 3UL);
+    ASSERT_EQ(*bitmap.claimChunk(2, 4 * kChunk, true), 0UL);
+
+    // before the focus, and after it
+    bitmap.releaseChunk(0);
+    bitmap.releaseChunk(2);
+    ASSERT_EQ(*bitmap.claimChunk(2, 4 * kChunk, true), 2UL);
+    ASSERT_EQ(*bitmap.claimChunk(2, 4 * kChunk, true), 0UL);
+    ASSERT_EQ(*bitmap.claimChunk(2, 4 * kChunk, true), 1UL);
+    ASSERT_FALSE(bitmap.claimChunk(2, 4 * kChunk, true));
+}
+
+TEST(MatchBitmap, NewFocusRestartsTheCursors) {
+    MatchBitmap bitmap;
+    ASSERT_EQ(*bitmap.claimChunk(0, 8 * kChunk, true), 0UL);
+    ASSERT_EQ(*bitmap.claimChunk(0, 8 * kChunk, true), 1UL);
+    ASSERT_EQ(*bitmap.claimChunk(6, 8 * kChunk, true), 6UL);
+    ASSERT_EQ(*bitmap.claimChunk(6, 8 * kChunk, true), 7UL);
+    // wrapping around skips the chunks that are still claimed
+    ASSERT_EQ(*bitmap.claimChunk(6, 8 * kChunk, true), 2UL);
+}
+
+TEST(MatchBitmap, Clear) {
+    MatchBitmap bitmap;
+    bitmap.setChunk(0, bitsOf(0, 10), kChunk);
+    ASSERT_GT(bitmap.memoryUsage(), 0UL);
+    bitmap.clear();
+    ASSERT_EQ(bitmap.memoryUsage(), 0UL);
+    ASSERT(bitmap.get(0) == MatchBitmap::State::kUnknown);
+    ASSERT_EQ(*bitmap.claimChunk(0, kChunk, true), 0UL);
+}
+
+}  // namespace
+}  // namespace mongo
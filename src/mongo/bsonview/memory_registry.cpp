@@ -0,0 +1,156 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/memory_registry.h"
+
+#include <algorithm>
+#include <sys/resource.h>
+#include <vector>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/util/processinfo.h"
+
+namespace mongo {
+
+MemoryRegistry::Registration::Registration(Registration&& other)
+    : _registry(other._registry), _it(other._it) {
+    other._registry = nullptr;
+}
+
+MemoryRegistry::Registration& MemoryRegistry::Registration::operator=(Registration&& other) {
+    if (this != &other) {
+        reset();
+        _registry = other._registry;
+        _it = other._it;
+        other._registry = nullptr;
+    }
+    return *this;
+}
+
+MemoryRegistry::Registration::~Registration() {
+    reset();
+}
+
+void MemoryRegistry::Registration::reset() {
+    if (_registry) {
+        _registry->_consumers.erase(_it);
+        _registry = nullptr;
+    }
+}
+
+MemoryRegistry::Registration MemoryRegistry::add(std::string name, UsageFn usage, EvictFn evict) {
+    Consumer consumer;
+    consumer.name = std::move(name);
+    consumer.usage = std::move(usage);
+    consumer.evict = std::move(evict);
+    return Registration(this, _consumers.insert(_consumers.end(), std::move(consumer)));
+}
+
+size_t MemoryRegistry::totalBytes() const {
+    size_t total = 0;
+    for (auto&& consumer : _consumers) {
+        total += consumer.usage();
+    }
+    return total;
+}
+
+size_t MemoryRegistry::enforceBudget(const std::function<size_t()>& used) {
+    if (_budget == 0) {
+        return 0;
+    }
+    size_t evicted = 0;
+    for (auto&& consumer : _consumers) {
+        if (used() <= _budget) {
+            break;
+        }
+        if (!consumer.evict) {
+            continue;
+        }
+        const size_t freed = consumer.evict();
+        if (freed > 0) {
+            consumer.evicted += freed;
+            evicted += freed;
+            _numEvictions++;
+        }
+    }
+    return evicted;
+}
+
+std::vector<BSONObj> MemoryRegistry::report() const {
+    std::vector<BSONObj> docs;
+    for (auto&& consumer : _consumers) {
+        docs.push_back(BSON("name" << consumer.name
+                                   << "bytes" << static_cast<long long>(consumer.usage())
+                                   << "evictable" << static_cast<bool>(consumer.evict)
+                                   << "evicted" << static_cast<long long>(consumer.evicted)));
+    }
+    return docs;
+}
+
+ProcessMemoryStats ProcessMemoryStats::get() {
+    ProcessMemoryStats stats;
+    // in MB
+    stats.residentBytes = static_cast<size_t>(ProcessInfo().getResidentSize()) << 20;
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats.minorFaults = usage.ru_minflt;
+        stats.majorFaults = usage.ru_majflt;
+    }
+    return stats;
+}
+
+size_t ProcessMemoryStats::residentBytesOf(const char* begin, const char* end) {
+    if (begin >= end || ! ProcessInfo::blockCheckSupported()) {
+        return 0;
+    }
+    const size_t pageSize = ProcessInfo::getPageSize();
+    const char* first = static_cast<const char*>(ProcessInfo::alignToStartOfPage(begin));
+    const size_t numPages = (end - first + pageSize - 1) / pageSize;
+
+    // a window at a time, so that huge files don't need a huge vector
+    const size_t kWindowPages = 1 << 16;
+    std::vector<char> inMemory;
+    size_t resident = 0;
+    for (size_t page = 0; page < numPages; page += kWindowPages) {
+        const size_t n = std::min(kWindowPages, numPages - page);
+        if (!ProcessInfo::pagesInMemory(first + page * pageSize, n, &inMemory)) {
+            return 0;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (inMemory[i]) {
+                resident += pageSize;
+            }
+        }
+    }
+    return resident;
+}
+
+}  // namespace mongo
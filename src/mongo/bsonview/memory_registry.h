@@ -0,0 +1,132 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <string>
+
+#include "mongo/bson/bsonobj.h"
+
+namespace mongo {
+
+/**
+ * Where bv's memory goes.  Each significant structure (the offset table of a file, the marked
+ * docs of a view, the match bitmap of a search, ...) registers a function which reports how many
+ * bytes it uses, and optionally one which frees what can be rebuilt later.  Against a budget,
+ * enforceBudget() evicts from those until the process fits again.
+ *
+ * Only to be used from the UI thread, which owns everything that's registered.
+ */
+class MemoryRegistry {
+public:
+    using UsageFn = std::function<size_t()>;
+    // Frees what it can, and returns how many bytes that was.
+    using EvictFn = std::function<size_t()>;
+
+    struct Consumer {
+        std::string name;
+        UsageFn usage;
+        EvictFn evict;  // empty if nothing can be given back
+        size_t evicted = 0;  // in total
+    };
+
+    /**
+     * Keeps a consumer registered for as long as it lives.
+     */
+    class Registration {
+    public:
+        Registration() = default;
+        Registration(MemoryRegistry* registry, std::list<Consumer>::iterator it)
+            : _registry(registry), _it(it) {}
+        Registration(Registration&& other);
+        Registration& operator=(Registration&& other);
+        ~Registration();
+
+        void reset();
+
+    private:
+        MemoryRegistry* _registry = nullptr;
+        std::list<Consumer>::iterator _it;
+    };
+
+    /**
+     * Consumers are evicted from in the order they're added, so the cheapest to rebuild should
+     * be added first.
+     */
+    Registration add(std::string name, UsageFn usage, EvictFn evict = nullptr);
+
+    size_t totalBytes() const;
+
+    // 0 for no budget.
+    void setBudget(size_t bytes) {
+        _budget = bytes;
+    }
+
+    size_t getBudget() const {
+        return _budget;
+    }
+
+    /**
+     * If used() is over the budget, evicts from each consumer in turn until it isn't.  used() is
+     * what's measured against the budget, eg. the resident size of the process, which also counts
+     * what isn't registered.  Returns the bytes evicted.
+     */
+    size_t enforceBudget(const std::function<size_t()>& used);
+
+    unsigned long numEvictions() const {
+        return _numEvictions;
+    }
+
+    // A doc per consumer: {name, bytes, evictable, evicted}.
+    std::vector<BSONObj> report() const;
+
+private:
+    std::list<Consumer> _consumers;
+    size_t _budget = 0;
+    unsigned long _numEvictions = 0;
+};
+
+/**
+ * What the OS says about the memory of the process.
+ */
+struct ProcessMemoryStats {
+    size_t residentBytes = 0;
+    long long minorFaults = 0;
+    long long majorFaults = 0;
+
+    static ProcessMemoryStats get();
+
+    // How much of [begin, end), eg. a mapped file, is resident.  Takes time in proportion to the
+    // size of the range (a byte per page), so isn't for calling every frame on big files.
+    static size_t residentBytesOf(const char* begin, const char* end);
+};
+
+}  // namespace mongo
@@ -0,0 +1,172 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/merge_order.h"
+
+#include <algorithm>
+
+#include "mongo/db/bson/dotted_path_support.h"
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+constexpr unsigned long MergeOrder::kCheckpointInterval;
+
+MergeOrder::MergeOrder(std::string path,
+                       std::vector<std::pair<unsigned long, unsigned long>> runs,
+                       DocFn doc,
+                       unsigned long checkpointInterval)
+    : _path(std::move(path)),
+      _runs(std::move(runs)),
+      _doc(std::move(doc)),
+      _interval(checkpointInterval) {
+    invariant(!_runs.empty());
+    invariant(_interval > 0);
+    for (size_t run = 0; run < _runs.size(); run++) {
+        invariant(_runs[run].first <= _runs[run].second);
+        invariant(run == 0 || _runs[run - 1].second <= _runs[run].first);
+        _numDocs += _runs[run].second - _runs[run].first;
+    }
+    _heads.resize(_runs.size());
+    _positions.resize(_runs.size());
+
+    // The first block starts at the start of every run.
+    _checkpoints.assign(_runs.size(), 0);
+}
+
+bool MergeOrder::_after(const HeapEntry& a, const HeapEntry& b) {
+    int cmp = a.key.woCompare(b.key, false);
+    if (cmp != 0) {
+        return cmp > 0;
+    }
+    return a.run > b.run;
+}
+
+void MergeOrder::_push(size_t run) const {
+    unsigned long pos = _positions[run];
+    if (_runs[run].first + pos >= _runs[run].second) {
+        _heads[run] = BSONObj();
+        return;
+    }
+    _heads[run] = _doc(_runs[run].first + pos);
+    _heap.push_back({dotted_path_support::extractElementAtPath(_heads[run], _path), run});
+    std::push_heap(_heap.begin(), _heap.end(), _after);
+}
+
+void MergeOrder::_restoreCheckpoint(unsigned long block) const {
+    _heap.clear();
+    auto checkpoint = _checkpoints.begin() + block * _runs.size();
+    std::copy(checkpoint, checkpoint + _runs.size(), _positions.begin());
+    for (size_t run = 0; run < _runs.size(); run++) {
+        _push(run);
+    }
+    _heapBlock = block;
+}
+
+void MergeOrder::_mergeBlock(unsigned long block) const {
+    invariant(block < numCheckpoints());
+    if (_heapBlock != block) {
+        _restoreCheckpoint(block);
+    }
+
+    unsigned long n = std::min(_interval, _numDocs - block * _interval);
+    _block.clear();
+    _block.reserve(n);
+    for (unsigned long i = 0; i < n; i++) {
+        invariant(!_heap.empty());
+        std::pop_heap(_heap.begin(), _heap.end(), _after);
+        size_t run = _heap.back().run;
+        _heap.pop_back();
+        _block.push_back(_runs[run].first + _positions[run]);
+        _positions[run]++;
+        _push(run);
+    }
+    _blockNum = block;
+    _heapBlock = block + 1;
+
+    if (block + 1 == numCheckpoints() && (block + 1) * _interval < _numDocs) {
+        _checkpoints.insert(_checkpoints.end(), _positions.begin(), _positions.end());
+    }
+}
+
+void MergeOrder::_loadBlock(unsigned long block) const {
+    if (_blockNum == block) {
+        return;
+    }
+    while (numCheckpoints() <= block) {
+        _mergeBlock(numCheckpoints() - 1);
+    }
+    if (_blockNum != block) {
+        _mergeBlock(block);
+    }
+}
+
+unsigned long MergeOrder::sourceDoc(unsigned long pos) const {
+    invariant(pos < _numDocs);
+    _loadBlock(pos / _interval);
+    return _block[pos % _interval];
+}
+
+unsigned long MergeOrder::position(unsigned long sourceDoc) const {
+    // The run the doc is in, and where in it.
+    auto it = std::upper_bound(
+        _runs.begin(), _runs.end(), sourceDoc, [](unsigned long doc, const auto& run) {
+            return doc < run.first;
+        });
+    invariant(it != _runs.begin());
+    size_t run = it - _runs.begin() - 1;
+    invariant(sourceDoc < _runs[run].second);
+    unsigned long i = sourceDoc - _runs[run].first;
+
+    // The doc is in the last block whose checkpoint has the run before it, so merge until there's
+    // a checkpoint past it (or there are no more blocks).
+    const size_t k = _runs.size();
+    const unsigned long numBlocks = (_numDocs + _interval - 1) / _interval;
+    while (_checkpoints[(numCheckpoints() - 1) * k + run] <= i && numCheckpoints() < numBlocks) {
+        _mergeBlock(numCheckpoints() - 1);
+    }
+    unsigned long lo = 0, hi = numCheckpoints();
+    while (hi - lo > 1) {
+        unsigned long mid = lo + (hi - lo) / 2;
+        if (_checkpoints[mid * k + run] <= i) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    _loadBlock(lo);
+    auto found = std::find(_block.begin(), _block.end(), sourceDoc);
+    invariant(found != _block.end());
+    return lo * _interval + (found - _block.begin());
+}
+
+}  // namespace mongo
@@ -0,0 +1,130 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/doc_order.h"
+
+namespace mongo {
+
+/**
+ * The docs of several runs (eg. the oplogs of the members of a replica set, as the files of a
+ * BSONFileSet), each of which is already in order of a field (eg. ts), interleaved in order of
+ * that field.  Ties are broken by run, and docs without the field come first.
+ *
+ * The merge is a k-way merge over a heap of the runs (like sorter::MergeIterator), which is done
+ * lazily, a block of kCheckpointInterval positions at a time, as the view gets to them.  At the
+ * start of each block, the position within each run is checkpointed, so that going back to a
+ * block only means restoring the heap from its checkpoint and merging that block again, rather
+ * than merging again from the start.  Only the current block's doc numbers are kept, so apart
+ * from that, a merge costs a position per run per block.
+ *
+ * The docs come from a function that's only called on the thread using the order (ie. the UI
+ * thread), so none of this is thread-safe.
+ */
+class MergeOrder : public DocOrder {
+public:
+    using DocFn = std::function<BSONObj(unsigned long sourceDoc)>;
+
+    static constexpr unsigned long kCheckpointInterval = 4096;
+
+    // Each run is a range [begin, end) of doc numbers, and they must be in order and not overlap.
+    MergeOrder(std::string path,
+               std::vector<std::pair<unsigned long, unsigned long>> runs,
+               DocFn doc,
+               unsigned long checkpointInterval = kCheckpointInterval);
+
+    const std::string& getPath() const {
+        return _path;
+    }
+
+    unsigned long numDocs() const override {
+        return _numDocs;
+    }
+
+    unsigned long sourceDoc(unsigned long pos) const override;
+
+    unsigned long position(unsigned long sourceDoc) const override;
+
+    unsigned long numCheckpoints() const {
+        return _checkpoints.size() / _runs.size();
+    }
+
+    // The checkpoints and the current block.
+    size_t memoryUsage() const {
+        return _checkpoints.capacity() * sizeof(unsigned long) +
+            _block.capacity() * sizeof(unsigned long);
+    }
+
+private:
+    struct HeapEntry {
+        BSONElement key;
+        size_t run;
+    };
+
+    // Whether a comes after b, so that the heap has the first doc on top.
+    static bool _after(const HeapEntry& a, const HeapEntry& b);
+
+    // Makes block the current one, merging every block before it that hasn't been yet.
+    void _loadBlock(unsigned long block) const;
+
+    // Merges the block from its checkpoint, and checkpoints the next one if it's new.
+    void _mergeBlock(unsigned long block) const;
+
+    void _restoreCheckpoint(unsigned long block) const;
+
+    void _push(size_t run) const;
+
+    const std::string _path;
+    const std::vector<std::pair<unsigned long, unsigned long>> _runs;
+    const DocFn _doc;
+    const unsigned long _interval;
+    unsigned long _numDocs = 0;
+
+    // Every block that's been got to has a checkpoint, of the position within each run of the
+    // first doc of the block (so there are _runs.size() of them per block).
+    mutable std::vector<unsigned long> _checkpoints;
+
+    // The merge itself, with the position within each run of its next doc.
+    mutable std::vector<HeapEntry> _heap;
+    mutable std::vector<BSONObj> _heads;  // keeps each run's key alive
+    mutable std::vector<unsigned long> _positions;
+    mutable unsigned long _heapBlock = -1;  // the block the heap is at the start of, if any
+
+    mutable std::vector<unsigned long> _block;  // doc numbers of the current block
+    mutable unsigned long _blockNum = -1;
+};
+
+}  // namespace mongo
@@ -0,0 +1,212 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/merge_order.h"
+
+#include <algorithm>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/platform/random.h"
+#include "mongo/unittest/unittest.h"
+
+namespace mongo {
+namespace {
+
+using Runs = std::vector<std::pair<unsigned long, unsigned long>>;
+
+/**
+ * Docs {ts: <value>} (or {} when the value is negative), as runs of consecutive doc numbers.
+ */
+class Docs {
+public:
+    void addRun(const std::vector<int>& values) {
+        unsigned long begin = _docs.size();
+        for (int value : values) {
+            _docs.push_back(value < 0 ? BSONObj() : BSON("ts" << value));
+        }
+        _runs.push_back({begin, _docs.size()});
+    }
+
+    MergeOrder merge(unsigned long interval) const {
+        return MergeOrder("ts", _runs, [this](unsigned long doc) { return _docs[doc]; }, interval);
+    }
+
+    // The expected order, by ts then run, with the docs without ts first.
+    std::vector<unsigned long> expected() const {
+        std::vector<unsigned long> order(_docs.size());
+        for (size_t doc = 0; doc < order.size(); doc++) {
+            order[doc] = doc;
+        }
+        std::stable_sort(order.begin(), order.end(), [this](unsigned long a, unsigned long b) {
+            return _ts(a) < _ts(b);
+        });
+        return order;
+    }
+
+private:
+    int _ts(unsigned long doc) const {
+        return _docs[doc].isEmpty() ? -1 : _docs[doc]["ts"].numberInt();
+    }
+
+    std::vector<BSONObj> _docs;
+    Runs _runs;
+};
+
+std::vector<unsigned long> inOrder(const MergeOrder& order) {
+    std::vector<unsigned long> docs;
+    for (unsigned long pos = 0; pos < order.numDocs(); pos++) {
+        docs.push_back(order.sourceDoc(pos));
+    }
+    return docs;
+}
+
+TEST(MergeOrder, Interleaves) {
+    Docs docs;
+    docs.addRun({0, 3, 6, 9});
+    docs.addRun({1, 4, 7});
+    docs.addRun({2, 5, 8, 10, 11});
+    for (unsigned long interval : {1UL, 2UL, 5UL, 100UL}) {
+        auto order = docs.merge(interval);
+        ASSERT_EQ(order.numDocs(), 12UL);
+        ASSERT(inOrder(order) == docs.expected());
+    }
+}
+
+TEST(MergeOrder, TiesAndMissingFields) {
+    Docs docs;
+    docs.addRun({-1, 1, 1, 2});
+    docs.addRun({-1, 1, 2});
+    docs.addRun({});
+    docs.addRun({0, 2});
+    auto order = docs.merge(3);
+    ASSERT(inOrder(order) == (std::vector<unsigned long>{0, 4, 7, 1, 2, 5, 3, 6, 8}));
+}
+
+TEST(MergeOrder, RandomAccess) {
+    Docs docs;
+    docs.addRun({0, 2, 4, 6, 8, 10, 12, 14, 16, 18});
+    docs.addRun({1, 5, 9, 13, 17});
+    docs.addRun({3, 7, 11, 15, 19, 20, 21});
+    const auto expected = docs.expected();
+
+    // backwards, so that every block is merged again from its checkpoint
+    auto order = docs.merge(3);
+    for (unsigned long pos = expected.size(); pos-- > 0;) {
+        ASSERT_EQ(order.sourceDoc(pos), expected[pos]);
+    }
+    ASSERT_EQ(order.numCheckpoints(), 8UL);
+    for (unsigned long pos : {10UL, 0UL, 21UL, 4UL, 5UL, 3UL}) {
+        ASSERT_EQ(order.sourceDoc(pos), expected[pos]);
+    }
+}
+
+TEST(MergeOrder, PositionIsTheInverse) {
+    Docs docs;
+    docs.addRun({0, 2, 4, 6, 8, 10, 12, 14, 16, 18});
+    docs.addRun({1, 5, 9, 13, 17});
+    docs.addRun({-1, 3, 7, 11, 15, 19, 20, 21});
+    const auto expected = docs.expected();
+    for (unsigned long interval : {1UL, 4UL, 7UL, 100UL}) {
+        auto order = docs.merge(interval);
+        for (unsigned long doc = expected.size(); doc-- > 0;) {
+            unsigned long pos = order.position(doc);
+            ASSERT_EQ(expected[pos], doc);
+        }
+    }
+}
+
+// When one run's docs all come after another's, its position stays the same across the
+// checkpoints of many blocks, and position() has to merge on until it moves.
+TEST(MergeOrder, PositionWhenARunStalls) {
+    Docs docs;
+    std::vector<int> early, late;
+    for (int i = 0; i < 100; i++) {
+        early.push_back(i);
+        late.push_back(1000 + i);
+    }
+    docs.addRun(late);
+    docs.addRun(early);
+
+    {
+        // the first doc of the late run is the first of the second half
+        auto order = docs.merge(7);
+        ASSERT_EQ(order.position(0), 100UL);
+        ASSERT_EQ(order.sourceDoc(100), 0UL);
+    }
+    {
+        auto order = docs.merge(7);
+        ASSERT_EQ(order.position(99), 199UL);
+        ASSERT_EQ(order.position(150), 50UL);
+        ASSERT_EQ(order.position(0), 100UL);
+        ASSERT_EQ(order.position(100), 0UL);
+    }
+    {
+        // the early run only needs the blocks it's in
+        auto order = docs.merge(7);
+        ASSERT_EQ(order.position(103), 3UL);
+        ASSERT_EQ(order.numCheckpoints(), 2UL);
+    }
+    {
+        // the blocks lined up with where the late run starts
+        auto order = docs.merge(10);
+        ASSERT_EQ(order.position(0), 100UL);
+        ASSERT_EQ(order.position(199), 99UL);
+    }
+}
+
+TEST(MergeOrder, Random) {
+    PseudoRandom random(4321);
+    for (int i = 0; i < 50; i++) {
+        Docs docs;
+        const int numRuns = 1 + random.nextInt32(5);
+        for (int run = 0; run < numRuns; run++) {
+            std::vector<int> values;
+            int value = 0;
+            for (int n = random.nextInt32(40); n > 0; n--) {
+                value += random.nextInt32(3);
+                values.push_back(value);
+            }
+            docs.addRun(values);
+        }
+        const auto expected = docs.expected();
+        const unsigned long interval = 1 + random.nextInt32(9);
+        ASSERT(inOrder(docs.merge(interval)) == expected);
+
+        auto order = docs.merge(interval);
+        for (unsigned long n = 0; n < expected.size(); n++) {
+            unsigned long doc = random.nextInt64(expected.size());
+            ASSERT_EQ(expected[order.position(doc)], doc);
+        }
+    }
+}
+
+}  // namespace
+}  // namespace mongo
@@ -0,0 +1,211 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/mql_match_plan.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "mongo/db/matcher/expression_leaf.h"
+#include "mongo/db/matcher/matcher.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+namespace {
+
+/**
+ * If every element equal to elem (under a simple comparison) has exactly the same value bytes,
+ * returns those bytes, so that they can be searched for in raw documents.  This is not the case
+ * for numbers, since eg. 1, 1.0 and NumberLong(1) are all equal.
+ */
+boost::optional<std::string> valueNeedle(const BSONElement& elem) {
+    switch (elem.type()) {
+        case String:
+        case Symbol:  // compares equal to String, but is encoded identically
+        case jstOID:
+        case Date:
+        case bsonTimestamp:
+        case BinData:
+            return std::string(elem.value(), elem.valuesize());
+        default:
+            return boost::none;
+    }
+}
+
+}  // namespace
+
+MQLMatchPlan::MQLMatchPlan(Matcher* matcher) : _matcher(matcher) {}
+
+std::unique_ptr<MQLMatchPlan> MQLMatchPlan::compile(Matcher* matcher) {
+    std::unique_ptr<MQLMatchPlan> plan(new MQLMatchPlan(matcher));
+    plan->_addConjunct(matcher->getMatchExpression());
+
+    if (plan->_predicates.size() > kMaxPredicates) {
+        plan->_fastPath = false;
+    }
+    if (!plan->_fastPath && plan->_needles.empty()) {
+        return nullptr;
+    }
+
+    // Check the longest (and so probably rarest) needles first, and each only once.
+    auto& needles = plan->_needles;
+    std::sort(needles.begin(), needles.end());
+    needles.erase(std::unique(needles.begin(), needles.end()), needles.end());
+    std::stable_sort(needles.begin(), needles.end(), [](const std::string& a, const std::string& b) {
+        return a.size() > b.size();
+    });
+
+    return plan;
+}
+
+void MQLMatchPlan::_addConjunct(const MatchExpression* expr) {
+    switch (expr->matchType()) {
+        case MatchExpression::AND:
+            for (size_t i = 0; i < expr->numChildren(); i++) {
+                _addConjunct(expr->getChild(i));
+            }
+            return;
+
+        case MatchExpression::ALWAYS_TRUE:
+            return;
+
+        case MatchExpression::EQ:
+        case MatchExpression::LTE:
+        case MatchExpression::LT:
+        case MatchExpression::GT:
+        case MatchExpression::GTE:
+        case MatchExpression::REGEX:
+        case MatchExpression::MOD:
+        case MatchExpression::EXISTS:
+        case MatchExpression::MATCH_IN:
+        case MatchExpression::TYPE_OPERATOR:
+        case MatchExpression::BITS_ALL_SET:
+        case MatchExpression::BITS_ALL_CLEAR:
+        case MatchExpression::BITS_ANY_SET:
+        case MatchExpression::BITS_ANY_CLEAR:
+            break;
+
+        default:
+            // Can't be checked one field at a time, so leave it to the Matcher.  (Nor can it
+            // contribute any needles, since it isn't known which fields it requires.)
+            _fastPath = false;
+            return;
+    }
+
+    StringData path = expr->path();
+    if (path.empty()) {
+        _fastPath = false;
+        return;
+    }
+
+    // A missing field is seen by the leaf as EOO, which is how {a: null} or {a: {$exists: false}}
+    // can match docs without the field.
+    bool matchesMissing = expr->matchesSingleElement(BSONElement());
+
+    if (!matchesMissing) {
+        // Every matching doc must then contain an element named by each part of the path.
+        std::vector<std::string> parts;
+        str::splitStringDelim(path.toString(), &parts, '.');
+        for (auto&& part : parts) {
+            _needles.push_back(part + '\0');
+        }
+
+        if (expr->matchType() == MatchExpression::EQ) {
+            auto cmp = static_cast<const ComparisonMatchExpression*>(expr);
+            if (!cmp->getCollator()) {
+                auto needle = valueNeedle(cmp->getData());
+                if (needle) {
+                    _needles.push_back(*needle);
+                }
+            }
+        }
+    }
+
+    if (path.find('.') != std::string::npos) {
+        _fastPath = false;
+        return;
+    }
+
+    _predicates.push_back({path.toString(), expr, matchesMissing});
+}
+
+bool MQLMatchPlan::_prefilter(const BSONObj& obj) const {
+    const char* data = obj.objdata();
+    size_t size = obj.objsize();
+    for (auto&& needle : _needles) {
+        if (!::memmem(data, size, needle.data(), needle.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MQLMatchPlan::matches(const BSONObj& obj) const {
+    if (!_prefilter(obj)) {
+        return false;
+    }
+
+    if (!_fastPath) {
+        return _matcher->matches(obj);
+    }
+
+    // Pick out the (first occurrence of) each field, in a single pass.
+    BSONElement found[kMaxPredicates];
+    size_t remaining = _predicates.size();
+    for (BSONObjIterator it(obj); remaining > 0 && it.more();) {
+        BSONElement elem = it.next();
+        StringData name = elem.fieldNameStringData();
+        for (size_t i = 0; i < _predicates.size(); i++) {
+            if (found[i].eoo() && _predicates[i].field == name) {
+                found[i] = elem;
+                remaining--;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < _predicates.size(); i++) {
+        const BSONElement& elem = found[i];
+        if (elem.eoo()) {
+            if (!_predicates[i].matchesMissing) {
+                return false;
+            }
+        } else if (elem.type() == Array) {
+            // the leaf would have to see each of the array's elements as well as the array
+            return _matcher->matches(obj);
+        } else if (!_predicates[i].expr->matchesSingleElement(elem)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace mongo
@@ -0,0 +1,100 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/bson/bsonobj.h"
+
+namespace mongo {
+
+class Matcher;
+class MatchExpression;
+
+/**
+ * A specialised way of evaluating a Matcher against raw documents, for the common case of simple
+ * predicates on a handful of fields.
+ *
+ * Before looking at a document's structure at all, the plan checks that its raw bytes contain the
+ * names of the fields that any match must have (and, for equality with a string, ObjectId, Date,
+ * etc, the encoded bytes of the value).  Only documents which get through this are parsed, and
+ * then only by a single walk over their top-level elements to pick out the fields, each of which
+ * is checked directly by its leaf predicate.
+ *
+ * If the query is anything other than a conjunction of leaf predicates on top-level fields, or a
+ * field in a document turns out to be an array (and so needs the full traversal semantics), the
+ * plan falls back to the Matcher.
+ */
+class MQLMatchPlan {
+public:
+    /**
+     * Returns null if the plan wouldn't be any better than using the Matcher directly.  The
+     * matcher must outlive the plan.
+     */
+    static std::unique_ptr<MQLMatchPlan> compile(Matcher* matcher);
+
+    // Thread-safe.
+    bool matches(const BSONObj& obj) const;
+
+    // Whether matching docs can (usually) be checked without the Matcher.
+    bool hasFastPath() const {
+        return _fastPath;
+    }
+
+    // The byte strings that every matching doc must contain.
+    const std::vector<std::string>& getNeedles() const {
+        return _needles;
+    }
+
+private:
+    struct Predicate {
+        std::string field;
+        const MatchExpression* expr;
+        bool matchesMissing;
+    };
+
+    // More than this and the fast path isn't worth it.
+    static constexpr size_t kMaxPredicates = 16;
+
+    explicit MQLMatchPlan(Matcher* matcher);
+
+    void _addConjunct(const MatchExpression* expr);
+
+    bool _prefilter(const BSONObj& obj) const;
+
+    Matcher* _matcher;
+    std::vector<std::string> _needles;
+    bool _fastPath = true;
+    std::vector<Predicate> _predicates;
+};
+
+}  // namespace mongo
@@ -0,0 +1,116 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <benchmark/benchmark.h>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/bson/json.h"
+#include "mongo/bsonview/mql_match_plan.h"
+#include "mongo/db/matcher/matcher.h"
+#include "mongo/db/pipeline/expression_context.h"
+
+namespace mongo {
+namespace {
+
+const char* kNamespaces[] = {
+    "app.users", "app.orders", "app.sessions", "app.events",
+    "app.carts", "app.items", "admin.system.users", "config.transactions",
+};
+const char* kOps[] = {"i", "u", "d", "n"};
+
+// Some oplog-shaped docs, concatenated as they would be in a dump.
+const std::vector<BSONObj>& docs() {
+    static const std::vector<BSONObj> docs = [] {
+        std::vector<BSONObj> docs;
+        for (int i = 0; i < 10000; i++) {
+            BSONObjBuilder b;
+            b.append("ts", Timestamp(1560000000 + i / 10, i % 10));
+            b.append("t", static_cast<long long>(i % 13));
+            b.append("h", static_cast<long long>(i) * 7919);
+            b.append("v", 2);
+            b.append("op", kOps[i % 4]);
+            b.append("ns", kNamespaces[i % 8]);
+            b.appendDate("wall", Date_t::fromMillisSinceEpoch(1560000000000LL + i));
+            {
+                BSONObjBuilder o(b.subobjStart("o"));
+                o.append("_id", OID::gen());
+                o.append("name", std::string(40 + i % 50, 'x'));
+                o.append("n", i);
+                o.append("tags", BSON_ARRAY("a" << "b" << "c"));
+            }
+            docs.push_back(b.obj());
+        }
+        return docs;
+    }();
+    return docs;
+}
+
+const char* kQueries[] = {
+    "{ns: 'app.users'}",
+    "{op: 'u', ns: 'app.users'}",
+    "{t: {$gte: 5, $lt: 8}}",
+    "{ns: {$in: ['app.carts', 'app.items']}}",
+    "{'o.n': 12345}",
+    "{ns: 'app.nonexistent'}",
+};
+
+const boost::intrusive_ptr<ExpressionContext> expCtx = new ExpressionContext(nullptr, nullptr);
+
+void BM_Matcher(benchmark::State& state) {
+    Matcher matcher(fromjson(kQueries[state.range(0)]), expCtx);
+    size_t matched = 0;
+    for (auto _ : state) {
+        for (auto&& doc : docs()) {
+            matched += matcher.matches(doc);
+        }
+    }
+    benchmark::DoNotOptimize(matched);
+    state.SetItemsProcessed(state.iterations() * docs().size());
+}
+
+void BM_MQLMatchPlan(benchmark::State& state) {
+    Matcher matcher(fromjson(kQueries[state.range(0)]), expCtx);
+    auto plan = MQLMatchPlan::compile(&matcher);
+    size_t matched = 0;
+    for (auto _ : state) {
+        for (auto&& doc : docs()) {
+            matched += plan ? plan->matches(doc) : matcher.matches(doc);
+        }
+    }
+    benchmark::DoNotOptimize(matched);
+    state.SetItemsProcessed(state.iterations() * docs().size());
+}
+
+BENCHMARK(BM_Matcher)->DenseRange(0, 5);
+BENCHMARK(BM_MQLMatchPlan)->DenseRange(0, 5);
+
+}  // namespace
+}  // namespace mongo
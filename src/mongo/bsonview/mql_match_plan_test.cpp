@@ -0,0 +1,223 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/mql_match_plan.h"
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/bson/json.h"
+#include "mongo/db/matcher/matcher.h"
+#include "mongo/db/pipeline/expression_context.h"
+#include "mongo/unittest/unittest.h"
+
+namespace mongo {
+namespace {
+
+const boost::intrusive_ptr<ExpressionContext> expCtx = new ExpressionContext(nullptr, nullptr);
+
+std::vector<BSONObj> fromjsons(const std::vector<std::string>& jsons) {
+    std::vector<BSONObj> docs;
+    for (auto&& json : jsons) {
+        docs.push_back(fromjson(json));
+    }
+    return docs;
+}
+
+// Checks that the plan (needle prefilter and all) gives the Matcher's answer for every doc.
+// Returns whether there was a plan to check, since without one SearchMQL uses the Matcher itself.
+bool assertAgrees(const BSONObj& query, const std::vector<BSONObj>& docs) {
+    Matcher matcher(query, expCtx);
+    auto plan = MQLMatchPlan::compile(&matcher);
+    if (!plan) {
+        return false;
+    }
+    for (auto&& doc : docs) {
+        ASSERT_EQ(plan->matches(doc), matcher.matches(doc)) << query << " on " << doc;
+    }
+    return true;
+}
+
+bool assertAgrees(const std::string& query, const std::vector<BSONObj>& docs) {
+    return assertAgrees(fromjson(query), docs);
+}
+
+TEST(MQLMatchPlanTest, Arrays) {
+    const auto docs = fromjsons({
+        "{a: 1}",
+        "{a: [1, 2]}",
+        "{a: [2, 3]}",
+        "{a: [[1]]}",
+        "{a: []}",
+        "{a: [{b: 1}, {b: 2}]}",
+        "{a: [1, 10], c: 'x'}",
+        "{a: ['x', 'y'], c: 'x'}",
+        "{b: [1]}",
+    });
+    ASSERT(assertAgrees("{a: 1}", docs));
+    ASSERT(assertAgrees("{a: [1]}", docs));
+    ASSERT(assertAgrees("{a: {$gt: 5}}", docs));
+    ASSERT(assertAgrees("{a: {$gt: 0, $lt: 2}}", docs));
+    ASSERT(assertAgrees("{a: {$in: [2, 'y']}}", docs));
+    ASSERT(assertAgrees("{a: 'x'}", docs));
+    ASSERT(assertAgrees("{a: {$size: 2}, c: 'x'}", docs));
+    ASSERT(assertAgrees("{a: {$elemMatch: {$gt: 5}}, c: 'x'}", docs));
+    ASSERT(assertAgrees("{a: {$elemMatch: {b: 2}}, c: 'x'}", docs));
+    ASSERT(assertAgrees("{'a.b': 1}", docs));
+}
+
+TEST(MQLMatchPlanTest, NullAndMissing) {
+    const auto docs = fromjsons({
+        "{}",
+        "{a: null}",
+        "{a: undefined}",
+        "{a: 1}",
+        "{a: [null]}",
+        "{a: [1]}",
+        "{a: []}",
+        "{a: {b: null}}",
+        "{b: null}",
+        "{a: null, b: 1}",
+    });
+    ASSERT(assertAgrees("{a: null}", docs));
+    ASSERT(assertAgrees("{a: {$exists: true}}", docs));
+    // $exists: false is a $not, so only the needles of the rest of the query are used
+    assertAgrees("{a: {$exists: false}}", docs);
+    ASSERT(assertAgrees("{a: {$exists: false}, b: {$exists: true}}", docs));
+    ASSERT(assertAgrees("{a: {$in: [null, 1]}}", docs));
+    ASSERT(assertAgrees("{a: {$type: 'null'}}", docs));
+    ASSERT(assertAgrees("{a: null, b: null}", docs));
+    assertAgrees("{'a.b': null}", docs);
+    assertAgrees("{'a.b': {$exists: false}}", docs);
+    assertAgrees("{a: {$ne: null}}", docs);
+}
+
+TEST(MQLMatchPlanTest, DottedPathsThroughArrays) {
+    const auto docs = fromjsons({
+        "{a: {b: {c: 'x'}}}",
+        "{a: [{b: {c: 'x'}}]}",
+        "{a: [{b: [{c: 'x'}]}]}",
+        "{a: [{b: [{c: 'y'}, {c: 'x'}]}]}",
+        "{a: [{b: [{c: ['x']}]}]}",
+        "{a: [{b: {c: 'y'}}, {b: {c: 'x'}}]}",
+        "{a: [{b: {c: 'y'}}]}",
+        "{a: {b: [1, {c: 'x'}]}}",
+        "{a: [[{b: {c: 'x'}}]]}",
+        "{a: {'0': {b: 1}}}",
+        "{a: [{b: 1}]}",
+        "{a: [{b: 2}, {b: 1}]}",
+        "{'a.b': {c: 'x'}}",
+        "{x: 'x', a: {b: {}}}",
+    });
+    ASSERT(assertAgrees("{'a.b.c': 'x'}", docs));
+    ASSERT(assertAgrees("{'a.b.c': {$in: ['x', 'z']}}", docs));
+    ASSERT(assertAgrees("{'a.b.c': {$gte: 'x'}}", docs));
+    ASSERT(assertAgrees("{'a.0.b': 1}", docs));
+    ASSERT(assertAgrees("{'a.1.b': 1}", docs));
+    ASSERT(assertAgrees("{'a.b': 1}", docs));
+    ASSERT(assertAgrees("{'a.b.1.c': 'x'}", docs));
+    ASSERT(assertAgrees("{'a.b.c': {$exists: true}}", docs));
+    ASSERT(assertAgrees("{x: 'x', 'a.b.c': {$exists: false}}", docs));
+}
+
+TEST(MQLMatchPlanTest, NumericTypes) {
+    const auto docs = fromjsons({
+        "{a: 1}",
+        "{a: NumberLong(1)}",
+        "{a: 1.0}",
+        "{a: NumberDecimal('1')}",
+        "{a: 1.5}",
+        "{a: NumberLong(2)}",
+        "{a: [NumberLong(1)]}",
+        "{a: '1'}",
+        "{a: true}",
+        "{a: NumberLong(9007199254740993)}",
+        "{a: 9007199254740992.0}",
+    });
+    ASSERT(assertAgrees("{a: 1}", docs));
+    ASSERT(assertAgrees("{a: NumberLong(1)}", docs));
+    ASSERT(assertAgrees("{a: 1.0}", docs));
+    ASSERT(assertAgrees("{a: NumberDecimal('1.0')}", docs));
+    ASSERT(assertAgrees("{a: {$gt: 1}}", docs));
+    ASSERT(assertAgrees("{a: {$lte: NumberLong(1)}}", docs));
+    ASSERT(assertAgrees("{a: {$in: [NumberLong(2), 1.5]}}", docs));
+    ASSERT(assertAgrees("{a: {$mod: [2, 1]}}", docs));
+    ASSERT(assertAgrees("{a: {$type: 'long'}}", docs));
+    ASSERT(assertAgrees("{a: {$type: 'number'}}", docs));
+    ASSERT(assertAgrees("{a: NumberLong(9007199254740993)}", docs));
+}
+
+TEST(MQLMatchPlanTest, SymbolAndString) {
+    std::vector<BSONObj> docs = fromjsons({
+        "{a: 'x'}",
+        "{a: 'xy'}",
+        "{a: ['x']}",
+        "{b: 'x'}",
+        "{a: 'y', b: 'x'}",
+    });
+    docs.push_back(BSONObjBuilder().appendSymbol("a", "x").obj());
+    docs.push_back(BSONObjBuilder().appendSymbol("a", "y").obj());
+    docs.push_back(BSON("a" << BSON_ARRAY(BSONSymbol("x"))));
+    docs.push_back(BSONObjBuilder().appendSymbol("b", "x").append("a", "y").obj());
+
+    ASSERT(assertAgrees("{a: 'x'}", docs));
+    ASSERT(assertAgrees(BSONObjBuilder().appendSymbol("a", "x").obj(), docs));
+    ASSERT(assertAgrees("{a: {$in: ['x', 'z']}}", docs));
+    ASSERT(assertAgrees("{a: {$gte: 'x'}}", docs));
+    ASSERT(assertAgrees("{a: {$type: 'string'}}", docs));
+    ASSERT(assertAgrees("{a: {$type: 'symbol'}}", docs));
+    ASSERT(assertAgrees("{a: /^x/}", docs));
+}
+
+// The needles are what every matching doc must contain, so a doc without them is skipped before
+// it's parsed at all.
+TEST(MQLMatchPlanTest, Needles) {
+    Matcher matcher(fromjson("{a: 'xyz', 'b.c': {$gt: 1}, d: null}"), expCtx);
+    auto plan = MQLMatchPlan::compile(&matcher);
+    ASSERT(plan);
+    ASSERT_FALSE(plan->hasFastPath());
+    auto needles = plan->getNeedles();
+    std::sort(needles.begin(), needles.end());
+    const std::vector<std::string> expected{
+        std::string("\x04\0\0\0xyz\0", 8),
+        std::string("a\0", 2),
+        std::string("b\0", 2),
+        std::string("c\0", 2),
+    };
+    ASSERT(needles == expected);
+
+    Matcher simple(fromjson("{a: 1, b: {$in: [1, 2]}}"), expCtx);
+    plan = MQLMatchPlan::compile(&simple);
+    ASSERT(plan);
+    ASSERT(plan->hasFastPath());
+}
+
+}  // namespace
+}  // namespace mongo
@@ -0,0 +1,83 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/output_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mongo/util/assert_util.h"
+#include "mongo/util/errno_util.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+OutputFile::OutputFile(std::string path) : OutputFile(std::move(path), false) {}
+
+OutputFile::OutputFile(std::string path, bool isStdout)
+    : _path(std::move(path)), _isStdout(isStdout) {
+    // never overwrite anything
+    _fd = _isStdout ? STDOUT_FILENO : ::open(_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    uassert(ErrorCodes::FileOpenFailed,
+            str::stream() << "Unable to create " << _path << ": " << errnoWithDescription(),
+            _fd != -1);
+}
+
+std::unique_ptr<OutputFile> OutputFile::toStdout() {
+    return std::unique_ptr<OutputFile>(new OutputFile("-", true));
+}
+
+OutputFile::~OutputFile() {
+    if (_isStdout) {
+        return;
+    }
+    if (_fd != -1) {
+        ::close(_fd);
+    }
+    if (!_committed) {
+        ::unlink(_path.c_str());
+    }
+}
+
+void OutputFile::commit() {
+    if (_isStdout) {
+        _committed = true;
+        return;
+    }
+    const int fd = _fd;
+    _fd = -1;
+    uassert(ErrorCodes::FileStreamFailed,
+            str::stream() << "Unable to write " << _path << ": " << errnoWithDescription(),
+            ::close(fd) == 0);
+    _committed = true;
+}
+
+}  // namespace mongo
@@ -0,0 +1,77 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace mongo {
+
+/**
+ * A new file to write to, which never overwrites an existing one.  Unless it's committed, it's
+ * removed again when destroyed, so that a write that fails or is interrupted part way through
+ * doesn't leave behind a partial file that looks like it might be complete.
+ */
+class OutputFile {
+public:
+    // Throws FileOpenFailed if the file can't be created, eg. because it already exists.
+    explicit OutputFile(std::string path);
+
+    // Stdout (as "-"), which is neither closed nor removed.  Only for where that's been asked for,
+    // since it needn't be seekable (and in bv, it's the terminal).
+    static std::unique_ptr<OutputFile> toStdout();
+
+    ~OutputFile();
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    int fd() const {
+        return _fd;
+    }
+
+    const std::string& getPath() const {
+        return _path;
+    }
+
+    // Closes the file and keeps it.  Throws FileStreamFailed if closing it reports an error (eg.
+    // from a delayed write), in which case it's still removed.
+    void commit();
+
+private:
+    OutputFile(std::string path, bool isStdout);
+
+    const std::string _path;
+    const bool _isStdout;
+    int _fd = -1;
+    bool _committed = false;
+};
+
+}  // namespace mongo
@@ -0,0 +1,270 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/parallel_aggregation.h"
+
+#include "mongo/bson/json.h"
+#include "mongo/bsonview/document_source_bson_views.h"
+#include "mongo/db/operation_context_noop.h"
+#include "mongo/db/pipeline/document_source_limit.h"
+#include "mongo/db/pipeline/document_source_match.h"
+#include "mongo/db/pipeline/document_source_queue.h"
+#include "mongo/db/pipeline/expression_context.h"
+
+namespace mongo {
+
+constexpr unsigned long ParallelAggregation::kBatchSize;
+
+ParallelAggregation::ParallelAggregation(LoadProgressFn loadProgress, LoadedDocsFn loadedDocs)
+    : _batches(std::move(loadProgress), std::move(loadedDocs), kBatchSize, &_stop) {}
+
+ParallelAggregation::~ParallelAggregation() {
+    _stop.store(true);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+StatusWith<std::unique_ptr<ParallelAggregation>> ParallelAggregation::create(
+    StringData pipelineJson, LoadProgressFn loadProgress, LoadedDocsFn loadedDocs) {
+    std::unique_ptr<ParallelAggregation> agg(
+        new ParallelAggregation(std::move(loadProgress), std::move(loadedDocs)));
+
+    try {
+        BSONObj wrapped = fromjson(str::stream() << "{pipeline: " << pipelineJson << "}");
+        BSONElement pipeline = wrapped.firstElement();
+        if (pipeline.type() == Object) {
+            agg->_stages.push_back(pipeline.Obj().getOwned());
+        } else if (pipeline.type() == Array) {
+            for (auto&& stage : pipeline.Obj()) {
+                if (stage.type() != Object) {
+                    return Status(ErrorCodes::TypeMismatch, "Each pipeline stage must be an object");
+                }
+                agg->_stages.push_back(stage.Obj().getOwned());
+            }
+        } else {
+            return Status(ErrorCodes::TypeMismatch,
+                          "The pipeline must be an array of stages, or a single stage");
+        }
+
+        // Work out where the pipeline gets split between the threads and the merge.
+        OperationContextNoop opCtx;
+        auto parsed = agg->_parse(agg->_makeExpCtx(&opCtx, false));
+        size_t i = 0;
+        for (auto&& stage : parsed->getSources()) {
+            if (auto logic = stage->distributedPlanLogic()) {
+                agg->_splitIndex = i;
+                agg->_mergeInFileOrder = !logic->shardsStage ||
+                    logic->shardsStage->getSourceName() == DocumentSourceLimit::kStageName;
+                break;
+            }
+            i++;
+        }
+    } catch (const DBException& e) {
+        return e.toStatus();
+    }
+
+    return {std::move(agg)};
+}
+
+void ParallelAggregation::start(unsigned numThreads) {
+    invariant(!_thread.joinable());
+    _thread = stdx::thread([this, numThreads]() { _run(numThreads); });
+}
+
+boost::intrusive_ptr<ExpressionContext> ParallelAggregation::_makeExpCtx(OperationContext* opCtx,
+                                                                         bool needsMerge) {
+    boost::intrusive_ptr<ExpressionContext> expCtx(new ExpressionContext(opCtx, nullptr));
+    expCtx->ns = NamespaceString("bv", "file");
+    expCtx->timeZoneDatabase = &_timeZoneDatabase;
+    // makes the per-shard halves of split stages produce partial results (eg. for $avg)
+    expCtx->needsMerge = needsMerge;
+    return expCtx;
+}
+
+std::unique_ptr<Pipeline, PipelineDeleter> ParallelAggregation::_parse(
+    const boost::intrusive_ptr<ExpressionContext>& expCtx) {
+    auto pipeline = uassertStatusOK(Pipeline::parse(_stages, expCtx));
+    pipeline->optimizePipeline();
+    return pipeline;
+}
+
+void ParallelAggregation::_run(unsigned numThreads) {
+    std::vector<stdx::thread> threads;
+    for (unsigned i = 0; i < numThreads; i++) {
+        threads.emplace_back([this]() { _worker(); });
+    }
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+
+    if (_status.isOK()) {
+        try {
+            _merge();
+        } catch (const DBException& e) {
+            _fail(e.toStatus());
+        }
+    }
+    _done.store(true);
+}
+
+void ParallelAggregation::_worker() {
+    try {
+        OperationContextNoop opCtx;
+        auto expCtx = _makeExpCtx(&opCtx, _splitIndex.has_value());
+        auto pipeline = _parse(expCtx);
+
+        // This thread's part of the pipeline.
+        auto part = uassertStatusOK(Pipeline::create({}, expCtx));
+        if (_splitIndex) {
+            for (size_t i = 0; i < *_splitIndex; i++) {
+                part->pushBack(pipeline->popFront());
+            }
+            auto logic = pipeline->popFront()->distributedPlanLogic();
+            if (logic->shardsStage) {
+                part->pushBack(logic->shardsStage);
+            }
+        } else {
+            while (!pipeline->getSources().empty()) {
+                part->pushBack(pipeline->popFront());
+            }
+        }
+
+        unsigned long batch = 0;
+        auto source = DocumentSourceBSONViews::create(
+            expCtx,
+            [this, &batch](std::vector<BSONObj>* docs) {
+                unsigned long begin;
+                if (!_batches.next(docs, &begin)) {
+                    return false;
+                }
+                batch = begin / kBatchSize;
+                return true;
+            },
+            _mergeInFileOrder);
+        if (!part->getSources().empty()) {
+            auto match = dynamic_cast<DocumentSourceMatch*>(part->getSources().front().get());
+            if (match && !match->isTextQuery()) {
+                source->setMatch(match->getQuery());
+                part->popFront();
+            }
+        }
+        source->setDependencies(part->getDependencies(DepsTracker::MetadataAvailable::kNoMetadata));
+        part->addInitialSource(source);
+
+        std::vector<Document> outputs;
+        auto last = part->getSources().back();
+        while (true) {
+            auto next = last->getNext();
+            if (next.isAdvanced()) {
+                outputs.push_back(next.releaseDocument());
+                continue;
+            }
+            if (_mergeInFileOrder && !outputs.empty()) {
+                // the source pauses after each batch, so everything so far came from the last one
+                stdx::lock_guard<stdx::mutex> lk(_mutex);
+                _batchOutputs[batch] = std::move(outputs);
+                outputs.clear();
+            }
+            if (next.isEOF()) {
+                break;
+            }
+        }
+
+        if (!_mergeInFileOrder) {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            std::move(outputs.begin(), outputs.end(), std::back_inserter(_partials));
+        }
+    } catch (const DBException& e) {
+        _fail(e.toStatus());
+    }
+}
+
+void ParallelAggregation::_merge() {
+    std::vector<Document> inputs;
+    if (_mergeInFileOrder) {
+        for (auto&& batch : _batchOutputs) {
+            std::move(batch.second.begin(), batch.second.end(), std::back_inserter(inputs));
+        }
+        _batchOutputs.clear();
+    } else {
+        inputs = std::move(_partials);
+    }
+
+    if (!_splitIndex) {
+        for (auto&& doc : inputs) {
+            _appendResult(doc);
+        }
+        return;
+    }
+
+    OperationContextNoop opCtx;
+    auto expCtx = _makeExpCtx(&opCtx, false);
+    auto pipeline = _parse(expCtx);
+    for (size_t i = 0; i < *_splitIndex; i++) {
+        pipeline->popFront();
+    }
+    auto split = pipeline->popFront();
+    auto logic = split->distributedPlanLogic();
+    // Rather than merging the threads' sorted streams, a split $sort is simply redone.
+    auto merging = logic->inputSortPattern ? split : logic->mergingStage;
+    if (merging) {
+        pipeline->addInitialSource(merging);
+    }
+
+    auto queue = DocumentSourceQueue::create(expCtx);
+    for (auto&& doc : inputs) {
+        queue->emplace_back(std::move(doc));
+    }
+    inputs.clear();
+    pipeline->addInitialSource(queue);
+
+    while (auto next = pipeline->getNext()) {
+        _appendResult(*next);
+    }
+}
+
+void ParallelAggregation::_appendResult(const Document& doc) {
+    BSONObj obj = doc.toBson();
+    _results.append(obj.objdata(), obj.objsize());
+    _numResults++;
+}
+
+void ParallelAggregation::_fail(Status status) {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    if (_status.isOK()) {
+        _status = std::move(status);
+    }
+    // no point in the other threads carrying on
+    _stop.store(true);
+}
+
+}  // namespace mongo
@@ -0,0 +1,147 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/base/status_with.h"
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/loaded_doc_batches.h"
+#include "mongo/db/pipeline/document.h"
+#include "mongo/db/pipeline/pipeline.h"
+#include "mongo/db/query/datetime/date_time_support.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+class OperationContext;
+
+/**
+ * Runs an aggregation pipeline over all the docs of a file, on several threads at once, without
+ * needing a mongod.
+ *
+ * The pipeline is split the same way that mongos splits it between shards: each thread runs its
+ * own copy of the stages up to the first one which can't just stream (plus that stage's
+ * per-shard half, eg. a partial $group), over batches of docs that it claims from the file as
+ * they're loaded.  Once every doc has been through, the threads' partial results are fed into
+ * the rest of the pipeline (starting with the merging half of the split stage) on one thread.
+ *
+ * If there's no per-shard half that would reorder the docs (eg. for $limit, $skip, or a pipeline
+ * which only streams), the partial results are merged in the order of the file.
+ */
+class ParallelAggregation {
+public:
+    using LoadProgressFn = LoadedDocBatches::LoadProgressFn;
+    using LoadedDocsFn = LoadedDocBatches::LoadedDocsFn;
+
+    static constexpr unsigned long kBatchSize = 4096;
+
+    /**
+     * Parses the pipeline, which is a JSON array of stages (or a single stage).  The docs come
+     * from the given functions.
+     */
+    static StatusWith<std::unique_ptr<ParallelAggregation>> create(StringData pipelineJson,
+                                                                   LoadProgressFn loadProgress,
+                                                                   LoadedDocsFn loadedDocs);
+
+    ~ParallelAggregation();
+
+    void start(unsigned numThreads);
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    unsigned long numDocsScanned() const {
+        return _batches.numScanned();
+    }
+
+    // The rest are only valid once done.
+
+    const Status& getStatus() const {
+        return _status;
+    }
+
+    // The result docs, one after another.
+    const std::string& getResults() const {
+        return _results;
+    }
+
+    unsigned long numResults() const {
+        return _numResults;
+    }
+
+private:
+    ParallelAggregation(LoadProgressFn loadProgress, LoadedDocsFn loadedDocs);
+
+    boost::intrusive_ptr<ExpressionContext> _makeExpCtx(OperationContext* opCtx,
+                                                        bool needsMerge);
+
+    std::unique_ptr<Pipeline, PipelineDeleter> _parse(
+        const boost::intrusive_ptr<ExpressionContext>& expCtx);
+
+    void _run(unsigned numThreads);
+
+    void _worker();
+
+    void _merge();
+
+    void _appendResult(const Document& doc);
+
+    void _fail(Status status);
+
+    LoadedDocBatches _batches;
+
+    std::vector<BSONObj> _stages;
+    boost::optional<size_t> _splitIndex;  // the first stage that can't just stream
+    bool _mergeInFileOrder = true;
+    TimeZoneDatabase _timeZoneDatabase;
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+
+    // Protects the partial results, and _status while running.
+    stdx::mutex _mutex;
+    std::vector<Document> _partials;
+    std::map<unsigned long, std::vector<Document>> _batchOutputs;  // by batch number
+    Status _status = Status::OK();
+
+    std::string _results;
+    unsigned long _numResults = 0;
+};
+
+}  // namespace mongo
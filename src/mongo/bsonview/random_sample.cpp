@@ -0,0 +1,215 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/random_sample.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "mongo/base/data_view.h"
+#include "mongo/bson/bson_validate.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bson/util/builder.h"
+
+namespace mongo {
+
+constexpr int RandomSample::kChainLength;
+constexpr int RandomSample::kNumPilotDocs;
+
+namespace {
+
+const size_t kMaxDocSize = BSONObjMaxInternalSize;
+
+// How far before a random offset to start looking for a doc boundary, at first.
+const size_t kInitialWindow = 64 * 1024;
+
+int64_t randomSeed() {
+    return std::unique_ptr<SecureRandom>(SecureRandom::create())->nextInt64();
+}
+
+}  // namespace
+
+RandomSample::RandomSample(const char* begin, const char* end, size_t sampleSize)
+    : RandomSample(begin, end, sampleSize, randomSeed()) {}
+
+RandomSample::RandomSample(const char* begin, const char* end, size_t sampleSize, int64_t seed)
+    : _begin(begin),
+      _size(end - begin),
+      _sampleSize(sampleSize),
+      _maxAttempts(1000 + 100 * sampleSize),
+      _seed(seed) {}
+
+RandomSample::~RandomSample() {
+    _stop.store(true);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void RandomSample::start(unsigned numThreads) {
+    invariant(!_thread.joinable());
+    _thread = stdx::thread([this, numThreads]() { _run(numThreads); });
+}
+
+void RandomSample::_run(unsigned numThreads) {
+    if (_size == 0) {
+        _done.store(true);
+        return;
+    }
+
+    PseudoRandom seeds(_seed);
+    // only one word of the generator's state is seeded, so its first few outputs are much alike
+    for (int i = 0; i < 4; i++) {
+        seeds.nextInt32();
+    }
+    PseudoRandom pilotRandom(seeds.nextInt64());
+
+    // the pilot finds how small the docs get, to scale the acceptance probabilities by
+    int numPilotDocs = 0;
+    for (int i = 0; i < kNumPilotDocs * 10 && numPilotDocs < kNumPilotDocs; i++) {
+        size_t docBegin;
+        size_t docEnd;
+        if (_findDoc(pilotRandom.nextInt64(_size), &docBegin, &docEnd)) {
+            const size_t size = docEnd - docBegin;
+            _referenceSize = numPilotDocs ? std::min(_referenceSize, size) : size;
+            numPilotDocs++;
+        }
+    }
+    if (numPilotDocs == 0) {
+        _status = Status(ErrorCodes::InvalidBSON, "Unable to find any docs at random offsets");
+        _done.store(true);
+        return;
+    }
+
+    std::vector<PseudoRandom> randoms;
+    for (unsigned i = 0; i < numThreads; i++) {
+        randoms.emplace_back(seeds.nextInt64());
+    }
+    std::vector<stdx::thread> threads;
+    for (unsigned i = 0; i < numThreads; i++) {
+        threads.emplace_back([this, random = &randoms[i]]() { _worker(random); });
+    }
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+
+    if (_stop.load()) {
+        _status = Status(ErrorCodes::Interrupted, "Sampling was interrupted");
+    }
+    for (auto&& doc : _sampled) {
+        _results.append(_begin + doc.first, doc.second - doc.first);
+        _offsets.push_back(doc.first);
+    }
+    _sampled.clear();
+    _done.store(true);
+}
+
+void RandomSample::_worker(PseudoRandom* random) {
+    while (!_stop.load() && _numSampled.load() < _sampleSize &&
+           _numAttempts.fetchAndAdd(1) < _maxAttempts) {
+        size_t docBegin;
+        size_t docEnd;
+        if (!_findDoc(random->nextInt64(_size), &docBegin, &docEnd)) {
+            continue;
+        }
+        // undo the bias towards larger docs
+        const size_t size = docEnd - docBegin;
+        if (size > _referenceSize &&
+            random->nextCanonicalDouble() >= static_cast<double>(_referenceSize) / size) {
+            continue;
+        }
+
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        if (_sampled.size() < _sampleSize && _sampled.emplace(docBegin, docEnd).second) {
+            _numSampled.store(_sampled.size());
+        }
+    }
+}
+
+bool RandomSample::_findDoc(size_t offset, size_t* docBegin, size_t* docEnd) const {
+    // Rather than looking backwards for the start of the doc, this finds a boundary some way
+    // before the offset and walks forwards from there.  A suffix of a doc can occasionally look
+    // like a doc of its own (eg. when it starts at an int field whose value happens to be the
+    // length of the rest of the doc), but that needs the search to start inside the same doc.
+    for (size_t window = kInitialWindow;; window *= 2) {
+        const size_t start = (offset > window) ? offset - window : 0;
+        size_t next = start;
+        while (next <= offset && !_isBoundary(next)) {
+            next++;
+        }
+        if (next > offset) {
+            // the doc is bigger than the window
+            if (start == 0 || window >= kMaxDocSize) {
+                return false;
+            }
+            continue;
+        }
+
+        while (_isPlausibleDoc(next)) {
+            const size_t end = next + ConstDataView(_begin + next).read<LittleEndian<int>>();
+            if (end > offset) {
+                *docBegin = next;
+                *docEnd = end;
+                return validateBSON(_begin + next, end - next, BSONVersion::kLatest).isOK();
+            }
+            next = end;
+        }
+        return false;
+    }
+}
+
+bool RandomSample::_isPlausibleDoc(size_t offset) const {
+    if (_size - offset < static_cast<size_t>(BSONObj::kMinBSONLength)) {
+        return false;
+    }
+    const int size = ConstDataView(_begin + offset).read<LittleEndian<int>>();
+    return size >= BSONObj::kMinBSONLength && static_cast<size_t>(size) <= kMaxDocSize &&
+        static_cast<size_t>(size) <= _size - offset && _begin[offset + size - 1] == EOO;
+}
+
+bool RandomSample::_isBoundary(size_t offset) const {
+    if (offset == _size) {
+        return true;
+    }
+    // cheap checks first, since most offsets aren't
+    size_t next = offset;
+    for (int i = 0; i < kChainLength && next < _size; i++) {
+        if (!_isPlausibleDoc(next)) {
+            return false;
+        }
+        next += ConstDataView(_begin + next).read<LittleEndian<int>>();
+    }
+    const int size = ConstDataView(_begin + offset).read<LittleEndian<int>>();
+    return validateBSON(_begin + offset, size, BSONVersion::kLatest).isOK();
+}
+
+}  // namespace mongo
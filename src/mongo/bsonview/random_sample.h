@@ -0,0 +1,140 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mongo/base/status.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/platform/random.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * Picks docs of a BSON file uniformly at random (without replacement), without reading the rest
+ * of the file, like $sample does with a random cursor.
+ *
+ * Each attempt picks a random byte of the file, and then finds the doc that contains it, by finding
+ * a doc boundary a little before the byte (one followed by a chain of plausible doc headers, and
+ * then valid BSON), and walking the docs from there up to the byte.  A doc is hit in proportion to
+ * its size, so to make every doc equally likely, a doc of size s is then only accepted with
+ * probability r/s, where the reference size r is the smallest doc found by a pilot run.  (Any
+ * docs smaller than r are accepted every time, so they're slightly under-represented.)
+ *
+ * Attempts are independent random reads, so several threads keep several of them outstanding.
+ */
+class RandomSample {
+public:
+    // How many docs after a boundary must look like docs, for it to be believed.
+    static constexpr int kChainLength = 4;
+    static constexpr int kNumPilotDocs = 64;
+
+    RandomSample(const char* begin, const char* end, size_t sampleSize);
+
+    // With one thread, the same seed always samples the same docs.
+    RandomSample(const char* begin, const char* end, size_t sampleSize, int64_t seed);
+
+    ~RandomSample();
+
+    void start(unsigned numThreads);
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    unsigned long numSampled() const {
+        return _numSampled.load();
+    }
+
+    unsigned long numAttempts() const {
+        return _numAttempts.load();
+    }
+
+    // The rest are only valid once done.
+
+    // Fails if the file doesn't seem to be BSON at all.  If the file has fewer docs than the
+    // sample size (or they can't be found, or it's empty), there are just fewer results.
+    const Status& getStatus() const {
+        return _status;
+    }
+
+    // The sampled docs, in file order, as contiguous BSON.
+    const std::string& getResults() const {
+        return _results;
+    }
+
+    unsigned long numResults() const {
+        return _offsets.size();
+    }
+
+    // The offsets of the sampled docs in the file, in order.
+    const std::vector<size_t>& getOffsets() const {
+        return _offsets;
+    }
+
+private:
+    void _run(unsigned numThreads);
+
+    void _worker(PseudoRandom* random);
+
+    // Finds the doc containing the byte at offset, if it can.
+    bool _findDoc(size_t offset, size_t* docBegin, size_t* docEnd) const;
+
+    bool _isPlausibleDoc(size_t offset) const;
+
+    bool _isBoundary(size_t offset) const;
+
+    const char* const _begin;
+    const size_t _size;
+    const size_t _sampleSize;
+    // Attempts stop after this many, in case the file has fewer docs than the sample size.
+    const unsigned long _maxAttempts;
+    const int64_t _seed;
+    size_t _referenceSize = 0;
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+    AtomicWord<unsigned long> _numSampled{0};
+    AtomicWord<unsigned long> _numAttempts{0};
+
+    stdx::mutex _mutex;  // protects _sampled
+    std::set<std::pair<size_t, size_t>> _sampled;  // (begin, end) of each doc
+
+    Status _status = Status::OK();
+    std::string _results;
+    std::vector<size_t> _offsets;
+};
+
+}  // namespace mongo
@@ -0,0 +1,147 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/random_sample.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+namespace {
+
+struct File {
+    std::string data;
+    std::vector<size_t> offsets;
+};
+
+// Docs of a few different sizes.
+File makeFile(unsigned long numDocs) {
+    File file;
+    for (unsigned long i = 0; i < numDocs; i++) {
+        const BSONObj doc = BSON("_id" << static_cast<long long>(i) << "s"
+                                       << std::string(i % 7 * 10, 'x'));
+        file.offsets.push_back(file.data.size());
+        file.data.append(doc.objdata(), doc.objsize());
+    }
+    return file;
+}
+
+void run(RandomSample* sample, unsigned numThreads) {
+    sample->start(numThreads);
+    while (!sample->isDone()) {
+        sleepmillis(1);
+    }
+    ASSERT_OK(sample->getStatus());
+    ASSERT_EQ(sample->numResults(), sample->getOffsets().size());
+    ASSERT_EQ(sample->numResults(), sample->numSampled());
+}
+
+// Checks the sample is of distinct docs of the file, in order, and returns their numbers.
+std::vector<unsigned long> docsOf(const RandomSample& sample, const File& file) {
+    std::vector<unsigned long> docs;
+    const char* next = sample.getResults().data();
+    for (size_t offset : sample.getOffsets()) {
+        auto it = std::lower_bound(file.offsets.begin(), file.offsets.end(), offset);
+        ASSERT(it != file.offsets.end());
+        ASSERT_EQ(*it, offset);
+        const unsigned long doc = it - file.offsets.begin();
+        ASSERT(docs.empty() || doc > docs.back());
+        docs.push_back(doc);
+
+        const BSONObj obj(file.data.data() + offset);
+        ASSERT(obj.binaryEqual(BSONObj(next)));
+        next += obj.objsize();
+    }
+    ASSERT(next == sample.getResults().data() + sample.getResults().size());
+    return docs;
+}
+
+TEST(RandomSample, EmptyFile) {
+    const std::string empty;
+    RandomSample sample(empty.data(), empty.data(), 10);
+    run(&sample, 2);
+    ASSERT_EQ(sample.numResults(), 0UL);
+    ASSERT(sample.getResults().empty());
+}
+
+TEST(RandomSample, SampleOfEveryDoc) {
+    const File file = makeFile(50);
+    std::vector<unsigned long> all(50);
+    std::iota(all.begin(), all.end(), 0);
+    for (size_t sampleSize : {50, 51, 1000}) {
+        for (unsigned numThreads : {1, 4}) {
+            RandomSample sample(
+                file.data.data(), file.data.data() + file.data.size(), sampleSize, 1);
+            run(&sample, numThreads);
+            ASSERT(docsOf(sample, file) == all);
+        }
+    }
+}
+
+TEST(RandomSample, FixedSeed) {
+    const File file = makeFile(10000);
+    const char* const end = file.data.data() + file.data.size();
+
+    RandomSample sample(file.data.data(), end, 200, 42);
+    run(&sample, 1);
+    const auto docs = docsOf(sample, file);
+    ASSERT_EQ(docs.size(), 200UL);
+
+    RandomSample again(file.data.data(), end, 200, 42);
+    run(&again, 1);
+    ASSERT(docsOf(again, file) == docs);
+
+    RandomSample other(file.data.data(), end, 200, 43);
+    run(&other, 1);
+    ASSERT(docsOf(other, file) != docs);
+
+    // with more threads, the docs depend on the timing, but are still distinct
+    RandomSample threaded(file.data.data(), end, 200, 42);
+    run(&threaded, 4);
+    ASSERT_EQ(docsOf(threaded, file).size(), 200UL);
+}
+
+TEST(RandomSample, NotBSON) {
+    const std::string garbage(100000, '\x7f');
+    RandomSample sample(garbage.data(), garbage.data() + garbage.size(), 10, 1);
+    sample.start(2);
+    while (!sample.isDone()) {
+        sleepmillis(1);
+    }
+    ASSERT_EQ(sample.getStatus().code(), ErrorCodes::InvalidBSON);
+}
+
+}  // namespace
+}  // namespace mongo
@@ -0,0 +1,251 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/render_projection.h"
+
+#include <algorithm>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+const RenderProjection::Node* RenderProjection::Node::find(StringData fieldName) const {
+    // projections only name a handful of fields, so this beats hashing
+    for (auto&& child : children) {
+        if (fieldName == child.first) {
+            return child.second.get();
+        }
+    }
+    return nullptr;
+}
+
+RenderProjection::RenderProjection(const BSONObj& spec, bool inclusion)
+    : _spec(spec.getOwned()), _inclusion(inclusion) {}
+
+StatusWith<std::unique_ptr<RenderProjection>> RenderProjection::parse(const BSONObj& spec) {
+    if (spec.isEmpty()) {
+        return Status(ErrorCodes::BadValue, "The projection must have at least one path");
+    }
+
+    // Like a find projection, _id can be excluded from an inclusion projection, but otherwise
+    // the paths must either all be included or all be excluded.
+    boost::optional<bool> inclusion;
+    boost::optional<bool> includeId;
+    for (auto&& elem : spec) {
+        const StringData path = elem.fieldNameStringData();
+        if (path.empty() || path[0] == '$' || path.find(".$") != std::string::npos) {
+            return Status(ErrorCodes::BadValue,
+                          str::stream() << "Unsupported projection path: '" << path << "'");
+        }
+        if (!elem.isNumber() && !elem.isBoolean()) {
+            return Status(ErrorCodes::BadValue,
+                          str::stream() << "Only inclusion and exclusion are supported, not '"
+                                        << elem.toString() << "'");
+        }
+        if (path == "_id") {
+            includeId = elem.trueValue();
+        } else if (inclusion && *inclusion != elem.trueValue()) {
+            return Status(ErrorCodes::BadValue,
+                          "Projection cannot have a mix of inclusion and exclusion");
+        } else {
+            inclusion = elem.trueValue();
+        }
+    }
+    if (!inclusion) {
+        // only _id was given
+        inclusion = *includeId;
+    }
+
+    std::unique_ptr<RenderProjection> projection(new RenderProjection(spec, *inclusion));
+    for (auto&& elem : spec) {
+        const StringData path = elem.fieldNameStringData();
+        if (path == "_id" && elem.trueValue() != *inclusion) {
+            // excluded from an inclusion projection, which is the same as not mentioning it
+            continue;
+        }
+
+        std::vector<StringData> fieldNames;
+        size_t begin = 0;
+        while (true) {
+            const size_t dot = path.find('.', begin);
+            fieldNames.push_back(
+                path.substr(begin, (dot == std::string::npos) ? std::string::npos : dot - begin));
+            if (dot == std::string::npos) {
+                break;
+            }
+            begin = dot + 1;
+        }
+
+        Node* node = &projection->_root;
+        for (size_t i = 0; i < fieldNames.size(); i++) {
+            if (fieldNames[i].empty()) {
+                return Status(ErrorCodes::BadValue,
+                              str::stream() << "Unsupported projection path: '" << path << "'");
+            }
+            auto it = std::find_if(
+                node->children.begin(), node->children.end(), [&](const auto& child) {
+                    return fieldNames[i] == child.first;
+                });
+            if (it == node->children.end()) {
+                node->children.emplace_back(fieldNames[i].toString(), std::make_unique<Node>());
+                node = node->children.back().second.get();
+            } else if (i + 1 == fieldNames.size() || it->second->children.empty()) {
+                // eg. "a.b" and "a", or "a" and "a.b"
+                return Status(ErrorCodes::BadValue,
+                              str::stream() << "Projection paths collide at '" << path << "'");
+            } else {
+                node = it->second.get();
+            }
+        }
+    }
+
+    if (*inclusion && includeId.value_or(true) && !projection->_root.find("_id")) {
+        // _id is included unless it's excluded
+        projection->_root.children.emplace_back("_id", std::make_unique<Node>());
+    }
+
+    return std::move(projection);
+}
+
+RenderProjection::Action RenderProjection::_action(const Node* node,
+                                                   const BSONElement& elem) const {
+    if (!node) {
+        return _inclusion ? Action::kSkip : Action::kWhole;
+    }
+    if (node->children.empty()) {
+        return _inclusion ? Action::kWhole : Action::kSkip;
+    }
+    if (elem.type() == Object || elem.type() == Array) {
+        return Action::kRecurse;
+    }
+    // a path into a scalar doesn't select anything
+    return _inclusion ? Action::kSkip : Action::kWhole;
+}
+
+void RenderProjection::jsonStringStream(const BSONObj& obj,
+                                        JsonStringFormat format,
+                                        int pretty,
+                                        std::stringstream& s) const {
+    _writeObject(obj, _root, false, format, pretty, s);
+}
+
+// Mirrors BSONObj::jsonStringStream() for objects, and BSONElement::jsonStringStream() for
+// arrays (with the same meaning of pretty as each), except that the elements come from the
+// projection.
+void RenderProjection::_writeObject(const BSONObj& obj,
+                                    const Node& node,
+                                    bool isArray,
+                                    JsonStringFormat format,
+                                    int pretty,
+                                    std::stringstream& s) const {
+    const int elemPretty = pretty ? pretty + 1 : 0;
+    bool first = true;
+    for (auto&& elem : obj) {
+        // the members of an array are all projected by the array's node
+        const Node* elemNode = isArray ? &node : node.find(elem.fieldNameStringData());
+        const Action action = _action(elemNode, elem);
+        if (action == Action::kSkip) {
+            continue;
+        }
+
+        if (first) {
+            s << (isArray ? "[ " : "{ ");
+            first = false;
+        } else if (isArray) {
+            s << ", ";
+        } else {
+            s << ",";
+            if (pretty) {
+                s << '\n';
+                for (int x = 0; x < pretty; x++)
+                    s << "  ";
+            } else {
+                s << " ";
+            }
+        }
+        if (isArray && pretty) {
+            s << '\n';
+            for (int x = 0; x < pretty; x++)
+                s << "  ";
+        }
+
+        if (action == Action::kWhole) {
+            elem.jsonStringStream(format, !isArray, elemPretty, s);
+        } else {
+            if (!isArray) {
+                s << '"' << str::escape(elem.fieldName()) << "\" : ";
+            }
+            _writeObject(
+                elem.embeddedObject(), *elemNode, elem.type() == Array, format, elemPretty, s);
+        }
+    }
+    if (first) {
+        s << (isArray ? "[]" : "{}");
+    } else {
+        s << (isArray ? " ]" : " }");
+    }
+}
+
+BSONObj RenderProjection::project(const BSONObj& obj) const {
+    BSONObjBuilder out;
+    _appendObject(obj, _root, false, &out);
+    return out.obj();
+}
+
+void RenderProjection::_appendObject(const BSONObj& obj,
+                                     const Node& node,
+                                     bool isArray,
+                                     BSONObjBuilder* out) const {
+    // the members of a projected array are renumbered
+    unsigned index = 0;
+    for (auto&& elem : obj) {
+        const Node* elemNode = isArray ? &node : node.find(elem.fieldNameStringData());
+        const Action action = _action(elemNode, elem);
+        if (action == Action::kSkip) {
+            continue;
+        }
+
+        const std::string fieldName =
+            isArray ? std::to_string(index++) : elem.fieldNameStringData().toString();
+        if (action == Action::kWhole) {
+            out->appendAs(elem, fieldName);
+        } else if (elem.type() == Array) {
+            BSONObjBuilder sub(out->subarrayStart(fieldName));
+            _appendObject(elem.embeddedObject(), *elemNode, true, &sub);
+        } else {
+            BSONObjBuilder sub(out->subobjStart(fieldName));
+            _appendObject(elem.embeddedObject(), *elemNode, false, &sub);
+        }
+    }
+}
+
+}  // namespace mongo
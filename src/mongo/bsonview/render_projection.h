@@ -0,0 +1,122 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mongo/base/status_with.h"
+#include "mongo/base/string_data.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bson/json.h"
+
+namespace mongo {
+
+/**
+ * A projection that is applied to docs as they're rendered, so that only the fields of interest
+ * get formatted.  It has the semantics of a find projection (as in ProjectionExec): either only
+ * the listed paths are included (plus _id, unless it's excluded), or the listed paths are
+ * excluded; paths into arrays apply to each of their subdocuments.
+ *
+ * Rather than building a projected copy of each doc, the projection is evaluated in a single
+ * pass over the doc's elements, and the ones that survive are written straight out as JSON, so
+ * the cost of rendering follows the size of the projected fields rather than the whole doc.
+ * Elements that aren't wanted are only ever stepped over.
+ *
+ * Positional, $slice, $elemMatch and $meta projections aren't supported.
+ */
+class RenderProjection {
+public:
+    /**
+     * Parses a projection spec, eg. {ts: 1, op: 1, ns: 1} or {o: 0}.
+     */
+    static StatusWith<std::unique_ptr<RenderProjection>> parse(const BSONObj& spec);
+
+    const BSONObj& getSpec() const {
+        return _spec;
+    }
+
+    /**
+     * Appends the projection of obj to s, formatted exactly as BSONObj::jsonStringStream() would
+     * format the projected doc.
+     */
+    void jsonStringStream(const BSONObj& obj,
+                          JsonStringFormat format,
+                          int pretty,
+                          std::stringstream& s) const;
+
+    std::string jsonString(const BSONObj& obj, JsonStringFormat format, int pretty = 0) const {
+        std::stringstream s;
+        jsonStringStream(obj, format, pretty, s);
+        return s.str();
+    }
+
+    /**
+     * Builds a copy of obj with the projection applied, for rendering other than as JSON.
+     */
+    BSONObj project(const BSONObj& obj) const;
+
+private:
+    // The projection of one level of the doc.  A node with no children projects its path
+    // as a whole (ie. includes or excludes it).
+    struct Node {
+        const Node* find(StringData fieldName) const;
+
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> children;
+    };
+
+    RenderProjection(const BSONObj& spec, bool inclusion);
+
+    enum class Action { kSkip, kWhole, kRecurse };
+
+    // What to do with an element, given its node (null if the projection doesn't mention it).
+    Action _action(const Node* node, const BSONElement& elem) const;
+
+    void _writeObject(const BSONObj& obj,
+                      const Node& node,
+                      bool isArray,
+                      JsonStringFormat format,
+                      int pretty,
+                      std::stringstream& s) const;
+
+    void _appendObject(const BSONObj& obj,
+                       const Node& node,
+                       bool isArray,
+                       BSONObjBuilder* out) const;
+
+    BSONObj _spec;
+    bool _inclusion;
+    Node _root;
+};
+
+}  // namespace mongo
@@ -0,0 +1,134 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/render_projection.h"
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/bson/json.h"
+#include "mongo/unittest/unittest.h"
+
+namespace mongo {
+namespace {
+
+std::unique_ptr<RenderProjection> parse(const char* spec) {
+    auto projection = RenderProjection::parse(fromjson(spec));
+    ASSERT_OK(projection.getStatus());
+    return std::move(projection.getValue());
+}
+
+// The projection is written out in one pass, so it must come out just as the projected doc would.
+void assertRendersLikeProjectedDoc(const RenderProjection& projection, const BSONObj& doc) {
+    const BSONObj projected = projection.project(doc);
+    for (JsonStringFormat format : {Strict, TenGen}) {
+        for (int pretty : {0, 1}) {
+            ASSERT_EQ(projection.jsonString(doc, format, pretty),
+                      projected.jsonString(format, pretty));
+        }
+    }
+}
+
+std::vector<BSONObj> testDocs() {
+    return {
+        fromjson("{_id: 1, a: 1, b: 'x', c: {d: 1, e: 2}}"),
+        fromjson("{_id: 2, c: [{d: 1, e: 2}, {e: 3}, 4, [{d: 5}]], f: null}"),
+        fromjson("{a: [1, 2], c: 'scalar'}"),
+        fromjson("{_id: {$oid: '5d6e7f8091a2b3c4d5e6f708'}, ts: {$timestamp: {t: 1, i: 2}}, "
+                 "c: {d: {$date: 0}, g: {h: [1, {i: 2}]}}}"),
+        fromjson("{}"),
+    };
+}
+
+TEST(RenderProjection, Inclusion) {
+    auto projection = parse("{a: 1, 'c.d': 1}");
+    ASSERT_BSONOBJ_EQ(projection->project(fromjson("{_id: 1, a: 1, b: 'x', c: {d: 1, e: 2}}")),
+                      fromjson("{_id: 1, a: 1, c: {d: 1}}"));
+    // paths into arrays apply to their subdocuments, and scalars along the path are dropped
+    ASSERT_BSONOBJ_EQ(projection->project(fromjson("{c: [{d: 1, e: 2}, {e: 3}, 4, [{d: 5}]]}")),
+                      fromjson("{c: [{d: 1}, {}, [{d: 5}]]}"));
+    ASSERT_BSONOBJ_EQ(projection->project(fromjson("{c: 'scalar'}")), BSONObj());
+    for (auto&& doc : testDocs()) {
+        assertRendersLikeProjectedDoc(*projection, doc);
+    }
+}
+
+TEST(RenderProjection, InclusionWithoutId) {
+    auto projection = parse("{_id: 0, 'c.g.h.i': 1, ts: 1}");
+    ASSERT_BSONOBJ_EQ(projection->project(testDocs()[3]),
+                      fromjson("{ts: {$timestamp: {t: 1, i: 2}}, c: {g: {h: [{i: 2}]}}}"));
+    for (auto&& doc : testDocs()) {
+        assertRendersLikeProjectedDoc(*projection, doc);
+    }
+}
+
+TEST(RenderProjection, Exclusion) {
+    auto projection = parse("{'c.e': 0, b: 0}");
+    ASSERT_BSONOBJ_EQ(projection->project(fromjson("{_id: 1, a: 1, b: 'x', c: {d: 1, e: 2}}")),
+                      fromjson("{_id: 1, a: 1, c: {d: 1}}"));
+    ASSERT_BSONOBJ_EQ(projection->project(fromjson("{c: [{d: 1, e: 2}, {e: 3}, 4]}")),
+                      fromjson("{c: [{d: 1}, {}, 4]}"));
+    for (auto&& doc : testDocs()) {
+        assertRendersLikeProjectedDoc(*projection, doc);
+    }
+}
+
+TEST(RenderProjection, OnlyId) {
+    auto included = parse("{_id: 1}");
+    ASSERT_BSONOBJ_EQ(included->project(testDocs()[0]), fromjson("{_id: 1}"));
+    auto excluded = parse("{_id: 0}");
+    ASSERT_BSONOBJ_EQ(excluded->project(fromjson("{_id: 1, a: 1}")), fromjson("{a: 1}"));
+    for (auto&& doc : testDocs()) {
+        assertRendersLikeProjectedDoc(*included, doc);
+        assertRendersLikeProjectedDoc(*excluded, doc);
+    }
+}
+
+TEST(RenderProjection, EmptyResult) {
+    auto projection = parse("{_id: 0, z: 1}");
+    ASSERT_EQ(projection->jsonString(testDocs()[0], Strict), "{}");
+    ASSERT_EQ(projection->jsonString(testDocs()[0], Strict, 1), "{}");
+}
+
+TEST(RenderProjection, InvalidSpecs) {
+    for (const char* spec : {"{}",
+                             "{a: 1, b: 0}",
+                             "{a: 'x'}",
+                             "{$a: 1}",
+                             "{'a.$': 1}",
+                             "{'a..b': 1}",
+                             "{a: {$slice: 1}}",
+                             "{a: 1, 'a.b': 1}",
+                             "{'a.b': 1, a: 1}"}) {
+        ASSERT_NOT_OK(RenderProjection::parse(fromjson(spec)).getStatus());
+    }
+}
+
+}  // namespace
+}  // namespace mongo
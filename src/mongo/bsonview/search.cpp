@@ -0,0 +1,265 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/search.h"
+
+#include <algorithm>
+
+#include "mongo/bson/json.h"
+#include "mongo/bsonview/loaded_doc_batches.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+const boost::intrusive_ptr<ExpressionContext> SearchMQL::_expCtx = new ExpressionContext(nullptr, nullptr);
+
+
+Search::Search(const std::string& s)
+: _text(s)
+{
+}
+
+Search::~Search() {
+    stopBackgroundFill();
+}
+
+const std::string& Search::getText() const {
+    return _text;
+}
+
+bool Search::_evaluate(const BSONObj& obj, const DocRenderer& renderer) const {
+    try {
+        return matchesObj(obj, renderer);
+    } catch (DBException& e) {
+        // eg. a corrupt doc that can't be rendered, which certainly doesn't match
+        return false;
+    }
+}
+
+bool Search::matches(unsigned long doc, BSONCache& cache, const DocRenderer& renderer) const {
+    if ( ! isValid()) {
+        return false;
+    }
+    switch (_bitmap.get(doc)) {
+        case MatchBitmap::State::kMatch:   return true;
+        case MatchBitmap::State::kNoMatch: return false;
+        case MatchBitmap::State::kUnknown: break;
+    }
+    if (_candidates && ! std::binary_search(_candidates->begin(), _candidates->end(), doc)) {
+        _bitmap.set(doc, false);
+        return false;
+    }
+    bool result = _evaluate(cache[doc], renderer);
+    _bitmap.set(doc, result);
+    return result;
+}
+
+boost::optional<unsigned long> Search::findNext(unsigned long from, unsigned long end, BSONCache& cache, const DocRenderer& renderer) const {
+    if ( ! isValid()) {
+        return boost::none;
+    }
+    if (_candidates) {
+        for (auto it = std::lower_bound(_candidates->begin(), _candidates->end(), from); it != _candidates->end() && *it < end; ++it) {
+            if (matches(*it, cache, renderer)) {
+                return *it;
+            }
+        }
+        return boost::none;
+    }
+    unsigned long curr = from;
+    while (curr < end) {
+        unsigned long unknown;
+        auto found = _bitmap.findNext(curr, end, &unknown);
+        if (found) {
+            return found;
+        }
+        if (unknown >= end) {
+            break;
+        }
+        if (matches(unknown, cache, renderer)) {
+            return unknown;
+        }
+        curr = unknown + 1;
+    }
+    return boost::none;
+}
+
+void Search::startBackgroundFill(const BSONCache& cache, const DocRenderer& renderer) {
+    stopBackgroundFill();
+    _stopFill.store(false);
+    // leave a core for the UI thread (and the loader)
+    unsigned cores = stdx::thread::hardware_concurrency();
+    unsigned numThreads = (cores > 1) ? cores - 1 : 1;
+    for (unsigned i = 0; i < numThreads; i++) {
+        _fillThreads.emplace_back([this, &cache, &renderer] () { _fillWorker(&cache, &renderer); });
+    }
+}
+
+void Search::stopBackgroundFill() {
+    _stopFill.store(true);
+    for (auto&& thread : _fillThreads) {
+        thread.join();
+    }
+    _fillThreads.clear();
+}
+
+void Search::setFillFocus(unsigned long doc) {
+    _fillFocus.store(doc);
+}
+
+void Search::resetMatches() {
+    stopBackgroundFill();
+    _bitmap.clear();
+}
+
+size_t Search::memoryUsage() const {
+    size_t bytes = _bitmap.memoryUsage();
+    if (_candidates) {
+        bytes += _candidates->capacity() * sizeof(unsigned long);
+    }
+    return bytes;
+}
+
+void Search::_fillWorker(const BSONCache* cache, const DocRenderer* renderer) {
+    std::vector<BSONObj> docs;
+    MatchBitmap::ChunkBits matched;
+    while ( ! _stopFill.load()) {
+        unsigned long numDocs;
+        bool complete;
+        cache->getLoadProgress(&numDocs, &complete);
+
+        auto chunk = _bitmap.claimChunk(_fillFocus.load() / MatchBitmap::kChunkSize, numDocs, complete);
+        if ( ! chunk) {
+            if (complete) {
+                // everything has been (or is being) evaluated
+                return;
+            }
+            // wait for the loader to catch up, like the other background jobs (which take their
+            // chunks in order, rather than from the focus, so can use LoadedDocBatches itself)
+            sleepmillis(LoadedDocBatches::kWaitMillis);
+            continue;
+        }
+
+        unsigned long begin = *chunk * MatchBitmap::kChunkSize;
+        unsigned long end = std::min(begin + MatchBitmap::kChunkSize, numDocs);
+        cache->getLoadedDocs(begin, end, &docs);
+
+        matched.reset();
+        if (_candidates) {
+            // everything else is already known not to match
+            for (auto it = std::lower_bound(_candidates->begin(), _candidates->end(), begin); it != _candidates->end() && *it < end; ++it) {
+                if (_stopFill.load()) {
+                    _bitmap.releaseChunk(*chunk);
+                    return;
+                }
+                matched.set(*it - begin, _evaluate(docs[*it - begin], *renderer));
+            }
+        } else {
+            for (unsigned long i = 0; i < docs.size(); i++) {
+                if (_stopFill.load()) {
+                    _bitmap.releaseChunk(*chunk);
+                    return;
+                }
+                matched.set(i, _evaluate(docs[i], *renderer));
+            }
+        }
+        _bitmap.setChunk(*chunk, matched, docs.size());
+    }
+}
+
+
+SearchRenderedText::SearchRenderedText(const std::string& s)
+: Search(s)
+{
+}
+
+SearchRenderedText::~SearchRenderedText() {
+    // the fill threads call matchesObj, which is gone by the time ~Search stops them
+    stopBackgroundFill();
+}
+
+bool SearchRenderedText::matchesObj(const BSONObj& obj, const DocRenderer& renderer) const {
+    if ( ! isValid()) {
+        return false;
+    }
+    // TODO: ergh this is so horribly slow
+    return (renderer.render(obj).find(getText()) != std::string::npos);
+}
+
+bool SearchRenderedText::isValid() const {
+    return (getText() != "");
+}
+
+
+SearchMQL::SearchMQL(const std::string& s, const FieldIndexCatalog* indexes)
+: Search(s), _matcher(nullptr), _valid(false)
+{
+    try {
+        _pattern = fromjson(s);
+        //OperationContext* opCtx = new OperationContextNoop();
+        //boost::intrusive_ptr<ExpressionContext> expCtx(new ExpressionContext(opCtx, nullptr));
+        _matcher = new Matcher(_pattern, _expCtx);
+        _plan = MQLMatchPlan::compile(_matcher);
+        if (indexes) {
+            if (auto candidates = indexes->candidateDocs(_matcher->getMatchExpression())) {
+                setCandidates(std::move(*candidates));
+            }
+        }
+        _valid = true;
+    } catch (DBException& e) {
+        // TODO
+        //return Status(BadQuery, "Cannot parse MQL query");
+        // leave _valid as false
+    }
+}
+
+SearchMQL::~SearchMQL() {
+    stopBackgroundFill();
+    _plan.reset();
+    delete _matcher;
+}
+
+bool SearchMQL::matchesObj(const BSONObj& obj, const DocRenderer& renderer) const {
+    if ( ! isValid()) {
+        return false;
+    }
+    if (_plan) {
+        return _plan->matches(obj);
+    }
+    // No MatchDetails, since this gets called concurrently from the background fill threads.
+    return (_matcher->matches(obj));
+}
+
+bool SearchMQL::isValid() const {
+    return _valid;
+}
+
+}  // namespace mongo
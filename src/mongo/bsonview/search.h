@@ -0,0 +1,163 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/bson_cache.h"
+#include "mongo/bsonview/doc_renderer.h"
+#include "mongo/bsonview/field_value_index.h"
+#include "mongo/bsonview/match_bitmap.h"
+#include "mongo/bsonview/mql_match_plan.h"
+#include "mongo/db/matcher/matcher.h"
+#include "mongo/db/pipeline/expression_context.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * A search over the docs of a file, which remembers which docs match in a match bitmap.  The
+ * renderer is the one the docs are viewed with, so that text searches find what's on the screen.
+ */
+class Search {
+public:
+    Search(const std::string& s);
+    virtual ~Search();
+
+    // Uses the results already in the match bitmap where possible, otherwise evaluates the doc
+    // (and remembers the result).
+    bool matches(unsigned long doc, BSONCache& cache, const DocRenderer& renderer) const;
+
+    // Returns the first matching doc in [from, end), using the match bitmap to skip over docs
+    // that have already been evaluated.
+    boost::optional<unsigned long> findNext(unsigned long from, unsigned long end, BSONCache& cache, const DocRenderer& renderer) const;
+
+    // Must be thread-safe, since it's also called from the background fill threads.
+    virtual bool matchesObj(const BSONObj& obj, const DocRenderer& renderer) const = 0;
+
+    virtual bool isValid() const = 0;
+
+    // If true, the results depend on how the docs are rendered, and so need to be thrown away
+    // when the render mode changes.
+    virtual bool dependsOnRendering() const {
+        return false;
+    }
+
+    // Starts background threads which evaluate the search over the whole file (as it's loaded),
+    // beginning from the fill focus (ie. the top of the screen), and store the results in the
+    // match bitmap.  This way, highlighting matches while scrolling around doesn't need to
+    // evaluate the search on the UI thread.  The cache and renderer must outlive the fill.
+    void startBackgroundFill(const BSONCache& cache, const DocRenderer& renderer);
+
+    // Must be called before the search (or anything the search depends on) is destroyed.
+    void stopBackgroundFill();
+
+    void setFillFocus(unsigned long doc);
+
+    // Stops any background filling, and throws away all the match results.
+    void resetMatches();
+
+    const MatchBitmap& getMatchBitmap() const {
+        return _bitmap;
+    }
+
+    // The match bitmap and the candidates.
+    size_t memoryUsage() const;
+
+    // If known (eg. from an index), the sorted docs which might match.  No other docs can.
+    const boost::optional<std::vector<unsigned long>>& getCandidates() const {
+        return _candidates;
+    }
+
+protected:
+    const std::string& getText() const;
+
+    // Only to be called from the constructor, ie. before anything has been evaluated.
+    void setCandidates(std::vector<unsigned long> docs) {
+        _candidates = std::move(docs);
+    }
+
+private:
+    bool _evaluate(const BSONObj& obj, const DocRenderer& renderer) const;
+
+    void _fillWorker(const BSONCache* cache, const DocRenderer* renderer);
+
+    std::string _text;
+
+    boost::optional<std::vector<unsigned long>> _candidates;
+
+    mutable MatchBitmap _bitmap;
+
+    std::vector<stdx::thread> _fillThreads;
+    AtomicWord<bool> _stopFill{false};
+    AtomicWord<unsigned long> _fillFocus{0};
+};
+
+
+class SearchRenderedText : public Search {
+public:
+    SearchRenderedText(const std::string& s);
+    virtual ~SearchRenderedText();
+
+    virtual bool matchesObj(const BSONObj& obj, const DocRenderer& renderer) const;
+
+    virtual bool isValid() const;
+
+    virtual bool dependsOnRendering() const {
+        return true;
+    }
+
+};
+
+
+class SearchMQL : public Search {
+public:
+    // If any of the indexes can be used, only the docs they give are evaluated.
+    SearchMQL(const std::string& s, const FieldIndexCatalog* indexes = nullptr);
+    virtual ~SearchMQL();
+
+    virtual bool matchesObj(const BSONObj& obj, const DocRenderer& renderer) const;
+
+    virtual bool isValid() const;
+
+private:
+    BSONObj _pattern;
+    static const boost::intrusive_ptr<ExpressionContext> _expCtx;
+    Matcher* _matcher;
+    std::unique_ptr<MQLMatchPlan> _plan;  // null if the query isn't suitable
+    bool _valid;
+};
+
+}  // namespace mongo
@@ -0,0 +1,288 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/bsonview/sort_permutation.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/bson/ordering.h"
+#include "mongo/db/bson/dotted_path_support.h"
+#include "mongo/db/sorter/sorter.h"
+#include "mongo/util/bufreader.h"
+#include "mongo/util/errno_util.h"
+#include "mongo/util/str.h"
+
+namespace mongo {
+
+namespace {
+
+/**
+ * Generates a new file name on each call using a static, atomic and monotonically increasing
+ * number.
+ *
+ * Each user of the Sorter must implement this function to ensure that all temporary files that the
+ * Sorter instances produce are uniquely identified using a unique file name extension with separate
+ * atomic variable. This is necessary because the sorter.cpp code is separately included in multiple
+ * places, rather than compiled in one place and linked, and so cannot provide a globally unique ID.
+ */
+std::string nextFileName() {
+    static AtomicWord<unsigned> sortPermutationFileCounter;
+    return str::stream() << "extsort-bv-sort." << ::getpid() << "."
+                         << sortPermutationFileCounter.fetchAndAdd(1);
+}
+
+// The value that goes through the Sorter along with each doc's key.
+struct DocNumber {
+    struct SorterDeserializeSettings {};  // unused
+    void serializeForSorter(BufBuilder& buf) const {
+        buf.appendNum(static_cast<long long>(doc));
+    }
+    static DocNumber deserializeForSorter(BufReader& buf, const SorterDeserializeSettings&) {
+        return {static_cast<unsigned long>(buf.read<LittleEndian<int64_t>>())};
+    }
+    int memUsageForSorter() const {
+        return sizeof(DocNumber);
+    }
+    DocNumber getOwned() const {
+        return *this;
+    }
+
+    unsigned long doc;
+};
+
+class SortPermutationComparison {
+public:
+    explicit SortPermutationComparison(const BSONObj& pattern)
+        : _ordering(Ordering::make(pattern)) {}
+
+    int operator()(const std::pair<BSONObj, DocNumber>& lhs,
+                   const std::pair<BSONObj, DocNumber>& rhs) const {
+        int cmp = lhs.first.woCompare(rhs.first, _ordering, /*considerFieldName*/ false);
+        if (cmp != 0) {
+            return cmp;
+        }
+        // keeps the sort stable, whichever thread saw each doc
+        return (lhs.second.doc < rhs.second.doc) ? -1 : (lhs.second.doc > rhs.second.doc);
+    }
+
+private:
+    Ordering _ordering;
+};
+
+using DocSorter = Sorter<BSONObj, DocNumber>;
+
+}  // namespace
+
+constexpr unsigned long SortPermutation::kBatchSize;
+
+SortPermutation::SortPermutation(const BSONObj& pattern,
+                                 LoadProgressFn loadProgress,
+                                 LoadedDocsFn loadedDocs,
+                                 const std::string& tempDir,
+                                 size_t maxMemoryUsageBytes)
+    : _pattern(pattern.getOwned()),
+      _batches(std::move(loadProgress), std::move(loadedDocs), kBatchSize, &_stop),
+      _tempDir(tempDir),
+      _maxMemoryUsageBytes(maxMemoryUsageBytes) {}
+
+SortPermutation::~SortPermutation() {
+    _stop.store(true);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_order) {
+        ::munmap(const_cast<uint64_t*>(_order), _numDocs * sizeof(uint64_t));
+    }
+    if (_positions) {
+        ::munmap(const_cast<uint64_t*>(_positions), _numDocs * sizeof(uint64_t));
+    }
+}
+
+StatusWith<std::unique_ptr<SortPermutation>> SortPermutation::create(
+    const BSONObj& pattern,
+    LoadProgressFn loadProgress,
+    LoadedDocsFn loadedDocs,
+    const std::string& tempDir,
+    size_t maxMemoryUsageBytes) {
+    if (pattern.isEmpty()) {
+        return Status(ErrorCodes::BadValue, "The sort pattern must have at least one path");
+    }
+    for (auto&& elem : pattern) {
+        if (elem.fieldNameStringData().empty()) {
+            return Status(ErrorCodes::BadValue, "The sort pattern can't have an empty path");
+        }
+        if (!elem.isNumber() || (elem.numberInt() != 1 && elem.numberInt() != -1)) {
+            return Status(ErrorCodes::BadValue,
+                          str::stream() << "The sort order of '" << elem.fieldName()
+                                        << "' must be 1 or -1");
+        }
+    }
+    return std::unique_ptr<SortPermutation>(new SortPermutation(
+        pattern, std::move(loadProgress), std::move(loadedDocs), tempDir, maxMemoryUsageBytes));
+}
+
+void SortPermutation::start(unsigned numThreads) {
+    invariant(!_thread.joinable());
+    _thread = stdx::thread([this, numThreads]() { _run(numThreads); });
+}
+
+void SortPermutation::_run(unsigned numThreads) {
+    const SortPermutationComparison comp(_pattern);
+    // the threads share the limit, and the final merge only needs a run's buffer per file
+    const SortOptions opts = SortOptions()
+                                 .MaxMemoryUsageBytes(_maxMemoryUsageBytes / numThreads)
+                                 .ExtSortAllowed()
+                                 .TempDir(_tempDir);
+
+    // Each thread has its own sorter, so they never contend.  The sorters have to outlive the
+    // iterators they hand back, which is why they live here rather than on the threads.
+    std::vector<std::unique_ptr<DocSorter>> sorters;
+    for (unsigned i = 0; i < numThreads; i++) {
+        sorters.emplace_back(DocSorter::make(opts, comp));
+    }
+
+    std::vector<stdx::thread> threads;
+    for (unsigned i = 0; i < numThreads; i++) {
+        threads.emplace_back([this, sorter = sorters[i].get()]() {
+            try {
+                std::vector<BSONObj> docs;
+                unsigned long begin;
+                while (_batches.next(&docs, &begin)) {
+                    for (unsigned long j = 0; j < docs.size(); j++) {
+                        sorter->add(_extractKey(docs[j]), DocNumber{begin + j});
+                    }
+                }
+            } catch (const DBException& e) {
+                _fail(e.toStatus());
+            } catch (const std::exception& e) {
+                // eg. from writing out a spilled run
+                _fail(Status(ErrorCodes::InternalError, e.what()));
+            }
+        });
+    }
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+
+    if (_status.isOK()) {
+        try {
+            std::vector<std::shared_ptr<DocSorter::Iterator>> iters;
+            for (auto&& sorter : sorters) {
+                iters.emplace_back(sorter->done());
+            }
+            std::unique_ptr<DocSorter::Iterator> merged(DocSorter::Iterator::merge(
+                iters, _tempDir + "/" + nextFileName(), opts, comp));
+
+            const unsigned long numDocs = _batches.numScanned();
+            _numDocs = numDocs;
+            uint64_t* order = _mapTempFile("order", numDocs);
+            _order = order;
+            uint64_t* positions = _mapTempFile("positions", numDocs);
+            _positions = positions;
+
+            unsigned long pos = 0;
+            while (merged->more()) {
+                uassert(ErrorCodes::Interrupted, "Sort was interrupted", !_stop.load());
+                const unsigned long doc = merged->next().second.doc;
+                order[pos] = doc;
+                positions[doc] = pos;
+                pos++;
+                _numMerged.store(pos);
+            }
+            invariant(pos == numDocs);
+        } catch (const DBException& e) {
+            _fail(e.toStatus());
+        } catch (const std::exception& e) {
+            _fail(Status(ErrorCodes::InternalError, e.what()));
+        }
+    }
+    _done.store(true);
+}
+
+BSONObj SortPermutation::_extractKey(const BSONObj& doc) const {
+    BSONObjBuilder key;
+    for (auto&& elem : _pattern) {
+        BSONElement value = dotted_path_support::extractElementAtPath(doc, elem.fieldName());
+        if (value.eoo()) {
+            key.appendNull("");
+        } else {
+            key.appendAs(value, "");
+        }
+    }
+    return key.obj();
+}
+
+uint64_t* SortPermutation::_mapTempFile(const std::string& name, unsigned long numDocs) {
+    if (numDocs == 0) {
+        // nothing to map
+        return nullptr;
+    }
+    const std::string path = str::stream() << _tempDir << "/" << nextFileName() << "." << name;
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    uassert(ErrorCodes::FileOpenFailed,
+            str::stream() << "Unable to create " << path << ": " << errnoWithDescription(),
+            fd != -1);
+    // it only needs to last as long as the mapping
+    ::unlink(path.c_str());
+
+    const size_t size = numDocs * sizeof(uint64_t);
+    if (::ftruncate(fd, size) == -1) {
+        const int err = errno;
+        ::close(fd);
+        uasserted(ErrorCodes::FileStreamFailed,
+                  str::stream() << "Unable to extend " << path << ": "
+                                << errnoWithDescription(err));
+    }
+    void* base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    const int err = errno;
+    ::close(fd);
+    uassert(ErrorCodes::FileStreamFailed,
+            str::stream() << "Unable to map " << path << ": " << errnoWithDescription(err),
+            base != MAP_FAILED);
+    return static_cast<uint64_t*>(base);
+}
+
+void SortPermutation::_fail(Status status) {
+    stdx::lock_guard<stdx::mutex> lk(_mutex);
+    if (_status.isOK()) {
+        _status = std::move(status);
+    }
+    // no point in the other threads carrying on
+    _stop.store(true);
+}
+
+}  // namespace mongo
+
+#include "mongo/db/sorter/sorter.cpp"
+MONGO_CREATE_SORTER(mongo::BSONObj, mongo::DocNumber, mongo::SortPermutationComparison);
@@ -0,0 +1,153 @@
+/**
+ *    Copyright (C) 2019-present MongoDB, Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the Server Side Public License, version 1,
+ *    as published by MongoDB, Inc.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    Server Side Public License for more details.
+ *
+ *    You should have received a copy of the Server Side Public License
+ *    along with this program. If not, see
+ *    <http://www.mongodb.com/licensing/server-side-public-license>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the Server Side Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/base/status_with.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/bsonview/doc_order.h"
+#include "mongo/bsonview/loaded_doc_batches.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+/**
+ * A permutation of the docs of a file, ordering them by a sort pattern, eg. {ts: -1}.
+ *
+ * Several threads extract the sort key of each doc (as docs are loaded), and feed the (key, doc
+ * number) pairs into their own Sorter, which spills sorted runs to temp files whenever it goes
+ * over its share of the memory limit.  Once every doc has been seen, the sorters' runs are
+ * merged, and the doc numbers are written out in sorted order to a temp file, along with the
+ * inverse permutation.  Both files are unlinked as soon as they're created, and are memory
+ * mapped once the sort is done, so only the Sorters' buffers ever count against the memory
+ * limit, no matter how many docs the file has.
+ *
+ * The key of a doc is the value at each path of the pattern (null if missing), compared as BSON,
+ * with ties broken by position in the file.  Unlike a query's sort, arrays are compared as whole
+ * values, rather than by their smallest or largest member.
+ */
+class SortPermutation : public DocOrder {
+public:
+    using LoadProgressFn = LoadedDocBatches::LoadProgressFn;
+    using LoadedDocsFn = LoadedDocBatches::LoadedDocsFn;
+
+    static constexpr unsigned long kBatchSize = 4096;
+
+    /**
+     * Checks the sort pattern, which must be a non-empty object of paths to 1 or -1.  The docs
+     * come from the given functions.  Spilled runs, and the permutation itself, go in tempDir.
+     */
+    static StatusWith<std::unique_ptr<SortPermutation>> create(const BSONObj& pattern,
+                                                               LoadProgressFn loadProgress,
+                                                               LoadedDocsFn loadedDocs,
+                                                               const std::string& tempDir,
+                                                               size_t maxMemoryUsageBytes);
+
+    ~SortPermutation() override;
+
+    void start(unsigned numThreads);
+
+    bool isDone() const {
+        return _done.load();
+    }
+
+    unsigned long numDocsScanned() const {
+        return _batches.numScanned();
+    }
+
+    // How many docs have been placed in order by the final merge.
+    unsigned long numDocsMerged() const {
+        return _numMerged.load();
+    }
+
+    // The rest are only valid once done.
+
+    const Status& getStatus() const {
+        return _status;
+    }
+
+    const BSONObj& getPattern() const {
+        return _pattern;
+    }
+
+    unsigned long numDocs() const override {
+        return _numDocs;
+    }
+
+    unsigned long sourceDoc(unsigned long pos) const override {
+        return _order[pos];
+    }
+
+    unsigned long position(unsigned long sourceDoc) const override {
+        return _positions[sourceDoc];
+    }
+
+private:
+    SortPermutation(const BSONObj& pattern,
+                    LoadProgressFn loadProgress,
+                    LoadedDocsFn loadedDocs,
+                    const std::string& tempDir,
+                    size_t maxMemoryUsageBytes);
+
+    void _run(unsigned numThreads);
+
+    BSONObj _extractKey(const BSONObj& doc) const;
+
+    // Creates a temp file with room for a doc number per doc, which is unlinked straight away,
+    // and maps it.
+    uint64_t* _mapTempFile(const std::string& name, unsigned long numDocs);
+
+    void _fail(Status status);
+
+    BSONObj _pattern;
+    LoadedDocBatches _batches;
+    std::string _tempDir;
+    size_t _maxMemoryUsageBytes;
+
+    stdx::thread _thread;
+    AtomicWord<bool> _stop{false};
+    AtomicWord<bool> _done{false};
+    AtomicWord<unsigned long> _numMerged{0};
+
+    // Protects _status while running.
+    stdx::mutex _mutex;
+    Status _status = Status::OK();
+
+    unsigned long _numDocs = 0;
+    const uint64_t* _order = nullptr;  // mapped
+    const uint64_t* _positions = nullptr;  // mapped
+};
+
+}  // namespace mongo